@@ -0,0 +1,193 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <netinet/in.h>
+#include <string.h>
+
+#include "contrib/dnstap/convert.h"
+#include "contrib/dnstap/encoder.h"
+
+/* Protobuf wire types. */
+#define PB_VARINT   0
+#define PB_BYTES    2
+#define PB_FIXED32  5
+
+/* Dnstap message fields. */
+#define DNSTAP_IDENTITY  1
+#define DNSTAP_VERSION   2
+#define DNSTAP_MESSAGE   14
+#define DNSTAP_TYPE      15
+
+/* Dnstap.Message message fields. */
+#define MSG_TYPE               1
+#define MSG_SOCKET_FAMILY      2
+#define MSG_SOCKET_PROTOCOL    3
+#define MSG_QUERY_ADDRESS      4
+#define MSG_RESPONSE_ADDRESS   5
+#define MSG_QUERY_PORT         6
+#define MSG_RESPONSE_PORT      7
+#define MSG_QUERY_TIME_SEC     8
+#define MSG_QUERY_TIME_NSEC    9
+#define MSG_QUERY_MESSAGE      10
+#define MSG_RESPONSE_TIME_SEC  12
+#define MSG_RESPONSE_TIME_NSEC 13
+#define MSG_RESPONSE_MESSAGE   14
+
+/*!
+ * \brief Output buffer. If wire is NULL, the output is only measured.
+ */
+typedef struct {
+	uint8_t *wire;
+	size_t size;
+	size_t len;
+} pb_buf_t;
+
+static void pb_raw(pb_buf_t *pb, const void *data, size_t len)
+{
+	if (pb->wire != NULL && pb->len + len <= pb->size) {
+		memcpy(pb->wire + pb->len, data, len);
+	}
+	pb->len += len;
+}
+
+static void pb_varint(pb_buf_t *pb, uint64_t val)
+{
+	uint8_t buf[10];
+	size_t len = 0;
+	do {
+		buf[len] = val & 0x7F;
+		val >>= 7;
+		if (val != 0) {
+			buf[len] |= 0x80;
+		}
+		len++;
+	} while (val != 0);
+
+	pb_raw(pb, buf, len);
+}
+
+static void pb_tag(pb_buf_t *pb, unsigned field, unsigned type)
+{
+	pb_varint(pb, (field << 3) | type);
+}
+
+static void pb_uint(pb_buf_t *pb, unsigned field, uint64_t val)
+{
+	pb_tag(pb, field, PB_VARINT);
+	pb_varint(pb, val);
+}
+
+static void pb_fixed32(pb_buf_t *pb, unsigned field, uint32_t val)
+{
+	uint8_t buf[] = { val, val >> 8, val >> 16, val >> 24 };
+
+	pb_tag(pb, field, PB_FIXED32);
+	pb_raw(pb, buf, sizeof(buf));
+}
+
+static void pb_bytes(pb_buf_t *pb, unsigned field, const void *data, size_t len)
+{
+	pb_tag(pb, field, PB_BYTES);
+	pb_varint(pb, len);
+	pb_raw(pb, data, len);
+}
+
+static void put_address(pb_buf_t *pb, const struct sockaddr *sa,
+                        unsigned addr_field, unsigned port_field)
+{
+	if (sa == NULL) {
+		return;
+	}
+
+	if (sa->sa_family == AF_INET) {
+		const struct sockaddr_in *sai = (const struct sockaddr_in *)sa;
+		pb_bytes(pb, addr_field, &sai->sin_addr, sizeof(sai->sin_addr));
+		pb_uint(pb, port_field, ntohs(sai->sin_port));
+	} else if (sa->sa_family == AF_INET6) {
+		const struct sockaddr_in6 *sai6 = (const struct sockaddr_in6 *)sa;
+		pb_bytes(pb, addr_field, &sai6->sin6_addr, sizeof(sai6->sin6_addr));
+		pb_uint(pb, port_field, ntohs(sai6->sin6_port));
+	}
+}
+
+static void put_time(pb_buf_t *pb, const struct timespec *time,
+                     unsigned sec_field, unsigned nsec_field)
+{
+	if (time == NULL) {
+		return;
+	}
+
+	pb_uint(pb, sec_field, time->tv_sec);
+	pb_fixed32(pb, nsec_field, time->tv_nsec);
+}
+
+static void put_message(pb_buf_t *pb, const dt_frame_t *frame)
+{
+	pb_uint(pb, MSG_TYPE, frame->type);
+
+	const struct sockaddr *sa = frame->query_sa ? frame->query_sa : frame->response_sa;
+	if (sa != NULL) {
+		int family = dt_family_encode(sa->sa_family);
+		if (family != 0) {
+			pb_uint(pb, MSG_SOCKET_FAMILY, family);
+		}
+	}
+
+	int protocol = dt_protocol_encode(frame->protocol);
+	if (protocol != 0) {
+		pb_uint(pb, MSG_SOCKET_PROTOCOL, protocol);
+	}
+
+	put_address(pb, frame->query_sa, MSG_QUERY_ADDRESS, MSG_QUERY_PORT);
+	put_address(pb, frame->response_sa, MSG_RESPONSE_ADDRESS, MSG_RESPONSE_PORT);
+
+	put_time(pb, frame->query_time, MSG_QUERY_TIME_SEC, MSG_QUERY_TIME_NSEC);
+	put_time(pb, frame->response_time, MSG_RESPONSE_TIME_SEC, MSG_RESPONSE_TIME_NSEC);
+
+	if (dt_message_type_is_query(frame->type)) {
+		pb_bytes(pb, MSG_QUERY_MESSAGE, frame->wire, frame->wire_len);
+	} else if (dt_message_type_is_response(frame->type)) {
+		pb_bytes(pb, MSG_RESPONSE_MESSAGE, frame->wire, frame->wire_len);
+	}
+}
+
+size_t dt_frame_encode(const dt_frame_t *frame, uint8_t *buf, size_t maxlen)
+{
+	if (frame == NULL) {
+		return 0;
+	}
+
+	/* Measure the nested message first, its length precedes it. */
+	pb_buf_t msg = { NULL };
+	put_message(&msg, frame);
+
+	pb_buf_t pb = { .wire = buf, .size = maxlen };
+
+	if (frame->identity_len > 0) {
+		pb_bytes(&pb, DNSTAP_IDENTITY, frame->identity, frame->identity_len);
+	}
+	if (frame->version_len > 0) {
+		pb_bytes(&pb, DNSTAP_VERSION, frame->version, frame->version_len);
+	}
+
+	pb_tag(&pb, DNSTAP_MESSAGE, PB_BYTES);
+	pb_varint(&pb, msg.len);
+	put_message(&pb, frame);
+
+	pb_uint(&pb, DNSTAP_TYPE, DNSTAP__DNSTAP__TYPE__MESSAGE);
+
+	return pb.len;
+}
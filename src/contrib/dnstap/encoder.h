@@ -0,0 +1,65 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * \brief Allocation-free dnstap frame encoder.
+ *
+ * Serializes a Dnstap frame carrying one Message directly into a caller
+ * supplied buffer, without building the protobuf-c structures.
+ *
+ * \addtogroup dnstap
+ * @{
+ */
+
+#pragma once
+
+#include <sys/socket.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "contrib/dnstap/dnstap.pb-c.h"
+
+/*! \brief Dnstap frame contents. */
+typedef struct {
+	const uint8_t *identity;            /*!< Server identity, may be NULL. */
+	size_t identity_len;                /*!< Length of the identity. */
+	const uint8_t *version;             /*!< Server version, may be NULL. */
+	size_t version_len;                 /*!< Length of the version. */
+	Dnstap__Message__Type type;         /*!< Message type. */
+	const struct sockaddr *query_sa;    /*!< Query (remote) address, may be NULL. */
+	const struct sockaddr *response_sa; /*!< Response (local) address, may be NULL. */
+	int protocol;                       /*!< IPPROTO_UDP or IPPROTO_TCP. */
+	const struct timespec *query_time;    /*!< Query time, may be NULL. */
+	const struct timespec *response_time; /*!< Response time, may be NULL. */
+	const uint8_t *wire;                /*!< Query or response message (by type). */
+	size_t wire_len;                    /*!< Length of the message. */
+} dt_frame_t;
+
+/*!
+ * \brief Serializes the dnstap frame into the buffer.
+ *
+ * \param frame   Frame contents.
+ * \param buf     Output buffer (may be NULL if \a maxlen is 0).
+ * \param maxlen  Output buffer size.
+ *
+ * \return Frame size. If greater than \a maxlen, the buffer is too small
+ *         and its content is undefined.
+ */
+size_t dt_frame_encode(const dt_frame_t *frame, uint8_t *buf, size_t maxlen);
+
+/*! @} */
@@ -53,6 +53,7 @@ typedef uint bitmap_t; /*! Bit-maps, using the range of 1<<0 to 1<<16 (inclusive
 
 typedef struct {
 	uint32_t len; // 32 bits are enough for key lengths; probably even 16 bits would be.
+	uint32_t refs; // number of leaves (in cloned tries) pointing to the key
 	char chars[];
 } tkey_t;
 
@@ -87,6 +88,10 @@ typedef union node node_t;
  *
  * \note The branch nodes are never allocated individually, but they are
  *   always part of either the root node or the twigs array of the parent.
+ *
+ * \note The twigs arrays are prefixed by a twigs_hdr_t, which counts the tries
+ *   sharing the array (see trie_cow()). A shared array is never modified, the
+ *   path to the modified node is copied instead.
  */
 typedef struct {
 	#if FLAGS_HACK
@@ -105,6 +110,22 @@ union node {
 	branch_t branch;
 };
 
+/*! \brief Header of a twigs array. */
+typedef struct {
+	uint32_t refs; /*!< Number of branches (in cloned tries) pointing to the array. */
+	uint32_t unused;
+} twigs_hdr_t;
+
+#ifdef HAVE_ATOMIC
+ #define REF_GET(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+ #define REF_INC(x) __atomic_add_fetch(&(x), 1, __ATOMIC_RELAXED)
+ #define REF_DEC(x) __atomic_sub_fetch(&(x), 1, __ATOMIC_ACQ_REL)
+#else
+ #define REF_GET(x) (x)
+ #define REF_INC(x) (++(x))
+ #define REF_DEC(x) (--(x))
+#endif
+
 struct trie {
 	node_t root; // undefined when weight == 0, see empty_root()
 	size_t weight;
@@ -211,6 +232,97 @@ static node_t* twig(node_t *t, uint i)
 		max = bitmap_weight(t->branch.bitmap);	\
 	} while(0)
 
+/*! \brief Get the header of a twigs array. */
+static twigs_hdr_t *twigs_hdr(node_t *twigs)
+{
+	return (twigs_hdr_t *)twigs - 1;
+}
+
+/*! \brief Allocate a twigs array for the given number of children. */
+static node_t *twigs_alloc(knot_mm_t *mm, uint count)
+{
+	twigs_hdr_t *hdr = mm_alloc(mm, sizeof(twigs_hdr_t) + sizeof(node_t) * count);
+	if (unlikely(!hdr))
+		return NULL;
+	hdr->refs = 1;
+	return (node_t *)(hdr + 1);
+}
+
+/*! \brief Resize an unshared twigs array. */
+static node_t *twigs_realloc(knot_mm_t *mm, node_t *twigs, uint count, uint prev_count)
+{
+	assert(REF_GET(twigs_hdr(twigs)->refs) == 1);
+	twigs_hdr_t *hdr = mm_realloc(mm, twigs_hdr(twigs),
+	                              sizeof(twigs_hdr_t) + sizeof(node_t) * count,
+	                              sizeof(twigs_hdr_t) + sizeof(node_t) * prev_count);
+	if (unlikely(!hdr))
+		return NULL;
+	return (node_t *)(hdr + 1);
+}
+
+/*! \brief Free a twigs array, not touching the children. */
+static void twigs_free(knot_mm_t *mm, node_t *twigs)
+{
+	mm_free(mm, twigs_hdr(twigs));
+}
+
+/*! \brief Test if the twigs array of a branch is shared with another trie. */
+static bool twigs_shared(node_t *t)
+{
+	return REF_GET(twigs_hdr(t->branch.twigs)->refs) > 1;
+}
+
+/*! \brief Take a reference of the node content (twigs or key). */
+static void node_ref(node_t *t)
+{
+	if (isbranch(t))
+		REF_INC(twigs_hdr(t->branch.twigs)->refs);
+	else
+		REF_INC(t->leaf.key->refs);
+}
+
+/*! \brief Release a key, freeing it with the last reference. */
+static void key_unref(knot_mm_t *mm, tkey_t *key)
+{
+	if (REF_DEC(key->refs) == 0)
+		mm_free(mm, key);
+}
+
+/*!
+ * \brief Make the twigs array of the branch exclusively owned by the trie.
+ *
+ * The branch itself must already be exclusively owned.
+ */
+static int twigs_unshare(node_t *t, knot_mm_t *mm)
+{
+	assert(isbranch(t));
+	if (likely(!twigs_shared(t)))
+		return KNOT_EOK;
+
+	uint count = bitmap_weight(t->branch.bitmap);
+	node_t *twigs = twigs_alloc(mm, count);
+	if (unlikely(!twigs))
+		return KNOT_ENOMEM;
+	memcpy(twigs, t->branch.twigs, sizeof(node_t) * count);
+	for (uint i = 0; i < count; ++i)
+		node_ref(&twigs[i]);
+
+	// The original array stays referenced by the other trie(s).
+	if (unlikely(REF_DEC(twigs_hdr(t->branch.twigs)->refs) == 0)) {
+		// The other tries were freed meanwhile.
+		for (uint i = 0; i < count; ++i) {
+			node_t *c = &t->branch.twigs[i];
+			if (isbranch(c))
+				REF_DEC(twigs_hdr(c->branch.twigs)->refs);
+			else
+				REF_DEC(c->leaf.key->refs);
+		}
+		twigs_free(mm, t->branch.twigs);
+	}
+	t->branch.twigs = twigs;
+	return KNOT_EOK;
+}
+
 /*! \brief Simple string comparator. */
 static int key_cmp(const char *k1, uint32_t k1_len, const char *k2, uint32_t k2_len)
 {
@@ -244,17 +356,23 @@ trie_t* trie_create(knot_mm_t *mm)
 	return trie;
 }
 
-/*! \brief Free anything under the trie node, except for the passed pointer itself. */
+/*!
+ * \brief Free anything under the trie node, except for the passed pointer itself.
+ *
+ * Parts shared with other tries are only dereferenced.
+ */
 static void clear_trie(node_t *trie, knot_mm_t *mm)
 {
 	if (!isbranch(trie)) {
-		mm_free(mm, trie->leaf.key);
+		key_unref(mm, trie->leaf.key);
 	} else {
 		branch_t *b = &trie->branch;
+		if (REF_DEC(twigs_hdr(b->twigs)->refs) > 0)
+			return;
 		int len = bitmap_weight(b->bitmap);
 		for (int i = 0; i < len; ++i)
 			clear_trie(b->twigs + i, mm);
-		mm_free(mm, b->twigs);
+		twigs_free(mm, b->twigs);
 	}
 }
 
@@ -277,6 +395,18 @@ void trie_clear(trie_t *tbl)
 	tbl->weight = 0;
 }
 
+trie_t* trie_cow(trie_t *tbl)
+{
+	assert(tbl);
+	trie_t *trie = mm_alloc(&tbl->mm, sizeof(trie_t));
+	if (trie != NULL) {
+		*trie = *tbl;
+		if (trie->weight)
+			node_ref(&trie->root);
+	}
+	return trie;
+}
+
 size_t trie_weight(const trie_t *tbl)
 {
 	assert(tbl);
@@ -304,22 +434,20 @@ trie_val_t* trie_get_try(trie_t *tbl, const char *key, uint32_t len)
 int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val)
 {
 	assert(tbl);
-	if (!tbl->weight)
+	if (trie_get_try(tbl, key, len) == NULL)
 		return KNOT_ENOENT;
 	node_t *t = &tbl->root; // current and parent node
 	branch_t *p = NULL;
 	bitmap_t b = 0;
 	while (isbranch(t)) {
-		__builtin_prefetch(t->branch.twigs);
+		// Unshare the path, the removed leaf is present.
+		ERR_RETURN(twigs_unshare(t, &tbl->mm));
 		b = twigbit(t, key, len);
-		if (!hastwig(t, b))
-			return KNOT_ENOENT;
+		assert(hastwig(t, b));
 		p = &t->branch;
 		t = twig(t, twigoff(t, b));
 	}
-	if (key_cmp(key, len, t->leaf.key->chars, t->leaf.key->len) != 0)
-		return KNOT_ENOENT;
-	mm_free(&tbl->mm, t->leaf.key);
+	key_unref(&tbl->mm, t->leaf.key);
 	if (val != NULL)
 		*val = t->leaf.val; // we return trie_val_t directly when deleting
 	--tbl->weight;
@@ -336,13 +464,12 @@ int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val)
 	if (cc == 2) { // collapse binary node p: move the other child to this node
 		node_t *twigs = p->twigs;
 		(*(node_t *)p) = twigs[1 - ci]; // it might be a leaf or branch
-		mm_free(&tbl->mm, twigs);
+		twigs_free(&tbl->mm, twigs);
 		return KNOT_EOK;
 	}
 	memmove(p->twigs + ci, p->twigs + ci + 1, sizeof(node_t) * (cc - ci - 1));
 	p->bitmap &= ~b;
-	node_t *twigs = mm_realloc(&tbl->mm, p->twigs, sizeof(node_t) * (cc - 1),
-	                           sizeof(node_t) * cc);
+	node_t *twigs = twigs_realloc(&tbl->mm, p->twigs, cc - 1, cc);
 	if (likely(twigs != NULL))
 		p->twigs = twigs;
 		/* We can ignore mm_realloc failure, only beware that next time
@@ -358,6 +485,7 @@ int trie_del(trie_t *tbl, const char *key, uint32_t len, trie_val_t *val)
  * (i.e. it->len == 0).
  */
 typedef struct trie_it {
+	trie_t *tbl;    /*!< The trie, for repositioning an iterator. */
 	node_t* *stack; /*!< The stack; malloc is used directly instead of mm. */
 	uint32_t len;   /*!< Current length of the stack. */
 	uint32_t alen;  /*!< Allocated/available length of the stack. */
@@ -369,6 +497,7 @@ typedef struct trie_it {
 static void ns_init(nstack_t *ns, trie_t *tbl)
 {
 	assert(tbl);
+	ns->tbl = tbl;
 	ns->stack = ns->stack_init;
 	ns->alen = sizeof(ns->stack_init) / sizeof(ns->stack_init[0]);
 	if (tbl->weight) {
@@ -505,6 +634,25 @@ success:
 	return KNOT_EOK;
 }
 
+/*!
+ * \brief Make the path on the node stack exclusively owned by the trie.
+ *
+ * The pointers on the stack are updated to the unshared copies.
+ *
+ * \return KNOT_EOK or KNOT_ENOMEM.
+ */
+static int ns_unshare(nstack_t *ns, knot_mm_t *mm)
+{
+	assert(ns && ns->len);
+	for (uint32_t i = 0; i + 1 < ns->len; ++i) {
+		node_t *t = ns->stack[i];
+		int ci = ns->stack[i + 1] - t->branch.twigs;
+		ERR_RETURN(twigs_unshare(t, mm));
+		ns->stack[i + 1] = twig(t, ci);
+	}
+	return KNOT_EOK;
+}
+
 /*!
  * \brief Advance the node stack to the last leaf in the subtree.
  *
@@ -552,7 +700,7 @@ static int ns_prev_leaf(nstack_t *ns)
 	assert(ns && ns->len > 0);
 
 	node_t *t = ns->stack[ns->len - 1];
-	if (hastwig(t, 1 << 0)) { // the prefix leaf
+	if (isbranch(t) && hastwig(t, 1 << 0)) { // the prefix leaf
 		t = twig(t, 0);
 		ERR_RETURN(ns_longer(ns));
 		ns->stack[ns->len++] = t;
@@ -605,27 +753,24 @@ static int ns_next_leaf(nstack_t *ns)
 	} while (true);
 }
 
-int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
+/*!
+ * \brief Advance the node stack (containing just the root) to the leaf with
+ *        the less-or-equal key.
+ *
+ * \return KNOT_EOK for exact match, 1 for previous, KNOT_ENOENT for not-found,
+ *         or possibly KNOT_ENOMEM.
+ */
+static int ns_get_leq(nstack_t *ns, const char *key, uint32_t len)
 {
-	assert(tbl && val);
-	*val = NULL; // so on failure we can just return;
-	if (tbl->weight == 0)
-		return KNOT_ENOENT;
-	{ // Intentionally un-indented; until end of function, to bound cleanup attr.
+	assert(ns && ns->len == 1);
 	// First find a key with longest-matching prefix
-	__attribute__((cleanup(ns_cleanup)))
-		nstack_t ns_local;
-	ns_init(&ns_local, tbl);
-	nstack_t *ns = &ns_local;
 	branch_t bp;
 	int un_leaf; // first unmatched character in the leaf
 	ERR_RETURN(ns_find_branch(ns, key, len, &bp, &un_leaf));
 	int un_key = bp.index < len ? key[bp.index] : -256;
 	node_t *t = ns->stack[ns->len - 1];
-	if (bp.flags == 0) { // found exact match
-		*val = &t->leaf.val;
+	if (bp.flags == 0) // found exact match
 		return KNOT_EOK;
-	}
 	// Get t: the last node on matching path
 	if (isbranch(t) && t->branch.index == bp.index && t->branch.flags == bp.flags) {
 		// t is OK
@@ -656,9 +801,70 @@ int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
 	}
 success:
 	assert(!isbranch(ns->stack[ns->len - 1]));
-	*val = &ns->stack[ns->len - 1]->leaf.val;
 	return 1;
+}
+
+int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
+{
+	assert(tbl && val);
+	*val = NULL; // so on failure we can just return;
+	if (tbl->weight == 0)
+		return KNOT_ENOENT;
+	{ // Intentionally un-indented; until end of function, to bound cleanup attr.
+	__attribute__((cleanup(ns_cleanup)))
+		nstack_t ns_local;
+	ns_init(&ns_local, tbl);
+	nstack_t *ns = &ns_local;
+	int ret = ns_get_leq(ns, key, len);
+	if (ret < 0)
+		return ret;
+	*val = &ns->stack[ns->len - 1]->leaf.val;
+	return ret;
+	}
+}
+
+int trie_get_lpm(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val)
+{
+	assert(tbl && val);
+	*val = NULL;
+	if (tbl->weight == 0)
+		return KNOT_ENOENT;
+
+	// Descend along the key to any leaf, it shares all the tested nibbles.
+	node_t *t = &tbl->root;
+	while (isbranch(t)) {
+		bitmap_t b = twigbit(t, key, len);
+		t = twig(t, hastwig(t, b) ? twigoff(t, b) : 0);
+	}
+
+	// Only keys on the path that are shorter than the common prefix match.
+	const tkey_t *lkey = t->leaf.key;
+	uint32_t common = 0;
+	uint32_t max = MIN(len, lkey->len);
+	while (common < max && key[common] == lkey->chars[common])
+		++common;
+	if (common == lkey->len) {
+		*val = &t->leaf.val;
+		return (lkey->len == len) ? KNOT_EOK : 1;
+	}
+
+	// The end-of-string twig of a branch holds the key ending at its index.
+	node_t *match = NULL;
+	t = &tbl->root;
+	while (isbranch(t) && t->branch.index <= common) {
+		if (hastwig(t, 1 << 0))
+			match = twig(t, 0);
+		bitmap_t b = twigbit(t, key, len);
+		if (b == (1 << 0) || !hastwig(t, b))
+			break;
+		t = twig(t, twigoff(t, b));
 	}
+	if (match == NULL)
+		return KNOT_ENOENT;
+
+	assert(!isbranch(match) && match->leaf.key->len <= common);
+	*val = &match->leaf.val;
+	return 1;
 }
 
 /*! \brief Initialize a new leaf, copying the key, and returning failure code. */
@@ -671,6 +877,7 @@ static int mk_leaf(node_t *leaf, const char *key, uint32_t len, knot_mm_t *mm)
 	if (unlikely(!k))
 		return KNOT_ENOMEM;
 	k->len = len;
+	k->refs = 1;
 	memcpy(k->chars, key, len);
 	leaf->leaf = (leaf_t){
 		#if !FLAGS_HACK
@@ -702,6 +909,9 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 	int k2; // the first unmatched character in the leaf
 	if (unlikely(ns_find_branch(ns, key, len, &bp, &k2)))
 		return NULL;
+	// The found leaf or the modified node must not be shared.
+	if (unlikely(ns_unshare(ns, &tbl->mm)))
+		return NULL;
 	node_t *t = ns->stack[ns->len - 1];
 	if (bp.flags == 0) // the same key was already present
 		return &t->leaf.val;
@@ -714,8 +924,9 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 		bitmap_t b1 = twigbit(t, key, len);
 		assert(!hastwig(t, b1));
 		uint s, m; TWIGOFFMAX(s, m, t, b1); // new child position and original child count
-		node_t *twigs = mm_realloc(&tbl->mm, t->branch.twigs,
-				sizeof(node_t) * (m + 1), sizeof(node_t) * m);
+		if (unlikely(twigs_unshare(t, &tbl->mm)))
+			goto err_leaf;
+		node_t *twigs = twigs_realloc(&tbl->mm, t->branch.twigs, m + 1, m);
 		if (unlikely(!twigs))
 			goto err_leaf;
 		memmove(twigs + s + 1, twigs + s, sizeof(node_t) * (m - s));
@@ -733,7 +944,7 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 				assert(hastwig(pt, twigbit(pt, key, len)));
 			}
 		#endif
-		node_t *twigs = mm_alloc(&tbl->mm, sizeof(node_t) * 2);
+		node_t *twigs = twigs_alloc(&tbl->mm, 2);
 		if (unlikely(!twigs))
 			goto err_leaf;
 		node_t t2 = *t; // Save before overwriting t.
@@ -749,7 +960,7 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len)
 		return &twig(t, twigoff(t, b1))->leaf.val;
 	};
 err_leaf:
-	mm_free(&tbl->mm, leaf.leaf.key);
+	key_unref(&tbl->mm, leaf.leaf.key);
 	return NULL;
 	}
 }
@@ -774,6 +985,28 @@ int trie_apply(trie_t *tbl, int (*f)(trie_val_t *, void *), void *d)
 	return apply_trie(&tbl->root, f, d);
 }
 
+/*! \brief Apply a function to every trie_val_t*, in order, unsharing the path. */
+static int apply_trie_cow(node_t *t, int (*f)(trie_val_t *, void *), void *d,
+                          knot_mm_t *mm)
+{
+	assert(t);
+	if (!isbranch(t))
+		return f(&t->leaf.val, d);
+	ERR_RETURN(twigs_unshare(t, mm));
+	int child_count = bitmap_weight(t->branch.bitmap);
+	for (int i = 0; i < child_count; ++i)
+		ERR_RETURN(apply_trie_cow(twig(t, i), f, d, mm));
+	return KNOT_EOK;
+}
+
+int trie_apply_cow(trie_t *tbl, int (*f)(trie_val_t *, void *), void *d)
+{
+	assert(tbl && f);
+	if (!tbl->weight)
+		return KNOT_EOK;
+	return apply_trie_cow(&tbl->root, f, d, &tbl->mm);
+}
+
 /* These are all thin wrappers around static Tns* functions. */
 trie_it_t* trie_it_begin(trie_t *tbl)
 {
@@ -799,6 +1032,51 @@ void trie_it_next(trie_it_t *it)
 		it->len = 0;
 }
 
+void trie_it_prev(trie_it_t *it)
+{
+	assert(it && it->len);
+	if (ns_prev_leaf(it) != KNOT_EOK)
+		it->len = 0;
+}
+
+int trie_it_get_leq(trie_it_t *it, const char *key, uint32_t len)
+{
+	assert(it && it->tbl);
+	it->len = 0;
+	if (it->tbl->weight == 0)
+		return KNOT_ENOENT;
+	it->stack[0] = &it->tbl->root;
+	it->len = 1;
+	int ret = ns_get_leq(it, key, len);
+	if (ret < 0)
+		it->len = 0;
+	return ret;
+}
+
+void trie_it_first(trie_it_t *it)
+{
+	assert(it && it->tbl);
+	it->len = 0;
+	if (it->tbl->weight == 0)
+		return;
+	it->stack[0] = &it->tbl->root;
+	it->len = 1;
+	if (ns_first_leaf(it) != KNOT_EOK)
+		it->len = 0;
+}
+
+void trie_it_last(trie_it_t *it)
+{
+	assert(it && it->tbl);
+	it->len = 0;
+	if (it->tbl->weight == 0)
+		return;
+	it->stack[0] = &it->tbl->root;
+	it->len = 1;
+	if (ns_last_leaf(it) != KNOT_EOK)
+		it->len = 0;
+}
+
 bool trie_it_finished(trie_it_t *it)
 {
 	assert(it);
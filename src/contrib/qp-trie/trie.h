@@ -28,6 +28,11 @@
  *   the structure copies the contents of the passed keys
  * - values are void* pointers, typically you get an ephemeral pointer to it
  * - key lengths are limited by 2^32-1 ATM
+ * - a trie can be cloned in constant time (trie_cow()), the clones share
+ *   their structure and a modification copies just the path to the changed
+ *   leaf; the values returned by trie_get_try(), trie_apply() or trie_it_val()
+ *   are shared by the clones, use trie_get_ins() or trie_apply_cow() to
+ *   rewrite a value in one clone only
  */
 
 /*! \brief Element value. */
@@ -45,6 +50,16 @@ trie_t* trie_create(knot_mm_t *mm);
 /*! \brief Free a trie instance. */
 void trie_free(trie_t *tbl);
 
+/*!
+ * \brief Create a copy-on-write clone of the trie.
+ *
+ * The clone shares the memory context and all the structure with the original,
+ * each of them can be modified or freed independently of the other.
+ *
+ * \return The clone or NULL on error.
+ */
+trie_t* trie_cow(trie_t *tbl);
+
 /*! \brief Clear a trie instance (make it empty). */
 void trie_clear(trie_t *tbl);
 
@@ -69,6 +84,20 @@ trie_val_t* trie_get_ins(trie_t *tbl, const char *key, uint32_t len);
  */
 int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val);
 
+/*!
+ * \brief Search for the longest key that is a prefix of the searched key.
+ *
+ * If all keys end with a separator (e.g. lookup format of domain names),
+ * only separator-aligned prefixes can match.
+ *
+ * \param tbl  Trie.
+ * \param key  Searched key.
+ * \param len  Key length.
+ * \param val  Must be valid; it will be set to NULL if not found.
+ * \return KNOT_EOK for exact match, 1 for shorter prefix, KNOT_ENOENT for not-found.
+ */
+int trie_get_lpm(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val);
+
 /*!
  * \brief Apply a function to every trie_val_t, in order.
  *
@@ -76,6 +105,16 @@ int trie_get_leq(trie_t *tbl, const char *key, uint32_t len, trie_val_t **val);
  */
 int trie_apply(trie_t *tbl, int (*f)(trie_val_t *, void *), void *d);
 
+/*!
+ * \brief Apply a function to every trie_val_t, in order, allowing to rewrite it.
+ *
+ * Unlike trie_apply(), the structure shared with other clones is copied first,
+ * so the function may change the value without affecting the other clones.
+ *
+ * \return KNOT_EOK if success or KNOT_E* if error.
+ */
+int trie_apply_cow(trie_t *tbl, int (*f)(trie_val_t *, void *), void *d);
+
 /*!
  * \brief Remove an item, returning KNOT_EOK if succeeded or KNOT_ENOENT if not found.
  *
@@ -94,6 +133,23 @@ trie_it_t* trie_it_begin(trie_t *tbl);
  */
 void trie_it_next(trie_it_t *it);
 
+/*! \brief Move the iterator to the previous element (finish it if there's none). */
+void trie_it_prev(trie_it_t *it);
+
+/*!
+ * \brief Move the iterator to the element with the less-or-equal key.
+ *
+ * \return KNOT_EOK for exact match, 1 for previous, KNOT_ENOENT for not-found
+ *         (the iterator is finished then), or KNOT_E*.
+ */
+int trie_it_get_leq(trie_it_t *it, const char *key, uint32_t len);
+
+/*! \brief Move the iterator to the first element (if any). */
+void trie_it_first(trie_it_t *it);
+
+/*! \brief Move the iterator to the last element (if any). */
+void trie_it_last(trie_it_t *it);
+
 /*! \brief Test if the iterator has gone past the last element. */
 bool trie_it_finished(trie_it_t *it);
 
@@ -153,6 +153,24 @@ int dnssec_nsec3_hash(const dnssec_binary_t *data,
 		      const dnssec_nsec3_params_t *params,
 		      dnssec_binary_t *hash);
 
+/*!
+ * Compute NSEC3 hashes for a batch of data with the same parameters.
+ *
+ * This is faster than repeated dnssec_nsec3_hash() calls as the hashing
+ * context is initialized only once and no memory is allocated.
+ *
+ * \param[in]  data    Array of data to be hashed (usually domain names).
+ * \param[in]  count   Number of items in the array.
+ * \param[in]  params  NSEC3 parameters.
+ * \param[out] hashes  Output buffer for \a count raw hashes, each
+ *                     dnssec_nsec3_hash_length() bytes long.
+ *
+ * \return Error code, DNSSEC_EOK if successful.
+ */
+int dnssec_nsec3_hash_batch(const dnssec_binary_t *data, size_t count,
+			    const dnssec_nsec3_params_t *params,
+			    uint8_t *hashes);
+
 /*!
  * Get length of raw NSEC3 hash for a given algorithm.
  *
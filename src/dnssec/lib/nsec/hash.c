@@ -24,54 +24,70 @@
 #include "shared.h"
 
 /*!
- * Compute NSEC3 hash for given data and algorithm.
+ * Compute NSEC3 hash for given data using an initialized digest context.
  *
  * \see RFC 5155
  *
  * \todo Input data should be converted to lowercase.
  */
+static int nsec3_hash_digest(gnutls_hash_hd_t digest, int iterations,
+			     const dnssec_binary_t *salt, const dnssec_binary_t *data,
+			     uint8_t *hash, size_t hash_size)
+{
+	const uint8_t *in = data->data;
+	size_t in_size = data->size;
+
+	for (int i = 0; i <= iterations; i++) {
+		int result = gnutls_hash(digest, in, in_size);
+		if (result < 0) {
+			return DNSSEC_NSEC3_HASHING_ERROR;
+		}
+
+		result = gnutls_hash(digest, salt->data, salt->size);
+		if (result < 0) {
+			return DNSSEC_NSEC3_HASHING_ERROR;
+		}
+
+		// Output resets the context for the next round.
+		gnutls_hash_output(digest, hash);
+
+		in = hash;
+		in_size = hash_size;
+	}
+
+	return DNSSEC_EOK;
+}
+
+/*!
+ * Compute NSEC3 hashes for given data and algorithm.
+ *
+ * The digest context is shared by all the items.
+ */
 static int nsec3_hash(gnutls_digest_algorithm_t algorithm, int iterations,
 		      const dnssec_binary_t *salt, const dnssec_binary_t *data,
-		      dnssec_binary_t *hash)
+		      size_t count, uint8_t *hashes)
 {
 	assert(salt);
 	assert(data);
-	assert(hash);
+	assert(hashes);
 
 	int hash_size = gnutls_hash_get_len(algorithm);
 	if (hash_size <= 0) {
 		return DNSSEC_NSEC3_HASHING_ERROR;
 	}
 
-	int result = dnssec_binary_resize(hash, hash_size);
-	if (result != DNSSEC_EOK) {
-		return result;
-	}
-
 	_cleanup_hash_ gnutls_hash_hd_t digest = NULL;
-	result = gnutls_hash_init(&digest, algorithm);
+	int result = gnutls_hash_init(&digest, algorithm);
 	if (result < 0) {
 		return DNSSEC_NSEC3_HASHING_ERROR;
 	}
 
-	const uint8_t *in = data->data;
-	size_t in_size = data->size;
-
-	for (int i = 0; i <= iterations; i++) {
-		result = gnutls_hash(digest, in, in_size);
-		if (result < 0) {
-			return DNSSEC_NSEC3_HASHING_ERROR;
-		}
-
-		result = gnutls_hash(digest, salt->data, salt->size);
-		if (result < 0) {
-			return DNSSEC_NSEC3_HASHING_ERROR;
+	for (size_t i = 0; i < count; i++) {
+		result = nsec3_hash_digest(digest, iterations, salt, &data[i],
+					   hashes + i * hash_size, hash_size);
+		if (result != DNSSEC_EOK) {
+			return result;
 		}
-
-		gnutls_hash_output(digest, hash->data);
-
-		in = hash->data;
-		in_size = hash->size;
 	}
 
 	return DNSSEC_EOK;
@@ -107,7 +123,39 @@ int dnssec_nsec3_hash(const dnssec_binary_t *data,
 		return DNSSEC_INVALID_NSEC3_ALGORITHM;
 	}
 
-	return nsec3_hash(algorithm, params->iterations, &params->salt, data, hash);
+	int hash_size = gnutls_hash_get_len(algorithm);
+	if (hash_size <= 0) {
+		return DNSSEC_NSEC3_HASHING_ERROR;
+	}
+
+	int result = dnssec_binary_resize(hash, hash_size);
+	if (result != DNSSEC_EOK) {
+		return result;
+	}
+
+	return nsec3_hash(algorithm, params->iterations, &params->salt, data, 1,
+			  hash->data);
+}
+
+/*!
+ * Compute NSEC3 hashes for a batch of data.
+ */
+_public_
+int dnssec_nsec3_hash_batch(const dnssec_binary_t *data, size_t count,
+			    const dnssec_nsec3_params_t *params,
+			    uint8_t *hashes)
+{
+	if (!data || !params || !hashes) {
+		return DNSSEC_EINVAL;
+	}
+
+	gnutls_digest_algorithm_t algorithm = algorithm_d2g(params->algorithm);
+	if (algorithm == GNUTLS_DIG_UNKNOWN) {
+		return DNSSEC_INVALID_NSEC3_ALGORITHM;
+	}
+
+	return nsec3_hash(algorithm, params->iterations, &params->salt, data,
+			  count, hashes);
 }
 
 /*!
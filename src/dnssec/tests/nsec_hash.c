@@ -14,6 +14,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdbool.h>
 #include <string.h>
 #include <tap/basic.h>
 
@@ -84,6 +85,37 @@ static void test_hashing(void)
 	dnssec_binary_free(&hash);
 }
 
+static void test_hashing_batch(void)
+{
+	const dnssec_binary_t names[] = {
+		{ .size = 13, .data = (uint8_t *) "\x08""knot-dns""\x02""cz" },
+		{ .size = 1,  .data = (uint8_t *) "" },
+		{ .size = 16, .data = (uint8_t *) "\x02""ns""\x08""knot-dns""\x02""cz" },
+	};
+	const size_t count = sizeof(names) / sizeof(names[0]);
+
+	const dnssec_nsec3_params_t params = {
+		.algorithm = DNSSEC_NSEC3_ALGORITHM_SHA1,
+		.flags = 0,
+		.iterations = 7,
+		.salt = { .size = 14, .data = (uint8_t *) "happywithnsec3" }
+	};
+
+	uint8_t hashes[3 * 20] = { 0 };
+	int result = dnssec_nsec3_hash_batch(names, count, &params, hashes);
+	ok(result == DNSSEC_EOK, "dnssec_nsec3_hash_batch()");
+
+	bool match = true;
+	for (size_t i = 0; i < count; i++) {
+		dnssec_binary_t hash = { 0 };
+		result = dnssec_nsec3_hash(&names[i], &params, &hash);
+		match = match && result == DNSSEC_EOK && hash.size == 20 &&
+		        memcmp(hash.data, hashes + i * 20, 20) == 0;
+		dnssec_binary_free(&hash);
+	}
+	ok(match, "batch hashes match single hashes");
+}
+
 static void test_clear(void)
 {
 	const dnssec_nsec3_params_t empty = { 0 };
@@ -108,6 +140,7 @@ int main(void)
 	test_length();
 	test_parsing();
 	test_hashing();
+	test_hashing_batch();
 	test_clear();
 
 	return 0;
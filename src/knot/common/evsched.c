@@ -23,40 +23,152 @@
 #include "libknot/libknot.h"
 #include "knot/server/dthreads.h"
 #include "knot/common/evsched.h"
+#include "contrib/time.h"
 
-/*! \brief Some implementations of timercmp >= are broken, this is for compat.*/
-static inline int timercmp_ge(struct timeval *a, struct timeval *b) {
-	return timercmp(a, b, >) || timercmp(a, b, ==);
+#define SLOT_BITS 6
+#define SLOT_MASK (EVSCHED_SLOTS - 1)
+#define TICK_MAX UINT64_MAX
+
+enum event_state {
+	EVENT_IDLE = 0,
+	EVENT_SCHEDULED,
+	EVENT_EXPIRED,
+};
+
+/*! \brief Get scheduler ticks (milliseconds since the scheduler init). */
+static uint64_t ticks_now(const evsched_t *sched)
+{
+	struct timespec now = time_now();
+	struct timespec diff = time_diff(&sched->epoch, &now);
+
+	return (uint64_t)diff.tv_sec * 1000 + diff.tv_nsec / 1000000;
 }
 
-static int compare_event_heap_nodes(void *e1, void *e2)
+static void wheel_insert(evsched_t *sched, event_t *ev)
 {
-	if (timercmp(&((event_t *)e1)->tv, &((event_t *)e2)->tv, <)) return -1;
-	if (timercmp(&((event_t *)e1)->tv, &((event_t *)e2)->tv, >)) return 1;
-	return 0;
+	uint64_t time = (ev->time > sched->now) ? ev->time : sched->now;
+
+	unsigned level = 0;
+	uint64_t diff = time ^ sched->now;
+	if (diff != 0) {
+		level = (63 - __builtin_clzll(diff)) / SLOT_BITS;
+		if (level >= EVSCHED_LEVELS) {
+			level = EVSCHED_LEVELS - 1;
+		}
+	}
+	unsigned slot = (time >> (level * SLOT_BITS)) & SLOT_MASK;
+
+	add_tail(&sched->wheel[level][slot], &ev->n);
+	sched->occupied[level] |= UINT64_C(1) << slot;
+	ev->state = EVENT_SCHEDULED;
+	ev->level = level;
+	ev->slot = slot;
 }
 
-/*!
- * \brief Get time T (now) + dt miliseconds.
- */
-static struct timeval timeval_in(uint32_t dt)
+/*! \brief Remove the event from the wheel or the expired list. */
+static void wheel_remove(evsched_t *sched, event_t *ev)
 {
-	struct timeval tv = { 0 };
-	gettimeofday(&tv, NULL);
+	switch (ev->state) {
+	case EVENT_SCHEDULED:
+		rem_node(&ev->n);
+		if (EMPTY_LIST(sched->wheel[ev->level][ev->slot])) {
+			sched->occupied[ev->level] &= ~(UINT64_C(1) << ev->slot);
+		}
+		break;
+	case EVENT_EXPIRED:
+		rem_node(&ev->n);
+		break;
+	default:
+		break;
+	}
+
+	ev->state = EVENT_IDLE;
+}
+
+/*! \brief Get the time when the wheel reaches the next non-empty slot. */
+static bool wheel_next(const evsched_t *sched, uint64_t *next)
+{
+	bool found = false;
+
+	for (unsigned level = 0; level < EVSCHED_LEVELS; level++) {
+		unsigned shift = level * SLOT_BITS;
+		unsigned current = (sched->now >> shift) & SLOT_MASK;
+		uint64_t pending = sched->occupied[level] & (~UINT64_C(0) << current);
+		if (pending == 0) {
+			continue;
+		}
+
+		unsigned slot = __builtin_ctzll(pending);
+		uint64_t time = (sched->now >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+		time += (uint64_t)slot << shift;
+		if (time < sched->now) {
+			time = sched->now;
+		}
+		if (!found || time < *next) {
+			*next = time;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+/*! \brief Move the wheel time forward, collect the expired events. */
+static void wheel_advance(evsched_t *sched, uint64_t target)
+{
+	uint64_t next = 0;
+	while (wheel_next(sched, &next) && next <= target) {
+		sched->now = next;
+
+		/* Cascade the entered slots from the top, so the events can fall through. */
+		for (unsigned level = EVSCHED_LEVELS - 1; level > 0; level--) {
+			unsigned slot = (next >> (level * SLOT_BITS)) & SLOT_MASK;
+			if (!(sched->occupied[level] & (UINT64_C(1) << slot))) {
+				continue;
+			}
+			sched->occupied[level] &= ~(UINT64_C(1) << slot);
+
+			event_t *ev = NULL, *nxt = NULL;
+			WALK_LIST_DELSAFE(ev, nxt, sched->wheel[level][slot]) {
+				rem_node(&ev->n);
+				wheel_insert(sched, ev);
+			}
+		}
 
-	/* Add number of seconds. */
-	tv.tv_sec += dt / 1000;
+		unsigned slot = next & SLOT_MASK;
+		sched->occupied[0] &= ~(UINT64_C(1) << slot);
 
-	/* Add the number of microseconds. */
-	tv.tv_usec += (dt % 1000) * 1000;
+		event_t *ev = NULL, *nxt = NULL;
+		WALK_LIST_DELSAFE(ev, nxt, sched->wheel[0][slot]) {
+			rem_node(&ev->n);
+			add_tail(&sched->expired, &ev->n);
+			ev->state = EVENT_EXPIRED;
+		}
+	}
+
+	if (target > sched->now) {
+		sched->now = target;
+	}
+}
+
+/*! \brief Wait until the given tick or an interrupt. */
+static void wait_until(evsched_t *sched, uint64_t tick)
+{
+	uint64_t now = ticks_now(sched);
+	uint64_t wait = (tick > now) ? tick - now : 0;
 
-	/* Check for overflow. */
-	while (tv.tv_usec > 999999) {
-		tv.tv_sec += 1;
-		tv.tv_usec -= 1 * 1000 * 1000;
+	struct timeval tv = { 0 };
+	gettimeofday(&tv, NULL);
+
+	struct timespec ts;
+	ts.tv_sec = tv.tv_sec + wait / 1000;
+	ts.tv_nsec = tv.tv_usec * 1000L + (wait % 1000) * 1000000L;
+	if (ts.tv_nsec > 999999999) {
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000000000L;
 	}
 
-	return tv;
+	pthread_cond_timedwait(&sched->notify, &sched->lock, &ts);
 }
 
 /*! \brief Event scheduler loop. */
@@ -68,33 +180,37 @@ static int evsched_run(dthread_t *thread)
 	}
 
 	/* Run event loop. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	while (!dt_is_cancelled(thread)) {
-		if (EMPTY_HEAP(&sched->heap)) {
-			pthread_cond_wait(&sched->notify, &sched->heap_lock);
-			continue;
-		}
-
-		/* Get current time. */
-		struct timeval dt;
-		gettimeofday(&dt, 0);
+		sched->wake_at = 0;
+		wheel_advance(sched, ticks_now(sched));
 
-		/* Get next event. */
-		event_t *ev = *((event_t**)HHEAD(&sched->heap));
-		assert(ev != NULL);
+		/* Dispatch the expired events, the callbacks run unlocked. */
+		if (!EMPTY_LIST(sched->expired)) {
+			event_t *ev = HEAD(sched->expired);
+			rem_node(&ev->n);
+			ev->state = EVENT_IDLE;
+			sched->firing = ev;
+			pthread_mutex_unlock(&sched->lock);
 
-		if (timercmp_ge(&dt, &ev->tv)) {
-			heap_delmin(&sched->heap);
 			ev->cb(ev);
+
+			pthread_mutex_lock(&sched->lock);
+			sched->firing = NULL;
+			pthread_cond_broadcast(&sched->fired);
+			continue;
+		}
+
+		uint64_t next = 0;
+		if (wheel_next(sched, &next)) {
+			sched->wake_at = next;
+			wait_until(sched, next);
 		} else {
-			/* Wait for next event or interrupt. Unlock calendar. */
-			struct timespec ts;
-			ts.tv_sec = ev->tv.tv_sec;
-			ts.tv_nsec = ev->tv.tv_usec * 1000L;
-			pthread_cond_timedwait(&sched->notify, &sched->heap_lock, &ts);
+			sched->wake_at = TICK_MAX;
+			pthread_cond_wait(&sched->notify, &sched->lock);
 		}
 	}
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	return KNOT_EOK;
 }
@@ -105,9 +221,16 @@ int evsched_init(evsched_t *sched, void *ctx)
 	sched->ctx = ctx;
 
 	/* Initialize event calendar. */
-	pthread_mutex_init(&sched->heap_lock, 0);
+	pthread_mutex_init(&sched->lock, 0);
 	pthread_cond_init(&sched->notify, 0);
-	heap_init(&sched->heap, compare_event_heap_nodes, 0);
+	pthread_cond_init(&sched->fired, 0);
+	sched->epoch = time_now();
+	for (int level = 0; level < EVSCHED_LEVELS; level++) {
+		for (int slot = 0; slot < EVSCHED_SLOTS; slot++) {
+			init_list(&sched->wheel[level][slot]);
+		}
+	}
+	init_list(&sched->expired);
 
 	sched->thread = dt_create(1, evsched_run, NULL, sched);
 
@@ -126,17 +249,23 @@ void evsched_deinit(evsched_t *sched)
 	}
 
 	/* Deinitialize event calendar. */
-	pthread_mutex_destroy(&sched->heap_lock);
+	pthread_mutex_destroy(&sched->lock);
 	pthread_cond_destroy(&sched->notify);
-
-	while (!EMPTY_HEAP(&sched->heap)) {
-		event_t *e = (event_t *)*HHEAD(&sched->heap);
-		heap_delmin(&sched->heap);
+	pthread_cond_destroy(&sched->fired);
+
+	for (int level = 0; level < EVSCHED_LEVELS; level++) {
+		for (int slot = 0; slot < EVSCHED_SLOTS; slot++) {
+			event_t *e = NULL, *nxt = NULL;
+			WALK_LIST_DELSAFE(e, nxt, sched->wheel[level][slot]) {
+				evsched_event_free(e);
+			}
+		}
+	}
+	event_t *e = NULL, *nxt = NULL;
+	WALK_LIST_DELSAFE(e, nxt, sched->expired) {
 		evsched_event_free(e);
 	}
 
-	heap_deinit(&sched->heap);
-
 	if (sched->thread != NULL) {
 		dt_delete(&sched->thread);
 	}
@@ -163,7 +292,6 @@ event_t *evsched_event_create(evsched_t *sched, event_cb_t cb, void *data)
 	e->sched = sched;
 	e->cb = cb;
 	e->data = data;
-	e->hpos.pos=0;
 
 	return e;
 }
@@ -183,26 +311,25 @@ int evsched_schedule(event_t *ev, uint32_t dt)
 		return KNOT_EINVAL;
 	}
 
-	struct timeval new_time = timeval_in(dt);
-
 	evsched_t *sched = ev->sched;
 
+	uint64_t time = ticks_now(sched) + dt;
+
 	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 
-	ev->tv = new_time;
+	/* Replace the previous timer. */
+	wheel_remove(sched, ev);
+	ev->time = time;
+	wheel_insert(sched, ev);
 
-	/* Make sure it's not already enqueued. */
-	int found = heap_find(&sched->heap, (heap_val_t *)ev);
-	if (found > 0) {
-		heap_replace(&sched->heap, found, (heap_val_t *)ev);
-	} else {
-		heap_insert(&sched->heap, (heap_val_t *)ev);
+	/* Wake up the scheduler only if it sleeps beyond the event. */
+	if (time < sched->wake_at) {
+		pthread_cond_signal(&sched->notify);
 	}
 
 	/* Unlock calendar. */
-	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	return KNOT_EOK;
 }
@@ -216,19 +343,20 @@ int evsched_cancel(event_t *ev)
 	evsched_t *sched = ev->sched;
 
 	/* Lock calendar. */
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
+
+	wheel_remove(sched, ev);
 
-	int found = heap_find(&sched->heap, (heap_val_t *)ev);
-	if (found > 0) {
-		heap_delete(&sched->heap, found);
+	/* Wait for the running callback. */
+	while (sched->firing == ev) {
+		pthread_cond_wait(&sched->fired, &sched->lock);
 	}
 
 	/* Unlock calendar. */
-	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 
 	/* Reset event timer. */
-	memset(&ev->tv, 0, sizeof(struct timeval));
+	ev->time = 0;
 
 	return KNOT_EOK;
 }
@@ -240,10 +368,10 @@ void evsched_start(evsched_t *sched)
 
 void evsched_stop(evsched_t *sched)
 {
-	pthread_mutex_lock(&sched->heap_lock);
+	pthread_mutex_lock(&sched->lock);
 	dt_stop(sched->thread);
 	pthread_cond_signal(&sched->notify);
-	pthread_mutex_unlock(&sched->heap_lock);
+	pthread_mutex_unlock(&sched->lock);
 }
 
 void evsched_join(evsched_t *sched)
@@ -15,6 +15,13 @@
  */
 /*!
  * \brief Event scheduler.
+ *
+ * The events are kept in a hierarchical timing wheel with millisecond ticks.
+ * Each level has 64 slots, a slot on level N covers 64^N ticks. An event is
+ * placed on the level given by the highest bit in which its time differs
+ * from the wheel time, so inserting and canceling is O(1). Once the wheel
+ * time enters a slot on a higher level, its events are cascaded to the lower
+ * levels. Empty slots are skipped using per-level occupancy bitmaps.
  */
 
 #pragma once
@@ -25,7 +32,12 @@
 #include <sys/time.h>
 
 #include "knot/server/dthreads.h"
-#include "contrib/ucw/heap.h"
+#include "contrib/ucw/lists.h"
+
+/*! \brief Number of timing wheel levels (covers 2^42 ms). */
+#define EVSCHED_LEVELS 7
+/*! \brief Number of slots on one timing wheel level. */
+#define EVSCHED_SLOTS 64
 
 /* Forward decls. */
 struct evsched;
@@ -50,8 +62,11 @@ typedef void (*event_cb_t)(struct event *);
  * \brief Event structure.
  */
 typedef struct event {
-	struct heap_val hpos;
-	struct timeval tv; /*!< Event scheduled time. */
+	node_t n;          /*!< Node in the wheel slot or in the expired list. */
+	uint64_t time;     /*!< Event scheduled time (scheduler ticks). */
+	uint8_t state;     /*!< Idle, scheduled or expired. */
+	uint8_t level;     /*!< Wheel level of the scheduled event. */
+	uint8_t slot;      /*!< Wheel slot of the scheduled event. */
 	void *data;        /*!< Usable data ptr. */
 	event_cb_t cb;     /*!< Event callback. */
 	struct evsched *sched; /*!< Scheduler for this event. */
@@ -62,9 +77,16 @@ typedef struct event {
  */
 typedef struct evsched {
 	volatile bool running;     /*!< True if running. */
-	pthread_mutex_t heap_lock; /*!< Event heap locking. */
-	pthread_cond_t notify;     /*!< Event heap notification. */
-	struct heap heap;          /*!< Event heap. */
+	pthread_mutex_t lock;      /*!< Event wheel locking. */
+	pthread_cond_t notify;     /*!< Event wheel notification. */
+	pthread_cond_t fired;      /*!< Event callback finished. */
+	struct timespec epoch;     /*!< Time of the tick zero. */
+	uint64_t now;              /*!< Wheel time (ticks). */
+	uint64_t wake_at;          /*!< Planned wake up of the scheduler thread. */
+	uint64_t occupied[EVSCHED_LEVELS];            /*!< Non-empty slots bitmaps. */
+	list_t wheel[EVSCHED_LEVELS][EVSCHED_SLOTS];  /*!< Event wheel. */
+	list_t expired;            /*!< Expired events waiting for dispatch. */
+	event_t *firing;           /*!< Event with the callback in progress. */
 	void *ctx;                 /*!< Scheduler context. */
 	dt_unit_t *thread;
 } evsched_t;
@@ -14,6 +14,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -28,16 +29,77 @@
 		return KNOT_ENOMEM; \
 	(p) = tmp;
 
+/*! \brief Empty watchdog wheel link. */
+#define TW_NONE ((unsigned)-1)
+
 static int fdset_resize(fdset_t *set, unsigned size)
 {
 	void *tmp = NULL;
 	MEM_RESIZE(tmp, set->ctx, size);
+#ifdef ENABLE_EPOLL
+	MEM_RESIZE(tmp, set->fd, size);
+	MEM_RESIZE(tmp, set->ev, size);
+#else
 	MEM_RESIZE(tmp, set->pfd, size);
+#endif
 	MEM_RESIZE(tmp, set->timeout, size);
+	MEM_RESIZE(tmp, set->tw_next, size);
+	MEM_RESIZE(tmp, set->tw_prev, size);
 	set->size = size;
 	return KNOT_EOK;
 }
 
+#ifdef ENABLE_EPOLL
+static uint32_t events_to_epoll(unsigned events)
+{
+	return ((events & POLLIN)  ? EPOLLIN  : 0) |
+	       ((events & POLLOUT) ? EPOLLOUT : 0);
+}
+
+static unsigned events_from_epoll(uint32_t events)
+{
+	return ((events & EPOLLIN)  ? POLLIN  : 0) |
+	       ((events & EPOLLOUT) ? POLLOUT : 0) |
+	       ((events & EPOLLERR) ? POLLERR : 0) |
+	       ((events & EPOLLHUP) ? POLLHUP : 0);
+}
+#endif
+
+/*! \brief Link the fd to the wheel slot of its timeout. */
+static void tw_link(fdset_t *set, unsigned i)
+{
+	if (set->timeout[i] == 0) {
+		return;
+	}
+
+	unsigned *head = &set->tw_slot[set->timeout[i] % FDSET_WHEEL_SIZE];
+	set->tw_prev[i] = TW_NONE;
+	set->tw_next[i] = *head;
+	if (*head != TW_NONE) {
+		set->tw_prev[*head] = i;
+	}
+	*head = i;
+}
+
+/*! \brief Unlink the fd from its wheel slot. */
+static void tw_unlink(fdset_t *set, unsigned i)
+{
+	if (set->timeout[i] == 0) {
+		return;
+	}
+
+	unsigned next = set->tw_next[i];
+	unsigned prev = set->tw_prev[i];
+	if (prev != TW_NONE) {
+		set->tw_next[prev] = next;
+	} else {
+		set->tw_slot[set->timeout[i] % FDSET_WHEEL_SIZE] = next;
+	}
+	if (next != TW_NONE) {
+		set->tw_prev[next] = prev;
+	}
+}
+
 int fdset_init(fdset_t *set, unsigned size)
 {
 	if (set == NULL) {
@@ -45,6 +107,24 @@ int fdset_init(fdset_t *set, unsigned size)
 	}
 
 	memset(set, 0, sizeof(fdset_t));
+	for (unsigned i = 0; i < FDSET_WHEEL_SIZE; i++) {
+		set->tw_slot[i] = TW_NONE;
+	}
+	set->tw_time = time_now().tv_sec;
+
+#ifdef ENABLE_EPOLL
+	set->efd = epoll_create1(EPOLL_CLOEXEC);
+	if (set->efd < 0) {
+		return knot_map_errno();
+	}
+
+	/* Not resized with the set, the iterator points into it. */
+	set->recv_ev = malloc(FDSET_INIT_SIZE * sizeof(*set->recv_ev));
+	if (set->recv_ev == NULL) {
+		return KNOT_ENOMEM;
+	}
+#endif
+
 	return fdset_resize(set, size);
 }
 
@@ -55,9 +135,23 @@ int fdset_clear(fdset_t* set)
 	}
 
 	free(set->ctx);
+#ifdef ENABLE_EPOLL
+	free(set->fd);
+	free(set->ev);
+	free(set->recv_ev);
+	if (set->efd >= 0) {
+		close(set->efd);
+	}
+#else
 	free(set->pfd);
+#endif
 	free(set->timeout);
+	free(set->tw_next);
+	free(set->tw_prev);
 	memset(set, 0, sizeof(fdset_t));
+#ifdef ENABLE_EPOLL
+	set->efd = -1;
+#endif
 	return KNOT_EOK;
 }
 
@@ -72,23 +166,62 @@ int fdset_add(fdset_t *set, int fd, unsigned events, void *ctx)
 		return KNOT_ENOMEM;
 
 	/* Initialize. */
-	int i = set->n++;
+	int i = set->n;
+#ifdef ENABLE_EPOLL
+	set->fd[i] = fd;
+	set->ev[i].events = events_to_epoll(events);
+	set->ev[i].data.u64 = i;
+	if (epoll_ctl(set->efd, EPOLL_CTL_ADD, fd, &set->ev[i]) != 0) {
+		return knot_map_errno();
+	}
+#else
 	set->pfd[i].fd = fd;
 	set->pfd[i].events = events;
 	set->pfd[i].revents = 0;
+#endif
 	set->ctx[i] = ctx;
 	set->timeout[i] = 0;
+	set->n++;
 
 	/* Return index to this descriptor. */
 	return i;
 }
 
+int fdset_set_events(fdset_t *set, unsigned i, unsigned events)
+{
+	if (set == NULL || i >= set->n) {
+		return KNOT_EINVAL;
+	}
+
+#ifdef ENABLE_EPOLL
+	uint32_t ev = events_to_epoll(events);
+	if (set->ev[i].events == ev) {
+		return KNOT_EOK;
+	}
+	set->ev[i].events = ev;
+	set->ev[i].data.u64 = i;
+	if (epoll_ctl(set->efd, EPOLL_CTL_MOD, set->fd[i], &set->ev[i]) != 0) {
+		return knot_map_errno();
+	}
+#else
+	set->pfd[i].events = events;
+#endif
+
+	return KNOT_EOK;
+}
+
 int fdset_remove(fdset_t *set, unsigned i)
 {
 	if (set == NULL || i >= set->n) {
 		return KNOT_EINVAL;
 	}
 
+	/* Stop watching the descriptor, it may be already closed. */
+#ifdef ENABLE_EPOLL
+	(void)epoll_ctl(set->efd, EPOLL_CTL_DEL, set->fd[i], NULL);
+#endif
+	tw_unlink(set, i);
+
 	/* Decrement number of elms. */
 	--set->n;
 
@@ -96,20 +229,160 @@ int fdset_remove(fdset_t *set, unsigned i)
 	 * Move last -> i if some remain. */
 	unsigned last = set->n; /* Already decremented */
 	if (i < last) {
+		tw_unlink(set, last);
+#ifdef ENABLE_EPOLL
+		set->fd[i] = set->fd[last];
+		set->ev[i] = set->ev[last];
+		set->ev[i].data.u64 = i;
+		(void)epoll_ctl(set->efd, EPOLL_CTL_MOD, set->fd[i], &set->ev[i]);
+#else
 		set->pfd[i] = set->pfd[last];
+#endif
 		set->timeout[i] = set->timeout[last];
 		set->ctx[i] = set->ctx[last];
+		tw_link(set, i);
 	}
 
 	return KNOT_EOK;
 }
 
+int fdset_get_fd(const fdset_t *set, unsigned i)
+{
+	if (set == NULL || i >= set->n) {
+		return -1;
+	}
+
+#ifdef ENABLE_EPOLL
+	return set->fd[i];
+#else
+	return set->pfd[i].fd;
+#endif
+}
+
+#ifdef ENABLE_EPOLL
+/*! \brief Set the iterator index from the current event. */
+static void it_load(fdset_it_t *it)
+{
+	if (it->left > 0) {
+		it->idx = it->ev->data.u64;
+	}
+}
+#else
+/*! \brief Move the iterator to the first fd with events, starting at current index. */
+static void it_seek(fdset_it_t *it)
+{
+	const fdset_t *set = it->set;
+	while (it->left > 0 && it->idx < set->n && set->pfd[it->idx].revents == 0) {
+		it->idx++;
+	}
+	if (it->idx >= set->n) {
+		it->left = 0;
+	}
+}
+#endif
+
+int fdset_wait(fdset_t *set, fdset_it_t *it, int timeout)
+{
+	if (set == NULL || it == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	memset(it, 0, sizeof(*it));
+	it->set = set;
+
+#ifdef ENABLE_EPOLL
+	int ret = epoll_wait(set->efd, set->recv_ev, FDSET_INIT_SIZE, timeout);
+	it->ev = set->recv_ev;
+#else
+	int ret = poll(set->pfd, set->n, timeout);
+#endif
+	if (ret < 0) {
+		return knot_map_errno();
+	}
+
+	it->left = ret;
+#ifdef ENABLE_EPOLL
+	it_load(it);
+#else
+	it_seek(it);
+#endif
+
+	return ret;
+}
+
+bool fdset_it_done(const fdset_it_t *it)
+{
+	return it == NULL || it->left <= 0;
+}
+
+void fdset_it_next(fdset_it_t *it)
+{
+	if (fdset_it_done(it)) {
+		return;
+	}
+
+	it->left--;
+#ifdef ENABLE_EPOLL
+	it->ev++;
+	it_load(it);
+#else
+	it->idx++;
+	it_seek(it);
+#endif
+}
+
+unsigned fdset_it_events(const fdset_it_t *it)
+{
+	if (fdset_it_done(it)) {
+		return 0;
+	}
+
+#ifdef ENABLE_EPOLL
+	return events_from_epoll(it->ev->events);
+#else
+	return it->set->pfd[it->idx].revents;
+#endif
+}
+
+int fdset_it_remove(fdset_it_t *it)
+{
+	if (fdset_it_done(it)) {
+		return KNOT_EINVAL;
+	}
+
+	fdset_t *set = it->set;
+	unsigned last = set->n - 1;
+	int ret = fdset_remove(set, it->idx);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+#ifdef ENABLE_EPOLL
+	/* The last fd was moved, update its pending event. */
+	for (int i = 1; i < it->left; i++) {
+		if (it->ev[i].data.u64 == last) {
+			it->ev[i].data.u64 = it->idx;
+			break;
+		}
+	}
+#else
+	/* The last fd was moved to the current index, check it once more. */
+	if (it->idx < last) {
+		it->idx--;
+	}
+#endif
+
+	return KNOT_EOK;
+}
+
 int fdset_set_watchdog(fdset_t* set, int i, int interval)
 {
 	if (set == NULL || i >= set->n) {
 		return KNOT_EINVAL;
 	}
 
+	tw_unlink(set, i);
+
 	/* Lift watchdog if interval is negative. */
 	if (interval < 0) {
 		set->timeout[i] = 0;
@@ -120,9 +393,17 @@ int fdset_set_watchdog(fdset_t* set, int i, int interval)
 	struct timespec now = time_now();
 
 	set->timeout[i] = now.tv_sec + interval; /* Only seconds precision. */
+	tw_link(set, i);
 	return KNOT_EOK;
 }
 
+static int cmp_idx_desc(const void *a, const void *b)
+{
+	unsigned x = *(const unsigned *)a;
+	unsigned y = *(const unsigned *)b;
+	return (x < y) - (x > y);
+}
+
 int fdset_sweep(fdset_t* set, fdset_sweep_cb_t cb, void *data)
 {
 	if (set == NULL || cb == NULL) {
@@ -132,20 +413,46 @@ int fdset_sweep(fdset_t* set, fdset_sweep_cb_t cb, void *data)
 	/* Get time threshold. */
 	struct timespec now = time_now();
 
-	unsigned i = 0;
-	while (i < set->n) {
+	/* Visit the wheel slots elapsed since the last sweep. */
+	time_t slots = now.tv_sec - set->tw_time + 1;
+	if (slots > FDSET_WHEEL_SIZE) {
+		slots = FDSET_WHEEL_SIZE;
+	} else if (slots < 1) {
+		slots = 1;
+	}
 
-		/* Check sweep state, remove if requested. */
-		if (set->timeout[i] > 0 && set->timeout[i] <= now.tv_sec) {
-			if (cb(set, i, data) == FDSET_SWEEP) {
-				if (fdset_remove(set, i) == KNOT_EOK)
-					continue; /* Stay on the index. */
+	/* Collect expired descriptors. */
+	unsigned count = 0;
+	unsigned *expired = NULL;
+	for (time_t t = now.tv_sec - slots + 1; t <= now.tv_sec; t++) {
+		unsigned i = set->tw_slot[t % FDSET_WHEEL_SIZE];
+		for (; i != TW_NONE; i = set->tw_next[i]) {
+			if (set->timeout[i] > now.tv_sec) {
+				continue; /* Later round. */
+			}
+			if (expired == NULL) {
+				expired = malloc(set->n * sizeof(*expired));
+				if (expired == NULL) {
+					return KNOT_ENOMEM;
+				}
 			}
+			expired[count++] = i;
 		}
+	}
+	set->tw_time = now.tv_sec;
 
-		/* Next descriptor. */
-		++i;
+	/* Check sweep state, remove from the highest index, so the indices
+	 * of the remaining expired descriptors don't change. */
+	qsort(expired, count, sizeof(*expired), cmp_idx_desc);
+	int sweeped = 0;
+	for (unsigned j = 0; j < count; j++) {
+		if (cb(set, expired[j], data) == FDSET_SWEEP &&
+		    fdset_remove(set, expired[j]) == KNOT_EOK) {
+			sweeped++;
+		}
 	}
 
-	return KNOT_EOK;
+	free(expired);
+
+	return sweeped;
 }
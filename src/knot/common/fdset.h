@@ -19,22 +19,48 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <poll.h>
 #include <sys/time.h>
 #include <signal.h>
+#ifdef ENABLE_EPOLL
+#include <sys/epoll.h>
+#endif
 
 #define FDSET_INIT_SIZE 256 /* Resize step. */
+#define FDSET_WHEEL_SIZE 64 /* Number of watchdog timer wheel slots (seconds). */
 
 /*! \brief Set of filedescriptors with associated context and timeouts. */
 typedef struct fdset {
 	unsigned n;          /*!< Active fds. */
 	unsigned size;       /*!< Array size (allocated). */
 	void* *ctx;          /*!< Context for each fd. */
+#ifdef ENABLE_EPOLL
+	int efd;                     /*!< Epoll file descriptor. */
+	int *fd;                     /*!< File descriptor at each index. */
+	struct epoll_event *ev;      /*!< Epoll registration for each fd. */
+	struct epoll_event *recv_ev; /*!< Received epoll events (FDSET_INIT_SIZE). */
+#else
 	struct pollfd *pfd;  /*!< poll state for each fd */
+#endif
 	time_t *timeout;     /*!< Timeout for each fd (seconds precision). */
+	unsigned *tw_next;   /*!< Next fd in the same watchdog wheel slot. */
+	unsigned *tw_prev;   /*!< Previous fd in the same watchdog wheel slot. */
+	unsigned tw_slot[FDSET_WHEEL_SIZE]; /*!< First fd in each wheel slot. */
+	time_t tw_time;      /*!< Time of the first not yet sweeped wheel slot. */
 } fdset_t;
 
+/*! \brief Iterator over the fds with pending events. */
+typedef struct {
+	fdset_t *set;        /*!< Iterated set. */
+	unsigned idx;        /*!< Index of the current fd. */
+	int left;            /*!< Number of unprocessed events. */
+#ifdef ENABLE_EPOLL
+	struct epoll_event *ev; /*!< Current event. */
+#endif
+} fdset_it_t;
+
 /*! \brief Mark-and-sweep state. */
 enum fdset_sweep_state {
 	FDSET_KEEP,
@@ -62,7 +88,7 @@ int fdset_clear(fdset_t* set);
  *
  * \param set Target set.
  * \param fd Added file descriptor.
- * \param events Mask of watched events.
+ * \param events Mask of watched events (POLLIN, POLLOUT).
  * \param ctx Context (optional).
  *
  * \retval index of the added fd if successful.
@@ -70,9 +96,23 @@ int fdset_clear(fdset_t* set);
  */
 int fdset_add(fdset_t *set, int fd, unsigned events, void *ctx);
 
+/*!
+ * \brief Change watched events of the file descriptor.
+ *
+ * \param set Target set.
+ * \param i Index of the file descriptor.
+ * \param events Mask of watched events (POLLIN, POLLOUT).
+ *
+ * \retval KNOT_EOK if successful.
+ * \retval knot_error on errors.
+ */
+int fdset_set_events(fdset_t *set, unsigned i, unsigned events);
+
 /*!
  * \brief Remove file descriptor from watched set.
  *
+ * The last file descriptor in the set is moved to the index of the removed one.
+ *
  * \param set Target set.
  * \param i Index of the removed fd.
  *
@@ -81,6 +121,50 @@ int fdset_add(fdset_t *set, int fd, unsigned events, void *ctx);
  */
 int fdset_remove(fdset_t *set, unsigned i);
 
+/*!
+ * \brief Get file descriptor at the given index.
+ *
+ * \param set Target set.
+ * \param i Index of the fd.
+ *
+ * \return File descriptor or -1 on errors.
+ */
+int fdset_get_fd(const fdset_t *set, unsigned i);
+
+/*!
+ * \brief Wait for events on the watched file descriptors.
+ *
+ * \param set Target set.
+ * \param it Iterator over the fds with pending events (output).
+ * \param timeout Maximum wait time in milliseconds (-1 for infinity).
+ *
+ * \return Number of fds with pending events, negative value on errors.
+ */
+int fdset_wait(fdset_t *set, fdset_it_t *it, int timeout);
+
+/*!
+ * \brief Check if the iterator is past the last pending event.
+ */
+bool fdset_it_done(const fdset_it_t *it);
+
+/*!
+ * \brief Move the iterator to the next fd with pending events.
+ */
+void fdset_it_next(fdset_it_t *it);
+
+/*!
+ * \brief Get pending events (POLLIN, POLLOUT, POLLERR, POLLHUP) of the current fd.
+ */
+unsigned fdset_it_events(const fdset_it_t *it);
+
+/*!
+ * \brief Remove the current fd from the set, the iterator remains usable.
+ *
+ * \retval 0 if successful.
+ * \retval -1 on errors.
+ */
+int fdset_it_remove(fdset_it_t *it);
+
 /*!
  * \brief Set file descriptor watchdog interval.
  *
@@ -102,6 +186,9 @@ int fdset_set_watchdog(fdset_t* set, int i, int interval);
 /*!
  * \brief Sweep file descriptors with exceeding inactivity period.
  *
+ * The watchdog timers are kept in a timer wheel, so only the descriptors
+ * in the wheel slots elapsed since the last sweep are visited.
+ *
  * \param set Target set.
  * \param cb Callback for sweeped descriptors.
  * \param data Pointer to extra data.
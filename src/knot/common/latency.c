@@ -0,0 +1,327 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "knot/common/latency.h"
+#include "libknot/errcode.h"
+#include "contrib/time.h"
+
+#define TRANSPORTS	2
+#define SUB_MASK	((1 << LATENCY_SUB_BITS) - 1)
+
+/*! \brief Fixed point shift of the tick to nanoseconds ratio. */
+#define MULT_SHIFT	24
+
+/*! \brief Calibration period in nanoseconds. */
+#define CALIBRATION_NS	10000000
+
+/*!
+ * \brief Histograms of one thread, written only by the thread.
+ */
+typedef struct latency_block {
+	struct latency_block *next;
+	uint64_t stages[TRANSPORTS][LATENCY_STAGES][LATENCY_BUCKETS];
+	uint64_t modules[TRANSPORTS][LATENCY_MODULES][LATENCY_BUCKETS];
+} latency_block_t;
+
+static struct {
+	pthread_mutex_t lock;
+	latency_block_t *blocks;
+	char *modules[LATENCY_MODULES];
+	unsigned module_count;
+	uint64_t mult;   /*!< Nanoseconds per tick << MULT_SHIFT. */
+} latency = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.mult = 1 << MULT_SHIFT,
+};
+
+static __thread latency_block_t *thread_block = NULL;
+
+static const char *transport_names[] = { "udp", "tcp" };
+
+static const char *stage_names[] = {
+	[KNOTD_STAGE_BEGIN]      = "begin",
+	[KNOTD_STAGE_ANSWER]     = "answer",
+	[KNOTD_STAGE_AUTHORITY]  = "authority",
+	[KNOTD_STAGE_ADDITIONAL] = "additional",
+	[KNOTD_STAGE_END]        = "end",
+	[LATENCY_STAGE_TOTAL]    = "total",
+};
+
+void latency_init(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	struct timespec begin = time_now();
+	uint64_t ticks_begin = latency_now();
+
+	struct timespec wait = { .tv_nsec = CALIBRATION_NS };
+	nanosleep(&wait, NULL);
+
+	struct timespec end = time_now();
+	uint64_t ticks = latency_now() - ticks_begin;
+
+	struct timespec diff = time_diff(&begin, &end);
+	uint64_t ns = (uint64_t)diff.tv_sec * 1000000000 + diff.tv_nsec;
+	if (ticks > 0) {
+		latency.mult = (ns << MULT_SHIFT) / ticks;
+	}
+#endif
+}
+
+void latency_deinit(void)
+{
+	pthread_mutex_lock(&latency.lock);
+
+	latency_block_t *block = latency.blocks;
+	while (block != NULL) {
+		latency_block_t *next = block->next;
+		free(block);
+		block = next;
+	}
+	latency.blocks = NULL;
+
+	for (unsigned i = 0; i < latency.module_count; i++) {
+		free(latency.modules[i]);
+		latency.modules[i] = NULL;
+	}
+	latency.module_count = 0;
+
+	pthread_mutex_unlock(&latency.lock);
+
+	thread_block = NULL;
+}
+
+unsigned latency_bucket(uint64_t ns)
+{
+	if (ns >> 32 != 0) {
+		return LATENCY_BUCKETS - 1;
+	}
+
+	unsigned msb = 63 - __builtin_clzll(ns | 1);
+	if (msb < LATENCY_SUB_BITS) {
+		return ns;
+	}
+
+	unsigned shift = msb - LATENCY_SUB_BITS;
+	return ((shift + 1) << LATENCY_SUB_BITS) + ((ns >> shift) & SUB_MASK);
+}
+
+uint64_t latency_bucket_bound(unsigned bucket)
+{
+	if (bucket >= LATENCY_BUCKETS - 1) {
+		return UINT64_MAX;
+	}
+
+	/* The first bucket of the next one minus one. */
+	unsigned next = bucket + 1;
+	unsigned group = next >> LATENCY_SUB_BITS;
+	if (group == 0) {
+		return next - 1;
+	}
+
+	unsigned shift = group - 1;
+	uint64_t base = (uint64_t)((1 << LATENCY_SUB_BITS) | (next & SUB_MASK)) << shift;
+	return base - 1;
+}
+
+unsigned latency_module(const char *name)
+{
+	if (name == NULL) {
+		return LATENCY_MODULE_NONE;
+	}
+
+	pthread_mutex_lock(&latency.lock);
+
+	unsigned idx;
+	for (idx = 0; idx < latency.module_count; idx++) {
+		if (strcmp(latency.modules[idx], name) == 0) {
+			break;
+		}
+	}
+
+	if (idx == latency.module_count) {
+		char *copy = NULL;
+		if (idx < LATENCY_MODULES && (copy = strdup(name)) != NULL) {
+			latency.modules[idx] = copy;
+			latency.module_count++;
+		} else {
+			idx = LATENCY_MODULE_NONE;
+		}
+	}
+
+	pthread_mutex_unlock(&latency.lock);
+
+	return idx;
+}
+
+/*! \brief Get the histograms of the current thread, allocated on the first use. */
+static latency_block_t *block_get(void)
+{
+	if (thread_block != NULL) {
+		return thread_block;
+	}
+
+	latency_block_t *block = calloc(1, sizeof(*block));
+	if (block == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&latency.lock);
+	block->next = latency.blocks;
+	latency.blocks = block;
+	pthread_mutex_unlock(&latency.lock);
+
+	thread_block = block;
+
+	return block;
+}
+
+static void record(uint64_t *hist, uint64_t start)
+{
+	uint64_t now = latency_now();
+	uint64_t ticks = (now > start) ? now - start : 0;
+
+	uint64_t ns = UINT64_MAX;
+	if (ticks >> (64 - MULT_SHIFT - 8) == 0) {
+		ns = (ticks * latency.mult) >> MULT_SHIFT;
+	}
+
+	/* Only this thread writes the histogram. */
+	uint64_t *bucket = hist + latency_bucket(ns);
+	__atomic_store_n(bucket, __atomic_load_n(bucket, __ATOMIC_RELAXED) + 1,
+	                 __ATOMIC_RELAXED);
+}
+
+static unsigned transport(const knotd_qdata_params_t *params)
+{
+	return (params->flags & KNOTD_QUERY_FLAG_LIMIT_SIZE) ? 0 : 1;
+}
+
+void latency_record_stage(const knotd_qdata_params_t *params, unsigned stage,
+                          uint64_t start)
+{
+	latency_block_t *block = block_get();
+	if (block == NULL || params == NULL || stage >= LATENCY_STAGES) {
+		return;
+	}
+
+	record(block->stages[transport(params)][stage], start);
+}
+
+void latency_record_module(const knotd_qdata_params_t *params, unsigned module,
+                           uint64_t start)
+{
+	latency_block_t *block = block_get();
+	if (block == NULL || params == NULL || module >= LATENCY_MODULES) {
+		return;
+	}
+
+	record(block->modules[transport(params)][module], start);
+}
+
+/*! \brief Sum the histogram over all threads. */
+static bool merge(uint64_t *out, size_t offset)
+{
+	memset(out, 0, LATENCY_BUCKETS * sizeof(uint64_t));
+
+	bool empty = true;
+	for (latency_block_t *block = latency.blocks; block != NULL; block = block->next) {
+		const uint64_t *hist = (const uint64_t *)((const uint8_t *)block + offset);
+		for (unsigned i = 0; i < LATENCY_BUCKETS; i++) {
+			uint64_t val = __atomic_load_n(&hist[i], __ATOMIC_RELAXED);
+			out[i] += val;
+			empty = empty && val == 0;
+		}
+	}
+
+	return !empty;
+}
+
+static int dump_hist(const char *name, size_t offset, bool force,
+                     latency_dump_f cb, void *data)
+{
+	uint64_t hist[LATENCY_BUCKETS];
+	if (!merge(hist, offset) && !force) {
+		return KNOT_EOK;
+	}
+
+	bool first = true;
+	for (unsigned i = 0; i < LATENCY_BUCKETS; i++) {
+		// Skip empty buckets.
+		if (hist[i] == 0 && !force) {
+			continue;
+		}
+
+		int ret = cb(name, latency_bucket_bound(i), hist[i], first, data);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		first = false;
+	}
+
+	return KNOT_EOK;
+}
+
+int latency_dump(const char *item, bool force, latency_dump_f cb, void *data)
+{
+	if (cb == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	bool found = false;
+	int ret = KNOT_EOK;
+	char name[64];
+
+	pthread_mutex_lock(&latency.lock);
+
+	for (unsigned t = 0; t < TRANSPORTS && ret == KNOT_EOK; t++) {
+		for (unsigned s = 0; s < LATENCY_STAGES && ret == KNOT_EOK; s++) {
+			snprintf(name, sizeof(name), "%s-%s", transport_names[t], stage_names[s]);
+			if (item != NULL && strcasecmp(item, name) != 0) {
+				continue;
+			}
+			found = true;
+
+			size_t offset = offsetof(latency_block_t, stages[t][s]);
+			ret = dump_hist(name, offset, force, cb, data);
+		}
+
+		for (unsigned m = 0; m < latency.module_count && ret == KNOT_EOK; m++) {
+			snprintf(name, sizeof(name), "%s-%s", transport_names[t], latency.modules[m]);
+			if (item != NULL && strcasecmp(item, name) != 0) {
+				continue;
+			}
+			found = true;
+
+			size_t offset = offsetof(latency_block_t, modules[t][m]);
+			ret = dump_hist(name, offset, force, cb, data);
+		}
+	}
+
+	pthread_mutex_unlock(&latency.lock);
+
+	if (ret == KNOT_EOK && !found) {
+		return KNOT_ENOENT;
+	}
+
+	return ret;
+}
@@ -0,0 +1,152 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \brief Query processing latency histograms.
+ *
+ * Each thread records the durations of the query processing stages and of
+ * the module hooks into its own log-linear histograms (each power of two
+ * split into four buckets), separately for UDP and TCP. The histograms are
+ * merged only when the statistics are read. The measurement points are
+ * compiled in only with ENABLE_LATENCY_STATS.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "knot/include/module.h"
+
+/*! \brief Measured stages: the module stages and the whole query processing. */
+#define LATENCY_STAGE_TOTAL	(KNOTD_STAGE_END + 1)
+#define LATENCY_STAGES		(LATENCY_STAGE_TOTAL + 1)
+
+/*! \brief Maximal number of distinct measured modules. */
+#define LATENCY_MODULES		32
+/*! \brief Module index for modules over the limit (not measured). */
+#define LATENCY_MODULE_NONE	LATENCY_MODULES
+
+/*! \brief Number of buckets per power of two (as bits). */
+#define LATENCY_SUB_BITS	2
+/*! \brief Number of histogram buckets, the last one for 2^32 ns and more. */
+#define LATENCY_BUCKETS		(((32 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) + 1)
+
+/*!
+ * \brief Histogram dump callback.
+ *
+ * \param item   Histogram name (e.g. "udp-answer", "tcp-mod-rrl").
+ * \param bound  Bucket upper bound in nanoseconds (UINT64_MAX for the last one).
+ * \param count  Number of samples in the bucket.
+ * \param first  First bucket of the histogram.
+ * \param data   Callback context.
+ *
+ * \return KNOT_E*
+ */
+typedef int (*latency_dump_f)(const char *item, uint64_t bound, uint64_t count,
+                              bool first, void *data);
+
+/*! \brief Reads the time stamp counter (or the monotonic clock). */
+static inline uint64_t latency_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/*!
+ * \brief Calibrates the time stamp counter, takes about 10 ms.
+ */
+void latency_init(void);
+
+/*!
+ * \brief Releases all the histograms and registered modules.
+ *
+ * \note No thread may record the latency anymore.
+ */
+void latency_deinit(void);
+
+/*!
+ * \brief Gets the histogram bucket for the duration.
+ */
+unsigned latency_bucket(uint64_t ns);
+
+/*!
+ * \brief Gets the upper bound of the histogram bucket in nanoseconds.
+ */
+uint64_t latency_bucket_bound(unsigned bucket);
+
+/*!
+ * \brief Registers a module name for measuring.
+ *
+ * \param name  Module name (e.g. "mod-rrl").
+ *
+ * \return Module index or LATENCY_MODULE_NONE if too many modules.
+ */
+unsigned latency_module(const char *name);
+
+/*!
+ * \brief Records the duration of a processing stage.
+ *
+ * \param params  Query parameters (transport).
+ * \param stage   KNOTD_STAGE_* or LATENCY_STAGE_TOTAL.
+ * \param start   Stage start from latency_now().
+ */
+void latency_record_stage(const knotd_qdata_params_t *params, unsigned stage,
+                          uint64_t start);
+
+/*!
+ * \brief Records the duration of a module hook.
+ *
+ * \param params  Query parameters (transport).
+ * \param module  Module index from latency_module().
+ * \param start   Hook start from latency_now().
+ */
+void latency_record_module(const knotd_qdata_params_t *params, unsigned module,
+                           uint64_t start);
+
+/*!
+ * \brief Merges the per-thread histograms and passes them to the callback.
+ *
+ * \param item   Dump only the given histogram (NULL for all).
+ * \param force  Dump also the empty histograms and buckets.
+ * \param cb     Callback.
+ * \param data   Callback context.
+ *
+ * \retval KNOT_ENOENT  The given histogram doesn't exist.
+ * \return KNOT_E*      Callback result or other errors.
+ */
+int latency_dump(const char *item, bool force, latency_dump_f cb, void *data);
+
+#ifdef ENABLE_LATENCY_STATS
+ #define LATENCY_START(var)			uint64_t var = latency_now()
+ #define LATENCY_RESTART(var)			var = latency_now()
+ #define LATENCY_STAGE(params, stage, var)	latency_record_stage(params, stage, var)
+ #define LATENCY_MODULE(params, mod, var) \
+	latency_record_module(params, ((knotd_mod_t *)(mod))->latency_idx, var)
+#else
+ #define LATENCY_START(var)
+ #define LATENCY_RESTART(var)
+ #define LATENCY_STAGE(params, stage, var)
+ #define LATENCY_MODULE(params, mod, var)
+#endif
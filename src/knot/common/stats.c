@@ -22,6 +22,7 @@
 
 #include "contrib/files.h"
 #include "knot/common/stats.h"
+#include "knot/common/latency.h"
 #include "knot/common/log.h"
 #include "knot/nameserver/query_module.h"
 
@@ -37,6 +38,7 @@ typedef struct {
 	const list_t *query_modules;
 	const knot_dname_t *zone;
 	bool zone_emitted;
+	bool latency_emitted;
 } dump_ctx_t;
 
 #define DUMP_STR(fd, level, name, ...) do { \
@@ -56,10 +58,11 @@ const stats_item_t server_stats[] = {
 	{ 0 }
 };
 
-static void dump_counters(FILE *fd, int level, mod_ctr_t *ctr)
+static void dump_counters(FILE *fd, int level, knotd_mod_t *mod, uint32_t ctr_id)
 {
+	mod_ctr_t *ctr = mod->stats + ctr_id;
 	for (uint32_t j = 0; j < ctr->count; j++) {
-		uint64_t counter = ATOMIC_GET(ctr->counters[j]);
+		uint64_t counter = knotd_mod_stats_get(mod, ctr_id, j);
 
 		// Skip empty counters.
 		if (counter == 0) {
@@ -116,17 +119,39 @@ static void dump_modules(dump_ctx_t *ctx)
 			}
 			if (ctr->count == 1) {
 				// Simple counter.
-				uint64_t counter = ATOMIC_GET(ctr->counter);
+				uint64_t counter = knotd_mod_stats_get(mod, i, 0);
 				DUMP_CTR(ctx->fd, level + 1, "%s", ctr->name, counter);
 			} else {
 				// Array of counters.
 				DUMP_STR(ctx->fd, level + 1, "%s", ctr->name, "");
-				dump_counters(ctx->fd, level + 2, ctr);
+				dump_counters(ctx->fd, level + 2, mod, i);
 			}
 		}
 	}
 }
 
+#ifdef ENABLE_LATENCY_STATS
+static int dump_latency(const char *item, uint64_t bound, uint64_t count,
+                        bool first, void *data)
+{
+	dump_ctx_t *ctx = data;
+
+	// Dump latency section header.
+	if (!ctx->latency_emitted) {
+		DUMP_STR(ctx->fd, 0, "latency", "");
+		ctx->latency_emitted = true;
+	}
+
+	// Dump histogram bucket, identified by its upper bound in nanoseconds.
+	if (first) {
+		DUMP_STR(ctx->fd, 1, "%s", item, "");
+	}
+	DUMP_CTR(ctx->fd, 2, "%"PRIu64, bound, count);
+
+	return KNOT_EOK;
+}
+#endif
+
 static void zone_stats_dump(zone_t *zone, dump_ctx_t *ctx)
 {
 	if (EMPTY_LIST(zone->query_modules)) {
@@ -174,6 +199,11 @@ static void dump_to_file(FILE *fd, server_t *server)
 		.query_modules = conf()->query_modules,
 	};
 
+#ifdef ENABLE_LATENCY_STATS
+	// Dump latency histograms.
+	(void)latency_dump(NULL, false, dump_latency, &ctx);
+#endif
+
 	// Dump global statistics.
 	dump_modules(&ctx);
 
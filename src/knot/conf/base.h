@@ -123,6 +123,7 @@ typedef struct {
 		int32_t srv_tcp_idle_timeout;
 		int32_t srv_tcp_reply_timeout;
 		int32_t srv_max_tcp_clients;
+		int32_t srv_max_refresh_queries;
 		int32_t ctl_timeout;
 		conf_val_t srv_nsid;
 	} cache;
@@ -32,6 +32,7 @@
 #define C_ACTION		"\x06""action"
 #define C_ADDR			"\x07""address"
 #define C_ALG			"\x09""algorithm"
+#define C_ANSWER_CACHE		"\x0C""answer-cache"
 #define C_ANY			"\x03""any"
 #define C_APPEND		"\x06""append"
 #define C_ASYNC_START		"\x0B""async-start"
@@ -76,6 +77,7 @@
 #define C_MAX_JOURNAL_USAGE	"\x11""max-journal-usage"
 #define C_MAX_KASP_DB_SIZE	"\x10""max-kasp-db-size"
 #define C_MAX_REFRESH_INTERVAL	"\x14""max-refresh-interval"
+#define C_MAX_REFRESH_QUERIES	"\x13""max-refresh-queries"
 #define C_MAX_TCP_CLIENTS	"\x0F""max-tcp-clients"
 #define C_MAX_TIMER_DB_SIZE	"\x11""max-timer-db-size"
 #define C_MAX_UDP_PAYLOAD	"\x0F""max-udp-payload"
@@ -102,6 +104,7 @@
 #define C_SECRET		"\x06""secret"
 #define C_SEM_CHECKS		"\x0F""semantic-checks"
 #define C_SERIAL_POLICY		"\x0D""serial-policy"
+#define C_SIGNING_THREADS	"\x0F""signing-threads"
 #define C_SERVER		"\x06""server"
 #define C_SINGLE_TYPE_SIGNING	"\x13""single-type-signing"
 #define C_SRV			"\x06""server"
@@ -122,6 +125,8 @@
 #define C_VIA			"\x03""via"
 #define C_ZONE			"\x04""zone"
 #define C_ZONEFILE_LOAD		"\x0D""zonefile-load"
+#define C_ZONEFILE_LOAD_THREADS	"\x15""zonefile-load-threads"
+#define C_ZONEFILE_SNAPSHOT	"\x11""zonefile-snapshot"
 #define C_ZONEFILE_SYNC		"\x0D""zonefile-sync"
 #define C_ZSK_LIFETIME		"\x0C""zsk-lifetime"
 #define C_ZSK_SIZE		"\x08""zsk-size"
@@ -18,6 +18,7 @@
 #include <unistd.h>
 #include <sys/time.h>
 
+#include "knot/common/latency.h"
 #include "knot/common/log.h"
 #include "knot/common/stats.h"
 #include "knot/conf/confio.h"
@@ -1014,13 +1015,15 @@ static int zone_purge(zone_t *zone, ctl_args_t *args)
 	return KNOT_EOK;
 }
 
-static int send_stats_ctr(mod_ctr_t *ctr, ctl_args_t *args, knot_ctl_data_t *data)
+static int send_stats_ctr(knotd_mod_t *mod, uint32_t ctr_id, ctl_args_t *args,
+                          knot_ctl_data_t *data)
 {
 	char index[128];
 	char value[32];
 
+	mod_ctr_t *ctr = mod->stats + ctr_id;
 	if (ctr->count == 1) {
-		uint64_t counter = ATOMIC_GET(ctr->counter);
+		uint64_t counter = knotd_mod_stats_get(mod, ctr_id, 0);
 		int ret = snprintf(value, sizeof(value), "%"PRIu64, counter);
 		if (ret <= 0 || ret >= sizeof(value)) {
 			return KNOT_ESPACE;
@@ -1038,7 +1041,7 @@ static int send_stats_ctr(mod_ctr_t *ctr, ctl_args_t *args, knot_ctl_data_t *dat
 		                          CTL_FLAG_FORCE);
 
 		for (uint32_t i = 0; i < ctr->count; i++) {
-			uint64_t counter = ATOMIC_GET(ctr->counters[i]);
+			uint64_t counter = knotd_mod_stats_get(mod, ctr_id, i);
 
 			// Skip empty counters.
 			if (counter == 0 && !force) {
@@ -1145,7 +1148,7 @@ static int modules_stats(list_t *query_modules, ctl_args_t *args, knot_dname_t *
 			data[KNOT_CTL_IDX_ITEM] = ctr->name;
 
 			// Send the counters.
-			int ret = send_stats_ctr(ctr, args, &data);
+			int ret = send_stats_ctr(mod, i, args, &data);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
@@ -1266,6 +1269,37 @@ static int ctl_server(ctl_args_t *args, ctl_cmd_t cmd)
 	return ret;
 }
 
+#ifdef ENABLE_LATENCY_STATS
+static int send_latency(const char *item, uint64_t bound, uint64_t count,
+                        bool first, void *data)
+{
+	ctl_args_t *args = data;
+
+	char index[32];
+	char value[32];
+
+	// The bucket is identified by its upper bound in nanoseconds.
+	int ret = snprintf(index, sizeof(index), "%"PRIu64, bound);
+	if (ret <= 0 || ret >= sizeof(index)) {
+		return KNOT_ESPACE;
+	}
+
+	ret = snprintf(value, sizeof(value), "%"PRIu64, count);
+	if (ret <= 0 || ret >= sizeof(value)) {
+		return KNOT_ESPACE;
+	}
+
+	knot_ctl_data_t ctl_data = {
+		[KNOT_CTL_IDX_SECTION] = "latency",
+		[KNOT_CTL_IDX_ITEM] = item,
+		[KNOT_CTL_IDX_ID] = index,
+		[KNOT_CTL_IDX_DATA] = value
+	};
+
+	return knot_ctl_send(args->ctl, KNOT_CTL_TYPE_DATA, &ctl_data);
+}
+#endif
+
 static int ctl_stats(ctl_args_t *args, ctl_cmd_t cmd)
 {
 	const char *section = args->data[KNOT_CTL_IDX_SECTION];
@@ -1311,6 +1345,22 @@ static int ctl_stats(ctl_args_t *args, ctl_cmd_t cmd)
 		}
 	}
 
+#ifdef ENABLE_LATENCY_STATS
+	// Process latency histograms.
+	if (section == NULL || strcasecmp(section, "latency") == 0) {
+		bool force = ctl_has_flag(args->data[KNOT_CTL_IDX_FLAGS],
+		                          CTL_FLAG_FORCE);
+
+		int ret = latency_dump(item, force, send_latency, args);
+		if (ret == KNOT_EOK) {
+			found = true;
+		} else if (ret != KNOT_ENOENT) {
+			send_error(args, knot_strerror(ret));
+			return ret;
+		}
+	}
+#endif
+
 	// Process modules metrics.
 	if (section == NULL || strncasecmp(section, "mod-", strlen("mod-")) == 0) {
 		int ret = modules_stats(conf()->query_modules, args, NULL);
@@ -80,6 +80,7 @@ typedef struct {
 	// RRSIG
 	uint32_t rrsig_lifetime;
 	uint32_t rrsig_refresh_before;
+	uint16_t signing_threads;
 	// NSEC3
 	bool nsec3_enabled;
 	bool nsec3_opt_out;
@@ -21,6 +21,7 @@
 #include "knot/dnssec/nsec3-chain.h"
 #include "knot/dnssec/zone-sign.h"
 #include "knot/dnssec/zone-nsec.h"
+#include "knot/server/dthreads.h"
 #include "knot/zone/zone-diff.h"
 #include "contrib/base32hex.h"
 #include "contrib/macros.h"
@@ -316,6 +317,35 @@ static zone_node_t *create_nsec3_node(const knot_dname_t *owner,
 	return new_node;
 }
 
+/*!
+ * \brief Create new NSEC3 node with given owner for given regular node.
+ */
+static zone_node_t *create_nsec3_node_with_owner(const zone_node_t *node,
+                                                 const knot_dname_t *nsec3_owner,
+                                                 zone_node_t *apex,
+                                                 const dnssec_nsec3_params_t *params,
+                                                 uint32_t ttl)
+{
+	dnssec_nsec_bitmap_t *rr_types = dnssec_nsec_bitmap_new();
+	if (!rr_types) {
+		return NULL;
+	}
+
+	bitmap_add_node_rrsets(rr_types, KNOT_RRTYPE_NSEC3, node);
+	if (node->rrset_count > 0 && node_should_be_signed_nsec3(node)) {
+		dnssec_nsec_bitmap_add(rr_types, KNOT_RRTYPE_RRSIG);
+	}
+	if (node == apex) {
+		dnssec_nsec_bitmap_add(rr_types, KNOT_RRTYPE_NSEC3PARAM);
+	}
+
+	zone_node_t *nsec3_node = create_nsec3_node(nsec3_owner, params, apex,
+	                                            rr_types, ttl);
+	dnssec_nsec_bitmap_free(rr_types);
+
+	return nsec3_node;
+}
+
 /*!
  * \brief Create new NSEC3 node for given regular node.
  *
@@ -323,7 +353,6 @@ static zone_node_t *create_nsec3_node(const knot_dname_t *owner,
  * \param apex       Zone apex node.
  * \param params     NSEC3 hash function parameters.
  * \param ttl        TTL of the new NSEC3 node.
- * \param apex_cds   Hint to guess apex node type bitmap: false=just DNSKEY, true=DNSKEY,CDS,CDNSKEY.
  *
  * \return Error code, KNOT_EOK if successful.
  */
@@ -343,24 +372,87 @@ static zone_node_t *create_nsec3_node_for_node(const zone_node_t *node,
 		return NULL;
 	}
 
-	dnssec_nsec_bitmap_t *rr_types = dnssec_nsec_bitmap_new();
-	if (!rr_types) {
-		return NULL;
+	return create_nsec3_node_with_owner(node, nsec3_owner, apex, params, ttl);
+}
+
+/* - NSEC3 hashing ---------------------------------------------------------- */
+
+/*! \brief Minimal number of names hashed by one thread. */
+#define NSEC3_HASH_THREAD_MIN 1024
+
+/*!
+ * \brief Batch of names hashed by one thread.
+ */
+typedef struct {
+	const dnssec_binary_t *names;        /*!< Names to be hashed. */
+	size_t count;                        /*!< Number of names. */
+	const dnssec_nsec3_params_t *params; /*!< NSEC3 parameters. */
+	uint8_t *hashes;                     /*!< Output raw hashes. */
+	int result;                          /*!< Hashing result. */
+} nsec3_hash_batch_t;
+
+static int nsec3_hash_run(dthread_t *thread)
+{
+	nsec3_hash_batch_t *batch = (nsec3_hash_batch_t *)thread->data + dt_get_id(thread);
+
+	batch->result = dnssec_nsec3_hash_batch(batch->names, batch->count,
+	                                        batch->params, batch->hashes);
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Compute NSEC3 hashes of the names, possibly in multiple threads.
+ *
+ * \param names    Names to be hashed.
+ * \param count    Number of names.
+ * \param params   NSEC3 parameters.
+ * \param threads  Maximal number of threads.
+ * \param hashes   Output buffer for raw hashes.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+static int nsec3_hash_names(const dnssec_binary_t *names, size_t count,
+                            const dnssec_nsec3_params_t *params,
+                            unsigned threads, uint8_t *hashes)
+{
+	threads = MIN(threads, count / NSEC3_HASH_THREAD_MIN);
+	if (threads <= 1) {
+		int ret = dnssec_nsec3_hash_batch(names, count, params, hashes);
+		return knot_error_from_libdnssec(ret);
 	}
 
-	bitmap_add_node_rrsets(rr_types, KNOT_RRTYPE_NSEC3, node);
-	if (node->rrset_count > 0 && node_should_be_signed_nsec3(node)) {
-		dnssec_nsec_bitmap_add(rr_types, KNOT_RRTYPE_RRSIG);
+	nsec3_hash_batch_t *batches = calloc(threads, sizeof(*batches));
+	if (batches == NULL) {
+		return KNOT_ENOMEM;
 	}
-	if (node == apex) {
-		dnssec_nsec_bitmap_add(rr_types, KNOT_RRTYPE_NSEC3PARAM);
+
+	size_t hash_len = dnssec_nsec3_hash_length(params->algorithm);
+	for (unsigned i = 0; i < threads; i++) {
+		size_t first = count * i / threads;
+		batches[i].names = names + first;
+		batches[i].count = count * (i + 1) / threads - first;
+		batches[i].params = params;
+		batches[i].hashes = hashes + first * hash_len;
 	}
 
-	zone_node_t *nsec3_node = create_nsec3_node(nsec3_owner, params, apex,
-	                                            rr_types, ttl);
-	dnssec_nsec_bitmap_free(rr_types);
+	int ret = KNOT_ENOMEM;
+	dt_unit_t *unit = dt_create(threads, nsec3_hash_run, NULL, batches);
+	if (unit != NULL) {
+		ret = dt_start(unit);
+		if (ret == KNOT_EOK) {
+			dt_join(unit);
+		}
+		dt_delete(&unit);
+	}
 
-	return nsec3_node;
+	for (unsigned i = 0; i < threads && ret == KNOT_EOK; i++) {
+		ret = knot_error_from_libdnssec(batches[i].result);
+	}
+
+	free(batches);
+
+	return ret;
 }
 
 /* - NSEC3 chain creation --------------------------------------------------- */
@@ -490,6 +582,7 @@ static int connect_nsec3_nodes2(zone_node_t *a, zone_node_t *b,
 static int create_nsec3_nodes(const zone_contents_t *zone,
                               const dnssec_nsec3_params_t *params,
                               uint32_t ttl,
+                              unsigned threads,
                               zone_tree_t *nsec3_nodes,
                               changeset_t *chgset)
 {
@@ -497,7 +590,25 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 	assert(nsec3_nodes);
 	assert(chgset);
 
+	size_t hash_len = dnssec_nsec3_hash_length(params->algorithm);
+	if (hash_len == 0) {
+		return KNOT_EINVAL;
+	}
+
+	size_t max_count = zone_tree_count(zone->nodes);
+	zone_node_t **nodes = malloc(max_count * sizeof(*nodes));
+	dnssec_binary_t *names = malloc(max_count * sizeof(*names));
+	uint8_t *hashes = malloc(max_count * hash_len);
+	if (nodes == NULL || names == NULL || hashes == NULL) {
+		free(nodes);
+		free(names);
+		free(hashes);
+		return KNOT_ENOMEM;
+	}
+
+	/* Collect the nodes which need NSEC3. */
 	int result = KNOT_EOK;
+	size_t count = 0;
 
 	trie_it_t *it = trie_it_begin(zone->nodes);
 	while (!trie_it_finished(it)) {
@@ -519,23 +630,45 @@ static int create_nsec3_nodes(const zone_contents_t *zone,
 			continue;
 		}
 
+		assert(count < max_count);
+		nodes[count] = node;
+		names[count].data = node->owner;
+		names[count].size = knot_dname_size(node->owner);
+		count++;
+
+		trie_it_next(it);
+	}
+
+	trie_it_free(it);
+
+	/* Hash all the owners at once. */
+	if (result == KNOT_EOK) {
+		result = nsec3_hash_names(names, count, params, threads, hashes);
+	}
+
+	for (size_t i = 0; i < count && result == KNOT_EOK; i++) {
+		uint8_t nsec3_owner[KNOT_DNAME_MAXLEN];
+		result = knot_nsec3_hash_to_dname(nsec3_owner, sizeof(nsec3_owner),
+		                                  hashes + i * hash_len, hash_len,
+		                                  zone->apex->owner);
+		if (result != KNOT_EOK) {
+			break;
+		}
+
 		zone_node_t *nsec3_node;
-		nsec3_node = create_nsec3_node_for_node(node, zone->apex,
-							params, ttl);
+		nsec3_node = create_nsec3_node_with_owner(nodes[i], nsec3_owner,
+		                                          zone->apex, params, ttl);
 		if (!nsec3_node) {
 			result = KNOT_ENOMEM;
 			break;
 		}
 
 		result = zone_tree_insert(nsec3_nodes, nsec3_node);
-		if (result != KNOT_EOK) {
-			break;
-		}
-
-		trie_it_next(it);
 	}
 
-	trie_it_free(it);
+	free(nodes);
+	free(names);
+	free(hashes);
 
 	return result;
 }
@@ -751,6 +884,7 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
                             const dnssec_nsec3_params_t *params,
                             uint32_t ttl,
                             bool opt_out,
+                            unsigned threads,
                             changeset_t *changeset)
 {
 	assert(zone);
@@ -778,7 +912,7 @@ int knot_nsec3_create_chain(const zone_contents_t *zone,
 		return result;
 	}
 
-	result = create_nsec3_nodes(zone, params, ttl, nsec3_nodes, changeset);
+	result = create_nsec3_nodes(zone, params, ttl, threads, nsec3_nodes, changeset);
 	if (result != KNOT_EOK) {
 		free_nsec3_tree(nsec3_nodes);
 		return result;
@@ -147,7 +147,12 @@ int knot_dnssec_zone_sign(zone_update_t *update,
 		return KNOT_EINVAL;
 	}
 
-	int result = KNOT_ERROR;
+	// The signing modifies the nodes in place.
+	int result = zone_contents_unshare(update->new_cont);
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
 	const knot_dname_t *zone_name = update->new_cont->apex->owner;
 	kdnssec_ctx_t ctx = { 0 };
 	zone_keyset_t keyset = { 0 };
@@ -232,7 +237,12 @@ int knot_dnssec_sign_update(zone_update_t *update, zone_sign_reschedule_t *resch
 		return KNOT_EINVAL;
 	}
 
-	int result = KNOT_ERROR;
+	// The signing modifies the nodes in place.
+	int result = zone_contents_unshare(update->new_cont);
+	if (result != KNOT_EOK) {
+		return result;
+	}
+
 	const knot_dname_t *zone_name = update->new_cont->apex->owner;
 	kdnssec_ctx_t ctx = { 0 };
 	zone_keyset_t keyset = { 0 };
@@ -358,7 +358,8 @@ int knot_zone_create_nsec_chain(zone_update_t *update,
 
 	if (ctx->policy->nsec3_enabled) {
 		ret = knot_nsec3_create_chain(update->new_cont, &params, nsec_ttl,
-					      ctx->policy->nsec3_opt_out, &ch);
+					      ctx->policy->nsec3_opt_out,
+					      ctx->policy->signing_threads, &ch);
 		if (ret != KNOT_EOK) {
 			goto cleanup;
 		}
@@ -432,7 +433,8 @@ int knot_zone_fix_nsec_chain(zone_update_t *update,
 		}
 		if (ctx->policy->nsec3_enabled) {
 			ret = knot_nsec3_create_chain(update->new_cont, &params, nsec_ttl,
-						      ctx->policy->nsec3_opt_out, &ch);
+						      ctx->policy->nsec3_opt_out,
+						      ctx->policy->signing_threads, &ch);
 		} else {
 			ret = knot_nsec_create_chain(update->new_cont, nsec_ttl, &ch);
 		}
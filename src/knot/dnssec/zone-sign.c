@@ -15,6 +15,7 @@
  */
 
 #include <assert.h>
+#include <string.h>
 #include <sys/types.h>
 
 #include "dnssec/error.h"
@@ -24,6 +25,7 @@
 #include "knot/dnssec/key-events.h"
 #include "knot/dnssec/rrset-sign.h"
 #include "knot/dnssec/zone-sign.h"
+#include "knot/server/dthreads.h"
 #include "libknot/libknot.h"
 #include "contrib/dynarray.h"
 #include "contrib/macros.h"
@@ -578,6 +580,195 @@ static int sign_node(zone_node_t **node, void *data)
 	return result;
 }
 
+/*! \brief Minimal number of nodes signed by one thread. */
+#define SIGN_THREAD_MIN_NODES 256
+
+/*!
+ * \brief Thread-local data for parallel zone tree signing.
+ */
+typedef struct {
+	zone_tree_t *tree;        /*!< Signed zone tree. */
+	uint8_t first[KNOT_DNAME_MAXLEN]; /*!< Lookup key of the first node to be signed. */
+	size_t first_len;         /*!< Length of the first node key. */
+	size_t nodes;             /*!< Number of nodes to be signed. */
+	zone_keyset_t zone_keys;  /*!< Zone keys with own signing contexts. */
+	changeset_t changeset;    /*!< Partial changeset. */
+	node_sign_args_t args;    /*!< Signing arguments. */
+	int result;               /*!< Signing result. */
+} sign_thread_t;
+
+/*! \brief Copy the zone keys, creating new signing contexts. */
+static int sign_thread_keys(const zone_keyset_t *from, zone_keyset_t *to)
+{
+	to->keys = calloc(from->count, sizeof(zone_key_t));
+	if (to->keys == NULL) {
+		return KNOT_ENOMEM;
+	}
+	to->count = from->count;
+
+	for (size_t i = 0; i < from->count; i++) {
+		to->keys[i] = from->keys[i];
+		to->keys[i].ctx = NULL;
+		int ret = dnssec_sign_new(&to->keys[i].ctx, from->keys[i].key);
+		if (ret != DNSSEC_EOK) {
+			return knot_error_from_libdnssec(ret);
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Free the copy of zone keys. */
+static void sign_thread_keys_free(zone_keyset_t *keys)
+{
+	for (size_t i = 0; i < keys->count; i++) {
+		dnssec_sign_free(keys->keys[i].ctx);
+	}
+	free(keys->keys);
+}
+
+/*!
+ * \brief Find the first node of each thread's part of the zone tree.
+ *
+ * The tree is walked only once, each thread then seeks directly to its part.
+ */
+static int sign_thread_split(zone_tree_t *tree, sign_thread_t *ctxs,
+                             unsigned threads)
+{
+	trie_it_t *it = trie_it_begin(tree);
+	if (it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	size_t count = zone_tree_count(tree);
+	size_t pos = 0;
+	for (unsigned i = 0; i < threads; i++) {
+		size_t first = count * i / threads;
+		for (; pos < first && !trie_it_finished(it); pos++) {
+			trie_it_next(it);
+		}
+		if (trie_it_finished(it)) {
+			trie_it_free(it);
+			return KNOT_ERROR;
+		}
+
+		size_t len = 0;
+		const char *key = trie_it_key(it, &len);
+		assert(len <= sizeof(ctxs[i].first));
+		memcpy(ctxs[i].first, key, len);
+		ctxs[i].first_len = len;
+		ctxs[i].nodes = count * (i + 1) / threads - first;
+	}
+
+	trie_it_free(it);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Sign a contiguous part of the zone tree (thread runnable). */
+static int sign_thread_run(dthread_t *thread)
+{
+	sign_thread_t *ctx = (sign_thread_t *)thread->data + dt_get_id(thread);
+
+	trie_it_t *it = trie_it_begin(ctx->tree);
+	if (it == NULL) {
+		ctx->result = KNOT_ENOMEM;
+		return KNOT_EOK;
+	}
+
+	// The tree is not modified while signing, the exact key must be found.
+	int ret = trie_it_get_leq(it, (char *)ctx->first, ctx->first_len);
+	if (ret != KNOT_EOK) {
+		ctx->result = (ret == 1) ? KNOT_ERROR : ret;
+		trie_it_free(it);
+		return KNOT_EOK;
+	}
+
+	for (size_t i = 0; i < ctx->nodes && !trie_it_finished(it); i++) {
+		ctx->result = sign_node((zone_node_t **)trie_it_val(it), &ctx->args);
+		if (ctx->result != KNOT_EOK) {
+			break;
+		}
+		trie_it_next(it);
+	}
+
+	trie_it_free(it);
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Update RRSIGs in a given zone tree in parallel.
+ *
+ * Each thread signs a contiguous part of the tree into its own changeset,
+ * the changesets are merged afterwards.
+ */
+static int zone_tree_sign_parallel(zone_tree_t *tree,
+                                   unsigned threads,
+                                   const zone_keyset_t *zone_keys,
+                                   const kdnssec_ctx_t *dnssec_ctx,
+                                   changeset_t *changeset,
+                                   knot_time_t *expires_at)
+{
+	sign_thread_t *ctxs = calloc(threads, sizeof(sign_thread_t));
+	if (ctxs == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int result = sign_thread_split(tree, ctxs, threads);
+	unsigned ready = 0;
+	for (; result == KNOT_EOK && ready < threads; ready++) {
+		sign_thread_t *ctx = &ctxs[ready];
+		ctx->tree = tree;
+		ctx->args.zone_keys = &ctx->zone_keys;
+		ctx->args.dnssec_ctx = dnssec_ctx;
+		ctx->args.changeset = &ctx->changeset;
+		ctx->args.expires_at = *expires_at;
+
+		result = changeset_init(&ctx->changeset, changeset->add->apex->owner);
+		if (result != KNOT_EOK) {
+			break;
+		}
+		result = sign_thread_keys(zone_keys, &ctx->zone_keys);
+		if (result != KNOT_EOK) {
+			sign_thread_keys_free(&ctx->zone_keys);
+			changeset_clear(&ctx->changeset);
+			break;
+		}
+	}
+
+	if (result == KNOT_EOK) {
+		dt_unit_t *unit = dt_create(threads, sign_thread_run, NULL, ctxs);
+		if (unit == NULL) {
+			result = KNOT_ENOMEM;
+		} else {
+			result = dt_start(unit);
+			if (result == KNOT_EOK) {
+				dt_join(unit);
+			}
+			dt_delete(&unit);
+		}
+	}
+
+	for (unsigned i = 0; i < ready; i++) {
+		sign_thread_t *ctx = &ctxs[i];
+		if (result == KNOT_EOK) {
+			result = ctx->result;
+		}
+		if (result == KNOT_EOK) {
+			result = changeset_merge(changeset, &ctx->changeset, 0);
+		}
+		*expires_at = knot_time_min(*expires_at, ctx->args.expires_at);
+
+		sign_thread_keys_free(&ctx->zone_keys);
+		changeset_clear(&ctx->changeset);
+	}
+
+	free(ctxs);
+
+	return result;
+}
+
 /*!
  * \brief Update RRSIGs in a given zone tree by updating changeset.
  *
@@ -599,11 +790,20 @@ static int zone_tree_sign(zone_tree_t *tree,
 	assert(dnssec_ctx);
 	assert(changeset);
 
+	*expires_at = knot_time_add(dnssec_ctx->now, dnssec_ctx->policy->rrsig_lifetime);
+
+	unsigned threads = MIN(dnssec_ctx->policy->signing_threads,
+	                       zone_tree_count(tree) / SIGN_THREAD_MIN_NODES);
+	if (threads > 1) {
+		return zone_tree_sign_parallel(tree, threads, zone_keys, dnssec_ctx,
+		                               changeset, expires_at);
+	}
+
 	node_sign_args_t args = {
 		.zone_keys = zone_keys,
 		.dnssec_ctx = dnssec_ctx,
 		.changeset = changeset,
-		.expires_at = knot_time_add(dnssec_ctx->now, dnssec_ctx->policy->rrsig_lifetime),
+		.expires_at = *expires_at,
 	};
 
 	int result = zone_tree_apply(tree, sign_node, &args);
@@ -34,20 +34,21 @@ typedef struct event_info {
 	zone_event_type_t type;
 	const zone_event_cb callback;
 	const char *name;
+	task_prio_t prio;
 } event_info_t;
 
 static const event_info_t EVENT_INFO[] = {
-	{ ZONE_EVENT_LOAD,         event_load,        "load" },
-	{ ZONE_EVENT_REFRESH,      event_refresh,     "refresh" },
-	{ ZONE_EVENT_UPDATE,       event_update,      "update" },
-	{ ZONE_EVENT_EXPIRE,       event_expire,      "expiration" },
-	{ ZONE_EVENT_FLUSH,        event_flush,       "journal flush" },
-	{ ZONE_EVENT_NOTIFY,       event_notify,      "notify" },
-	{ ZONE_EVENT_DNSSEC,       event_dnssec,      "DNSSEC re-sign" },
-	{ ZONE_EVENT_UFREEZE,      event_ufreeze,     "update freeze" },
-	{ ZONE_EVENT_UTHAW,        event_uthaw,       "update thaw" },
-	{ ZONE_EVENT_NSEC3RESALT,  event_nsec3resalt, "NSEC3 resalt" },
-	{ ZONE_EVENT_PARENT_DS_Q,  event_parent_ds_q, "parent DS query" },
+	{ ZONE_EVENT_LOAD,         event_load,        "load",            TASK_PRIO_LOW },
+	{ ZONE_EVENT_REFRESH,      event_refresh,     "refresh",         TASK_PRIO_HIGH },
+	{ ZONE_EVENT_UPDATE,       event_update,      "update",          TASK_PRIO_HIGH },
+	{ ZONE_EVENT_EXPIRE,       event_expire,      "expiration",      TASK_PRIO_HIGH },
+	{ ZONE_EVENT_FLUSH,        event_flush,       "journal flush",   TASK_PRIO_NORMAL },
+	{ ZONE_EVENT_NOTIFY,       event_notify,      "notify",          TASK_PRIO_HIGH },
+	{ ZONE_EVENT_DNSSEC,       event_dnssec,      "DNSSEC re-sign",  TASK_PRIO_NORMAL },
+	{ ZONE_EVENT_UFREEZE,      event_ufreeze,     "update freeze",   TASK_PRIO_NORMAL },
+	{ ZONE_EVENT_UTHAW,        event_uthaw,       "update thaw",     TASK_PRIO_NORMAL },
+	{ ZONE_EVENT_NSEC3RESALT,  event_nsec3resalt, "NSEC3 resalt",    TASK_PRIO_NORMAL },
+	{ ZONE_EVENT_PARENT_DS_Q,  event_parent_ds_q, "parent DS query", TASK_PRIO_NORMAL },
 	{ 0 }
 };
 
@@ -239,6 +240,17 @@ static void event_wrap(task_t *task)
 	reschedule(events);
 }
 
+/*!
+ * \brief Assign the event execution to a worker with the event's priority.
+ *
+ * \note Events lock must be held.
+ */
+static void assign_task(zone_events_t *events, zone_event_type_t type)
+{
+	events->task.prio = valid_event(type) ? get_event_info(type)->prio : TASK_PRIO_NORMAL;
+	worker_pool_assign(events->pool, &events->task);
+}
+
 /*!
  * \brief Called by scheduler thread if the event occurs.
  */
@@ -252,7 +264,7 @@ static void event_dispatch(event_t *event)
 	pthread_mutex_lock(&events->mx);
 	if (!events->running && !events->frozen) {
 		events->running = true;
-		worker_pool_assign(events->pool, &events->task);
+		assign_task(events, get_next_event(events));
 	}
 	pthread_mutex_unlock(&events->mx);
 }
@@ -374,7 +386,7 @@ void zone_events_enqueue(zone_t *zone, zone_event_type_t type)
 	    (!events->ufrozen || !ufreeze_applies(type))) {
 		events->running = true;
 		event_set_time(events, type, ZONE_EVENT_IMMEDIATE);
-		worker_pool_assign(events->pool, &events->task);
+		assign_task(events, type);
 		pthread_mutex_unlock(&events->mx);
 		return;
 	}
@@ -33,7 +33,7 @@ int event_expire(conf_t *conf, zone_t *zone)
 	log_zone_info(zone->name, "zone expired");
 
 	synchronize_rcu();
-	zone_contents_deep_free(&expired);
+	zone_contents_retire(expired, NULL, NULL);
 
 	zone->zonefile.exists = false;
 	mem_trim();
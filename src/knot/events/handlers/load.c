@@ -63,7 +63,7 @@ int event_load(conf_t *conf, zone_t *zone)
 		bool zonefile_unchanged = (zone->zonefile.exists && zone->zonefile.mtime == mtime);
 		free(filename);
 		if (ret == KNOT_EOK) {
-			ret = zone_load_contents(conf, zone->name, &zf_conts);
+			ret = zone_load_contents(conf, zone->name, &zf_conts, true);
 		}
 		if (ret != KNOT_EOK) {
 			zf_conts = NULL;
@@ -17,7 +17,9 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
+#include "contrib/sockaddr.h"
 #include "contrib/trim.h"
 #include "dnssec/random.h"
 #include "knot/common/log.h"
@@ -102,6 +104,7 @@ struct refresh_data {
 	conf_t *conf;                     //!< Server configuration.
 	const struct sockaddr *remote;    //!< Remote endpoint.
 	const knot_rrset_t *soa;          //!< Local SOA (NULL for AXFR).
+	bool soa_checked;                 //!< Remote SOA already known to be newer.
 	const size_t max_zone_size;       //!< Maximal zone size.
 	struct query_edns_data edns;      //!< EDNS data to be used in queries.
 
@@ -948,7 +951,7 @@ static int refresh_begin(knot_layer_t *layer, void *_data)
 	struct refresh_data *data = _data;
 
 	if (data->soa) {
-		data->state = STATE_SOA_QUERY;
+		data->state = data->soa_checked ? STATE_TRANSFER : STATE_SOA_QUERY;
 		data->xfr_type = XFR_TYPE_IXFR;
 		data->initial_soa_copy = NULL;
 	} else {
@@ -1016,6 +1019,7 @@ static size_t max_zone_size(conf_t *conf, const knot_dname_t *zone)
 
 typedef struct {
 	bool force_axfr;
+	bool soa_checked;
 	bool send_notify;
 } try_refresh_ctx_t;
 
@@ -1039,6 +1043,7 @@ static int try_refresh(conf_t *conf, zone_t *zone, const conf_remote_t *master,
 		.conf = conf,
 		.remote = (struct sockaddr *)&master->addr,
 		.soa = zone->contents && !trctx->force_axfr ? &soa : NULL,
+		.soa_checked = trctx->soa_checked,
 		.max_zone_size = max_zone_size(conf, zone->name),
 	};
 
@@ -1087,6 +1092,98 @@ static int64_t max_refresh_interval(conf_t *conf, const knot_dname_t *zone)
 	return conf_int(&val);
 }
 
+/*! \brief Transfers the zone from the master which answered the SOA check. */
+static int refresh_checked(conf_t *conf, zone_t *zone, const soa_check_result_t *result,
+                           try_refresh_ctx_t *trctx)
+{
+	const struct sockaddr *remote = (const struct sockaddr *)&result->master;
+
+	uint32_t local_serial = zone_contents_serial(zone->contents);
+	(void)zone_get_master_serial(zone, &local_serial);
+	bool current = serial_is_current(local_serial, result->serial);
+
+	REFRESH_LOG(LOG_INFO, zone->name, remote, "remote serial %u, %s",
+	            result->serial, current ? "zone is up-to-date" : "zone is outdated");
+
+	if (current) {
+		return KNOT_EOK;
+	}
+
+	conf_remote_t masters[SOA_CHECK_MASTERS];
+	size_t count = zone_master_list(conf, zone, masters, SOA_CHECK_MASTERS);
+	for (size_t i = 0; i < MIN(count, SOA_CHECK_MASTERS); i++) {
+		if (sockaddr_cmp((struct sockaddr *)&masters[i].addr, remote) != 0) {
+			continue;
+		}
+
+		trctx->soa_checked = true;
+		int ret = try_refresh(conf, zone, &masters[i], trctx);
+		trctx->soa_checked = false;
+		if (ret == KNOT_EOK) {
+			return KNOT_EOK;
+		}
+		break;
+	}
+
+	return KNOT_EAGAIN;
+}
+
+/*!
+ * \brief Refreshes the zone using the asynchronous SOA check.
+ *
+ * \retval KNOT_EBUSY   SOA check in progress, the refresh is scheduled once done.
+ * \retval KNOT_EAGAIN  The zone has to be refreshed synchronously.
+ * \return KNOT_E*      Refresh result.
+ */
+static int refresh_async(conf_t *conf, zone_t *zone, try_refresh_ctx_t *trctx)
+{
+	bool canceled = false;
+	int state = __atomic_load_n(&zone->soa_result.state, __ATOMIC_ACQUIRE);
+	if (state == SOA_CHECK_PENDING) {
+		// Refresh requested meanwhile (e.g. NOTIFY), the result may predate it.
+		zone->soa_result.rerun = true;
+		return KNOT_EBUSY;
+	} else if (state == SOA_CHECK_DONE) {
+		soa_check_result_t result = zone->soa_result;
+		zone->soa_result.rerun = false;
+		__atomic_store_n(&zone->soa_result.state, SOA_CHECK_IDLE, __ATOMIC_RELAXED);
+
+		switch (result.rerun ? KNOT_EAGAIN : result.ret) {
+		case KNOT_EOK:
+			return refresh_checked(conf, zone, &result, trctx);
+		case KNOT_EAGAIN: // Check canceled or outdated, start a new one.
+			canceled = true;
+			break;
+		case KNOT_ESPACE: // Truncated responses, query over TCP.
+			return KNOT_EAGAIN;
+		default:
+			return result.ret;
+		}
+	}
+
+	if (zone->soa_check == NULL || conf->cache.srv_max_refresh_queries == 0) {
+		return KNOT_EAGAIN;
+	}
+
+	conf_remote_t masters[SOA_CHECK_MASTERS];
+	size_t count = zone_master_list(conf, zone, masters, SOA_CHECK_MASTERS);
+	if (count == 0 || count > SOA_CHECK_MASTERS) {
+		return KNOT_EAGAIN;
+	}
+
+	uint32_t local_serial = zone_contents_serial(zone->contents);
+	(void)zone_get_master_serial(zone, &local_serial);
+
+	int ret = soa_check_submit(zone->soa_check, conf, zone, local_serial,
+	                           masters, count);
+	if (ret == KNOT_EOK || (ret == KNOT_ENOTRUNNING && canceled)) {
+		// Stopped server keeps the refresh planned for the next start.
+		return KNOT_EBUSY;
+	}
+
+	return KNOT_EAGAIN;
+}
+
 int event_refresh(conf_t *conf, zone_t *zone)
 {
 	assert(zone);
@@ -1104,7 +1201,17 @@ int event_refresh(conf_t *conf, zone_t *zone)
 		trctx.force_axfr = true;
 	}
 
-	int ret = zone_master_try(conf, zone, try_refresh, &trctx, "refresh");
+	int ret = KNOT_EAGAIN;
+	if (!bootstrap && !trctx.force_axfr) {
+		ret = refresh_async(conf, zone, &trctx);
+		if (ret == KNOT_EBUSY) {
+			return KNOT_EOK;
+		}
+	}
+
+	if (ret == KNOT_EAGAIN) {
+		ret = zone_master_try(conf, zone, try_refresh, &trctx, "refresh");
+	}
 	if (ret != KNOT_EOK) {
 		log_zone_error(zone->name, "refresh, failed (%s)", knot_strerror(ret));
 	}
@@ -0,0 +1,833 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dnssec/random.h"
+#include "knot/events/soa-check.h"
+#include "knot/nameserver/log.h"
+#include "knot/nameserver/tsig_ctx.h"
+#include "knot/query/query.h"
+#include "knot/zone/serial.h"
+#include "knot/zone/zone.h"
+#include "libknot/libknot.h"
+#include "contrib/macros.h"
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+#include "contrib/time.h"
+#include "contrib/ucw/lists.h"
+
+#define SOA_CHECK_LOG(priority, zone, remote, msg...) \
+	ns_log(priority, zone, LOG_OPERATION_REFRESH, LOG_DIRECTION_OUT, \
+	       (const struct sockaddr *)(remote), msg)
+
+/*!
+ * \brief Number of queries sent from one socket before it's replaced.
+ *
+ * Each socket gets a random source port, so the queries are rotated over many
+ * ports and a spoofed response has to guess both the port and the message ID.
+ */
+#define SOCKET_QUERIES 64
+
+/*! \brief Maximal number of responses read from a socket at once. */
+#define RECV_BATCH 64
+
+struct check;
+
+/*! \brief Master address of the checked zone. */
+typedef struct {
+	struct sockaddr_storage addr;
+	struct sockaddr_storage via;
+	knot_tsig_key_t key;
+	uint16_t max_payload;
+} check_remote_t;
+
+/*! \brief Shared UDP socket with the outstanding queries. */
+typedef struct {
+	node_t n;
+	int fd;
+	int family;
+	struct sockaddr_storage via;
+	unsigned sent;            /*!< Queries sent, the socket is retired at SOCKET_QUERIES. */
+	unsigned outstanding;     /*!< Queries waiting for a response. */
+	struct {
+		uint16_t id;
+		struct check *check;
+	} queries[SOCKET_QUERIES];
+} check_socket_t;
+
+/*! \brief Master with its outstanding and waiting queries. */
+typedef struct {
+	node_t n;
+	struct sockaddr_storage addr;
+	unsigned active;
+	list_t waiting;
+} check_master_t;
+
+/*! \brief SOA check of one zone. */
+typedef struct check {
+	node_t n;                 /*!< Node in the submitted, waiting or active list. */
+	zone_t *zone;
+	uint32_t serial;          /*!< Local serial. */
+	int timeout;              /*!< Query timeout in milliseconds. */
+	unsigned limit;           /*!< Maximal number of queries to one master. */
+	bool truncated;           /*!< Some response was truncated. */
+	struct query_edns_data edns;
+
+	/* Outstanding query. */
+	check_master_t *master;
+	check_socket_t *sock;
+	unsigned slot;            /*!< Query slot in the socket. */
+	unsigned tries;           /*!< Transmissions to the current remote. */
+	struct timespec deadline;
+	tsig_ctx_t tsig;
+
+	size_t cur;               /*!< Currently tried remote. */
+	size_t count;
+	check_remote_t remotes[];
+} check_t;
+
+struct soa_check {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int wakeup[2];
+
+	/* Guarded by the lock. */
+	bool running;
+	bool stop;
+	unsigned cancel_req;
+	unsigned cancel_done;
+	list_t submitted;
+
+	/* Owned by the engine thread. */
+	list_t active;            /*!< Outstanding queries in order of sending. */
+	list_t masters;
+	list_t sockets;
+	size_t sockets_count;
+	knot_pkt_t *query;
+	knot_pkt_t *resp;
+};
+
+static void check_free(check_t *check)
+{
+	for (size_t i = 0; i < check->count; i++) {
+		knot_tsig_key_deinit(&check->remotes[i].key);
+	}
+	free((uint8_t *)check->edns.custom_data);
+	free(check);
+}
+
+static void check_complete(check_t *check, int ret, uint32_t serial,
+                           const struct sockaddr_storage *master)
+{
+	zone_t *zone = check->zone;
+
+	zone->soa_result.ret = ret;
+	zone->soa_result.serial = serial;
+	if (master != NULL) {
+		zone->soa_result.master = *master;
+	} else {
+		zone->soa_result.master.ss_family = AF_UNSPEC;
+	}
+	__atomic_store_n(&zone->soa_result.state, SOA_CHECK_DONE, __ATOMIC_RELEASE);
+
+	check_free(check);
+
+	zone_events_schedule_now(zone, ZONE_EVENT_REFRESH);
+}
+
+static check_master_t *master_get(soa_check_t *engine, const struct sockaddr_storage *addr)
+{
+	check_master_t *master = NULL;
+	WALK_LIST(master, engine->masters) {
+		if (sockaddr_cmp((struct sockaddr *)&master->addr,
+		                 (struct sockaddr *)addr) == 0) {
+			return master;
+		}
+	}
+
+	master = calloc(1, sizeof(*master));
+	if (master == NULL) {
+		return NULL;
+	}
+	master->addr = *addr;
+	init_list(&master->waiting);
+	add_tail(&engine->masters, &master->n);
+
+	return master;
+}
+
+static int socket_get(soa_check_t *engine, const check_remote_t *remote,
+                      check_socket_t **out)
+{
+	bool bound = (remote->via.ss_family != AF_UNSPEC);
+
+	check_socket_t *sock = NULL;
+	WALK_LIST(sock, engine->sockets) {
+		if (sock->sent == SOCKET_QUERIES) {
+			continue;
+		}
+		if (bound ? sockaddr_cmp((struct sockaddr *)&sock->via,
+		                         (struct sockaddr *)&remote->via) == 0 :
+		            (sock->via.ss_family == AF_UNSPEC &&
+		             sock->family == remote->addr.ss_family)) {
+			*out = sock;
+			return KNOT_EOK;
+		}
+	}
+
+	int fd = bound ? net_bound_socket(SOCK_DGRAM, (struct sockaddr *)&remote->via, 0) :
+	                 net_unbound_socket(SOCK_DGRAM, (struct sockaddr *)&remote->addr);
+	if (fd < 0) {
+		return fd;
+	}
+
+	sock = calloc(1, sizeof(*sock));
+	if (sock == NULL) {
+		close(fd);
+		return KNOT_ENOMEM;
+	}
+	sock->fd = fd;
+	sock->family = remote->addr.ss_family;
+	sock->via = remote->via;
+	add_tail(&engine->sockets, &sock->n);
+	engine->sockets_count++;
+
+	*out = sock;
+	return KNOT_EOK;
+}
+
+/*! \brief Closes the retired sockets without outstanding queries. */
+static void sockets_sweep(soa_check_t *engine)
+{
+	check_socket_t *sock = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(sock, next, engine->sockets) {
+		if (sock->sent == SOCKET_QUERIES && sock->outstanding == 0) {
+			rem_node(&sock->n);
+			engine->sockets_count--;
+			close(sock->fd);
+			free(sock);
+		}
+	}
+}
+
+static check_t *socket_query(check_socket_t *sock, uint16_t id)
+{
+	for (unsigned i = 0; i < sock->sent; i++) {
+		if (sock->queries[i].check != NULL && sock->queries[i].id == id) {
+			return sock->queries[i].check;
+		}
+	}
+
+	return NULL;
+}
+
+static int query_send(soa_check_t *engine, check_t *check, check_socket_t *sock)
+{
+	const check_remote_t *remote = &check->remotes[check->cur];
+
+	assert(sock->sent < SOCKET_QUERIES);
+
+	uint16_t id = dnssec_random_uint16_t();
+	while (socket_query(sock, id) != NULL) {
+		id++;
+	}
+
+	knot_pkt_t *pkt = engine->query;
+	query_init_pkt(pkt);
+	knot_wire_set_id(pkt->wire, id);
+
+	int ret = knot_pkt_put_question(pkt, check->zone->name, KNOT_CLASS_IN,
+	                                KNOT_RRTYPE_SOA);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	struct query_edns_data edns = check->edns;
+	edns.max_payload = remote->max_payload;
+	ret = query_put_edns(pkt, &edns);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	tsig_init(&check->tsig, remote->key.name != NULL ? &remote->key : NULL);
+	ret = tsig_sign_packet(&check->tsig, pkt);
+	if (ret == KNOT_EOK) {
+		ret = net_dgram_send(sock->fd, pkt->wire, pkt->size,
+		                     (struct sockaddr *)&remote->addr);
+		ret = (ret == pkt->size) ? KNOT_EOK : KNOT_ECONN;
+	}
+	if (ret != KNOT_EOK) {
+		tsig_cleanup(&check->tsig);
+		return ret;
+	}
+
+	check->slot = sock->sent++;
+	sock->queries[check->slot].id = id;
+	sock->queries[check->slot].check = check;
+	sock->outstanding++;
+	check->sock = sock;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Sends the query to the current remote and waits for a part of the timeout. */
+static int query_transmit(soa_check_t *engine, check_t *check)
+{
+	const check_remote_t *remote = &check->remotes[check->cur];
+
+	check_socket_t *sock = NULL;
+	int ret = socket_get(engine, remote, &sock);
+	if (ret == KNOT_EOK) {
+		ret = query_send(engine, check, sock);
+	}
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	/* The query is retransmitted if unanswered within its part of the timeout. */
+	int timeout = check->timeout / SOA_CHECK_TRIES;
+	struct timespec now = time_now();
+	check->deadline.tv_sec = now.tv_sec + timeout / 1000;
+	check->deadline.tv_nsec = now.tv_nsec + (timeout % 1000) * 1000000;
+	if (check->deadline.tv_nsec >= 1000000000) {
+		check->deadline.tv_sec += 1;
+		check->deadline.tv_nsec -= 1000000000;
+	}
+
+	check->tries++;
+	add_tail(&engine->active, &check->n);
+
+	return KNOT_EOK;
+}
+
+/*! \brief Forgets the outstanding query, its master slot is kept. */
+static void query_detach(check_t *check)
+{
+	check_socket_t *sock = check->sock;
+
+	sock->queries[check->slot].check = NULL;
+	sock->outstanding--;
+	check->sock = NULL;
+	tsig_cleanup(&check->tsig);
+	rem_node(&check->n);
+}
+
+static void check_next(soa_check_t *engine, check_t *check);
+
+/*! \brief Sends the query to the current remote (the master has a free slot). */
+static void check_send(soa_check_t *engine, check_t *check)
+{
+	const check_remote_t *remote = &check->remotes[check->cur];
+
+	check->tries = 0;
+	int ret = query_transmit(engine, check);
+	if (ret != KNOT_EOK) {
+		SOA_CHECK_LOG(LOG_WARNING, check->zone->name, &remote->addr,
+		              "failed (%s)", knot_strerror(ret));
+		check->master = NULL;
+		check->cur++;
+		check_next(engine, check);
+		return;
+	}
+
+	check->master->active++;
+}
+
+/*! \brief Moves the check to the current remote or finishes it. */
+static void check_next(soa_check_t *engine, check_t *check)
+{
+	if (check->cur >= check->count) {
+		check_complete(check, check->truncated ? KNOT_ESPACE : KNOT_ENOMASTER,
+		               0, NULL);
+		return;
+	}
+
+	check_master_t *master = master_get(engine, &check->remotes[check->cur].addr);
+	if (master == NULL) {
+		check->cur++;
+		check_next(engine, check);
+		return;
+	}
+	check->master = master;
+
+	if (master->active >= check->limit || !EMPTY_LIST(master->waiting)) {
+		add_tail(&master->waiting, &check->n);
+	} else {
+		check_send(engine, check);
+	}
+}
+
+/*! \brief Releases the outstanding query of the check. */
+static check_master_t *query_release(check_t *check)
+{
+	check_master_t *master = check->master;
+
+	if (check->sock != NULL) {
+		query_detach(check);
+	}
+	check->master = NULL;
+	master->active--;
+
+	return master;
+}
+
+/*! \brief Sends the waiting queries the master has free slots for. */
+static void master_dispatch(soa_check_t *engine, check_master_t *master)
+{
+	while (!EMPTY_LIST(master->waiting)) {
+		check_t *check = HEAD(master->waiting);
+		if (master->active >= check->limit) {
+			break;
+		}
+		rem_node(&check->n);
+		check_send(engine, check);
+	}
+}
+
+static void check_failed(soa_check_t *engine, check_t *check)
+{
+	master_dispatch(engine, query_release(check));
+
+	check->cur++;
+	check_next(engine, check);
+}
+
+static void handle_response(soa_check_t *engine, check_socket_t *sock,
+                            const struct sockaddr_storage *from)
+{
+	knot_pkt_t *pkt = engine->resp;
+	if (pkt->size < KNOT_WIRE_HEADER_SIZE) {
+		return;
+	}
+
+	check_t *check = socket_query(sock, knot_wire_get_id(pkt->wire));
+	if (check == NULL) {
+		return;
+	}
+
+	// Ignore unrelated or unparsable messages, the query times out eventually.
+	const check_remote_t *remote = &check->remotes[check->cur];
+	if (sockaddr_cmp((struct sockaddr *)from, (struct sockaddr *)&remote->addr) != 0 ||
+	    knot_pkt_parse(pkt, 0) != KNOT_EOK || !knot_wire_get_qr(pkt->wire) ||
+	    knot_pkt_qtype(pkt) != KNOT_RRTYPE_SOA ||
+	    !knot_dname_is_equal(knot_pkt_qname(pkt), check->zone->name)) {
+		return;
+	}
+
+	int ret = tsig_verify_packet(&check->tsig, pkt);
+	if (ret == KNOT_EOK && tsig_unsigned_count(&check->tsig) != 0) {
+		ret = KNOT_TSIG_EBADSIG;
+	}
+	if (ret != KNOT_EOK) {
+		SOA_CHECK_LOG(LOG_WARNING, check->zone->name, &remote->addr,
+		              "failed (%s)", knot_strerror(ret));
+		check_failed(engine, check);
+		return;
+	}
+
+	if (knot_wire_get_tc(pkt->wire)) {
+		// The query is repeated over TCP if no other master answers.
+		check->truncated = true;
+		check_failed(engine, check);
+		return;
+	}
+
+	if (knot_pkt_ext_rcode(pkt) != KNOT_RCODE_NOERROR) {
+		SOA_CHECK_LOG(LOG_WARNING, check->zone->name, &remote->addr,
+		              "server responded with error '%s'",
+		              knot_pkt_ext_rcode_name(pkt));
+		check_failed(engine, check);
+		return;
+	}
+
+	const knot_pktsection_t *answer = knot_pkt_section(pkt, KNOT_ANSWER);
+	const knot_rrset_t *rr = answer->count == 1 ? knot_pkt_rr(answer, 0) : NULL;
+	if (!rr || rr->type != KNOT_RRTYPE_SOA || rr->rrs.rr_count != 1) {
+		SOA_CHECK_LOG(LOG_WARNING, check->zone->name, &remote->addr,
+		              "malformed message");
+		check_failed(engine, check);
+		return;
+	}
+
+	uint32_t serial = knot_soa_serial(&rr->rrs);
+	bool current = (serial_compare(check->serial, serial) & SERIAL_MASK_GEQ);
+	bool master_uptodate = (serial_compare(serial, check->serial) & SERIAL_MASK_GEQ);
+	if (current && !master_uptodate) {
+		SOA_CHECK_LOG(LOG_INFO, check->zone->name, &remote->addr,
+		              "remote serial %u, master is outdated", serial);
+		check_failed(engine, check);
+		return;
+	}
+
+	master_dispatch(engine, query_release(check));
+	check_complete(check, KNOT_EOK, serial, &remote->addr);
+}
+
+static void socket_recv(soa_check_t *engine, check_socket_t *sock)
+{
+	knot_pkt_t *pkt = engine->resp;
+
+	for (int i = 0; i < RECV_BATCH; i++) {
+		struct sockaddr_storage from = { 0 };
+		socklen_t from_len = sizeof(from);
+
+		knot_pkt_clear(pkt);
+		ssize_t ret = recvfrom(sock->fd, pkt->wire, pkt->max_size, 0,
+		                       (struct sockaddr *)&from, &from_len);
+		if (ret < 0) {
+			return;
+		}
+		pkt->size = ret;
+
+		handle_response(engine, sock, &from);
+	}
+}
+
+/*! \brief Fails the timed out queries, returns the time to the next timeout. */
+static int expire_queries(soa_check_t *engine)
+{
+	struct timespec now = time_now();
+
+	while (!EMPTY_LIST(engine->active)) {
+		check_t *check = HEAD(engine->active);
+		double left = time_diff_ms(&now, &check->deadline);
+		if (left > 0) {
+			return (int)left + 1;
+		}
+
+		const check_remote_t *remote = &check->remotes[check->cur];
+
+		/* Retransmit the lost query or response. */
+		int ret = KNOT_ETIMEOUT;
+		if (check->tries < SOA_CHECK_TRIES) {
+			query_detach(check);
+			ret = query_transmit(engine, check);
+			if (ret == KNOT_EOK) {
+				continue;
+			}
+		}
+
+		SOA_CHECK_LOG(LOG_WARNING, check->zone->name, &remote->addr,
+		              "failed (%s)", knot_strerror(ret));
+		check_failed(engine, check);
+	}
+
+	return -1;
+}
+
+static void cancel_all(soa_check_t *engine, list_t *submitted)
+{
+	check_t *check = NULL, *next = NULL;
+	WALK_LIST_DELSAFE(check, next, engine->active) {
+		query_release(check);
+		check_complete(check, KNOT_EAGAIN, 0, NULL);
+	}
+
+	check_master_t *master = NULL;
+	WALK_LIST(master, engine->masters) {
+		WALK_LIST_DELSAFE(check, next, master->waiting) {
+			rem_node(&check->n);
+			check_complete(check, KNOT_EAGAIN, 0, NULL);
+		}
+	}
+
+	WALK_LIST_DELSAFE(check, next, *submitted) {
+		rem_node(&check->n);
+		check_complete(check, KNOT_EAGAIN, 0, NULL);
+	}
+}
+
+static void *engine_run(void *arg)
+{
+	soa_check_t *engine = arg;
+
+	while (true) {
+		list_t submitted;
+		init_list(&submitted);
+
+		pthread_mutex_lock(&engine->lock);
+		check_t *check = NULL, *next = NULL;
+		WALK_LIST_DELSAFE(check, next, engine->submitted) {
+			rem_node(&check->n);
+			add_tail(&submitted, &check->n);
+		}
+		bool stop = engine->stop;
+		unsigned cancel = engine->cancel_req;
+		pthread_mutex_unlock(&engine->lock);
+
+		if (stop || cancel != engine->cancel_done) {
+			cancel_all(engine, &submitted);
+
+			pthread_mutex_lock(&engine->lock);
+			engine->cancel_done = cancel;
+			pthread_cond_broadcast(&engine->cond);
+			pthread_mutex_unlock(&engine->lock);
+
+			if (stop) {
+				break;
+			}
+		}
+
+		WALK_LIST_DELSAFE(check, next, submitted) {
+			rem_node(&check->n);
+			check_next(engine, check);
+		}
+
+		int timeout = expire_queries(engine);
+		sockets_sweep(engine);
+
+		size_t nfds = 1 + engine->sockets_count;
+		struct pollfd fds[nfds];
+		fds[0].fd = engine->wakeup[0];
+		fds[0].events = POLLIN;
+		size_t i = 1;
+		check_socket_t *sock = NULL;
+		WALK_LIST(sock, engine->sockets) {
+			fds[i].fd = sock->fd;
+			fds[i].events = POLLIN;
+			i++;
+		}
+
+		if (poll(fds, nfds, timeout) <= 0) {
+			continue;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			uint8_t buf[64];
+			while (read(engine->wakeup[0], buf, sizeof(buf)) > 0);
+		}
+
+		// New sockets may be appended while processing the responses.
+		i = 1;
+		WALK_LIST(sock, engine->sockets) {
+			if (i == nfds) {
+				break;
+			}
+			if (fds[i++].revents & POLLIN) {
+				socket_recv(engine, sock);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void engine_wake(soa_check_t *engine)
+{
+	uint8_t byte = 0;
+	if (write(engine->wakeup[1], &byte, sizeof(byte)) < 0) {
+		// The pipe is full, so the engine will wake up anyway.
+	}
+}
+
+soa_check_t *soa_check_new(void)
+{
+	soa_check_t *engine = calloc(1, sizeof(*engine));
+	if (engine == NULL) {
+		return NULL;
+	}
+
+	if (pipe(engine->wakeup) != 0) {
+		free(engine);
+		return NULL;
+	}
+	for (int i = 0; i < 2; i++) {
+		fcntl(engine->wakeup[i], F_SETFL, O_NONBLOCK);
+		fcntl(engine->wakeup[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	engine->query = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	engine->resp = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	if (engine->query == NULL || engine->resp == NULL) {
+		knot_pkt_free(engine->query);
+		knot_pkt_free(engine->resp);
+		close(engine->wakeup[0]);
+		close(engine->wakeup[1]);
+		free(engine);
+		return NULL;
+	}
+
+	pthread_mutex_init(&engine->lock, NULL);
+	pthread_cond_init(&engine->cond, NULL);
+	init_list(&engine->submitted);
+	init_list(&engine->active);
+	init_list(&engine->masters);
+	init_list(&engine->sockets);
+
+	return engine;
+}
+
+void soa_check_free(soa_check_t *engine)
+{
+	if (engine == NULL) {
+		return;
+	}
+
+	assert(!engine->running);
+
+	check_master_t *master = NULL, *next_master = NULL;
+	WALK_LIST_DELSAFE(master, next_master, engine->masters) {
+		free(master);
+	}
+
+	check_socket_t *sock = NULL, *next_sock = NULL;
+	WALK_LIST_DELSAFE(sock, next_sock, engine->sockets) {
+		close(sock->fd);
+		free(sock);
+	}
+
+	knot_pkt_free(engine->query);
+	knot_pkt_free(engine->resp);
+	close(engine->wakeup[0]);
+	close(engine->wakeup[1]);
+	pthread_cond_destroy(&engine->cond);
+	pthread_mutex_destroy(&engine->lock);
+
+	free(engine);
+}
+
+int soa_check_start(soa_check_t *engine)
+{
+	if (engine == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	pthread_mutex_lock(&engine->lock);
+	if (engine->running) {
+		pthread_mutex_unlock(&engine->lock);
+		return KNOT_EOK;
+	}
+
+	engine->stop = false;
+	int ret = pthread_create(&engine->thread, NULL, engine_run, engine);
+	engine->running = (ret == 0);
+	pthread_mutex_unlock(&engine->lock);
+
+	return (ret == 0) ? KNOT_EOK : knot_map_errno_code(ret);
+}
+
+void soa_check_stop(soa_check_t *engine)
+{
+	if (engine == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&engine->lock);
+	if (!engine->running) {
+		pthread_mutex_unlock(&engine->lock);
+		return;
+	}
+	engine->stop = true;
+	engine_wake(engine);
+	pthread_mutex_unlock(&engine->lock);
+
+	pthread_join(engine->thread, NULL);
+
+	pthread_mutex_lock(&engine->lock);
+	engine->running = false;
+	pthread_mutex_unlock(&engine->lock);
+}
+
+void soa_check_cancel(soa_check_t *engine)
+{
+	if (engine == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&engine->lock);
+	if (engine->running && !engine->stop) {
+		unsigned req = ++engine->cancel_req;
+		engine_wake(engine);
+		while (engine->cancel_done != req) {
+			pthread_cond_wait(&engine->cond, &engine->lock);
+		}
+	}
+	pthread_mutex_unlock(&engine->lock);
+}
+
+int soa_check_submit(soa_check_t *engine, conf_t *conf, zone_t *zone,
+                     uint32_t serial, const conf_remote_t *masters, size_t count)
+{
+	if (engine == NULL || conf == NULL || zone == NULL || masters == NULL ||
+	    count == 0) {
+		return KNOT_EINVAL;
+	}
+
+	check_t *check = calloc(1, sizeof(*check) + count * sizeof(check_remote_t));
+	if (check == NULL) {
+		return KNOT_ENOMEM;
+	}
+	check->zone = zone;
+	check->serial = serial;
+	check->timeout = conf->cache.srv_tcp_reply_timeout * 1000;
+	check->limit = MAX(conf->cache.srv_max_refresh_queries, 1);
+	check->count = count;
+
+	int ret = KNOT_EOK;
+	for (size_t i = 0; i < count && ret == KNOT_EOK; i++) {
+		check_remote_t *remote = &check->remotes[i];
+		remote->addr = masters[i].addr;
+		remote->via = masters[i].via;
+
+		struct query_edns_data edns;
+		ret = query_edns_data_init(&edns, conf, zone->name, remote->addr.ss_family);
+		if (ret != KNOT_EOK) {
+			break;
+		}
+		remote->max_payload = edns.max_payload;
+
+		// The custom option is configured per zone, the data points into conf.
+		if (i == 0 && edns.custom_code != 0) {
+			uint8_t *data = malloc(edns.custom_len);
+			if (data == NULL) {
+				ret = KNOT_ENOMEM;
+				break;
+			}
+			memcpy(data, edns.custom_data, edns.custom_len);
+			edns.custom_data = data;
+			check->edns = edns;
+		}
+
+		if (masters[i].key.name != NULL) {
+			ret = knot_tsig_key_copy(&remote->key, &masters[i].key);
+		}
+	}
+	if (ret != KNOT_EOK) {
+		check_free(check);
+		return ret;
+	}
+
+	pthread_mutex_lock(&engine->lock);
+	if (!engine->running || engine->stop) {
+		pthread_mutex_unlock(&engine->lock);
+		check_free(check);
+		return KNOT_ENOTRUNNING;
+	}
+	__atomic_store_n(&zone->soa_result.state, SOA_CHECK_PENDING, __ATOMIC_RELAXED);
+	add_tail(&engine->submitted, &check->n);
+	engine_wake(engine);
+	pthread_mutex_unlock(&engine->lock);
+
+	return KNOT_EOK;
+}
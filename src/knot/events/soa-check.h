@@ -0,0 +1,129 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file
+ *
+ * Asynchronous SOA check engine.
+ *
+ * The engine runs one thread sending the refresh SOA queries over shared UDP
+ * sockets, so the background workers don't wait for the masters' replies.
+ * The masters of a zone are tried in the given order and the number of
+ * outstanding queries to one master is limited. Once the check finishes,
+ * the result is stored into the zone and its refresh event is scheduled
+ * to process it.
+ *
+ * \addtogroup events
+ * @{
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "knot/conf/conf.h"
+
+struct zone;
+
+/*! \brief Maximal number of master addresses checked for one zone. */
+#define SOA_CHECK_MASTERS 16
+
+/*! \brief Number of query transmissions to one master within the timeout. */
+#define SOA_CHECK_TRIES 3
+
+typedef struct soa_check soa_check_t;
+
+/*!
+ * \brief SOA check state of a zone.
+ */
+typedef enum {
+	SOA_CHECK_IDLE = 0, /*!< No check in progress. */
+	SOA_CHECK_PENDING,  /*!< Check in progress. */
+	SOA_CHECK_DONE,     /*!< Check finished, result not processed yet. */
+} soa_check_state_t;
+
+/*!
+ * \brief SOA check result.
+ *
+ * The result codes are:
+ * - KNOT_EOK        A master answered with a serial not older than the local one.
+ * - KNOT_ESPACE     No master answered, some responses were truncated.
+ * - KNOT_EAGAIN     The check was canceled.
+ * - KNOT_ENOMASTER  No master answered.
+ */
+typedef struct {
+	int state;                      /*!< Check state, accessed atomically. */
+	bool rerun;                     /*!< Refresh requested during the check. */
+	int ret;                        /*!< Result code. */
+	uint32_t serial;                /*!< Serial of the answering master. */
+	struct sockaddr_storage master; /*!< Address of the answering master. */
+} soa_check_result_t;
+
+/*!
+ * \brief Creates the SOA check engine.
+ *
+ * \return New engine or NULL on error.
+ */
+soa_check_t *soa_check_new(void);
+
+/*!
+ * \brief Releases the SOA check engine (must be stopped).
+ */
+void soa_check_free(soa_check_t *engine);
+
+/*!
+ * \brief Starts the engine thread.
+ *
+ * \return KNOT_E*
+ */
+int soa_check_start(soa_check_t *engine);
+
+/*!
+ * \brief Cancels all checks and stops the engine thread.
+ *
+ * The canceled zones get the KNOT_EAGAIN result and a refresh scheduled.
+ */
+void soa_check_stop(soa_check_t *engine);
+
+/*!
+ * \brief Cancels all checks in progress.
+ *
+ * The canceled zones get the KNOT_EAGAIN result and a refresh scheduled.
+ * No zone is referenced by the engine once the function returns.
+ */
+void soa_check_cancel(soa_check_t *engine);
+
+/*!
+ * \brief Starts the SOA check of the zone.
+ *
+ * The zone must be in the idle state and it's set to pending on success.
+ *
+ * \param engine   SOA check engine.
+ * \param conf     Configuration (timeout, query limit, EDNS).
+ * \param zone     Zone to check.
+ * \param serial   Local zone serial.
+ * \param masters  Master addresses in order of preference.
+ * \param count    Number of master addresses.
+ *
+ * \retval KNOT_EOK          Check started.
+ * \retval KNOT_ENOTRUNNING  Engine isn't running.
+ * \return KNOT_E*           Other errors.
+ */
+int soa_check_submit(soa_check_t *engine, conf_t *conf, struct zone *zone,
+                     uint32_t serial, const conf_remote_t *masters, size_t count);
+
+/*! @} */
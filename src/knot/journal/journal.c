@@ -21,6 +21,7 @@
 #include "knot/journal/journal.h"
 #include "knot/common/log.h"
 #include "contrib/files.h"
+#include "contrib/macros.h"
 #include "libknot/endian.h"
 
 /*! \brief Journal version. */
@@ -120,6 +121,7 @@ typedef struct {
 typedef struct {
 	journal_t *j;
 	knot_db_txn_t *txn;
+	knot_db_txn_t *parent;
 	int ret;
 	bool opened;
 
@@ -261,8 +263,8 @@ static void txn_begin(txn_t *txn, bool write_allowed)
 		return;
 	}
 
-	txn->ret = txn->j->db->db_api->txn_begin(txn->j->db->db, txn->txn,
-	                                         (write_allowed ? 0 : KNOT_DB_RDONLY));
+	txn->ret = knot_db_lmdb_txn_begin(txn->j->db->db, txn->txn, txn->parent,
+	                                  (write_allowed ? 0 : KNOT_DB_RDONLY));
 
 	txn->is_rw = write_allowed;
 	txn->opened = true;
@@ -877,6 +879,82 @@ int journal_load_changesets(journal_t *j, list_t *dst, uint32_t from)
 	return txn->ret;
 }
 
+typedef struct {
+	uint8_t *data;      // concatenated chunk contents
+	size_t size;
+	size_t capacity;
+	uint32_t serial_to; // serial-to of the last loaded changeset
+	uint32_t to;        // requested serial-to
+	bool complete;      // changeset with requested serial-to loaded
+} load_serialized_ctx_t;
+
+static int load_serialized_itercb(iteration_ctx_t *ctx)
+{
+	load_serialized_ctx_t *lctx = ctx->iter_context;
+	if (lctx->complete) {
+		return KNOT_EOK;
+	}
+
+	size_t len = ctx->val->len - JOURNAL_HEADER_SIZE;
+	if (lctx->size + len > lctx->capacity) {
+		size_t capacity = MAX(2 * lctx->capacity, lctx->size + len);
+		uint8_t *data = realloc(lctx->data, capacity);
+		if (data == NULL) {
+			return KNOT_ENOMEM;
+		}
+		lctx->data = data;
+		lctx->capacity = capacity;
+	}
+	memcpy(lctx->data + lctx->size, ctx->val->data + JOURNAL_HEADER_SIZE, len);
+	lctx->size += len;
+
+	if (ctx->chunk_index == ctx->chunk_count - 1) {
+		lctx->serial_to = ctx->serial_to;
+		lctx->complete = serial_equal(ctx->serial_to, lctx->to);
+	}
+
+	return KNOT_EOK;
+}
+
+int journal_load_serialized(journal_t *j, uint32_t from, uint32_t to,
+                            uint8_t **data, size_t *size)
+{
+	if (j == NULL || j->db == NULL || data == NULL || size == NULL) return KNOT_EINVAL;
+
+	load_serialized_ctx_t lctx = { .serial_to = from, .to = to };
+
+	local_txn_t(txn, j);
+	txn_begin(txn, false);
+
+	uint32_t ms = txn->shadow_md.merged_serial;
+	if (txn->ret == KNOT_EOK && md_flag(txn, MERGED_SERIAL_VALID) &&
+	    serial_equal(ms, from)) {
+		iterate(j, txn, load_serialized_itercb, JOURNAL_ITERATION_CHUNKS, &lctx,
+		        ms, ms, normal_iterkeycb);
+	}
+
+	uint32_t ls = txn->shadow_md.last_serial;
+	if (txn->ret == KNOT_EOK && !lctx.complete) {
+		iterate(j, txn, load_serialized_itercb, JOURNAL_ITERATION_CHUNKS, &lctx,
+		        lctx.serial_to, ls, normal_iterkeycb);
+	}
+	txn_commit(txn);
+
+	// The history doesn't lead to the requested serial.
+	if (txn->ret == KNOT_EOK && !lctx.complete) {
+		txn->ret = KNOT_ENOENT;
+	}
+
+	if (txn->ret != KNOT_EOK) {
+		free(lctx.data);
+		return txn->ret;
+	}
+
+	*data = lctx.data;
+	*size = lctx.size;
+	return KNOT_EOK;
+}
+
 int load_bootstrap_iterkeycb(iteration_ctx_t *ctx)
 {
 	txn_key_str_u32(ctx->txn, ctx->txn->j->zone, KEY_BOOTSTRAP_CHANGESET, ctx->chunk_index);
@@ -1250,12 +1328,21 @@ m_u_ch_end:
 		} \
 	}
 
-static int store_changesets(journal_t *j, list_t *changesets)
+// Nested transaction of a batch can't be restarted, so anything that may need
+// a restart or a big deletion is left for storing directly after the batch.
+#define try_batch_bail \
+	if (parent != NULL) { \
+		txn->ret = KNOT_EAGAIN; \
+		goto store_changeset_cleanup; \
+	}
+
+static int store_changesets(journal_t *j, list_t *changesets, knot_db_txn_t *parent,
+                            size_t *batch_usage)
 {
 	// PART 1 : initializers, compute serialized_sizes, transaction start
 	changeset_t *ch;
 
-	size_t nchs = 0, inserted_size = 0, insert_txn_count = 1;
+	size_t nchs = 0, inserted_size = 0, inserted_total = 0, insert_txn_count = 1;
 	size_t serialized_size_changes = 0, serialized_size_merged = 0;
 
 	uint8_t *allchunks = NULL;
@@ -1267,7 +1354,9 @@ static int store_changesets(journal_t *j, list_t *changesets)
 	bool merged_into_bootstrap = false;
 	bool inserting_bootstrap = false;
 
-	size_t occupied_last, occupied_now = knot_db_lmdb_get_usage(j->db->db);
+	// The batch writes aren't visible to a separate transaction.
+	size_t occupied_last, occupied_now = (parent != NULL) ? *batch_usage :
+	                                     knot_db_lmdb_get_usage(j->db->db);
 
 	WALK_LIST(ch, *changesets) {
 		nchs++;
@@ -1278,6 +1367,7 @@ static int store_changesets(journal_t *j, list_t *changesets)
 	}
 
 	local_txn_t(txn, j);
+	txn->parent = parent;
 	txn_begin(txn, true);
 
 	bool zone_in_journal = has_bootstrap_changeset(j, txn);
@@ -1304,6 +1394,7 @@ static int store_changesets(journal_t *j, list_t *changesets)
 
 	// PART 3a : delete all if inserting bootstrap changeset
 	if (inserting_bootstrap) {
+		try_batch_bail
 		drop_journal(j, txn);
 		txn_restart(txn);
 	}
@@ -1314,6 +1405,7 @@ static int store_changesets(journal_t *j, list_t *changesets)
 	occupied_max = journal_max_usage(j);
 	occupied += serialized_size_changes;
 	if (occupied > occupied_max) {
+		try_batch_bail
 		size_t freed;
 		size_t tofree = (occupied - occupied_max) * journal_tofree_factor(j);
 		size_t free_min = tofree * journal_minfree_factor(j);
@@ -1340,6 +1432,7 @@ static int store_changesets(journal_t *j, list_t *changesets)
 		log_zone_warning(j->zone, "journal, unable to make free slot for insert");
 		goto store_changeset_cleanup;
 	} else if (over_limit > 0) {
+		try_batch_bail
 		size_t deled;
 		delete_count(j, txn, over_limit, &deled);
 		over_limit -= deled;
@@ -1357,6 +1450,7 @@ static int store_changesets(journal_t *j, list_t *changesets)
 	if (md_flag(txn, SERIAL_TO_VALID) && (is_first_bootstrap ||
 	    !serial_equal(txn->shadow_md.last_serial_to, serial)) &&
 	    !inserting_bootstrap /* if inserting bootstrap, drop_journal() was called, so no discontinuity */) {
+		try_batch_bail
 		log_zone_warning(j->zone, "journal, discontinuity in changes history (%u -> %u), dropping older changesets",
 		                 txn->shadow_md.last_serial_to, serial);
 		if (zone_in_journal) {
@@ -1379,6 +1473,7 @@ static int store_changesets(journal_t *j, list_t *changesets)
 		}
 		txn_key_2u32(txn, j->zone, serial_to, 0);
 		if (txn_find(txn)) {
+			try_batch_bail
 			log_zone_warning(j->zone, "journal, duplicate changeset serial (%u), dropping older changesets",
 			                 serial_to);
 			if (zone_in_journal) {
@@ -1444,7 +1539,9 @@ static int store_changesets(journal_t *j, list_t *changesets)
 			txn->val = vals[i];
 			txn_insert(txn);
 			inserted_size += (vals+i)->len;
+			inserted_total += (vals+i)->len;
 			if ((float)inserted_size > journal_max_txn(j) * (float)j->db->fslimit) { // insert txn too large
+				try_batch_bail
 				inserted_size = 0;
 				txn->shadow_md.dirty_serial = serial;
 				txn->shadow_md.flags |= DIRTY_SERIAL_VALID;
@@ -1496,8 +1593,13 @@ store_changeset_cleanup:
 
 	txn_commit(txn);
 
-	if (txn->ret != KNOT_EOK) {
+	if (txn->ret == KNOT_EOK && parent != NULL) {
+		*batch_usage += inserted_total;
+	}
+
+	if (txn->ret != KNOT_EOK && txn->ret != KNOT_EAGAIN) {
 		local_txn_t(ddtxn, j);
+		ddtxn->parent = parent;
 		txn_begin(ddtxn, true);
 		if (md_flag(ddtxn, DIRTY_SERIAL_VALID)) {
 			delete_dirty_serial(j, ddtxn);
@@ -1521,6 +1623,132 @@ store_changeset_cleanup:
 	return txn->ret;
 }
 #undef try_flush
+#undef try_batch_bail
+
+/*! \brief Changesets waiting for group commit. */
+typedef struct {
+	node_t n;
+	journal_t *j;
+	list_t *changesets;
+	size_t size;
+	int ret;
+	bool done;
+} store_request_t;
+
+static bool group_commit_allowed(journal_db_t *db)
+{
+#ifdef __OpenBSD__
+	return false; // MDB_WRITEMAP is enforced, no nested transactions.
+#else
+	return db->mode == JOURNAL_MODE_ROBUST;
+#endif
+}
+
+/*!
+ * \brief Store a batch of changesets of possibly different zones at once.
+ *
+ * Each request is stored in a nested transaction, so a failing one doesn't
+ * affect the others. The batch is made durable by one commit. Requests which
+ * need to free space or drop the history are stored directly afterwards.
+ */
+static void store_batch(journal_db_t *db, list_t *batch)
+{
+	store_request_t *req = HEAD(*batch);
+	if (req == TAIL(*batch)) {
+		req->ret = store_changesets(req->j, req->changesets, NULL, NULL);
+		return;
+	}
+
+	// DB usage including the preceding requests of the batch.
+	size_t usage = knot_db_lmdb_get_usage(db->db);
+
+	knot_db_txn_t parent;
+	int ret = knot_db_lmdb_txn_begin(db->db, &parent, NULL, 0);
+	WALK_LIST(req, *batch) {
+		req->ret = (ret == KNOT_EOK) ?
+		           store_changesets(req->j, req->changesets, &parent, &usage) : ret;
+	}
+	if (ret == KNOT_EOK) {
+		ret = db->db_api->txn_commit(&parent);
+	}
+
+	WALK_LIST(req, *batch) {
+		if (req->ret == KNOT_EAGAIN) {
+			req->ret = store_changesets(req->j, req->changesets, NULL, NULL);
+		} else if (req->ret == KNOT_EOK) {
+			req->ret = ret;
+		}
+	}
+}
+
+/*!
+ * \brief Store changesets using group commit.
+ *
+ * The caller queues the changesets and waits. If no batch is being committed,
+ * the caller commits the queued changesets of all waiting callers (up to
+ * the transaction size limit) at once. So the changesets queued during one
+ * commit are committed together by the next one.
+ */
+static int store_changesets_grouped(journal_t *j, list_t *changesets)
+{
+	journal_db_t *db = j->db;
+	size_t batch_max = journal_max_txn(j) * (float)db->fslimit;
+
+	store_request_t req = {
+		.j = j,
+		.changesets = changesets,
+	};
+	changeset_t *ch;
+	WALK_LIST(ch, *changesets) {
+		req.size += changeset_serialized_size(ch);
+	}
+
+	pthread_mutex_lock(&db->commit_lock);
+	add_tail(&db->commit_queue, &req.n);
+	while (!req.done) {
+		if (db->committing) {
+			pthread_cond_wait(&db->commit_cond, &db->commit_lock);
+			continue;
+		}
+
+		// Take the batch over.
+		db->committing = true;
+		list_t batch;
+		init_list(&batch);
+		size_t batch_size = 0;
+		store_request_t *r, *nxt;
+		WALK_LIST_DELSAFE(r, nxt, db->commit_queue) {
+			if (!EMPTY_LIST(batch) && batch_size + r->size > batch_max) {
+				break;
+			}
+			rem_node(&r->n);
+			add_tail(&batch, &r->n);
+			batch_size += r->size;
+		}
+		pthread_mutex_unlock(&db->commit_lock);
+
+		store_batch(db, &batch);
+
+		pthread_mutex_lock(&db->commit_lock);
+		WALK_LIST(r, batch) {
+			r->done = true;
+		}
+		db->committing = false;
+		pthread_cond_broadcast(&db->commit_cond);
+	}
+	pthread_mutex_unlock(&db->commit_lock);
+
+	return req.ret;
+}
+
+static int store_changesets_any(journal_t *j, list_t *changesets)
+{
+	if (group_commit_allowed(j->db)) {
+		return store_changesets_grouped(j, changesets);
+	} else {
+		return store_changesets(j, changesets, NULL, NULL);
+	}
+}
 
 int journal_store_changeset(journal_t *journal, changeset_t *ch)
 {
@@ -1535,7 +1763,7 @@ int journal_store_changeset(journal_t *journal, changeset_t *ch)
 	list_t list;
 	init_list(&list);
 	add_tail(&list, &ch_shallowcopy->n);
-	int ret = store_changesets(journal, &list);
+	int ret = store_changesets_any(journal, &list);
 
 	free(ch_shallowcopy);
 	return ret;
@@ -1544,7 +1772,7 @@ int journal_store_changeset(journal_t *journal, changeset_t *ch)
 int journal_store_changesets(journal_t *journal, list_t *src)
 {
 	if (journal == NULL || journal->db == NULL || src == NULL) return KNOT_EINVAL;
-	return store_changesets(journal, src);
+	return store_changesets_any(journal, src);
 }
 
 /*
@@ -1664,6 +1892,9 @@ int journal_db_init(journal_db_t **db, const char *lmdb_dir_path, size_t lmdb_fs
 	};
 	memcpy(*db, &dbinit, sizeof(journal_db_t));
 	pthread_mutex_init(&(*db)->db_mutex, NULL);
+	pthread_mutex_init(&(*db)->commit_lock, NULL);
+	pthread_cond_init(&(*db)->commit_cond, NULL);
+	init_list(&(*db)->commit_queue);
 	return KNOT_EOK;
 }
 
@@ -1672,6 +1903,8 @@ static void destroy_journal_db(journal_db_t **db)
 	assert((*db)->db == NULL);
 
 	pthread_mutex_destroy(&(*db)->db_mutex);
+	pthread_mutex_destroy(&(*db)->commit_lock);
+	pthread_cond_destroy(&(*db)->commit_cond);
 	free((*db)->path);
 	free((*db));
 	*db = NULL;
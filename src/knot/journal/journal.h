@@ -39,6 +39,11 @@ typedef struct {
 	size_t fslimit;
 	journal_mode_t mode;
 	pthread_mutex_t db_mutex; // please delete this once you move DB opening from journal_open to db_init
+
+	pthread_mutex_t commit_lock;  // Guards the group commit state.
+	pthread_cond_t commit_cond;   // Signals finished batch.
+	list_t commit_queue;          // Changesets waiting for group commit.
+	bool committing;              // A batch is being committed.
 } journal_db_t;
 
 typedef struct {
@@ -134,6 +139,25 @@ void journal_close(journal_t *journal);
  */
 int journal_load_changesets(journal_t *journal, list_t *dst, uint32_t from);
 
+/*!
+ * \brief Load serialized changesets from journal since "from" up to "to" serial.
+ *
+ * The chunk contents are concatenated without any deserialization, so the
+ * result is a sequence of changesets in the changeset_serialize() format.
+ *
+ * \param journal  Journal to load from.
+ * \param from     Start serial.
+ * \param to       Final serial.
+ * \param data     Output serialized changesets (to be freed by the caller).
+ * \param size     Output size of the serialized changesets.
+ *
+ * \retval KNOT_EOK on success.
+ * \retval KNOT_ENOENT when there is no history from "from" to "to" serial.
+ * \return < KNOT_EOK on other error.
+ */
+int journal_load_serialized(journal_t *journal, uint32_t from, uint32_t to,
+                            uint8_t **data, size_t *size);
+
 /*!
  * \brief Load changesets from journal, starting with bootstrap changeset.
  *
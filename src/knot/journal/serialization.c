@@ -18,7 +18,6 @@
 
 #include "knot/journal/serialization.h"
 #include "libknot/libknot.h"
-#include "contrib/wire_ctx.h"
 
 #define SERIALIZE_RRSET_INIT (-1)
 #define SERIALIZE_RRSET_DONE ((1L<<16)+1)
@@ -352,3 +351,73 @@ int changeset_deserialize(changeset_t *ch, uint8_t *src_chunks[],
 
 	return wire.error;
 }
+
+int serialized_rrset_read(wire_ctx_t *wire, knot_rrset_t *rrset, uint8_t *buf,
+                          size_t *buf_size)
+{
+	if (wire == NULL || rrset == NULL || buf_size == NULL ||
+	    (buf == NULL && *buf_size > 0)) {
+		return KNOT_EINVAL;
+	}
+
+	if (wire_ctx_available(wire) == 0) {
+		return KNOT_ENOENT;
+	}
+
+	wire_ctx_t ctx = *wire;
+
+	// Read owner, rtype, rclass and RR count.
+	int size = knot_dname_wire_check(ctx.position, ctx.position +
+	                                 wire_ctx_available(&ctx), NULL);
+	if (size <= 0) {
+		return KNOT_EMALF;
+	}
+	knot_dname_t *owner = ctx.position;
+	wire_ctx_skip(&ctx, size);
+	uint16_t type = wire_ctx_read_u16(&ctx);
+	uint16_t rclass = wire_ctx_read_u16(&ctx);
+	uint16_t rrcount = wire_ctx_read_u16(&ctx);
+	if (ctx.error != KNOT_EOK) {
+		return KNOT_EMALF;
+	}
+
+	// Compute the rdata size first.
+	wire_ctx_t rrs = ctx;
+	uint32_t ttl = 0;
+	size_t need = 0;
+	for (uint16_t i = 0; i < rrcount; i++) {
+		uint32_t rr_ttl = wire_ctx_read_u32(&rrs);
+		if (i == 0) {
+			ttl = rr_ttl;
+		}
+		uint16_t rdlen = wire_ctx_read_u16(&rrs);
+		wire_ctx_skip(&rrs, rdlen);
+		need += knot_rdata_size(rdlen);
+	}
+	if (rrs.error != KNOT_EOK) {
+		return KNOT_EMALF;
+	}
+
+	if (need > *buf_size) {
+		*buf_size = need;
+		return KNOT_ESPACE;
+	}
+
+	knot_rrset_init(rrset, owner, type, rclass, ttl);
+	rrset->rrs.rr_count = rrcount;
+	rrset->rrs.data = (knot_rdata_t *)buf;
+
+	knot_rdata_t *rdata = rrset->rrs.data;
+	for (uint16_t i = 0; i < rrcount; i++) {
+		wire_ctx_skip(&ctx, sizeof(uint32_t));
+		uint16_t rdlen = wire_ctx_read_u16(&ctx);
+		knot_rdata_init(rdata, rdlen, ctx.position);
+		wire_ctx_skip(&ctx, rdlen);
+		rdata = (knot_rdata_t *)((uint8_t *)rdata + knot_rdata_size(rdlen));
+	}
+
+	*buf_size = need;
+	*wire = ctx;
+
+	return KNOT_EOK;
+}
@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include "libknot/rrset.h"
 #include "knot/updates/changesets.h"
+#include "contrib/wire_ctx.h"
 
 /*!
  * \brief Returns size of changeset in serialized form.
@@ -75,3 +76,24 @@ int changeset_deserialize(changeset_t *ch, uint8_t *src_chunks[],
  */
 int changeset_deserialize_bootstrap(changeset_t *ch, uint8_t *src_chunks[],
                                     const size_t *chunks_sizes, size_t chunks_count);
+
+/*!
+ * \brief Reads one RRSet from serialized changesets without copying.
+ *
+ * The serialized changesets are expected in a continuous memory area (e.g.
+ * concatenated chunks of changesets). The owner of the read RRSet points
+ * into the serialized data, the rdata are stored into the provided buffer.
+ * If the buffer is too small, the wire position isn't changed.
+ *
+ * \param[in]     wire      Serialized data, moved behind the read RRSet.
+ * \param[out]    rrset     The RRSet read.
+ * \param[out]    buf       Buffer for the rdata.
+ * \param[in,out] buf_size  Buffer size, the used (or required) size on return.
+ *
+ * \retval KNOT_EOK     RRSet read.
+ * \retval KNOT_ENOENT  No more data.
+ * \retval KNOT_ESPACE  Insufficient buffer size.
+ * \retval KNOT_EMALF   Malformed data.
+ */
+int serialized_rrset_read(wire_ctx_t *wire, knot_rrset_t *rrset, uint8_t *buf,
+                          size_t *buf_size);
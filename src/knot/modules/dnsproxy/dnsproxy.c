@@ -17,6 +17,8 @@
 #include "contrib/net.h"
 #include "knot/include/module.h"
 #include "knot/conf/schema.h"
+#include "knot/modules/dnsproxy/forwarder.h"
+#include "knot/nameserver/process_query.h" // Forces static module!
 #include "knot/query/capture.h" // Forces static module!
 #include "knot/query/requestor.h" // Forces static module!
 
@@ -24,6 +26,7 @@
 #define MOD_TIMEOUT		"\x07""timeout"
 #define MOD_FALLBACK		"\x08""fallback"
 #define MOD_CATCH_NXDOMAIN	"\x0E""catch-nxdomain"
+#define MOD_ASYNC		"\x05""async"
 
 const yp_item_t dnsproxy_conf[] = {
 	{ MOD_REMOTE,         YP_TREF,  YP_VREF = { C_RMT }, YP_FNONE,
@@ -31,6 +34,7 @@ const yp_item_t dnsproxy_conf[] = {
 	{ MOD_TIMEOUT,        YP_TINT,  YP_VINT = { 0, INT32_MAX, 500 } },
 	{ MOD_FALLBACK,       YP_TBOOL, YP_VBOOL = { true } },
 	{ MOD_CATCH_NXDOMAIN, YP_TBOOL, YP_VNONE },
+	{ MOD_ASYNC,          YP_TBOOL, YP_VNONE },
 	{ NULL }
 };
 
@@ -51,6 +55,7 @@ typedef struct {
 	bool fallback;
 	bool catch_nxdomain;
 	int timeout;
+	fwd_t *fwd;
 } dnsproxy_t;
 
 static knotd_state_t dnsproxy_fwd(knotd_state_t state, knot_pkt_t *pkt,
@@ -72,6 +77,19 @@ static knotd_state_t dnsproxy_fwd(knotd_state_t state, knot_pkt_t *pkt,
 		                 qdata->query->max_size, qdata->query->tsig_rr);
 	}
 
+	/* Forward asynchronously over UDP, the answer is sent by the forwarder. */
+	bool is_tcp = net_is_stream(qdata->params->socket);
+	if (proxy->fwd != NULL && !is_tcp) {
+		/* Empty original QNAME means the root domain. */
+		const knot_dname_t *orig_qname = qdata->extra->orig_qname;
+		int ret = fwd_query(proxy->fwd, qdata->query,
+		                    orig_qname[0] != '\0' ? orig_qname : NULL,
+		                    qdata->params->socket, qdata->params->remote);
+		if (ret == KNOT_EOK) {
+			return KNOTD_STATE_NOOP;
+		}
+	}
+
 	/* Capture layer context. */
 	const knot_layer_api_t *capture = query_capture_api();
 	struct capture_param capture_param = {
@@ -85,7 +103,6 @@ static knotd_state_t dnsproxy_fwd(knotd_state_t state, knot_pkt_t *pkt,
 		return state; /* Ignore, not enough memory. */
 	}
 
-	bool is_tcp = net_is_stream(qdata->params->socket);
 	const struct sockaddr *dst = (const struct sockaddr *)&proxy->remote;
 	const struct sockaddr *src = (const struct sockaddr *)&proxy->via;
 	struct knot_request *req = knot_request_make(re.mm, dst, src, qdata->query, NULL,
@@ -145,6 +162,17 @@ int dnsproxy_load(knotd_mod_t *mod)
 	conf = knotd_conf_mod(mod, MOD_CATCH_NXDOMAIN);
 	proxy->catch_nxdomain = conf.single.boolean;
 
+	conf = knotd_conf_mod(mod, MOD_ASYNC);
+	if (conf.single.boolean) {
+		int ret = fwd_new(&proxy->remote, &proxy->via, proxy->timeout, &proxy->fwd);
+		if (ret != KNOT_EOK) {
+			knotd_mod_log(mod, LOG_ERR, "failed to start forwarder (%s)",
+			              knot_strerror(ret));
+			free(proxy);
+			return ret;
+		}
+	}
+
 	knotd_mod_ctx_set(mod, proxy);
 
 	if (proxy->fallback) {
@@ -156,7 +184,9 @@ int dnsproxy_load(knotd_mod_t *mod)
 
 void dnsproxy_unload(knotd_mod_t *mod)
 {
-	free(knotd_mod_ctx(mod));
+	dnsproxy_t *proxy = knotd_mod_ctx(mod);
+	fwd_free(proxy->fwd);
+	free(proxy);
 }
 
 KNOTD_MOD_API(dnsproxy, KNOTD_MOD_FLAG_SCOPE_ANY,
@@ -0,0 +1,443 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "knot/modules/dnsproxy/forwarder.h"
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+#include "contrib/time.h"
+#include "contrib/tolower.h"
+#include "dnssec/random.h"
+#include "libknot/errcode.h"
+
+#define FWD_SOCKETS		16	/*!< Upstream UDP sockets. */
+#define FWD_SOCKET_QUERIES	256	/*!< Queries sent before the socket is replaced. */
+#define FWD_SLOTS		1024	/*!< In-flight queries. */
+#define FWD_BUCKETS		1024	/*!< Message ID lookup buckets (power of 2). */
+#define FWD_TICK		50	/*!< Timeout check interval in milliseconds. */
+#define FWD_NONE		UINT16_MAX
+#define FWD_QUESTION	(KNOT_WIRE_HEADER_SIZE + KNOT_DNAME_MAXLEN + 2 * sizeof(uint16_t))
+
+/*! \brief In-flight forwarded query. */
+typedef struct {
+	struct sockaddr_storage remote; /*!< Original query source. */
+	struct timespec deadline;       /*!< Upstream response deadline. */
+	int fd;                         /*!< Duplicate of the original query socket. */
+	bool used;                      /*!< Slot is occupied. */
+	uint16_t id;                    /*!< Upstream message ID. */
+	uint16_t sock;                  /*!< Upstream socket index. */
+	uint16_t next;                  /*!< Next slot in the bucket or free list. */
+	size_t question_len;            /*!< Header and question length. */
+	uint8_t question[FWD_QUESTION]; /*!< Original header and question. */
+} fwd_slot_t;
+
+/*! \brief Upstream socket. */
+typedef struct {
+	int fd;
+	unsigned sent;                  /*!< Queries sent, retired at the limit. */
+	unsigned refs;                  /*!< In-flight queries and pending sends. */
+} fwd_socket_t;
+
+struct fwd {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	bool stop;
+	struct sockaddr_storage remote;
+	struct sockaddr_storage via;
+	int timeout;
+	unsigned next;                  /*!< Next socket to try. */
+	uint16_t free;                  /*!< Free slot list. */
+	fwd_socket_t socks[FWD_SOCKETS];
+	uint16_t buckets[FWD_BUCKETS];  /*!< Slot lists by the upstream ID. */
+	fwd_slot_t slots[FWD_SLOTS];
+};
+
+static fwd_slot_t *slot_find(fwd_t *fwd, unsigned sock, uint16_t id)
+{
+	uint16_t pos = fwd->buckets[id & (FWD_BUCKETS - 1)];
+	while (pos != FWD_NONE) {
+		fwd_slot_t *slot = &fwd->slots[pos];
+		if (slot->sock == sock && slot->id == id) {
+			return slot;
+		}
+		pos = slot->next;
+	}
+
+	return NULL;
+}
+
+/*! \brief Releases the slot, the caller takes over the query socket. */
+static int slot_release(fwd_t *fwd, fwd_slot_t *slot)
+{
+	uint16_t pos = slot - fwd->slots;
+	uint16_t *link = &fwd->buckets[slot->id & (FWD_BUCKETS - 1)];
+	while (*link != pos) {
+		assert(*link != FWD_NONE);
+		link = &fwd->slots[*link].next;
+	}
+	*link = slot->next;
+
+	fwd->socks[slot->sock].refs--;
+
+	slot->used = false;
+	slot->next = fwd->free;
+	fwd->free = pos;
+
+	return slot->fd;
+}
+
+/*! \brief Replaces retired sockets which are no longer in use. */
+static void sockets_rotate(fwd_t *fwd)
+{
+	const struct sockaddr *dst = (const struct sockaddr *)&fwd->remote;
+	const struct sockaddr *src = (const struct sockaddr *)&fwd->via;
+
+	for (unsigned i = 0; i < FWD_SOCKETS; i++) {
+		fwd_socket_t *sock = &fwd->socks[i];
+		if (sock->fd >= 0 && sock->sent >= FWD_SOCKET_QUERIES && sock->refs == 0) {
+			close(sock->fd);
+			sock->fd = -1;
+		}
+		if (sock->fd < 0) {
+			/* A new socket gets a new random source port. */
+			sock->fd = net_connected_socket(SOCK_DGRAM, dst, src);
+			sock->sent = 0;
+		}
+	}
+}
+
+static void fwd_reply(int fd, const struct sockaddr_storage *remote,
+                      const uint8_t *wire, size_t len)
+{
+	const struct sockaddr *sa = (const struct sockaddr *)remote;
+	(void)sendto(fd, wire, len, MSG_DONTWAIT | MSG_NOSIGNAL, sa, sockaddr_len(sa));
+}
+
+static bool question_match(const uint8_t *wire, size_t len, const fwd_slot_t *slot)
+{
+	if (len < slot->question_len) {
+		return false;
+	}
+
+	/* The query was sent upstream with the QNAME in lower case. */
+	size_t qname_end = slot->question_len - 2 * sizeof(uint16_t);
+	for (size_t i = KNOT_WIRE_HEADER_SIZE; i < qname_end; i++) {
+		if (knot_tolower(wire[i]) != knot_tolower(slot->question[i])) {
+			return false;
+		}
+	}
+
+	return memcmp(wire + qname_end, slot->question + qname_end,
+	              2 * sizeof(uint16_t)) == 0;
+}
+
+static void fwd_answer(fwd_t *fwd, unsigned sock, uint8_t *wire, size_t len)
+{
+	if (len < KNOT_WIRE_HEADER_SIZE || !knot_wire_get_qr(wire)) {
+		return;
+	}
+
+	/* Match the in-flight query including the question. */
+	pthread_mutex_lock(&fwd->lock);
+	fwd_slot_t *slot = slot_find(fwd, sock, knot_wire_get_id(wire));
+	if (slot == NULL || !question_match(wire, len, slot)) {
+		pthread_mutex_unlock(&fwd->lock);
+		return;
+	}
+
+	/* Restore the original message ID and question. */
+	memcpy(wire, slot->question, sizeof(uint16_t));
+	memcpy(wire + KNOT_WIRE_HEADER_SIZE, slot->question + KNOT_WIRE_HEADER_SIZE,
+	       slot->question_len - KNOT_WIRE_HEADER_SIZE);
+
+	struct sockaddr_storage remote = slot->remote;
+	int fd = slot_release(fwd, slot);
+	pthread_mutex_unlock(&fwd->lock);
+
+	fwd_reply(fd, &remote, wire, len);
+	close(fd);
+}
+
+static void fwd_expire(fwd_t *fwd)
+{
+	struct timespec now = time_now();
+
+	for (unsigned i = 0; i < FWD_SLOTS; i++) {
+		fwd_slot_t *slot = &fwd->slots[i];
+
+		pthread_mutex_lock(&fwd->lock);
+		if (!slot->used || time_diff_ms(&slot->deadline, &now) < 0) {
+			pthread_mutex_unlock(&fwd->lock);
+			continue;
+		}
+
+		/* Forwarding timed out, SERVFAIL. */
+		uint8_t wire[FWD_QUESTION];
+		size_t len = slot->question_len;
+		memcpy(wire, slot->question, len);
+		struct sockaddr_storage remote = slot->remote;
+		int fd = slot_release(fwd, slot);
+		pthread_mutex_unlock(&fwd->lock);
+
+		knot_wire_set_qr(wire);
+		knot_wire_clear_aa(wire);
+		knot_wire_set_rcode(wire, KNOT_RCODE_SERVFAIL);
+		knot_wire_set_ancount(wire, 0);
+		knot_wire_set_nscount(wire, 0);
+		knot_wire_set_arcount(wire, 0);
+		fwd_reply(fd, &remote, wire, len);
+		close(fd);
+	}
+}
+
+static void *fwd_run(void *arg)
+{
+	fwd_t *fwd = arg;
+
+	struct pollfd pfd[FWD_SOCKETS];
+	uint8_t wire[KNOT_WIRE_MAX_PKTSIZE];
+	while (true) {
+		pthread_mutex_lock(&fwd->lock);
+		if (fwd->stop) {
+			pthread_mutex_unlock(&fwd->lock);
+			break;
+		}
+		sockets_rotate(fwd);
+		for (unsigned i = 0; i < FWD_SOCKETS; i++) {
+			pfd[i].fd = fwd->socks[i].fd;
+			pfd[i].events = POLLIN;
+			pfd[i].revents = 0;
+		}
+		pthread_mutex_unlock(&fwd->lock);
+
+		/* Only this thread closes the sockets. */
+		int ret = poll(pfd, FWD_SOCKETS, FWD_TICK);
+		for (unsigned i = 0; ret > 0 && i < FWD_SOCKETS; i++) {
+			if (pfd[i].revents == 0) {
+				continue;
+			}
+			/* Also consumes pending errors (e.g. ICMP unreachable). */
+			ssize_t len;
+			while ((len = recv(pfd[i].fd, wire, sizeof(wire), MSG_DONTWAIT)) > 0) {
+				fwd_answer(fwd, i, wire, len);
+			}
+		}
+		fwd_expire(fwd);
+	}
+
+	return NULL;
+}
+
+/*! \brief Reserves a slot on a usable socket with a free random message ID. */
+static fwd_slot_t *slot_reserve(fwd_t *fwd)
+{
+	if (fwd->free == FWD_NONE) {
+		return NULL;
+	}
+
+	for (unsigned i = 0; i < FWD_SOCKETS; i++) {
+		unsigned sock = fwd->next++ % FWD_SOCKETS;
+		if (fwd->socks[sock].fd < 0 || fwd->socks[sock].sent >= FWD_SOCKET_QUERIES) {
+			continue;
+		}
+
+		uint16_t id;
+		do {
+			id = dnssec_random_uint16_t();
+		} while (slot_find(fwd, sock, id) != NULL);
+
+		uint16_t pos = fwd->free;
+		fwd_slot_t *slot = &fwd->slots[pos];
+		fwd->free = slot->next;
+
+		uint16_t *bucket = &fwd->buckets[id & (FWD_BUCKETS - 1)];
+		slot->next = *bucket;
+		*bucket = pos;
+
+		slot->used = true;
+		slot->id = id;
+		slot->sock = sock;
+
+		/* The slot reference and the pending send reference. */
+		fwd->socks[sock].sent++;
+		fwd->socks[sock].refs += 2;
+
+		return slot;
+	}
+
+	return NULL;
+}
+
+int fwd_query(fwd_t *fwd, const knot_pkt_t *query, const knot_dname_t *orig_qname,
+              int fd, const struct sockaddr_storage *remote)
+{
+	if (fwd == NULL || query == NULL || remote == NULL ||
+	    knot_pkt_qname(query) == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	size_t question_len = KNOT_WIRE_HEADER_SIZE + query->qname_size +
+	                      2 * sizeof(uint16_t);
+	assert(question_len <= FWD_QUESTION && question_len <= query->size);
+
+	/* Keep the query socket open until answered. */
+	int reply_fd = dup(fd);
+	if (reply_fd < 0) {
+		return knot_map_errno();
+	}
+
+	pthread_mutex_lock(&fwd->lock);
+
+	fwd_slot_t *slot = slot_reserve(fwd);
+	if (slot == NULL) {
+		pthread_mutex_unlock(&fwd->lock);
+		close(reply_fd);
+		return KNOT_ELIMIT;
+	}
+
+	unsigned sock = slot->sock;
+	uint16_t id = slot->id;
+	int sock_fd = fwd->socks[sock].fd;
+
+	slot->fd = reply_fd;
+	memcpy(&slot->remote, remote, sizeof(slot->remote));
+	slot->deadline = time_now();
+	slot->deadline.tv_sec += fwd->timeout / 1000;
+	slot->deadline.tv_nsec += (fwd->timeout % 1000) * 1000000;
+	if (slot->deadline.tv_nsec >= 1000000000) {
+		slot->deadline.tv_sec += 1;
+		slot->deadline.tv_nsec -= 1000000000;
+	}
+	slot->question_len = question_len;
+	memcpy(slot->question, query->wire, question_len);
+	if (orig_qname != NULL) {
+		memcpy(slot->question + KNOT_WIRE_HEADER_SIZE, orig_qname,
+		       query->qname_size);
+	}
+
+	pthread_mutex_unlock(&fwd->lock);
+
+	/* Send the query with the upstream ID. */
+	uint8_t header[KNOT_WIRE_HEADER_SIZE];
+	memcpy(header, query->wire, sizeof(header));
+	knot_wire_set_id(header, id);
+	struct iovec iov[] = {
+		{ header, sizeof(header) },
+		{ query->wire + sizeof(header), query->size - sizeof(header) }
+	};
+	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+	ssize_t sent = sendmsg(sock_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+	pthread_mutex_lock(&fwd->lock);
+	fwd->socks[sock].refs--;
+	reply_fd = -1;
+	if (sent != query->size && slot->used && slot->sock == sock && slot->id == id) {
+		reply_fd = slot_release(fwd, slot);
+	}
+	pthread_mutex_unlock(&fwd->lock);
+
+	if (sent != query->size) {
+		if (reply_fd >= 0) {
+			close(reply_fd);
+		}
+		return KNOT_NET_ESEND;
+	}
+
+	return KNOT_EOK;
+}
+
+int fwd_new(const struct sockaddr_storage *remote,
+            const struct sockaddr_storage *via, int timeout, fwd_t **out)
+{
+	if (remote == NULL || via == NULL || out == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	fwd_t *fwd = calloc(1, sizeof(*fwd));
+	if (fwd == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	pthread_mutex_init(&fwd->lock, NULL);
+	fwd->stop = true;
+	fwd->remote = *remote;
+	fwd->via = *via;
+	fwd->timeout = timeout;
+
+	memset(fwd->buckets, 0xff, sizeof(fwd->buckets));
+	for (unsigned i = 0; i < FWD_SLOTS; i++) {
+		fwd->slots[i].next = (i + 1 < FWD_SLOTS) ? i + 1 : FWD_NONE;
+	}
+	fwd->free = 0;
+
+	for (unsigned i = 0; i < FWD_SOCKETS; i++) {
+		fwd->socks[i].fd = -1;
+	}
+	sockets_rotate(fwd);
+	for (unsigned i = 0; i < FWD_SOCKETS; i++) {
+		if (fwd->socks[i].fd < 0) {
+			int ret = fwd->socks[i].fd;
+			fwd_free(fwd);
+			return ret;
+		}
+	}
+
+	fwd->stop = false;
+	if (pthread_create(&fwd->thread, NULL, fwd_run, fwd) != 0) {
+		fwd->stop = true;
+		fwd_free(fwd);
+		return KNOT_ERROR;
+	}
+
+	*out = fwd;
+
+	return KNOT_EOK;
+}
+
+void fwd_free(fwd_t *fwd)
+{
+	if (fwd == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&fwd->lock);
+	bool running = !fwd->stop;
+	fwd->stop = true;
+	pthread_mutex_unlock(&fwd->lock);
+	if (running) {
+		(void)pthread_join(fwd->thread, NULL);
+	}
+
+	for (unsigned i = 0; i < FWD_SLOTS; i++) {
+		if (fwd->slots[i].used) {
+			close(fwd->slots[i].fd);
+		}
+	}
+	for (unsigned i = 0; i < FWD_SOCKETS; i++) {
+		if (fwd->socks[i].fd >= 0) {
+			close(fwd->socks[i].fd);
+		}
+	}
+	pthread_mutex_destroy(&fwd->lock);
+	free(fwd);
+}
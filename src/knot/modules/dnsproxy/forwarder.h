@@ -0,0 +1,69 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <sys/socket.h>
+
+#include "libknot/dname.h"
+#include "libknot/packet/pkt.h"
+
+/*!
+ * \brief Asynchronous UDP forwarder.
+ *
+ * Queries are sent upstream with a random message ID from a pool of
+ * connected sockets which are regularly replaced to rotate the source ports.
+ * A dedicated thread matches the answers and relays them to the original
+ * query source, or answers with SERVFAIL on timeout.
+ */
+typedef struct fwd fwd_t;
+
+/*!
+ * \brief Create a new forwarder and start its thread.
+ *
+ * \param remote   Upstream server address.
+ * \param via      Source address (AF_UNSPEC for any).
+ * \param timeout  Upstream response timeout in milliseconds.
+ * \param out      Output forwarder.
+ *
+ * \return Error code, KNOT_EOK if successful.
+ */
+int fwd_new(const struct sockaddr_storage *remote,
+            const struct sockaddr_storage *via, int timeout, fwd_t **out);
+
+/*!
+ * \brief Stop the forwarder thread and free the forwarder.
+ *
+ * Pending queries are dropped without an answer.
+ */
+void fwd_free(fwd_t *fwd);
+
+/*!
+ * \brief Hand the query over to the forwarder, the answer is sent from there.
+ *
+ * The query socket is duplicated so that the answer can be sent even if
+ * the original socket is closed in the meantime (e.g. on reload).
+ *
+ * \param fwd         Forwarder.
+ * \param query       Parsed query to be forwarded.
+ * \param orig_qname  QNAME in the original letter case (NULL if not changed).
+ * \param fd          Query socket to send the answer from.
+ * \param remote      Query source to send the answer to.
+ *
+ * \return KNOT_EOK if forwarded, the caller has to answer otherwise.
+ */
+int fwd_query(fwd_t *fwd, const knot_pkt_t *query, const knot_dname_t *orig_qname,
+              int fd, const struct sockaddr_storage *remote);
@@ -15,12 +15,13 @@
  */
 
 #include <netinet/in.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "contrib/dnstap/dnstap.h"
-#include "contrib/dnstap/dnstap.pb-c.h"
-#include "contrib/dnstap/message.h"
+#include "contrib/dnstap/encoder.h"
 #include "contrib/dnstap/writer.h"
-#include "contrib/time.h"
+#include "contrib/macros.h"
 #include "knot/include/module.h"
 
 #define MOD_SINK	"\x04""sink"
@@ -28,13 +29,22 @@
 #define MOD_VERSION	"\x07""version"
 #define MOD_QUERIES	"\x0B""log-queries"
 #define MOD_RESPONSES	"\x0D""log-responses"
+#define MOD_SAMPLE	"\x0B""sample-rate"
+#define MOD_RATE_LIMIT	"\x0A""rate-limit"
+
+/*! \brief Number of frame slots per thread (equal to the I/O queue size). */
+#define RING_SIZE	512
+/*! \brief Frame slot size, larger frames are allocated. */
+#define SLOT_SIZE	2048
 
 const yp_item_t dnstap_conf[] = {
-	{ MOD_SINK,      YP_TSTR,  YP_VNONE },
-	{ MOD_IDENTITY,  YP_TSTR,  YP_VNONE },
-	{ MOD_VERSION,   YP_TSTR,  YP_VNONE },
-	{ MOD_QUERIES,   YP_TBOOL, YP_VBOOL = { true } },
-	{ MOD_RESPONSES, YP_TBOOL, YP_VBOOL = { true } },
+	{ MOD_SINK,       YP_TSTR,  YP_VNONE },
+	{ MOD_IDENTITY,   YP_TSTR,  YP_VNONE },
+	{ MOD_VERSION,    YP_TSTR,  YP_VNONE },
+	{ MOD_QUERIES,    YP_TBOOL, YP_VBOOL = { true } },
+	{ MOD_RESPONSES,  YP_TBOOL, YP_VBOOL = { true } },
+	{ MOD_SAMPLE,     YP_TINT,  YP_VINT = { 1, UINT32_MAX, 1 } },
+	{ MOD_RATE_LIMIT, YP_TINT,  YP_VINT = { 0, UINT32_MAX, 0 } },
 	{ NULL }
 };
 
@@ -49,104 +59,246 @@ int dnstap_conf_check(knotd_conf_check_args_t *args)
 	return KNOT_EOK;
 }
 
+/*! \brief Pre-allocated frame buffer, released by the I/O thread. */
+typedef struct {
+	bool busy;
+	uint8_t data[SLOT_SIZE];
+} frame_slot_t;
+
+/*! \brief Frame slots of one worker thread. */
+typedef struct {
+	unsigned next;               /*!< Next slot to use. */
+	frame_slot_t slots[RING_SIZE];
+} frame_ring_t;
+
+/*!
+ * \brief Per-thread frame rings shared by all module instances.
+ *
+ * A ring is allocated by its worker thread when logging the first frame.
+ */
+static struct {
+	pthread_mutex_t lock;
+	size_t refs;                 /*!< Module instances using the rings. */
+	size_t count;                /*!< Number of the rings. */
+	frame_ring_t **rings;
+} shared_rings = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/*! \brief Per-thread state, accessed only by the owning worker thread. */
+typedef struct {
+	struct fstrm_iothr_queue *ioq;
+	frame_ring_t **ring;         /*!< Shared frame ring of the thread. */
+	struct timespec query_time;  /*!< Receive time of the current query. */
+	bool sampled;                /*!< The current query is logged. */
+	uint64_t sample_count;       /*!< Queries seen for sampling. */
+	time_t rate_time;            /*!< Current rate limit interval. */
+	uint32_t rate_count;         /*!< Queries logged in the interval. */
+} dnstap_thread_t;
+
 typedef struct {
 	struct fstrm_iothr *iothread;
 	char *identity;
 	size_t identity_len;
 	char *version;
 	size_t version_len;
+	bool log_queries;
+	uint32_t sample_rate;
+	uint32_t rate_limit;         /*!< Per-thread limit, 0 for unlimited. */
+	size_t thread_count;
+	dnstap_thread_t *threads;
 } dnstap_ctx_t;
 
-static knotd_state_t log_message(knotd_state_t state, const knot_pkt_t *pkt,
-                                 knotd_qdata_t *qdata, knotd_mod_t *mod)
-{
-	assert(pkt && qdata && mod);
+enum {
+	CTR_DROPPED = 0,
+};
 
-	/* Skip empty packet. */
-	if (state == KNOTD_STATE_NOOP) {
-		return state;
+/*!
+ * \brief Get the shared frame rings.
+ *
+ * \param count  Number of the rings requested, the number available on return.
+ */
+static frame_ring_t **rings_acquire(size_t *count)
+{
+	pthread_mutex_lock(&shared_rings.lock);
+	if (shared_rings.refs == 0) {
+		shared_rings.rings = calloc(*count, sizeof(frame_ring_t *));
+		shared_rings.count = (shared_rings.rings != NULL) ? *count : 0;
+	}
+	frame_ring_t **rings = shared_rings.rings;
+	if (rings != NULL) {
+		shared_rings.refs++;
+		*count = MIN(*count, shared_rings.count);
 	}
+	pthread_mutex_unlock(&shared_rings.lock);
 
-	dnstap_ctx_t *ctx = knotd_mod_ctx(mod);
+	return rings;
+}
 
-	struct fstrm_iothr_queue *ioq =
-		fstrm_iothr_get_input_queue_idx(ctx->iothread, qdata->params->thread_id);
+static void rings_release(void)
+{
+	pthread_mutex_lock(&shared_rings.lock);
+	if (--shared_rings.refs == 0) {
+		for (size_t i = 0; i < shared_rings.count; i++) {
+			free(shared_rings.rings[i]);
+		}
+		free(shared_rings.rings);
+		shared_rings.rings = NULL;
+		shared_rings.count = 0;
+	}
+	pthread_mutex_unlock(&shared_rings.lock);
+}
 
-	/* Unless we want to measure the time it takes to process each query,
-	 * we can treat Q/R times the same. */
-	struct timespec tv = { .tv_sec = time(NULL) };
+static void slot_release(void *buf, void *slot)
+{
+	__atomic_store_n(&((frame_slot_t *)slot)->busy, false, __ATOMIC_RELEASE);
+}
 
-	/* Determine query / response. */
-	Dnstap__Message__Type msgtype = DNSTAP__MESSAGE__TYPE__AUTH_QUERY;
-	if (knot_wire_get_qr(pkt->wire)) {
-		msgtype = DNSTAP__MESSAGE__TYPE__AUTH_RESPONSE;
+/*! \brief Encode the frame into a free slot (or a new buffer) and submit it. */
+static void submit_frame(dnstap_ctx_t *ctx, dnstap_thread_t *thr, knotd_mod_t *mod,
+                         const dt_frame_t *frame)
+{
+	if (*thr->ring == NULL) {
+		*thr->ring = calloc(1, sizeof(frame_ring_t));
+		if (*thr->ring == NULL) {
+			knotd_mod_stats_incr(mod, CTR_DROPPED, 0, 1);
+			return;
+		}
 	}
 
-	/* Determine whether we run on UDP/TCP. */
-	int protocol = IPPROTO_TCP;
-	if (qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_SIZE) {
-		protocol = IPPROTO_UDP;
+	frame_ring_t *ring = *thr->ring;
+	frame_slot_t *slot = &ring->slots[ring->next];
+	if (__atomic_load_n(&slot->busy, __ATOMIC_ACQUIRE)) {
+		knotd_mod_stats_incr(mod, CTR_DROPPED, 0, 1);
+		return;
 	}
 
-	/* Create a dnstap message. */
-	Dnstap__Message msg;
-	int ret = dt_message_fill(&msg, msgtype,
-	                          (const struct sockaddr *)qdata->params->remote,
-	                          NULL, /* todo: fill me! */
-				  protocol, pkt->wire, pkt->size, &tv);
-	if (ret != KNOT_EOK) {
-		return state;
+	uint8_t *buf = slot->data;
+	size_t size = dt_frame_encode(frame, buf, SLOT_SIZE);
+	void (*release)(void *, void *) = slot_release;
+	void *release_data = slot;
+
+	if (size > SLOT_SIZE) {
+		buf = malloc(size);
+		if (buf == NULL) {
+			knotd_mod_stats_incr(mod, CTR_DROPPED, 0, 1);
+			return;
+		}
+		dt_frame_encode(frame, buf, size);
+		release = fstrm_free_wrapper;
+		release_data = NULL;
+	} else {
+		__atomic_store_n(&slot->busy, true, __ATOMIC_RELAXED);
+		ring->next = (ring->next + 1) % RING_SIZE;
 	}
 
-	Dnstap__Dnstap dnstap = DNSTAP__DNSTAP__INIT;
-	dnstap.type = DNSTAP__DNSTAP__TYPE__MESSAGE;
-	dnstap.message = &msg;
+	fstrm_res res = fstrm_iothr_submit(ctx->iothread, thr->ioq, buf, size,
+	                                   release, release_data);
+	if (res != fstrm_res_success) {
+		release(buf, release_data);
+		knotd_mod_stats_incr(mod, CTR_DROPPED, 0, 1);
+	}
+}
 
-	/* Set message version and identity. */
-	if (ctx->identity_len > 0) {
-		dnstap.identity.data = (uint8_t *)ctx->identity;
-		dnstap.identity.len = ctx->identity_len;
-		dnstap.has_identity = 1;
+/*! \brief Decide if the query is logged according to the sampling and rate limit. */
+static bool query_sampled(dnstap_ctx_t *ctx, dnstap_thread_t *thr)
+{
+	if (thr->sample_count++ % ctx->sample_rate != 0) {
+		return false;
 	}
-	if (ctx->version_len > 0) {
-		dnstap.version.data = (uint8_t *)ctx->version;
-		dnstap.version.len = ctx->version_len;
-		dnstap.has_version = 1;
+
+	if (ctx->rate_limit > 0) {
+		if (thr->rate_time != thr->query_time.tv_sec) {
+			thr->rate_time = thr->query_time.tv_sec;
+			thr->rate_count = 0;
+		}
+		if (thr->rate_count >= ctx->rate_limit) {
+			return false;
+		}
+		thr->rate_count++;
 	}
 
-	/* Pack the message. */
-	uint8_t *frame = NULL;
-	size_t size = 0;
-	dt_pack(&dnstap, &frame, &size);
-	if (frame == NULL) {
-		return state;
+	return true;
+}
+
+static void log_message(const knot_pkt_t *pkt, knotd_qdata_t *qdata,
+                        dnstap_ctx_t *ctx, dnstap_thread_t *thr, knotd_mod_t *mod)
+{
+	dt_frame_t frame = {
+		.identity = (const uint8_t *)ctx->identity,
+		.identity_len = ctx->identity_len,
+		.version = (const uint8_t *)ctx->version,
+		.version_len = ctx->version_len,
+		.type = DNSTAP__MESSAGE__TYPE__AUTH_QUERY,
+		.query_sa = (const struct sockaddr *)qdata->params->remote,
+		.response_sa = NULL, /* todo: fill me! */
+		.protocol = IPPROTO_TCP,
+		.query_time = &thr->query_time,
+		.wire = pkt->wire,
+		.wire_len = pkt->size,
+	};
+
+	/* Determine query / response. */
+	struct timespec response_time;
+	if (knot_wire_get_qr(pkt->wire)) {
+		clock_gettime(CLOCK_REALTIME, &response_time);
+		frame.type = DNSTAP__MESSAGE__TYPE__AUTH_RESPONSE;
+		frame.response_time = &response_time;
 	}
 
-	/* Submit a request. */
-	fstrm_res res = fstrm_iothr_submit(ctx->iothread, ioq, frame, size,
-	                                   fstrm_free_wrapper, NULL);
-	if (res != fstrm_res_success) {
-		free(frame);
-		return state;
+	/* Determine whether we run on UDP/TCP. */
+	if (qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_SIZE) {
+		frame.protocol = IPPROTO_UDP;
 	}
 
-	return state;
+	submit_frame(ctx, thr, mod, &frame);
+}
+
+static dnstap_thread_t *thread_ctx(dnstap_ctx_t *ctx, knotd_qdata_t *qdata)
+{
+	unsigned id = qdata->params->thread_id;
+	return (id < ctx->thread_count && ctx->threads[id].ring != NULL) ?
+	       &ctx->threads[id] : NULL;
 }
 
 /*! \brief Submit message - query. */
 static knotd_state_t dnstap_message_log_query(knotd_state_t state, knot_pkt_t *pkt,
                                               knotd_qdata_t *qdata, knotd_mod_t *mod)
 {
-	assert(qdata);
+	assert(qdata && mod);
 
-	return log_message(state, qdata->query, qdata, mod);
+	dnstap_ctx_t *ctx = knotd_mod_ctx(mod);
+	dnstap_thread_t *thr = thread_ctx(ctx, qdata);
+	if (thr == NULL) {
+		return state;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &thr->query_time);
+	thr->sampled = query_sampled(ctx, thr);
+
+	/* Skip empty packet. */
+	if (thr->sampled && ctx->log_queries && state != KNOTD_STATE_NOOP) {
+		log_message(qdata->query, qdata, ctx, thr, mod);
+	}
+
+	return state;
 }
 
 /*! \brief Submit message - response. */
 static knotd_state_t dnstap_message_log_response(knotd_state_t state, knot_pkt_t *pkt,
                                                  knotd_qdata_t *qdata, knotd_mod_t *mod)
 {
-	return log_message(state, pkt, qdata, mod);
+	assert(pkt && qdata && mod);
+
+	dnstap_ctx_t *ctx = knotd_mod_ctx(mod);
+	dnstap_thread_t *thr = thread_ctx(ctx, qdata);
+
+	/* Skip empty packet. */
+	if (thr != NULL && thr->sampled && state != KNOTD_STATE_NOOP) {
+		log_message(pkt, qdata, ctx, thr, mod);
+	}
+
+	return state;
 }
 
 /*! \brief Create a UNIX socket sink. */
@@ -217,6 +369,17 @@ static struct fstrm_writer* dnstap_writer(const char *path)
 	return dnstap_file_writer(path);
 }
 
+static void ctx_free(dnstap_ctx_t *ctx)
+{
+	if (ctx->threads != NULL) {
+		rings_release();
+		free(ctx->threads);
+	}
+	free(ctx->identity);
+	free(ctx->version);
+	free(ctx);
+}
+
 int dnstap_load(knotd_mod_t *mod)
 {
 	/* Create dnstap context. */
@@ -253,12 +416,45 @@ int dnstap_load(knotd_mod_t *mod)
 
 	/* Set log_queries. */
 	conf = knotd_conf_mod(mod, MOD_QUERIES);
-	const bool log_queries = conf.single.boolean;
+	ctx->log_queries = conf.single.boolean;
 
 	/* Set log_responses. */
 	conf = knotd_conf_mod(mod, MOD_RESPONSES);
 	const bool log_responses = conf.single.boolean;
 
+	/* Set sampling. */
+	conf = knotd_conf_mod(mod, MOD_SAMPLE);
+	ctx->sample_rate = conf.single.integer;
+
+	/* Set up per-thread states, the frame rings are shared. */
+	knotd_conf_t udp = knotd_conf_env(mod, KNOTD_CONF_ENV_WORKERS_UDP);
+	knotd_conf_t tcp = knotd_conf_env(mod, KNOTD_CONF_ENV_WORKERS_TCP);
+	size_t qcount = udp.single.integer + tcp.single.integer;
+
+	size_t rings_count = qcount;
+	frame_ring_t **rings = rings_acquire(&rings_count);
+	if (rings == NULL) {
+		goto fail;
+	}
+	ctx->thread_count = qcount;
+	ctx->threads = calloc(qcount, sizeof(dnstap_thread_t));
+	if (ctx->threads == NULL) {
+		rings_release();
+		goto fail;
+	}
+	for (size_t i = 0; i < rings_count; i++) {
+		ctx->threads[i].ring = &rings[i];
+	}
+
+	/* Set rate limit, evenly divided between the threads. */
+	conf = knotd_conf_mod(mod, MOD_RATE_LIMIT);
+	if (conf.single.integer > 0) {
+		ctx->rate_limit = conf.single.integer / qcount;
+		if (ctx->rate_limit == 0) {
+			ctx->rate_limit = 1;
+		}
+	}
+
 	/* Initialize the writer and the options. */
 	struct fstrm_writer *writer = dnstap_writer(sink);
 	if (writer == NULL) {
@@ -272,10 +468,8 @@ int dnstap_load(knotd_mod_t *mod)
 	}
 
 	/* Initialize queues. */
-	knotd_conf_t udp = knotd_conf_env(mod, KNOTD_CONF_ENV_WORKERS_UDP);
-	knotd_conf_t tcp = knotd_conf_env(mod, KNOTD_CONF_ENV_WORKERS_TCP);
-	size_t qcount = udp.single.integer + tcp.single.integer;
 	fstrm_iothr_options_set_num_input_queues(opt, qcount);
+	fstrm_iothr_options_set_input_queue_size(opt, RING_SIZE);
 
 	/* Create the I/O thread. */
 	ctx->iothread = fstrm_iothr_init(opt, &writer);
@@ -285,12 +479,22 @@ int dnstap_load(knotd_mod_t *mod)
 		goto fail;
 	}
 
-	knotd_mod_ctx_set(mod, ctx);
+	for (size_t i = 0; i < qcount; i++) {
+		ctx->threads[i].ioq = fstrm_iothr_get_input_queue_idx(ctx->iothread, i);
+	}
 
-	/* Hook to the query plan. */
-	if (log_queries) {
-		knotd_mod_hook(mod, KNOTD_STAGE_BEGIN, dnstap_message_log_query);
+	/* Set up statistics counters. */
+	int ret = knotd_mod_stats_add(mod, "dropped", 1, NULL);
+	if (ret != KNOT_EOK) {
+		fstrm_iothr_destroy(&ctx->iothread);
+		ctx_free(ctx);
+		return ret;
 	}
+
+	knotd_mod_ctx_set(mod, ctx);
+
+	/* Hook to the query plan, the query hook also marks the query time. */
+	knotd_mod_hook(mod, KNOTD_STAGE_BEGIN, dnstap_message_log_query);
 	if (log_responses) {
 		knotd_mod_hook(mod, KNOTD_STAGE_END, dnstap_message_log_response);
 	}
@@ -299,9 +503,7 @@ int dnstap_load(knotd_mod_t *mod)
 fail:
 	knotd_mod_log(mod, LOG_ERR, "failed to init sink '%s'", sink);
 
-	free(ctx->identity);
-	free(ctx->version);
-	free(ctx);
+	ctx_free(ctx);
 
 	return KNOT_ENOMEM;
 }
@@ -310,10 +512,9 @@ void dnstap_unload(knotd_mod_t *mod)
 {
 	dnstap_ctx_t *ctx = knotd_mod_ctx(mod);
 
+	/* Flushes the queued frames, releasing the slots. */
 	fstrm_iothr_destroy(&ctx->iothread);
-	free(ctx->identity);
-	free(ctx->version);
-	free(ctx);
+	ctx_free(ctx);
 }
 
 KNOTD_MOD_API(dnstap, KNOTD_MOD_FLAG_SCOPE_ANY,
@@ -15,6 +15,7 @@
 */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -22,6 +23,7 @@
 #include "dnssec/error.h"
 #include "knot/include/module.h"
 #include "knot/modules/onlinesign/nsec_next.h"
+#include "knot/modules/onlinesign/rrsig_cache.h"
 // Next dependencies force static module!
 #include "knot/dnssec/key-events.h"
 #include "knot/dnssec/rrset-sign.h"
@@ -31,6 +33,7 @@
 #include "knot/nameserver/process_query.h"
 
 #define MOD_POLICY	"\x06""policy"
+#define MOD_CACHE_SIZE	"\x0A""cache-size"
 
 int policy_check(knotd_conf_check_args_t *args)
 {
@@ -43,7 +46,8 @@ int policy_check(knotd_conf_check_args_t *args)
 }
 
 const yp_item_t online_sign_conf[] = {
-	{ MOD_POLICY, YP_TREF, YP_VREF = { C_POLICY }, YP_FNONE, { policy_check } },
+	{ MOD_POLICY,     YP_TREF, YP_VREF = { C_POLICY }, YP_FNONE, { policy_check } },
+	{ MOD_CACHE_SIZE, YP_TINT, YP_VINT = { 0, INT32_MAX, 4096 } },
 	{ NULL }
 };
 
@@ -85,6 +89,10 @@ static const uint16_t NSEC_FORCE_TYPES[] = {
 typedef struct {
 	kdnssec_ctx_t kctx;
 	zone_keyset_t keyset;
+	pthread_mutex_t sign_lock; /*!< Guards the shared signing contexts. */
+	zone_keyset_t *threads;    /*!< Zone keys with per-thread signing contexts. */
+	size_t thread_count;       /*!< Number of per-thread key sets. */
+	rrsig_cache_t *cache;      /*!< Created signatures, NULL if disabled. */
 } online_sign_ctx_t;
 
 static bool want_dnssec(knotd_qdata_t *qdata)
@@ -247,9 +255,42 @@ static bool use_key(const zone_key_t *key, const knot_rrset_t *covered)
 	return (key->is_ksk && is_zone_key) || (key->is_zsk && !is_zone_key);
 }
 
+/*!
+ * \brief Sign the RRSet with the keys of the current thread.
+ *
+ * Signing contexts aren't thread-safe, the shared ones are used under a lock
+ * if the thread has no own contexts.
+ */
+static int sign_keys(knot_rrset_t *rrsig, const knot_rrset_t *covered,
+                     online_sign_ctx_t *module_ctx, zone_keyset_t *keyset,
+                     const kdnssec_ctx_t *kctx, knot_mm_t *mm)
+{
+	bool shared = (keyset == NULL);
+	if (shared) {
+		keyset = &module_ctx->keyset;
+		pthread_mutex_lock(&module_ctx->sign_lock);
+	}
+
+	int ret = KNOT_EOK;
+	for (size_t i = 0; i < keyset->count && ret == KNOT_EOK; i++) {
+		zone_key_t *kkey = &keyset->keys[i];
+		if (use_key(kkey, covered)) {
+			ret = knot_sign_rrset(rrsig, covered, kkey->key, kkey->ctx, kctx, mm);
+		}
+	}
+
+	if (shared) {
+		pthread_mutex_unlock(&module_ctx->sign_lock);
+	}
+
+	return ret;
+}
+
 static knot_rrset_t *sign_rrset(const knot_dname_t *owner,
                                 const knot_rrset_t *cover,
                                 online_sign_ctx_t *module_ctx,
+                                zone_keyset_t *keyset,
+                                const kdnssec_ctx_t *kctx,
                                 knot_mm_t *mm)
 {
 	// copy of RR set with replaced owner name
@@ -274,21 +315,28 @@ static knot_rrset_t *sign_rrset(const knot_dname_t *owner,
 		return NULL;
 	}
 
-	for (size_t i = 0; i < module_ctx->keyset.count; i++) {
-		zone_key_t *kkey = &module_ctx->keyset.keys[i];
+	// reuse previously created signatures
 
-		if (!use_key(kkey, copy)) {
-			continue;
-		}
+	uint32_t now = kctx->now;
+	if (rrsig_cache_get(module_ctx->cache, copy, now, &rrsig->rrs, mm) == KNOT_EOK) {
+		knot_rrset_free(&copy, NULL);
+		return rrsig;
+	}
 
-		int ret = knot_sign_rrset(rrsig, copy, kkey->key, kkey->ctx, &module_ctx->kctx, mm);
-		if (ret != KNOT_EOK) {
-			knot_rrset_free(&copy, NULL);
-			knot_rrset_free(&rrsig, mm);
-			return NULL;
-		}
+	if (sign_keys(rrsig, copy, module_ctx, keyset, kctx, mm) != KNOT_EOK) {
+		knot_rrset_free(&copy, NULL);
+		knot_rrset_free(&rrsig, mm);
+		return NULL;
 	}
 
+	// keep the signatures until they are due for refresh
+
+	const knot_kasp_policy_t *policy = kctx->policy;
+	uint32_t reuse = policy->rrsig_lifetime > policy->rrsig_refresh_before ?
+	                 policy->rrsig_lifetime - policy->rrsig_refresh_before :
+	                 policy->rrsig_lifetime / 2;
+	(void)rrsig_cache_put(module_ctx->cache, copy, &rrsig->rrs, now + reuse);
+
 	knot_rrset_free(&copy, NULL);
 
 	return rrsig;
@@ -303,7 +351,16 @@ static knotd_in_state_t sign_section(knotd_in_state_t state, knot_pkt_t *pkt,
 		return state;
 	}
 
-	module_ctx->kctx.now = time(NULL);
+	// signing time of this query
+	kdnssec_ctx_t kctx = module_ctx->kctx;
+	kctx.now = time(NULL);
+
+	unsigned id = qdata->params->thread_id;
+	zone_keyset_t *keyset = (id < module_ctx->thread_count) ?
+	                        &module_ctx->threads[id] : NULL;
+
+	// drop signatures of replaced zone contents
+	rrsig_cache_set_gen(module_ctx->cache, qdata->extra->zone->contents);
 
 	const knot_pktsection_t *section = knot_pkt_section(pkt, pkt->current);
 	assert(section);
@@ -317,7 +374,7 @@ static knotd_in_state_t sign_section(knotd_in_state_t state, knot_pkt_t *pkt,
 		knot_dname_unpack(owner, pkt->wire + rr_pos, sizeof(owner), pkt->wire);
 		knot_dname_to_lower(owner);
 
-		knot_rrset_t *rrsig = sign_rrset(owner, rr, module_ctx, &pkt->mm);
+		knot_rrset_t *rrsig = sign_rrset(owner, rr, module_ctx, keyset, &kctx, &pkt->mm);
 		if (!rrsig) {
 			state = KNOTD_IN_STATE_ERROR;
 			break;
@@ -445,8 +502,53 @@ static knotd_in_state_t synth_answer(knotd_in_state_t state, knot_pkt_t *pkt,
 	return state;
 }
 
+/*! \brief Copy the zone keys for each thread, creating new signing contexts. */
+static int thread_keys_init(online_sign_ctx_t *ctx, size_t count)
+{
+	ctx->threads = calloc(count, sizeof(zone_keyset_t));
+	if (ctx->threads == NULL) {
+		return KNOT_ENOMEM;
+	}
+	ctx->thread_count = count;
+
+	for (size_t i = 0; i < count; i++) {
+		zone_keyset_t *keyset = &ctx->threads[i];
+		keyset->keys = calloc(ctx->keyset.count, sizeof(zone_key_t));
+		if (keyset->keys == NULL) {
+			return KNOT_ENOMEM;
+		}
+		keyset->count = ctx->keyset.count;
+
+		for (size_t j = 0; j < keyset->count; j++) {
+			keyset->keys[j] = ctx->keyset.keys[j];
+			keyset->keys[j].ctx = NULL;
+			int ret = dnssec_sign_new(&keyset->keys[j].ctx, keyset->keys[j].key);
+			if (ret != DNSSEC_EOK) {
+				return knot_error_from_libdnssec(ret);
+			}
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static void thread_keys_free(online_sign_ctx_t *ctx)
+{
+	for (size_t i = 0; i < ctx->thread_count; i++) {
+		zone_keyset_t *keyset = &ctx->threads[i];
+		for (size_t j = 0; j < keyset->count; j++) {
+			dnssec_sign_free(keyset->keys[j].ctx);
+		}
+		free(keyset->keys);
+	}
+	free(ctx->threads);
+}
+
 static void online_sign_ctx_free(online_sign_ctx_t *ctx)
 {
+	thread_keys_free(ctx);
+	rrsig_cache_free(ctx->cache);
+	pthread_mutex_destroy(&ctx->sign_lock);
 	free_zone_keys(&ctx->keyset);
 	kdnssec_ctx_deinit(&ctx->kctx);
 
@@ -483,6 +585,29 @@ static int online_sign_ctx_new(online_sign_ctx_t **ctx_ptr, knotd_mod_t *mod)
 		return ret;
 	}
 
+	knotd_conf_t conf = knotd_conf_mod(mod, MOD_CACHE_SIZE);
+	if (conf.single.integer > 0) {
+		ctx->cache = rrsig_cache_new(conf.single.integer);
+		if (!ctx->cache) {
+			free_zone_keys(&ctx->keyset);
+			kdnssec_ctx_deinit(&ctx->kctx);
+			return KNOT_ENOMEM;
+		}
+	}
+
+	knotd_conf_t udp = knotd_conf_env(mod, KNOTD_CONF_ENV_WORKERS_UDP);
+	knotd_conf_t tcp = knotd_conf_env(mod, KNOTD_CONF_ENV_WORKERS_TCP);
+	ret = thread_keys_init(ctx, udp.single.integer + tcp.single.integer);
+	if (ret != KNOT_EOK) {
+		thread_keys_free(ctx);
+		rrsig_cache_free(ctx->cache);
+		free_zone_keys(&ctx->keyset);
+		kdnssec_ctx_deinit(&ctx->kctx);
+		return ret;
+	}
+
+	pthread_mutex_init(&ctx->sign_lock, NULL);
+
 	*ctx_ptr = ctx;
 
 	return KNOT_EOK;
@@ -0,0 +1,208 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "contrib/openbsd/siphash.h"
+#include "dnssec/error.h"
+#include "dnssec/random.h"
+#include "knot/modules/onlinesign/rrsig_cache.h"
+#include "libknot/errcode.h"
+
+#define RRSIG_CACHE_LOCKS 64
+
+typedef struct {
+	uint64_t hash;
+	uint32_t expire;
+	uint32_t ttl;
+	uint16_t type;
+	knot_dname_t *owner;
+	knot_rdataset_t covered;
+	knot_rdataset_t rrsigs;
+} rrsig_entry_t;
+
+struct rrsig_cache {
+	SIPHASH_KEY key;
+	const void *gen;
+	size_t size;
+	pthread_mutex_t locks[RRSIG_CACHE_LOCKS];
+	rrsig_entry_t *entries[];
+};
+
+static void entry_free(rrsig_entry_t *entry)
+{
+	if (entry == NULL) {
+		return;
+	}
+
+	knot_dname_free(&entry->owner, NULL);
+	knot_rdataset_clear(&entry->covered, NULL);
+	knot_rdataset_clear(&entry->rrsigs, NULL);
+	free(entry);
+}
+
+static uint64_t entry_hash(const rrsig_cache_t *cache, const knot_rrset_t *covered)
+{
+	SIPHASH_CTX ctx;
+	SipHash24_Init(&ctx, &cache->key);
+	SipHash24_Update(&ctx, covered->owner, knot_dname_size(covered->owner));
+	SipHash24_Update(&ctx, &covered->type, sizeof(covered->type));
+	SipHash24_Update(&ctx, &covered->ttl, sizeof(covered->ttl));
+	SipHash24_Update(&ctx, covered->rrs.data, knot_rdataset_size(&covered->rrs));
+	return SipHash24_End(&ctx);
+}
+
+static bool entry_match(const rrsig_entry_t *entry, uint64_t hash,
+                        const knot_rrset_t *covered)
+{
+	return entry != NULL && entry->hash == hash &&
+	       entry->type == covered->type && entry->ttl == covered->ttl &&
+	       knot_dname_is_equal(entry->owner, covered->owner) &&
+	       knot_rdataset_eq(&entry->covered, &covered->rrs);
+}
+
+rrsig_cache_t *rrsig_cache_new(size_t size)
+{
+	if (size == 0) {
+		return NULL;
+	}
+
+	rrsig_cache_t *cache = calloc(1, sizeof(*cache) + size * sizeof(rrsig_entry_t *));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	if (dnssec_random_buffer((uint8_t *)&cache->key, sizeof(cache->key)) != DNSSEC_EOK) {
+		free(cache);
+		return NULL;
+	}
+
+	cache->size = size;
+	for (size_t i = 0; i < RRSIG_CACHE_LOCKS; i++) {
+		pthread_mutex_init(&cache->locks[i], NULL);
+	}
+
+	return cache;
+}
+
+void rrsig_cache_free(rrsig_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < cache->size; i++) {
+		entry_free(cache->entries[i]);
+	}
+	for (size_t i = 0; i < RRSIG_CACHE_LOCKS; i++) {
+		pthread_mutex_destroy(&cache->locks[i]);
+	}
+	free(cache);
+}
+
+void rrsig_cache_set_gen(rrsig_cache_t *cache, const void *gen)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+#ifdef HAVE_ATOMIC
+	/* Checked on every signed query, the generation changes rarely. */
+	if (__atomic_load_n(&cache->gen, __ATOMIC_ACQUIRE) == gen ||
+	    __atomic_exchange_n(&cache->gen, gen, __ATOMIC_ACQ_REL) == gen) {
+		return;
+	}
+#else
+	pthread_mutex_lock(&cache->locks[0]);
+	bool changed = (cache->gen != gen);
+	cache->gen = gen;
+	pthread_mutex_unlock(&cache->locks[0]);
+	if (!changed) {
+		return;
+	}
+#endif
+
+	for (size_t i = 0; i < cache->size; i++) {
+		pthread_mutex_t *lock = &cache->locks[i % RRSIG_CACHE_LOCKS];
+		pthread_mutex_lock(lock);
+		rrsig_entry_t *entry = cache->entries[i];
+		cache->entries[i] = NULL;
+		pthread_mutex_unlock(lock);
+		entry_free(entry);
+	}
+}
+
+int rrsig_cache_get(rrsig_cache_t *cache, const knot_rrset_t *covered,
+                    uint32_t now, knot_rdataset_t *rrsigs, knot_mm_t *mm)
+{
+	if (cache == NULL || covered == NULL || rrsigs == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	uint64_t hash = entry_hash(cache, covered);
+	size_t pos = hash % cache->size;
+	pthread_mutex_t *lock = &cache->locks[pos % RRSIG_CACHE_LOCKS];
+
+	int ret = KNOT_ENOENT;
+	pthread_mutex_lock(lock);
+	rrsig_entry_t *entry = cache->entries[pos];
+	if (entry_match(entry, hash, covered) && now < entry->expire) {
+		ret = knot_rdataset_copy(rrsigs, &entry->rrsigs, mm);
+	}
+	pthread_mutex_unlock(lock);
+
+	return ret;
+}
+
+int rrsig_cache_put(rrsig_cache_t *cache, const knot_rrset_t *covered,
+                    const knot_rdataset_t *rrsigs, uint32_t expire)
+{
+	if (cache == NULL || covered == NULL || rrsigs == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	rrsig_entry_t *entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	entry->hash = entry_hash(cache, covered);
+	entry->expire = expire;
+	entry->ttl = covered->ttl;
+	entry->type = covered->type;
+	entry->owner = knot_dname_copy(covered->owner, NULL);
+	if (entry->owner == NULL ||
+	    knot_rdataset_copy(&entry->covered, &covered->rrs, NULL) != KNOT_EOK ||
+	    knot_rdataset_copy(&entry->rrsigs, rrsigs, NULL) != KNOT_EOK) {
+		entry_free(entry);
+		return KNOT_ENOMEM;
+	}
+
+	/* Replace the previous occupant of the slot. */
+	size_t pos = entry->hash % cache->size;
+	pthread_mutex_t *lock = &cache->locks[pos % RRSIG_CACHE_LOCKS];
+	pthread_mutex_lock(lock);
+	rrsig_entry_t *old = cache->entries[pos];
+	cache->entries[pos] = entry;
+	pthread_mutex_unlock(lock);
+
+	entry_free(old);
+
+	return KNOT_EOK;
+}
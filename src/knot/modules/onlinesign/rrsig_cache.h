@@ -0,0 +1,81 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "libknot/mm_ctx.h"
+#include "libknot/rrset.h"
+
+/*!
+ * \brief Bounded cache of online-created RRSIGs.
+ *
+ * Signatures are keyed by the covered RRSet (owner, type, TTL, RDATA), so
+ * the cache must be flushed whenever the signing keys change. Concurrent
+ * access is serialized per lock stripe.
+ */
+typedef struct rrsig_cache rrsig_cache_t;
+
+/*!
+ * \brief Create a new RRSIG cache.
+ *
+ * \param size  Maximal number of cached RRSIG sets.
+ *
+ * \return Cache or NULL on error.
+ */
+rrsig_cache_t *rrsig_cache_new(size_t size);
+
+/*!
+ * \brief Free the RRSIG cache.
+ */
+void rrsig_cache_free(rrsig_cache_t *cache);
+
+/*!
+ * \brief Drop all cached signatures if the generation changed.
+ *
+ * \param cache  RRSIG cache.
+ * \param gen    Current generation identifier (e.g. zone contents).
+ */
+void rrsig_cache_set_gen(rrsig_cache_t *cache, const void *gen);
+
+/*!
+ * \brief Find cached signatures of an RRSet.
+ *
+ * \param cache    RRSIG cache.
+ * \param covered  Covered RRSet.
+ * \param now      Current time.
+ * \param rrsigs   Output RRSIG RDATA (allocated using \a mm).
+ * \param mm       Memory context.
+ *
+ * \retval KNOT_EOK if found.
+ * \retval KNOT_ENOENT if not found or expired.
+ */
+int rrsig_cache_get(rrsig_cache_t *cache, const knot_rrset_t *covered,
+                    uint32_t now, knot_rdataset_t *rrsigs, knot_mm_t *mm);
+
+/*!
+ * \brief Store signatures of an RRSet, replacing an older entry.
+ *
+ * \param cache    RRSIG cache.
+ * \param covered  Covered RRSet.
+ * \param rrsigs   RRSIG RDATA.
+ * \param expire   Time the signatures must not be used after.
+ *
+ * \return KNOT_E*
+ */
+int rrsig_cache_put(rrsig_cache_t *cache, const knot_rrset_t *covered,
+                    const knot_rdataset_t *rrsigs, uint32_t expire);
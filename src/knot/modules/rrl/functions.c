@@ -33,7 +33,8 @@
 #define RRL_SSTART 2 /* 1/Nth of the rate for slow start */
 #define RRL_PSIZE_LARGE 1024
 #define RRL_CAPACITY 4 /* Window size in seconds */
-#define RRL_LOCK_GRANULARITY 32 /* Last digit granularity */
+#define RRL_SHARD_COUNT 32 /* Maximum number of table shards */
+#define RRL_SHARD_MIN_SIZE 1024 /* Minimum number of buckets per shard */
 
 /* Classification */
 enum {
@@ -203,7 +204,7 @@ static int bucket_match(rrl_item_t *b, rrl_item_t *m)
 	       b->qname  == m->qname;
 }
 
-static int find_free(rrl_table_t *t, unsigned i, uint32_t now)
+static int find_free(rrl_shard_t *t, unsigned i, uint32_t now)
 {
 	rrl_item_t *np = t->arr + t->size;
 	rrl_item_t *b = NULL;
@@ -223,7 +224,7 @@ static int find_free(rrl_table_t *t, unsigned i, uint32_t now)
 	return i;
 }
 
-static inline unsigned find_match(rrl_table_t *t, uint32_t id, rrl_item_t *m)
+static inline unsigned find_match(rrl_shard_t *t, uint32_t id, rrl_item_t *m)
 {
 	unsigned f = 0;
 	unsigned d = 0;
@@ -241,7 +242,7 @@ static inline unsigned find_match(rrl_table_t *t, uint32_t id, rrl_item_t *m)
 	return HOP_LEN + 1;
 }
 
-static inline unsigned reduce_dist(rrl_table_t *t, unsigned id, unsigned d, unsigned *f)
+static inline unsigned reduce_dist(rrl_shard_t *t, unsigned id, unsigned d, unsigned *f)
 {
 	unsigned rd = HOP_LEN - 1;
 	while (rd > 0) {
@@ -291,49 +292,54 @@ static void rrl_log_state(knotd_mod_t *mod, const struct sockaddr_storage *ss,
 static void rrl_lock(rrl_table_t *t, int lk_id)
 {
 	assert(lk_id > -1);
-	pthread_mutex_lock(t->lk + lk_id);
+	pthread_mutex_lock(&t->shards[lk_id].lk);
 }
 
 static void rrl_unlock(rrl_table_t *t, int lk_id)
 {
 	assert(lk_id > -1);
-	pthread_mutex_unlock(t->lk + lk_id);
+	pthread_mutex_unlock(&t->shards[lk_id].lk);
 }
 
-static int rrl_setlocks(rrl_table_t *rrl, uint32_t granularity)
+static int rrl_setshards(rrl_table_t *rrl, unsigned count)
 {
-	assert(!rrl->lk); /* Cannot change while locks are used. */
-	assert(granularity <= rrl->size / 10); /* Due to int. division err. */
+	assert(!rrl->shards); /* Cannot change while shards are used. */
+	assert(count > 0 && count <= rrl->size);
 
-	if (pthread_mutex_init(&rrl->ll, NULL) < 0) {
+	/* Alloc new shards. */
+	if (posix_memalign((void **)&rrl->shards, sizeof(rrl_shard_t),
+	                   count * sizeof(rrl_shard_t)) != 0) {
+		rrl->shards = NULL;
 		return KNOT_ENOMEM;
 	}
+	memset(rrl->shards, 0, count * sizeof(rrl_shard_t));
 
-	/* Alloc new locks. */
-	rrl->lk = malloc(granularity * sizeof(pthread_mutex_t));
-	if (!rrl->lk) {
-		return KNOT_ENOMEM;
-	}
-	memset(rrl->lk, 0, granularity * sizeof(pthread_mutex_t));
-
-	/* Initialize. */
-	for (size_t i = 0; i < granularity; ++i) {
-		if (pthread_mutex_init(rrl->lk + i, NULL) < 0) {
+	/* Initialize, distribute the buckets evenly. */
+	size_t offset = 0;
+	for (unsigned i = 0; i < count; ++i) {
+		rrl_shard_t *shard = rrl->shards + i;
+		if (pthread_mutex_init(&shard->lk, NULL) < 0) {
 			break;
 		}
-		++rrl->lk_count;
+		shard->size = rrl->size / count + (i < rrl->size % count ? 1 : 0);
+		shard->arr = rrl->arr + offset;
+		offset += shard->size;
+		++rrl->shard_count;
 	}
 
 	/* Incomplete initialization */
-	if (rrl->lk_count != granularity) {
-		for (size_t i = 0; i < rrl->lk_count; ++i) {
-			pthread_mutex_destroy(rrl->lk + i);
+	if (rrl->shard_count != count) {
+		for (unsigned i = 0; i < rrl->shard_count; ++i) {
+			pthread_mutex_destroy(&rrl->shards[i].lk);
 		}
-		free(rrl->lk);
-		rrl->lk_count = 0;
+		free(rrl->shards);
+		rrl->shards = NULL;
+		rrl->shard_count = 0;
 		return KNOT_ERROR;
 	}
 
+	assert(offset == rrl->size);
+
 	return KNOT_EOK;
 }
 
@@ -356,7 +362,10 @@ rrl_table_t *rrl_create(size_t size, uint32_t rate)
 		return NULL;
 	}
 
-	if (rrl_setlocks(t, RRL_LOCK_GRANULARITY) != KNOT_EOK) {
+	/* Small tables are not worth splitting. */
+	size_t shards = size / RRL_SHARD_MIN_SIZE;
+	shards = (shards < 1) ? 1 : (shards > RRL_SHARD_COUNT) ? RRL_SHARD_COUNT : shards;
+	if (rrl_setshards(t, shards) != KNOT_EOK) {
 		free(t);
 		return NULL;
 	}
@@ -375,10 +384,14 @@ static rrl_item_t *rrl_hash(rrl_table_t *t, const struct sockaddr_storage *a,
 		return NULL;
 	}
 
-	uint32_t id = SipHash24(&t->key, buf, len) % t->size;
+	/* Select the shard and the bucket within it. */
+	uint64_t hash = SipHash24(&t->key, buf, len);
+	*lock = hash % t->shard_count;
+	rrl_shard_t *shard = t->shards + *lock;
+	uint32_t id = (hash / t->shard_count) % shard->size;
 
-	/* Lock for lookup. */
-	pthread_mutex_lock(&t->ll);
+	/* Lock the shard for lookup and bucket update. */
+	rrl_lock(t, *lock);
 
 	/* Find an exact match in <id, id + HOP_LEN). */
 	char *qname = buf + sizeof(uint8_t) + sizeof(uint64_t);
@@ -394,26 +407,21 @@ static rrl_item_t *rrl_hash(rrl_table_t *t, const struct sockaddr_storage *a,
 		.time = stamp
 	};
 
-	unsigned d = find_match(t, id, &match);
+	unsigned d = find_match(shard, id, &match);
 	if (d > HOP_LEN) { /* not an exact match, find free element [f] */
-		d = find_free(t, id, stamp);
+		d = find_free(shard, id, stamp);
 	}
 
 	/* Reduce distance to fit <id, id + HOP_LEN) */
-	unsigned f = (id + d) % t->size;
+	unsigned f = (id + d) % shard->size;
 	while (d >= HOP_LEN) {
-		d = reduce_dist(t, id, d, &f);
+		d = reduce_dist(shard, id, d, &f);
 	}
 
-	/* Assign granular lock and unlock lookup. */
-	*lock = f % t->lk_count;
-	rrl_lock(t, *lock);
-	pthread_mutex_unlock(&t->ll);
-
 	/* found free elm 'k' which is in <id, id + HOP_LEN) */
-	t->arr[id].hop |= (1 << d);
-	rrl_item_t *b = t->arr + f;
-	assert(f == (id+d) % t->size);
+	shard->arr[id].hop |= (1 << d);
+	rrl_item_t *b = shard->arr + f;
+	assert(f == (id+d) % shard->size);
 
 	/* Inspect bucket state. */
 	unsigned hop = b->hop;
@@ -434,17 +442,14 @@ static rrl_item_t *rrl_hash(rrl_table_t *t, const struct sockaddr_storage *a,
 	return b;
 }
 
-int rrl_query(rrl_table_t *rrl, const struct sockaddr_storage *a, rrl_req_t *req,
-              const knot_dname_t *zone, knotd_mod_t *mod)
+/*! \brief Update the bucket for the request at the given time. */
+static int rrl_update(rrl_table_t *rrl, const struct sockaddr_storage *a,
+                      rrl_req_t *req, const knot_dname_t *zone, knotd_mod_t *mod,
+                      uint32_t now)
 {
-	if (!rrl || !req || !a) {
-		return KNOT_EINVAL;
-	}
-
 	/* Calculate hash and fetch */
 	int ret = KNOT_EOK;
 	int lock = -1;
-	uint32_t now = time(NULL);
 	rrl_item_t *b = rrl_hash(rrl, a, req, zone, now, &lock);
 	if (!b) {
 		if (lock > -1) {
@@ -498,6 +503,16 @@ int rrl_query(rrl_table_t *rrl, const struct sockaddr_storage *a, rrl_req_t *req
 	return ret;
 }
 
+int rrl_query(rrl_table_t *rrl, const struct sockaddr_storage *a, rrl_req_t *req,
+              const knot_dname_t *zone, knotd_mod_t *mod)
+{
+	if (!rrl || !req || !a) {
+		return KNOT_EINVAL;
+	}
+
+	return rrl_update(rrl, a, req, zone, mod, time(NULL));
+}
+
 bool rrl_slip_roll(int n_slip)
 {
 	/* Now n_slip means every Nth answer slips.
@@ -511,13 +526,10 @@ bool rrl_slip_roll(int n_slip)
 void rrl_destroy(rrl_table_t *rrl)
 {
 	if (rrl) {
-		if (rrl->lk_count > 0) {
-			pthread_mutex_destroy(&rrl->ll);
-		}
-		for (size_t i = 0; i < rrl->lk_count; ++i) {
-			pthread_mutex_destroy(rrl->lk + i);
+		for (unsigned i = 0; i < rrl->shard_count; ++i) {
+			pthread_mutex_destroy(&rrl->shards[i].lk);
 		}
-		free(rrl->lk);
+		free(rrl->shards);
 	}
 
 	free(rrl);
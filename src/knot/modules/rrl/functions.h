@@ -40,6 +40,19 @@ typedef struct {
 	uint32_t time;       /* Timestamp. */
 } rrl_item_t;
 
+/*!
+ * \brief RRL hash bucket table shard.
+ *
+ * Each shard is an independent hopscotch table over a contiguous part
+ * of the bucket array, guarded by its own lock. The structure is padded
+ * to a cache line, so the shard locks don't share cache lines.
+ */
+typedef struct {
+	pthread_mutex_t lk;  /* Shard lock. */
+	rrl_item_t *arr;     /* Shard buckets. */
+	size_t size;         /* Number of shard buckets. */
+} __attribute__((aligned(64))) rrl_shard_t;
+
 /*!
  * \brief RRL hash bucket table.
  *
@@ -48,18 +61,17 @@ typedef struct {
  * When a bucket is in a slow-start mode, it cannot reset again for the time
  * period.
  *
- * To avoid lock contention, N locks are created and distributed amongst buckets.
- * As of now lock K for bucket N is calculated as K = N % (num_buckets).
+ * To avoid lock contention, the table is split into N shards, each with its
+ * own lock. Shard K for a bucket is selected by the bucket hash as
+ * K = hash % shard_count, so there is no table-wide lock on the lookup path.
  */
-
 typedef struct {
-	SIPHASH_KEY key;     /* Siphash key. */
-	uint32_t rate;       /* Configured RRL limit. */
-	pthread_mutex_t ll;
-	pthread_mutex_t *lk; /* Table locks. */
-	unsigned lk_count;   /* Table lock count (granularity). */
-	size_t size;         /* Number of buckets. */
-	rrl_item_t arr[];    /* Buckets. */
+	SIPHASH_KEY key;        /* Siphash key. */
+	uint32_t rate;          /* Configured RRL limit. */
+	rrl_shard_t *shards;    /* Table shards. */
+	unsigned shard_count;   /* Number of shards. */
+	size_t size;            /* Number of buckets. */
+	rrl_item_t arr[];       /* Buckets. */
 } rrl_table_t;
 
 /*! \brief RRL request flags. */
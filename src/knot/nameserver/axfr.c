@@ -14,8 +14,6 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <urcu.h>
-
 #include "contrib/mempattern.h"
 #include "contrib/sockaddr.h"
 #include "knot/nameserver/axfr.h"
@@ -99,10 +97,8 @@ static void axfr_query_cleanup(knotd_qdata_t *qdata)
 
 	trie_it_free(axfr->i);
 	ptrlist_free(&axfr->proc.nodes, qdata->mm);
+	zone_contents_release(axfr->proc.contents);
 	mm_free(qdata->mm, axfr);
-
-	/* Allow zone changes (finished). */
-	rcu_read_unlock();
 }
 
 static int axfr_query_check(knotd_qdata_t *qdata)
@@ -149,8 +145,9 @@ static int axfr_query_init(knotd_qdata_t *qdata)
 	qdata->extra->ext = axfr;
 	qdata->extra->ext_cleanup = &axfr_query_cleanup;
 
-	/* No zone changes during multipacket answer (unlocked in axfr_answer_cleanup) */
-	rcu_read_lock();
+	/* Snapshot the contents, zone changes are allowed during multipacket answer
+	 * (released in axfr_query_cleanup). */
+	axfr->proc.contents = zone_contents_retain(zone);
 
 	return KNOT_EOK;
 }
@@ -175,7 +172,7 @@ int axfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 		switch (ret) {
 		case KNOT_EOK:      /* OK */
 			AXFROUT_LOG(LOG_INFO, qdata, "started, serial %u",
-			            zone_contents_serial(qdata->extra->zone->contents));
+			            zone_contents_serial(axfr->proc.contents));
 			break;
 		case KNOT_EDENIED:  /* Not authorized, already logged. */
 			return KNOT_STATE_FAIL;
@@ -15,6 +15,7 @@
  */
 
 #include "libknot/libknot.h"
+#include "knot/common/latency.h"
 #include "knot/nameserver/internet.h"
 #include "knot/nameserver/nsec_proofs.h"
 #include "knot/nameserver/query_module.h"
@@ -119,6 +120,18 @@ static bool have_dnssec(knotd_qdata_t *qdata)
 	       qdata->extra->zone->contents->dnssec;
 }
 
+/*! \brief Check if ANY queries are disabled for the zone. */
+static bool disable_any(const zone_t *zone)
+{
+	const zone_query_conf_t *query_conf = rcu_dereference(zone->query_conf);
+	if (query_conf != NULL) {
+		return query_conf->disable_any;
+	}
+
+	conf_val_t val = conf_zone_get(conf(), C_DISABLE_ANY, zone->name);
+	return conf_bool(&val);
+}
+
 /*! \brief This is a wildcard-covered or any other terminal node for QNAME.
  *         e.g. positive answer.
  */
@@ -143,11 +156,9 @@ static int put_answer(knot_pkt_t *pkt, uint16_t type, knotd_qdata_t *qdata)
 	int ret = KNOT_EOK;
 	switch (type) {
 	case KNOT_RRTYPE_ANY: /* Append all RRSets. */ {
-		conf_val_t val = conf_zone_get(conf(), C_DISABLE_ANY,
-		                               qdata->extra->zone->name);
 		/* If ANY not allowed, set TC bit. */
 		if ((qdata->params->flags & KNOTD_QUERY_FLAG_LIMIT_ANY) &&
-		    conf_bool(&val)) {
+		    disable_any(qdata->extra->zone)) {
 			knot_wire_set_tc(pkt->wire);
 			return KNOT_ESPACE;
 		}
@@ -189,7 +200,8 @@ static int put_delegation(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 {
 	/* Find closest delegation point. */
 	while (!(qdata->extra->node->flags & NODE_FLAGS_DELEG)) {
-		qdata->extra->node = qdata->extra->node->parent;
+		qdata->extra->node = zone_contents_node_parent(qdata->extra->zone->contents,
+		                                                 qdata->extra->node);
 	}
 
 	/* Insert NS record. */
@@ -226,11 +238,18 @@ static int put_additional(knot_pkt_t *pkt, const knot_rrset_t *rr,
 			flags |= KNOT_PF_NOTRUNC;
 		}
 
+		/* The glue node may have been removed meanwhile. */
+		const zone_node_t *glue_node =
+			zone_contents_glue_node(qdata->extra->zone->contents, glue);
+		if (glue_node == NULL) {
+			continue;
+		}
+
 		uint16_t hint = knot_compr_hint(info, KNOT_COMPR_HINT_RDATA +
 		                                glue->ns_pos);
-		knot_rrset_t rrsigs = node_rrset(glue->node, KNOT_RRTYPE_RRSIG);
+		knot_rrset_t rrsigs = node_rrset(glue_node, KNOT_RRTYPE_RRSIG);
 		for (int k = 0; k < ar_type_count; ++k) {
-			knot_rrset_t rrset = node_rrset(glue->node, ar_type_list[k]);
+			knot_rrset_t rrset = node_rrset(glue_node, ar_type_list[k]);
 			if (knot_rrset_empty(&rrset)) {
 				continue;
 			}
@@ -384,7 +403,7 @@ static int name_not_found(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 	/* Look up an authoritative encloser or its parent. */
 	const zone_node_t *node = qdata->extra->encloser;
 	while (node->rrset_count == 0 || node->flags & NODE_FLAGS_NONAUTH) {
-		node = node->parent;
+		node = zone_contents_node_parent(qdata->extra->zone->contents, node);
 		assert(node);
 	}
 
@@ -563,14 +582,108 @@ static int solve_additional_dnssec(int state, knot_pkt_t *pkt, knotd_qdata_t *qd
 }
 
 /*! \brief Helper for internet_query repetitive code. */
-#define SOLVE_STEP(solver, state, context) \
-	state = (solver)(state, pkt, qdata, context); \
+#define SOLVE_RESULT(state) \
 	if (state == KNOTD_IN_STATE_TRUNC) { \
 		return KNOT_STATE_DONE; \
 	} else if (state == KNOTD_IN_STATE_ERROR) { \
 		return KNOT_STATE_FAIL; \
 	}
 
+#define SOLVE_STEP(solver, state, context) \
+	state = (solver)(state, pkt, qdata, context); \
+	SOLVE_RESULT(state)
+
+/*! \brief Helper for query module steps, measures the module latency. */
+#define SOLVE_MOD_STEP(step, state) { \
+	LATENCY_START(step_start); \
+	state = (step)->process(state, pkt, qdata, (step)->ctx); \
+	LATENCY_MODULE(qdata->params, (step)->ctx, step_start); \
+	SOLVE_RESULT(state) \
+}
+
+/*! \brief Get the answer cache if the response can be taken from it. */
+static answer_cache_t *answer_cache(knotd_qdata_t *qdata)
+{
+	const zone_t *zone = qdata->extra->zone;
+
+	/* Query modules and TSIG may alter the response. */
+	if (conf()->query_plan != NULL || zone->query_plan != NULL ||
+	    knot_pkt_has_tsig(qdata->query) ||
+	    knot_pkt_qtype(qdata->query) == KNOT_RRTYPE_ANY) {
+		return NULL;
+	}
+
+	const zone_query_conf_t *query_conf = rcu_dereference(zone->query_conf);
+	if (query_conf == NULL || query_conf->answer_cache == 0) {
+		return NULL;
+	}
+
+	return zone_contents_answer_cache(zone->contents, query_conf->answer_cache);
+}
+
+static void answer_cache_key(answer_cache_key_t *key, knot_pkt_t *pkt,
+                             knotd_qdata_t *qdata)
+{
+	key->qname = qdata->name;
+	key->qtype = knot_pkt_qtype(qdata->query);
+	key->qclass = knot_pkt_qclass(qdata->query);
+	key->limit = pkt->max_size - pkt->reserved;
+	key->dnssec = have_dnssec(qdata);
+}
+
+/*! \brief Put the cached answer sections to the response. */
+static bool answer_from_cache(knot_pkt_t *pkt, knotd_qdata_t *qdata,
+                              answer_cache_t *cache, const answer_cache_key_t *key)
+{
+	answer_cache_val_t val;
+	int ret = answer_cache_get(cache, key, &val, pkt->wire + pkt->size,
+	                           key->limit - pkt->size);
+	if (ret != KNOT_EOK) {
+		return false;
+	}
+
+	pkt->size += val.size;
+	knot_wire_set_ancount(pkt->wire, val.count[KNOT_ANSWER]);
+	knot_wire_set_nscount(pkt->wire, val.count[KNOT_AUTHORITY]);
+	knot_wire_set_arcount(pkt->wire, val.count[KNOT_ADDITIONAL]);
+	if (val.aa) {
+		knot_wire_set_aa(pkt->wire);
+	}
+
+	/* Let OPT follow the cached sections. */
+	knot_pkt_begin(pkt, KNOT_ADDITIONAL);
+
+	qdata->rcode = val.rcode;
+	knot_wire_set_rcode(pkt->wire, qdata->rcode);
+
+	return true;
+}
+
+/*! \brief Store the rendered answer sections for later queries. */
+static void answer_to_cache(knot_pkt_t *pkt, knotd_qdata_t *qdata,
+                            answer_cache_t *cache, const answer_cache_key_t *key,
+                            size_t begin)
+{
+	/* Truncated or failed responses aren't worth caching. */
+	if (knot_wire_get_tc(pkt->wire) || qdata->rcode == KNOT_RCODE_SERVFAIL) {
+		return;
+	}
+
+	answer_cache_val_t val = {
+		.wire = pkt->wire + begin,
+		.size = pkt->size - begin,
+		.count = {
+			knot_wire_get_ancount(pkt->wire),
+			knot_wire_get_nscount(pkt->wire),
+			knot_wire_get_arcount(pkt->wire)
+		},
+		.rcode = qdata->rcode,
+		.aa = knot_wire_get_aa(pkt->wire)
+	};
+
+	(void)answer_cache_put(cache, key, &val);
+}
+
 static int answer_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 {
 	int state = KNOTD_IN_STATE_BEGIN;
@@ -579,6 +692,19 @@ static int answer_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 
 	bool with_dnssec = have_dnssec(qdata);
 
+	/* Try a response pre-rendered from the same zone contents. */
+	answer_cache_key_t cache_key;
+	answer_cache_t *cache = answer_cache(qdata);
+	if (cache != NULL) {
+		answer_cache_key(&cache_key, pkt, qdata);
+		if (answer_from_cache(pkt, qdata, cache, &cache_key)) {
+			return KNOT_STATE_DONE;
+		}
+	}
+	size_t begin = pkt->size;
+
+	LATENCY_START(stage_start);
+
 	/* Resolve ANSWER. */
 	knot_pkt_begin(pkt, KNOT_ANSWER);
 	SOLVE_STEP(solve_answer, state, NULL);
@@ -587,10 +713,13 @@ static int answer_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 	}
 	if (plan != NULL) {
 		WALK_LIST(step, plan->stage[KNOTD_STAGE_ANSWER]) {
-			SOLVE_STEP(step->process, state, step->ctx);
+			SOLVE_MOD_STEP(step, state);
 		}
 	}
 
+	LATENCY_STAGE(qdata->params, KNOTD_STAGE_ANSWER, stage_start);
+	LATENCY_RESTART(stage_start);
+
 	/* Resolve AUTHORITY. */
 	knot_pkt_begin(pkt, KNOT_AUTHORITY);
 	SOLVE_STEP(solve_authority, state, NULL);
@@ -599,10 +728,13 @@ static int answer_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 	}
 	if (plan != NULL) {
 		WALK_LIST(step, plan->stage[KNOTD_STAGE_AUTHORITY]) {
-			SOLVE_STEP(step->process, state, step->ctx);
+			SOLVE_MOD_STEP(step, state);
 		}
 	}
 
+	LATENCY_STAGE(qdata->params, KNOTD_STAGE_AUTHORITY, stage_start);
+	LATENCY_RESTART(stage_start);
+
 	/* Resolve ADDITIONAL. */
 	knot_pkt_begin(pkt, KNOT_ADDITIONAL);
 	SOLVE_STEP(solve_additional, state, NULL);
@@ -611,13 +743,19 @@ static int answer_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 	}
 	if (plan != NULL) {
 		WALK_LIST(step, plan->stage[KNOTD_STAGE_ADDITIONAL]) {
-			SOLVE_STEP(step->process, state, step->ctx);
+			SOLVE_MOD_STEP(step, state);
 		}
 	}
 
+	LATENCY_STAGE(qdata->params, KNOTD_STAGE_ADDITIONAL, stage_start);
+
 	/* Write resulting RCODE. */
 	knot_wire_set_rcode(pkt->wire, qdata->rcode);
 
+	if (cache != NULL) {
+		answer_to_cache(pkt, qdata, cache, &cache_key, begin);
+	}
+
 	return KNOT_STATE_DONE;
 }
 
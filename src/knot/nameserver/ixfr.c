@@ -14,10 +14,11 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <urcu.h>
 
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
 #include "contrib/sockaddr.h"
+#include "knot/journal/serialization.h"
 #include "knot/nameserver/axfr.h"
 #include "knot/nameserver/internet.h"
 #include "knot/nameserver/ixfr.h"
@@ -33,126 +34,108 @@
 	ns_log(priority, ZONE_NAME(qdata), LOG_OPERATION_IXFR, \
 	       LOG_DIRECTION_OUT, REMOTE(qdata), fmt)
 
-/*! \brief Helper macro for putting RRs into packet. */
-#define IXFR_SAFE_PUT(pkt, rr) \
-	int ret = knot_pkt_put((pkt), 0, (rr), KNOT_PF_NOTRUNC); \
-	if (ret != KNOT_EOK) { \
-		return ret; \
-	}
-
-/*! \brief Puts current RR into packet, stores state for retries. */
-static int ixfr_put_chg_part(knot_pkt_t *pkt, struct ixfr_proc *ixfr,
-                             changeset_iter_t *itt)
-{
-	assert(pkt);
-	assert(ixfr);
-	assert(itt);
-
-	if (knot_rrset_empty(&ixfr->cur_rr)) {
-		ixfr->cur_rr = changeset_iter_next(itt);
-	}
-
-	while (!knot_rrset_empty(&ixfr->cur_rr)) {
-		IXFR_SAFE_PUT(pkt, &ixfr->cur_rr);
-		ixfr->cur_rr = changeset_iter_next(itt);
-	}
-
-	return KNOT_EOK;
-}
-
-/*! \brief Tests if iteration has started. */
-static bool iter_empty(struct ixfr_proc *ixfr)
-{
-	return EMPTY_LIST(ixfr->cur.iters) && knot_rrset_empty(&ixfr->cur_rr);
-}
+/*! \brief Initial size of the rdata buffer (fits any packet in most cases). */
+#define IXFR_RDATA_SIZE (2 * KNOT_WIRE_MAX_PKTSIZE)
 
 /*!
- * \brief Process single changeset.
+ * \brief Puts serialized changes into the packet.
  * \note Keep in mind that this function must be able to resume processing,
  *       for example if it fills a packet and returns ESPACE, it is called again
  *       with next empty answer and it must resume the processing exactly where
  *       it's left off.
  */
-static int ixfr_process_changeset(knot_pkt_t *pkt, const void *item,
-                                  struct xfr_proc *xfer)
+static int ixfr_put_changes(knot_pkt_t *pkt, const void *item,
+                            struct xfr_proc *xfer)
 {
-	int ret = KNOT_EOK;
 	struct ixfr_proc *ixfr = (struct ixfr_proc *)xfer;
-	changeset_t *chgset = (changeset_t *)item;
-
-	/* Put former SOA. */
-	if (ixfr->state == IXFR_SOA_DEL) {
-		IXFR_SAFE_PUT(pkt, chgset->soa_from);
-		ixfr->state = IXFR_DEL;
-	}
 
-	/* Put REMOVE RRSets. */
-	if (ixfr->state == IXFR_DEL) {
-		if (iter_empty(ixfr)) {
-			ret = changeset_iter_rem(&ixfr->cur, chgset);
-			if (ret != KNOT_EOK) {
-				return ret;
+	while (true) {
+		/* Read next RRSet, the rdata live until the packet is sent. */
+		wire_ctx_t changes = ixfr->changes;
+		size_t size = ixfr->rdata_size - ixfr->rdata_used;
+		knot_rrset_t rr;
+		int ret = serialized_rrset_read(&changes, &rr,
+		                                ixfr->rdata + ixfr->rdata_used, &size);
+		if (ret == KNOT_ENOENT) {
+			return KNOT_EOK;
+		} else if (ret == KNOT_ESPACE) {
+			if (ixfr->rdata_used > 0) {
+				return KNOT_ESPACE; /* Continue with the next packet. */
 			}
-		}
-		ret = ixfr_put_chg_part(pkt, ixfr, &ixfr->cur);
-		if (ret != KNOT_EOK) {
+			/* Huge RRSet, nothing from the buffer in use. */
+			free(ixfr->rdata);
+			ixfr->rdata = malloc(MAX(size, IXFR_RDATA_SIZE));
+			ixfr->rdata_size = (ixfr->rdata != NULL) ? MAX(size, IXFR_RDATA_SIZE) : 0;
+			if (ixfr->rdata == NULL) {
+				return KNOT_ENOMEM;
+			}
+			continue;
+		} else if (ret != KNOT_EOK) {
 			return ret;
 		}
-		changeset_iter_clear(&ixfr->cur);
-		ixfr->state = IXFR_SOA_ADD;
-	}
 
-	/* Put next SOA. */
-	if (ixfr->state == IXFR_SOA_ADD) {
-		IXFR_SAFE_PUT(pkt, chgset->soa_to);
-		ixfr->state = IXFR_ADD;
-	}
-
-	/* Put Add RRSets. */
-	if (ixfr->state == IXFR_ADD) {
-		if (iter_empty(ixfr)) {
-			ret = changeset_iter_add(&ixfr->cur, chgset);
-			if (ret != KNOT_EOK) {
-				return ret;
-			}
-		}
-		ret = ixfr_put_chg_part(pkt, ixfr, &ixfr->cur);
+		ret = knot_pkt_put(pkt, 0, &rr, KNOT_PF_NOTRUNC);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
-		changeset_iter_clear(&ixfr->cur);
-		ixfr->state = IXFR_SOA_DEL;
+		ixfr->changes = changes;
+		ixfr->rdata_used += size;
+
+		/* SOA records delimit the changesets. */
+		if (rr.type == KNOT_RRTYPE_SOA) {
+			uint32_t serial = knot_soa_serial(&rr.rrs);
+			if (ixfr->state == IXFR_DEL) {
+				IXFROUT_LOG(LOG_DEBUG, ixfr->qdata, "serial %u -> %u",
+				            ixfr->cur_serial, serial);
+				ixfr->state = IXFR_ADD;
+			} else {
+				ixfr->cur_serial = serial;
+				ixfr->state = IXFR_DEL;
+			}
+		}
 	}
-
-	/* Finished change set. */
-	const uint32_t serial_from = knot_soa_serial(&chgset->soa_from->rrs);
-	const uint32_t serial_to = knot_soa_serial(&chgset->soa_to->rrs);
-	IXFROUT_LOG(LOG_DEBUG, ixfr->qdata, "serial %u -> %u", serial_from, serial_to);
-
-	return ret;
 }
 
-#undef IXFR_SAFE_PUT
-
-static int ixfr_load_chsets(list_t *chgsets, zone_t *zone,
-                            const knot_rrset_t *their_soa)
+static int ixfr_load_changes(struct ixfr_proc *ixfr, zone_t *zone,
+                             zone_contents_t *contents,
+                             const knot_rrset_t *their_soa)
 {
-	assert(chgsets);
+	assert(ixfr);
 	assert(zone);
+	assert(contents);
 
 	/* Compare serials. */
-	uint32_t serial_to = zone_contents_serial(zone->contents);
+	uint32_t serial_to = zone_contents_serial(contents);
 	uint32_t serial_from = knot_soa_serial(&their_soa->rrs);
 	if (serial_compare(serial_to, serial_from) & SERIAL_MASK_LEQ) { /* We have older/same age zone. */
 		return KNOT_EUPTODATE;
 	}
+	ixfr->serial_from = serial_from;
+	ixfr->serial_to = serial_to;
+
+	/* Changes leading to these contents may be cached. */
+	ixfr_cache_t *cache = zone_contents_ixfr_cache(contents);
+	const ixfr_range_t *range = ixfr_cache_get(cache, serial_from);
+	if (range == NULL) {
+		uint8_t *data = NULL;
+		size_t size = 0;
+		int ret = zone_changes_load_serialized(conf(), zone, serial_from,
+		                                       serial_to, &data, &size);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
 
-	int ret = zone_changes_load(conf(), zone, chgsets, serial_from);
-	if (ret != KNOT_EOK) {
-		changesets_free(chgsets);
+		range = ixfr_cache_put(cache, serial_from, data, size);
+		if (range == NULL) {
+			ixfr->changes_data = data;
+			ixfr->changes = wire_ctx_init(data, size);
+			return KNOT_EOK;
+		}
 	}
 
-	return ret;
+	ixfr->changes = wire_ctx_init_const(range->data, range->size);
+
+	return KNOT_EOK;
 }
 
 static int ixfr_query_check(knotd_qdata_t *qdata)
@@ -180,12 +163,10 @@ static void ixfr_answer_cleanup(knotd_qdata_t *qdata)
 	knot_mm_t *mm = qdata->mm;
 
 	ptrlist_free(&ixfr->proc.nodes, mm);
-	changeset_iter_clear(&ixfr->cur);
-	changesets_free(&ixfr->changesets);
+	free(ixfr->changes_data);
+	free(ixfr->rdata);
+	zone_contents_release(ixfr->proc.contents);
 	mm_free(mm, qdata->extra->ext);
-
-	/* Allow zone changes (finished). */
-	rcu_read_unlock();
 }
 
 static int ixfr_answer_init(knotd_qdata_t *qdata)
@@ -201,51 +182,48 @@ static int ixfr_answer_init(knotd_qdata_t *qdata)
 		}
 	}
 
-	/* Compare serials. */
-	const knot_pktsection_t *authority = knot_pkt_section(qdata->query, KNOT_AUTHORITY);
-	const knot_rrset_t *their_soa = knot_pkt_rr(authority, 0);
-	list_t chgsets;
-	init_list(&chgsets);
-	int ret = ixfr_load_chsets(&chgsets, (zone_t *)qdata->extra->zone, their_soa);
-	if (ret != KNOT_EOK) {
-		return ret;
-	}
-
 	/* Initialize transfer processing. */
 	knot_mm_t *mm = qdata->mm;
 	struct ixfr_proc *xfer = mm_alloc(mm, sizeof(struct ixfr_proc));
 	if (xfer == NULL) {
-		changesets_free(&chgsets);
 		return KNOT_ENOMEM;
 	}
 	memset(xfer, 0, sizeof(struct ixfr_proc));
 	xfr_stats_begin(&xfer->proc.stats);
 	xfer->state = IXFR_SOA_DEL;
 	init_list(&xfer->proc.nodes);
-	init_list(&xfer->changesets);
-	init_list(&xfer->cur.iters);
-	knot_rrset_init_empty(&xfer->cur_rr);
-	add_tail_list(&xfer->changesets, &chgsets);
 	xfer->qdata = qdata;
 
-	/* Put all changesets to processing queue. */
-	changeset_t *chs = NULL;
-	WALK_LIST(chs, xfer->changesets) {
-		ptrlist_add(&xfer->proc.nodes, chs, mm);
+	/* Load the changes leading to the current contents. */
+	const knot_pktsection_t *authority = knot_pkt_section(qdata->query, KNOT_AUTHORITY);
+	const knot_rrset_t *their_soa = knot_pkt_rr(authority, 0);
+	zone_t *zone = (zone_t *)qdata->extra->zone;
+	xfer->proc.contents = zone->contents;
+	int ret = ixfr_load_changes(xfer, zone, xfer->proc.contents, their_soa);
+	if (ret != KNOT_EOK) {
+		mm_free(mm, xfer);
+		return ret;
+	}
+
+	xfer->rdata = malloc(IXFR_RDATA_SIZE);
+	if (xfer->rdata == NULL) {
+		free(xfer->changes_data);
+		mm_free(mm, xfer);
+		return KNOT_ENOMEM;
 	}
+	xfer->rdata_size = IXFR_RDATA_SIZE;
 
-	/* Keep first and last serial. */
-	chs = HEAD(xfer->changesets);
-	xfer->soa_from = chs->soa_from;
-	chs = TAIL(xfer->changesets);
-	xfer->soa_to = chs->soa_to;
+	/* The changes are streamed as a single item. */
+	ptrlist_add(&xfer->proc.nodes, &xfer->changes, mm);
 
 	/* Set up cleanup callback. */
 	qdata->extra->ext = xfer;
 	qdata->extra->ext_cleanup = &ixfr_answer_cleanup;
 
-	/* No zone changes during multipacket answer (unlocked in ixfr_answer_cleanup) */
-	rcu_read_lock();
+	/* Snapshot the contents, the changes are cached along with them and zone
+	 * changes are allowed during multipacket answer (released in
+	 * ixfr_answer_cleanup). */
+	xfer->proc.contents = zone_contents_retain(xfer->proc.contents);
 
 	return KNOT_EOK;
 }
@@ -301,8 +279,7 @@ int ixfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 		switch (ret) {
 		case KNOT_EOK:       /* OK */
 			IXFROUT_LOG(LOG_INFO, qdata, "started, serial %u -> %u",
-			            knot_soa_serial(&ixfr->soa_from->rrs),
-			            knot_soa_serial(&ixfr->soa_to->rrs));
+			            ixfr->serial_from, ixfr->serial_to);
 			break;
 		case KNOT_EUPTODATE: /* Our zone is same age/older, send SOA. */
 			IXFROUT_LOG(LOG_INFO, qdata, "zone is up-to-date");
@@ -330,8 +307,9 @@ int ixfr_process_query(knot_pkt_t *pkt, knotd_qdata_t *qdata)
 		return KNOT_STATE_FAIL;
 	}
 
-	/* Answer current packet (or continue). */
-	ret = xfr_process_list(pkt, &ixfr_process_changeset, qdata);
+	/* Answer current packet (or continue), the previous one was sent. */
+	ixfr->rdata_used = 0;
+	ret = xfr_process_list(pkt, &ixfr_put_changes, qdata);
 	switch (ret) {
 	case KNOT_ESPACE: /* Couldn't write more, send packet and continue. */
 		return KNOT_STATE_PRODUCE; /* Check for more. */
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "contrib/wire_ctx.h"
 #include "knot/nameserver/process_query.h"
 #include "knot/nameserver/xfr.h"
 #include "libknot/packet/pkt.h"
@@ -37,14 +38,17 @@ struct ixfr_proc {
 	struct xfr_proc proc;
 	enum ixfr_state state;
 
-	/* Changes to be sent. */
-	list_t changesets;
+	/* Serialized changes to be sent. */
+	wire_ctx_t changes;
+	uint8_t *changes_data;  /* Private copy of the changes if not cached. */
+	uint32_t serial_from;
+	uint32_t serial_to;
+	uint32_t cur_serial;    /* Starting serial of the current changeset. */
 
-	/* Currenty processed changeset. */
-	knot_rrset_t cur_rr;
-	changeset_iter_t cur;
-	const knot_rrset_t *soa_from;
-	const knot_rrset_t *soa_to;
+	/* Rdata of the RRs put into the current packet. */
+	uint8_t *rdata;
+	size_t rdata_size;
+	size_t rdata_used;
 
 	/* Processing context. */
 	knotd_qdata_t *qdata;
@@ -40,9 +40,9 @@ static bool wildcard_expanded(const zone_node_t *node, const knot_dname_t *qname
 /*!
  * \brief Check if opt-out can take an effect.
  */
-static bool ds_optout(const zone_node_t *node)
+static bool ds_optout(const zone_contents_t *zone, const zone_node_t *node)
 {
-	return node->nsec3_node == NULL && node->flags & NODE_FLAGS_DELEG;
+	return zone_contents_node_nsec3(zone, node) == NULL && node->flags & NODE_FLAGS_DELEG;
 }
 
 /*!
@@ -65,21 +65,22 @@ static bool node_in_nsec(const zone_node_t *node)
  *
  * \see https://tools.ietf.org/html/rfc5155#section-7.1
  */
-static bool node_in_nsec3(const zone_node_t *node)
+static bool node_in_nsec3(const zone_contents_t *zone, const zone_node_t *node)
 {
-	return (node->flags & NODE_FLAGS_NONAUTH) == 0 && !ds_optout(node);
+	return (node->flags & NODE_FLAGS_NONAUTH) == 0 && !ds_optout(zone, node);
 }
 
 /*!
  * \brief Walk previous names until we reach a node in NSEC chain.
  *
  */
-static const zone_node_t *nsec_previous(const zone_node_t *previous)
+static const zone_node_t *nsec_previous(const zone_contents_t *zone,
+                                        const zone_node_t *previous)
 {
 	assert(previous);
 
 	while (!node_in_nsec(previous)) {
-		previous = previous->prev;
+		previous = zone_contents_node_prev(zone, previous);
 		assert(previous);
 	}
 
@@ -89,12 +90,13 @@ static const zone_node_t *nsec_previous(const zone_node_t *previous)
 /*!
  * \brief Get closest provable encloser from closest matching parent node.
  */
-static const zone_node_t *nsec3_encloser(const zone_node_t *closest)
+static const zone_node_t *nsec3_encloser(const zone_contents_t *zone,
+                                         const zone_node_t *closest)
 {
 	assert(closest);
 
-	while (!node_in_nsec3(closest)) {
-		closest = closest->parent;
+	while (!node_in_nsec3(zone, closest)) {
+		closest = zone_contents_node_parent(zone, closest);
 		assert(closest);
 	}
 
@@ -194,7 +196,7 @@ static int put_covering_nsec(const zone_contents_t *zone,
 	if (ret == ZONE_NAME_FOUND) {
 		proof = match;
 	} else if (ret == ZONE_NAME_NOT_FOUND) {
-		proof = nsec_previous(prev);
+		proof = nsec_previous(zone, prev);
 	} else {
 		assert(ret < 0);
 		return ret;
@@ -274,7 +276,7 @@ static int put_closest_encloser_proof(const knot_dname_t *qname,
 {
 	// An NSEC3 RR that matches the closest (provable) encloser.
 
-	int ret = put_nsec3_from_node(cpe->nsec3_node, qdata, resp);
+	int ret = put_nsec3_from_node(zone_contents_node_nsec3(zone, cpe), qdata, resp);
 	if (ret !=  KNOT_EOK) {
 		return ret;
 	}
@@ -323,7 +325,7 @@ static int put_nsec3_wildcard(const zone_node_t *wildcard,
                               knotd_qdata_t *qdata,
                               knot_pkt_t *resp)
 {
-	const zone_node_t *cpe = nsec3_encloser(wildcard->parent);
+	const zone_node_t *cpe = nsec3_encloser(zone, zone_contents_node_parent(zone, wildcard));
 
 	return put_nsec3_next_closer(cpe, qname, zone, qdata, resp);
 }
@@ -349,7 +351,7 @@ static int put_wildcard_answer(const zone_node_t *wildcard,
 	if (knot_is_nsec3_enabled(zone)) {
 		ret = put_nsec3_wildcard(wildcard, qname, zone, qdata, resp);
 	} else {
-		previous = nsec_previous(previous);
+		previous = nsec_previous(zone, previous);
 		ret = put_nsec_wildcard(previous, qdata, resp);
 	}
 
@@ -396,7 +398,7 @@ static int put_nsec_nxdomain(const zone_contents_t *zone,
 
 	// An NSEC RR proving that there is no exact match for <SNAME, SCLASS>.
 
-	previous = nsec_previous(previous);
+	previous = nsec_previous(zone, previous);
 	int ret = put_nsec_from_node(previous, qdata, resp);
 	if (ret != KNOT_EOK) {
 		return ret;
@@ -435,7 +437,7 @@ static int put_nsec3_nxdomain(const knot_dname_t *qname,
                               knotd_qdata_t *qdata,
                               knot_pkt_t *resp)
 {
-	const zone_node_t *cpe = nsec3_encloser(closest);
+	const zone_node_t *cpe = nsec3_encloser(zone, closest);
 
 	// Closest encloser proof.
 
@@ -533,8 +535,9 @@ static int put_nsec3_nodata(const knot_dname_t *qname,
 
 	// NSEC3 matching QNAME is always included.
 
-	if (match->nsec3_node) {
-		ret = put_nsec3_from_node(match->nsec3_node, qdata, resp);
+	const zone_node_t *match_nsec3 = zone_contents_node_nsec3(zone, match);
+	if (match_nsec3 != NULL) {
+		ret = put_nsec3_from_node(match_nsec3, qdata, resp);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
@@ -542,8 +545,8 @@ static int put_nsec3_nodata(const knot_dname_t *qname,
 
 	// Closest encloser proof for wildcard effect or NSEC3 opt-out.
 
-	if (wildcard_expanded(match, qname) || ds_optout(match)) {
-		const zone_node_t *cpe = nsec3_encloser(closest);
+	if (wildcard_expanded(match, qname) || ds_optout(zone, match)) {
+		const zone_node_t *cpe = nsec3_encloser(zone, closest);
 		ret = put_closest_encloser_proof(qname, zone, cpe, qdata, resp);
 	}
 
@@ -17,6 +17,7 @@
 #include <urcu.h>
 
 #include "dnssec/tsig.h"
+#include "knot/common/latency.h"
 #include "knot/common/log.h"
 #include "knot/dnssec/rrset-sign.h"
 #include "knot/nameserver/process_query.h"
@@ -79,6 +80,9 @@ static int process_query_begin(knot_layer_t *ctx, void *params)
 	/* Initialize persistent data. */
 	query_data_init(ctx, params, extra);
 
+	/* Update module statistics in the worker thread slot. */
+	knotd_mod_stats_thread(((knotd_qdata_params_t *)params)->thread_id);
+
 	/* Await packet. */
 	return KNOT_STATE_CONSUME;
 }
@@ -446,7 +450,9 @@ static int process_query_err(knot_layer_t *ctx, knot_pkt_t *pkt)
 #define PROCESS_BEGIN(plan, step, next_state, qdata) \
 	if (plan != NULL) { \
 		WALK_LIST(step, plan->stage[KNOTD_STAGE_BEGIN]) { \
+			LATENCY_START(step_start); \
 			next_state = step->process(next_state, pkt, qdata, step->ctx); \
+			LATENCY_MODULE(qdata->params, step->ctx, step_start); \
 			if (next_state == KNOT_STATE_FAIL) { \
 				goto finish; \
 			} \
@@ -456,7 +462,9 @@ static int process_query_err(knot_layer_t *ctx, knot_pkt_t *pkt)
 #define PROCESS_END(plan, step, next_state, qdata) \
 	if (plan != NULL) { \
 		WALK_LIST(step, plan->stage[KNOTD_STAGE_END]) { \
+			LATENCY_START(step_start); \
 			next_state = step->process(next_state, pkt, qdata, step->ctx); \
+			LATENCY_MODULE(qdata->params, step->ctx, step_start); \
 			if (next_state == KNOT_STATE_FAIL) { \
 				next_state = process_query_err(ctx, pkt); \
 			} \
@@ -467,6 +475,9 @@ static int process_query_out(knot_layer_t *ctx, knot_pkt_t *pkt)
 {
 	assert(pkt && ctx);
 
+	LATENCY_START(start);
+	LATENCY_START(stage_start);
+
 	rcu_read_lock();
 
 	knotd_qdata_t *qdata = QUERY_DATA(ctx);
@@ -495,8 +506,10 @@ static int process_query_out(knot_layer_t *ctx, knot_pkt_t *pkt)
 	}
 
 	/* Before query processing code. */
+	LATENCY_RESTART(stage_start);
 	PROCESS_BEGIN(plan, step, next_state, qdata);
 	PROCESS_BEGIN(zone_plan, step, next_state, qdata);
+	LATENCY_STAGE(qdata->params, KNOTD_STAGE_BEGIN, stage_start);
 
 	/* Answer based on qclass. */
 	if (next_state == KNOT_STATE_PRODUCE) {
@@ -552,14 +565,54 @@ finish:
 	}
 
 	/* After query processing code. */
+	LATENCY_RESTART(stage_start);
 	PROCESS_END(plan, step, next_state, qdata);
 	PROCESS_END(zone_plan, step, next_state, qdata);
+	LATENCY_STAGE(qdata->params, KNOTD_STAGE_END, stage_start);
+	LATENCY_STAGE(qdata->params, LATENCY_STAGE_TOTAL, start);
 
 	rcu_read_unlock();
 
 	return next_state;
 }
 
+static bool acl_check(conf_t *conf, const knot_dname_t *zone_name,
+                      acl_action_t action, knotd_qdata_t *qdata,
+                      knot_tsig_key_t *tsig)
+{
+	const struct sockaddr_storage *query_source = qdata->params->remote;
+
+	rcu_read_lock();
+
+	bool allowed;
+	const zone_t *zone = qdata->extra->zone;
+	const zone_query_conf_t *query_conf = NULL;
+	if (zone != NULL && knot_dname_is_equal(zone->name, zone_name)) {
+		query_conf = rcu_dereference(zone->query_conf);
+	}
+	if (query_conf != NULL) {
+		allowed = acl_match(query_conf->acl, action, query_source, tsig);
+	} else {
+		conf_val_t acl = conf_zone_get(conf, C_ACL, zone_name);
+		allowed = acl_allowed(conf, &acl, action, query_source, tsig);
+	}
+
+	/* Keep the secret valid after a reload or across response packets. */
+	if (allowed && tsig->name != NULL) {
+		uint8_t *secret = mm_alloc(qdata->mm, tsig->secret.size);
+		if (secret == NULL) {
+			allowed = false;
+		} else {
+			memcpy(secret, tsig->secret.data, tsig->secret.size);
+			tsig->secret.data = secret;
+		}
+	}
+
+	rcu_read_unlock();
+
+	return allowed;
+}
+
 bool process_query_acl_check(conf_t *conf, const knot_dname_t *zone_name,
                              acl_action_t action, knotd_qdata_t *qdata)
 {
@@ -579,8 +632,7 @@ bool process_query_acl_check(conf_t *conf, const knot_dname_t *zone_name,
 	}
 
 	/* Check if authenticated. */
-	conf_val_t acl = conf_zone_get(conf, C_ACL, zone_name);
-	if (!acl_allowed(conf, &acl, action, query_source, &tsig)) {
+	if (!acl_check(conf, zone_name, action, qdata, &tsig)) {
 		char addr_str[SOCKADDR_STRLEN] = { 0 };
 		sockaddr_tostr(addr_str, sizeof(addr_str), (struct sockaddr *)query_source);
 		const knot_lookup_t *act = knot_lookup_by_id((knot_lookup_t *)acl_actions,
@@ -21,11 +21,13 @@
 #include <string.h>
 
 #include "libknot/attribute.h"
+#include "knot/common/latency.h"
 #include "knot/common/log.h"
 #include "knot/conf/module.h"
 #include "knot/conf/tools.h"
 #include "knot/nameserver/query_module.h"
 #include "knot/nameserver/process_query.h"
+#include "contrib/macros.h"
 #include "contrib/mempattern.h"
 
 #ifdef HAVE_ATOMIC
@@ -39,6 +41,12 @@
  #define ATOMIC_SET(dst, val) ((dst) = (val))
 #endif
 
+/*! \brief Number of counter values per cache line. */
+#define STATS_LINE_VALS (64 / sizeof(uint64_t))
+
+/*! \brief Statistics slot identifier of the current thread. */
+static __thread unsigned stats_thread_id = 0;
+
 _public_
 int knotd_conf_check_ref(knotd_conf_check_args_t *args)
 {
@@ -152,6 +160,15 @@ knotd_mod_t *query_module_open(conf_t *conf, conf_mod_id_t *mod_id,
 	module->zone = zone;
 	module->id = mod_id;
 	module->api = mod->api;
+	module->latency_idx = LATENCY_MODULE_NONE;
+
+#ifdef ENABLE_LATENCY_STATS
+	char name[YP_MAX_ID_LEN + 1];
+	uint8_t name_len = mod_id->name[0];
+	memcpy(name, mod_id->name + 1, name_len);
+	name[name_len] = '\0';
+	module->latency_idx = latency_module(name);
+#endif
 
 	return module;
 }
@@ -221,6 +238,43 @@ void knotd_mod_vlog(knotd_mod_t *mod, int priority, const char *fmt, va_list arg
 	#undef LOG_ARGS
 }
 
+static int stats_vals_resize(knotd_mod_t *mod, uint32_t count)
+{
+	mod_ctr_vals_t *vals = &mod->stats_vals;
+
+	// One slot per worker thread, other threads share the slots.
+	if (vals->slots == 0) {
+		conf_t *config = (mod->config != NULL) ? mod->config : conf();
+		size_t threads = conf_udp_threads(config) + conf_tcp_threads(config);
+		vals->slots = MAX(threads, 1);
+	}
+
+	uint32_t slot_size = (count + STATS_LINE_VALS - 1) & ~(STATS_LINE_VALS - 1);
+	if (slot_size <= vals->slot_size) {
+		return KNOT_EOK;
+	}
+
+	size_t size = (size_t)vals->slots * slot_size * sizeof(uint64_t);
+	uint64_t *new_vals = NULL;
+	if (posix_memalign((void **)&new_vals, STATS_LINE_VALS * sizeof(uint64_t),
+	                   size) != 0) {
+		return KNOT_ENOMEM;
+	}
+	memset(new_vals, 0, size);
+
+	// Keep the already registered counters.
+	for (uint32_t i = 0; vals->vals != NULL && i < vals->slots; i++) {
+		memcpy(new_vals + i * slot_size, vals->vals + i * vals->slot_size,
+		       vals->slot_size * sizeof(uint64_t));
+	}
+
+	free(vals->vals);
+	vals->vals = new_vals;
+	vals->slot_size = slot_size;
+
+	return KNOT_EOK;
+}
+
 _public_
 int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_count,
                         knotd_mod_idx_to_str_f idx_to_str)
@@ -229,6 +283,7 @@ int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_cou
 		return KNOT_EINVAL;
 	}
 
+	uint32_t offset = 0;
 	mod_ctr_t *stats = NULL;
 	if (mod->stats == NULL) {
 		assert(mod->stats_count == 0);
@@ -248,21 +303,19 @@ int knotd_mod_stats_add(knotd_mod_t *mod, const char *ctr_name, uint32_t idx_cou
 		}
 		mod->stats = stats;
 		stats += mod->stats_count;
+		offset = stats[-1].offset + stats[-1].count;
 	}
 
 	mod->stats_count++;
 
-	if (idx_count > 1) {
-		size_t size = idx_count * sizeof(((mod_ctr_t *)0)->counter);
-		stats->counters = mm_alloc(mod->mm, size);
-		if (stats->counters == NULL) {
-			knotd_mod_stats_free(mod);
-			return KNOT_ENOMEM;
-		}
-		memset(stats->counters, 0, size);
-		stats->idx_to_str = idx_to_str;
+	if (stats_vals_resize(mod, offset + idx_count) != KNOT_EOK) {
+		knotd_mod_stats_free(mod);
+		return KNOT_ENOMEM;
 	}
+
 	stats->name = ctr_name;
+	stats->idx_to_str = (idx_count > 1) ? idx_to_str : NULL;
+	stats->offset = offset;
 	stats->count = idx_count;
 
 	return KNOT_EOK;
@@ -275,26 +328,48 @@ void knotd_mod_stats_free(knotd_mod_t *mod)
 		return;
 	}
 
-	for (int i = 0; i < mod->stats_count; i++) {
-		if (mod->stats[i].count > 1) {
-			mm_free(mod->mm, mod->stats[i].counters);
-		}
-	}
+	free(mod->stats_vals.vals);
+	memset(&mod->stats_vals, 0, sizeof(mod->stats_vals));
 
 	mm_free(mod->mm, mod->stats);
+	mod->stats = NULL;
+	mod->stats_count = 0;
+}
+
+uint64_t knotd_mod_stats_get(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx)
+{
+	if (mod == NULL) {
+		return 0;
+	}
+
+	mod_ctr_t *ctr = mod->stats + ctr_id;
+	assert(idx < ctr->count);
+
+	const mod_ctr_vals_t *vals = &mod->stats_vals;
+	uint64_t *val = vals->vals + ctr->offset + idx;
+
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < vals->slots; i++, val += vals->slot_size) {
+		sum += ATOMIC_GET(*val);
+	}
+
+	return sum;
+}
+
+void knotd_mod_stats_thread(unsigned thread_id)
+{
+	stats_thread_id = thread_id;
 }
 
 #define STATS_BODY(OPERATION) { \
 	if (mod == NULL) return; \
 	\
 	mod_ctr_t *ctr = mod->stats + ctr_id; \
-	if (ctr->count == 1) { \
-		assert(idx == 0); \
-		OPERATION(ctr->counter, val); \
-	} else { \
-		assert(idx < ctr->count); \
-		OPERATION(ctr->counters[idx], val); \
-	} \
+	assert(idx < ctr->count); \
+	\
+	const mod_ctr_vals_t *vals = &mod->stats_vals; \
+	uint32_t slot = stats_thread_id % vals->slots; \
+	OPERATION(vals->vals[slot * vals->slot_size + ctr->offset + idx], val); \
 }
 
 _public_
@@ -312,7 +387,18 @@ void knotd_mod_stats_decr(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx, uint6
 _public_
 void knotd_mod_stats_store(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx, uint64_t val)
 {
-	STATS_BODY(ATOMIC_SET)
+	if (mod == NULL) return;
+
+	mod_ctr_t *ctr = mod->stats + ctr_id;
+	assert(idx < ctr->count);
+
+	// Keep the value in the current slot, reset the others.
+	const mod_ctr_vals_t *vals = &mod->stats_vals;
+	uint32_t slot = stats_thread_id % vals->slots;
+	for (uint32_t i = 0; i < vals->slots; i++) {
+		ATOMIC_SET(vals->vals[i * vals->slot_size + ctr->offset + idx],
+		           (i == slot) ? val : 0);
+	}
 }
 
 _public_
@@ -70,16 +70,24 @@ typedef char* (*mod_idx_to_str_f)(uint32_t idx, uint32_t count);
 
 typedef struct {
 	const char *name;
-	union {
-		uint64_t counter;
-		struct {
-			uint64_t *counters;
-			mod_idx_to_str_f idx_to_str;
-		};
-	};
+	mod_idx_to_str_f idx_to_str;
+	uint32_t offset; /*!< Offset of the first subcounter in a thread slot. */
 	uint32_t count;
 } mod_ctr_t;
 
+/*!
+ * \brief Module statistics counter values.
+ *
+ * Each worker thread updates its own slot of counter values, the slots are
+ * padded to cache lines to avoid false sharing. The values are summed up
+ * only when the statistics are read.
+ */
+typedef struct {
+	uint64_t *vals;      /*!< Counter values, slot by slot. */
+	uint32_t slot_size;  /*!< Number of values per slot (padded). */
+	uint32_t slots;      /*!< Number of slots. */
+} mod_ctr_vals_t;
+
 struct knotd_mod {
 	node_t node;
 	knot_mm_t *mm;
@@ -89,8 +97,16 @@ struct knotd_mod {
 	const knot_dname_t *zone;
 	const knotd_mod_api_t *api;
 	mod_ctr_t *stats;
+	mod_ctr_vals_t stats_vals;
 	uint32_t stats_count;
+	unsigned latency_idx;
 	void *ctx;
 };
 
 void knotd_mod_stats_free(knotd_mod_t *mod);
+
+/*! \brief Get aggregated value of a statistics (sub)counter. */
+uint64_t knotd_mod_stats_get(knotd_mod_t *mod, uint32_t ctr_id, uint32_t idx);
+
+/*! \brief Set statistics slot of the current worker thread. */
+void knotd_mod_stats_thread(unsigned thread_id);
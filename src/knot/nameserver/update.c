@@ -321,6 +321,7 @@ static bool update_tsig_check(conf_t *conf, knotd_qdata_t *qdata, struct knot_re
 	if (!process_query_acl_check(conf, qdata->extra->zone->name, ACL_ACTION_UPDATE, qdata) ||
 	    process_query_verify(qdata) != KNOT_EOK) {
 		knot_wire_set_rcode(req->resp->wire, qdata->rcode);
+		free(qdata->sign.tsig_key.secret.data);
 		return false;
 	}
 
@@ -358,6 +359,7 @@ static void free_request(struct knot_request *req)
 	close(req->fd);
 	knot_pkt_free(req->query);
 	knot_pkt_free(req->resp);
+	free(req->sign.tsig_key.secret.data);
 	free(req);
 }
 
@@ -27,7 +27,10 @@ int xfr_process_list(knot_pkt_t *pkt, xfr_put_cb put, knotd_qdata_t *qdata)
 	knot_mm_t *mm = qdata->mm;
 	struct xfr_proc *xfer = qdata->extra->ext;
 
-	zone_contents_t *zone = qdata->extra->zone->contents;
+	zone_contents_t *zone = xfer->contents;
+	if (zone == NULL) {
+		zone = qdata->extra->zone->contents;
+	}
 	knot_rrset_t soa_rr = node_rrset(zone->apex, KNOT_RRTYPE_SOA);
 
 	/* Prepend SOA on first packet. */
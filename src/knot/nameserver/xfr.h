@@ -50,7 +50,7 @@ void xfr_log_finished(const knot_dname_t *zone, enum log_operation op,
  */
 struct xfr_proc {
 	list_t nodes;               //!< Items to process (ptrnode_t).
-	zone_contents_t *contents;  //!< Processed zone.
+	zone_contents_t *contents;  //!< Processed zone snapshot (optional).
 	struct xfr_stats stats;     //!< Packet transfer statistics.
 };
 
@@ -23,6 +23,7 @@
 
 #include "libknot/errcode.h"
 #include "libknot/yparser/ypschema.h"
+#include "knot/common/latency.h"
 #include "knot/common/log.h"
 #include "knot/common/stats.h"
 #include "knot/conf/confio.h"
@@ -416,6 +417,13 @@ int server_init(server_t *server, int bg_workers)
 		return KNOT_ENOMEM;
 	}
 
+	server->soa_check = soa_check_new();
+	if (server->soa_check == NULL) {
+		worker_pool_destroy(server->workers);
+		evsched_deinit(&server->sched);
+		return KNOT_ENOMEM;
+	}
+
 	char *journal_dir = conf_journalfile(conf());
 	conf_val_t journal_size = conf_default_get(conf(), C_MAX_JOURNAL_DB_SIZE);
 	conf_val_t journal_mode = conf_default_get(conf(), C_JOURNAL_DB_MODE);
@@ -423,6 +431,7 @@ int server_init(server_t *server, int bg_workers)
 	                          conf_int(&journal_size), conf_opt(&journal_mode));
 	free(journal_dir);
 	if (ret != KNOT_EOK) {
+		soa_check_free(server->soa_check);
 		worker_pool_destroy(server->workers);
 		evsched_deinit(&server->sched);
 		return ret;
@@ -434,11 +443,16 @@ int server_init(server_t *server, int bg_workers)
 	free(kasp_dir);
 	if (ret != KNOT_EOK) {
 		journal_db_close(&server->journal_db);
+		soa_check_free(server->soa_check);
 		worker_pool_destroy(server->workers);
 		evsched_deinit(&server->sched);
 		return ret;
 	}
 
+#ifdef ENABLE_LATENCY_STATS
+	latency_init();
+#endif
+
 	return KNOT_EOK;
 }
 
@@ -459,6 +473,7 @@ void server_deinit(server_t *server)
 
 	/* Free threads and event handlers. */
 	worker_pool_destroy(server->workers);
+	soa_check_free(server->soa_check);
 
 	/* Free zone database. */
 	knot_zonedb_deep_free(&server->zone_db);
@@ -475,6 +490,9 @@ void server_deinit(server_t *server)
 	/* Close persistent timers database. */
 	zone_timers_close(server->timers_db);
 
+	/* Free latency statistics. */
+	latency_deinit();
+
 	/* Clear the structure. */
 	memset(server, 0, sizeof(server_t));
 }
@@ -532,6 +550,13 @@ int server_start(server_t *server, bool async)
 		return KNOT_EINVAL;
 	}
 
+	/* Start SOA checks. */
+	int ret = soa_check_start(server->soa_check);
+	if (ret != KNOT_EOK) {
+		log_warning("failed to start asynchronous SOA checks (%s)",
+		            knot_strerror(ret));
+	}
+
 	/* Start workers. */
 	worker_pool_start(server->workers);
 
@@ -547,7 +572,7 @@ int server_start(server_t *server, bool async)
 	server->state |= ServerRunning;
 	for (int proto = IO_UDP; proto <= IO_TCP; ++proto) {
 		if (server->handlers[proto].size > 0) {
-			int ret = dt_start(server->handlers[proto].handler.unit);
+			ret = dt_start(server->handlers[proto].handler.unit);
 			if (ret != KNOT_EOK) {
 				return ret;
 			}
@@ -625,6 +650,11 @@ static int reload_conf(conf_t *new_conf)
 	return KNOT_EOK;
 }
 
+static void update_query_conf(zone_t *zone, conf_t *conf)
+{
+	zone_query_conf_update(conf, zone);
+}
+
 int server_reload(server_t *server)
 {
 	if (server == NULL) {
@@ -682,6 +712,9 @@ int server_reload(server_t *server)
 	}
 	if (full || (flags & (CONF_IO_FRLD_ZONES | CONF_IO_FRLD_ZONE))) {
 		server_update_zones(conf(), server);
+	} else if (server->zone_db != NULL) {
+		/* Referenced ACL or key items may have changed. */
+		knot_zonedb_foreach(server->zone_db, update_query_conf, conf());
 	}
 
 	/* Free old config needed for module unload in zone reload. */
@@ -704,6 +737,8 @@ void server_stop(server_t *server)
 {
 	log_info("stopping server");
 
+	/* Cancel SOA checks. */
+	soa_check_stop(server->soa_check);
 	/* Stop scheduler. */
 	evsched_stop(&server->sched);
 	/* Interrupt background workers. */
@@ -885,6 +920,9 @@ void server_update_zones(conf_t *conf, server_t *server)
 	worker_pool_clear(server->workers);
 	worker_pool_wait(server->workers);
 
+	/* Cancel SOA checks referencing the old zones. */
+	soa_check_cancel(server->soa_check);
+
 	/* Reload zone database and free old zones. */
 	reopen_timers_database(conf, server);
 	zonedb_reload(conf, server);
@@ -907,6 +945,11 @@ ref_t *server_set_ifaces(server_t *server, fdset_t *fds, int index, int thread_i
 
 	rcu_read_lock();
 	fdset_clear(fds);
+	if (fdset_init(fds, list_size(&server->ifaces->l)) != KNOT_EOK) {
+		fdset_clear(fds);
+		rcu_read_unlock();
+		return NULL;
+	}
 
 	iface_t *i = NULL;
 	WALK_LIST(i, server->ifaces->l) {
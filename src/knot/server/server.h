@@ -33,6 +33,7 @@
 #include "knot/common/evsched.h"
 #include "knot/common/fdset.h"
 #include "knot/dnssec/kasp/kasp_db.h"
+#include "knot/events/soa-check.h"
 #include "knot/server/dthreads.h"
 #include "knot/common/ref.h"
 #include "knot/worker/pool.h"
@@ -107,6 +108,9 @@ typedef struct server {
 	/*! \brief Background jobs. */
 	worker_pool_t *workers;
 
+	/*! \brief Asynchronous SOA checks. */
+	soa_check_t *soa_check;
+
 	/*! \brief Event scheduler. */
 	evsched_t sched;
 
@@ -43,11 +43,39 @@
 #include "contrib/time.h"
 #include "contrib/ucw/mempool.h"
 
+/*! \brief Size of the TCP receive buffer (two maximum DNS messages). */
+#define TCP_RX_SIZE (2 * (sizeof(uint16_t) + KNOT_WIRE_MAX_PKTSIZE))
+
+/*! \brief Maximum amount of queued unsent data before the answering is paused. */
+#define TCP_TX_LIMIT (2 * (sizeof(uint16_t) + KNOT_WIRE_MAX_PKTSIZE))
+
+/*! \brief Queued response message. */
+typedef struct tcp_msg {
+	struct tcp_msg *next;            /*!< Next queued message. */
+	size_t len;                      /*!< Message length incl. the length prefix. */
+	size_t sent;                     /*!< Already sent part of the message. */
+	uint8_t data[];                  /*!< Length-prefixed message. */
+} tcp_msg_t;
+
+/*! \brief TCP client connection state. */
+typedef struct {
+	struct sockaddr_storage addr;    /*!< Remote address. */
+	uint8_t *rx;                     /*!< Incomplete received message. */
+	size_t rx_len;                   /*!< Length of the incomplete message. */
+	tcp_msg_t *tx_head;              /*!< First unsent response message. */
+	tcp_msg_t *tx_tail;              /*!< Last unsent response message. */
+	size_t tx_len;                   /*!< Length of the unsent data. */
+	knotd_qdata_params_t params;     /*!< Parameters of the answered query. */
+	knot_layer_t layer;              /*!< Query processing layer. */
+	knot_mm_t mm;                    /*!< Memory of the answered query. */
+	knot_pkt_t *query;               /*!< Answered query (NULL if none). */
+	knot_pkt_t *ans;                 /*!< Response packet. */
+} tcp_conn_t;
+
 /*! \brief TCP context data. */
 typedef struct tcp_context {
-	knot_layer_t layer;              /*!< Query processing layer. */
 	server_t *server;                /*!< Name server structure. */
-	struct iovec iov[2];             /*!< TX/RX buffers. */
+	struct iovec iov[2];             /*!< RX/TX buffers. */
 	unsigned client_threshold;       /*!< Index of first TCP client. */
 	struct timespec last_poll_time;  /*!< Time of the last socket poll. */
 	struct timespec throttle_end;    /*!< End of accept() throttling. */
@@ -66,22 +94,180 @@ static inline int tcp_throttle(void) {
 	return TCP_THROTTLE_LO + (dnssec_random_uint16_t() % TCP_THROTTLE_HI);
 }
 
+static tcp_conn_t *tcp_conn_new(int fd)
+{
+	tcp_conn_t *conn = calloc(1, sizeof(*conn));
+	if (conn == NULL) {
+		return NULL;
+	}
+
+	/* Create per-query memory, flushed after each answered query. */
+	mm_ctx_mempool(&conn->mm, MM_DEFAULT_BLKSIZE);
+	if (conn->mm.ctx == NULL) {
+		free(conn);
+		return NULL;
+	}
+	knot_layer_init(&conn->layer, &conn->mm, process_query_layer());
+
+	/* Receive peer name. */
+	socklen_t addrlen = sizeof(conn->addr);
+	if (getpeername(fd, (struct sockaddr *)&conn->addr, &addrlen) < 0) {
+		memset(&conn->addr, 0, sizeof(conn->addr));
+	}
+
+	return conn;
+}
+
+/*! \brief Finish the answered query and flush its memory. */
+static void tcp_conn_finish(tcp_conn_t *conn)
+{
+	knot_layer_finish(&conn->layer);
+
+	knot_pkt_free(conn->query);
+	knot_pkt_free(conn->ans);
+	conn->query = NULL;
+	conn->ans = NULL;
+
+	mp_flush(conn->mm.ctx);
+}
+
+static void tcp_conn_free(tcp_conn_t *conn)
+{
+	if (conn == NULL) {
+		return;
+	}
+
+	/* Cancel the unfinished response. */
+	if (conn->query != NULL) {
+		tcp_conn_finish(conn);
+	}
+
+	while (conn->tx_head != NULL) {
+		tcp_msg_t *msg = conn->tx_head;
+		conn->tx_head = msg->next;
+		free(msg);
+	}
+
+	mp_delete(conn->mm.ctx);
+	free(conn->rx);
+	free(conn);
+}
+
+/*! \brief Append data to the connection buffer. */
+static int tcp_conn_append(uint8_t **buf, size_t *len, const uint8_t *data, size_t size)
+{
+	uint8_t *new_buf = realloc(*buf, *len + size);
+	if (new_buf == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	memcpy(new_buf + *len, data, size);
+	*buf = new_buf;
+	*len += size;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Send as much of the queued messages as possible without blocking. */
+static int tcp_conn_flush(tcp_conn_t *conn, int fd)
+{
+	while (conn->tx_head != NULL) {
+		tcp_msg_t *msg = conn->tx_head;
+		ssize_t ret = send(fd, msg->data + msg->sent, msg->len - msg->sent,
+		                   MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (ret > 0) {
+			msg->sent += ret;
+			conn->tx_len -= ret;
+		} else if (ret == -1 && errno == EINTR) {
+			continue;
+		} else if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		} else {
+			return KNOT_ECONN;
+		}
+
+		if (msg->sent == msg->len) {
+			conn->tx_head = msg->next;
+			if (conn->tx_head == NULL) {
+				conn->tx_tail = NULL;
+			}
+			free(msg);
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Send a response message, queue what can't be sent without blocking. */
+static int tcp_conn_send(tcp_conn_t *conn, int fd, const uint8_t *wire, size_t size)
+{
+	uint16_t pktsize = htons(size);
+	size_t len = sizeof(pktsize) + size;
+
+	/* Try to send directly if nothing is queued. */
+	ssize_t sent = 0;
+	if (conn->tx_head == NULL) {
+		struct iovec iov[2] = {
+			{ .iov_base = &pktsize, .iov_len = sizeof(pktsize) },
+			{ .iov_base = (void *)wire, .iov_len = size }
+		};
+		struct msghdr mh = { .msg_iov = iov, .msg_iovlen = 2 };
+		do {
+			sent = sendmsg(fd, &mh, MSG_DONTWAIT | MSG_NOSIGNAL);
+		} while (sent == -1 && errno == EINTR);
+		if (sent == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			return KNOT_ECONN;
+		} else if (sent == len) {
+			return KNOT_EOK;
+		} else if (sent < 0) {
+			sent = 0;
+		}
+	}
+
+	/* Queue the rest. */
+	tcp_msg_t *msg = malloc(sizeof(*msg) + len);
+	if (msg == NULL) {
+		return KNOT_ENOMEM;
+	}
+	msg->next = NULL;
+	msg->len = len;
+	msg->sent = sent;
+	memcpy(msg->data, &pktsize, sizeof(pktsize));
+	memcpy(msg->data + sizeof(pktsize), wire, size);
+
+	if (conn->tx_tail != NULL) {
+		conn->tx_tail->next = msg;
+	} else {
+		conn->tx_head = msg;
+	}
+	conn->tx_tail = msg;
+	conn->tx_len += len - sent;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Check if the client doesn't keep up with the responses. */
+static bool tcp_conn_blocked(const tcp_conn_t *conn)
+{
+	return conn->query != NULL || conn->tx_len >= TCP_TX_LIMIT;
+}
+
 /*! \brief Sweep TCP connection. */
 static enum fdset_sweep_state tcp_sweep(fdset_t *set, int i, void *data)
 {
 	UNUSED(data);
 	assert(set && i < set->n && i >= 0);
-	int fd = set->pfd[i].fd;
+	int fd = fdset_get_fd(set, i);
+	tcp_conn_t *conn = set->ctx[i];
 
 	/* Best-effort, name and shame. */
-	struct sockaddr_storage ss;
-	socklen_t len = sizeof(struct sockaddr_storage);
-	if (getpeername(fd, (struct sockaddr*)&ss, &len) == 0) {
+	if (conn != NULL && conn->addr.ss_family != AF_UNSPEC) {
 		char addr_str[SOCKADDR_STRLEN] = {0};
-		sockaddr_tostr(addr_str, sizeof(addr_str), (struct sockaddr *)&ss);
+		sockaddr_tostr(addr_str, sizeof(addr_str), (struct sockaddr *)&conn->addr);
 		log_notice("TCP, terminated inactive client, address %s", addr_str);
 	}
 
+	tcp_conn_free(set->ctx[i]);
 	close(fd);
 
 	return FDSET_SWEEP;
@@ -98,80 +284,72 @@ static bool tcp_send_state(int state)
 }
 
 /*!
- * \brief TCP event handler function.
+ * \brief Produce the response messages until the answer is finished.
+ *
+ * The answering is paused once the unsent data reach TCP_TX_LIMIT, and resumed
+ * when the client accepts them, so a multi-message response (e.g. AXFR) to
+ * a slow client isn't buffered as a whole.
  */
-static int tcp_handle(tcp_context_t *tcp, int fd,
-                      struct iovec *rx, struct iovec *tx)
+static int tcp_conn_produce(tcp_conn_t *conn, int fd)
 {
+	while (tcp_active_state(conn->layer.state)) {
+		if (conn->tx_len >= TCP_TX_LIMIT) {
+			return KNOT_EOK;
+		}
+
+		knot_layer_produce(&conn->layer, conn->ans);
+		/* Send, if response generation passed and wasn't ignored. */
+		if (conn->ans->size > 0 && tcp_send_state(conn->layer.state)) {
+			if (tcp_conn_send(conn, fd, conn->ans->wire, conn->ans->size) != KNOT_EOK) {
+				return KNOT_ECONNREFUSED;
+			}
+		}
+	}
+
+	/* Reset after processing. */
+	tcp_conn_finish(conn);
+
+	return KNOT_EOK;
+}
+
+/*!
+ * \brief Process one DNS message received over the connection.
+ */
+static int tcp_handle(tcp_context_t *tcp, int fd, tcp_conn_t *conn,
+                      const uint8_t *msg, size_t msg_len)
+{
+	assert(conn->query == NULL);
+
 	/* Create query processing parameter. */
-	struct sockaddr_storage ss = { 0 };
-	knotd_qdata_params_t params = {
-		.remote = &ss,
+	conn->params = (knotd_qdata_params_t) {
+		.remote = &conn->addr,
 		.socket = fd,
 		.server = tcp->server,
 		.thread_id = tcp->thread_id
 	};
 
-	rx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
-	tx->iov_len = KNOT_WIRE_MAX_PKTSIZE;
-
-	/* Receive peer name. */
-	socklen_t addrlen = sizeof(struct sockaddr_storage);
-	if (getpeername(fd, (struct sockaddr *)&ss, &addrlen) < 0) {
-		;
+	/* Initialize processing layer. */
+	knot_layer_begin(&conn->layer, &conn->params);
+
+	/* Create packets, the query outlives the receive buffer if paused. */
+	struct iovec *tx = &tcp->iov[1];
+	uint8_t *query_wire = mm_alloc(&conn->mm, msg_len);
+	if (query_wire != NULL) {
+		memcpy(query_wire, msg, msg_len);
+		conn->query = knot_pkt_new(query_wire, msg_len, &conn->mm);
+		conn->ans = knot_pkt_new(tx->iov_base, tx->iov_len, &conn->mm);
 	}
-
-	/* Timeout. */
-	rcu_read_lock();
-	int timeout = 1000 * conf()->cache.srv_tcp_reply_timeout;
-	rcu_read_unlock();
-
-	/* Receive data. */
-	int ret = net_dns_tcp_recv(fd, rx->iov_base, rx->iov_len, timeout);
-	if (ret <= 0) {
-		if (ret == KNOT_EAGAIN) {
-			char addr_str[SOCKADDR_STRLEN] = {0};
-			sockaddr_tostr(addr_str, sizeof(addr_str), (struct sockaddr *)&ss);
-			log_warning("TCP, connection timed out, address %s",
-			            addr_str);
-		}
-		return KNOT_ECONNREFUSED;
-	} else {
-		rx->iov_len = ret;
+	if (conn->query == NULL || conn->ans == NULL) {
+		tcp_conn_finish(conn);
+		return KNOT_ENOMEM;
 	}
 
-	/* Initialize processing layer. */
-	knot_layer_begin(&tcp->layer, &params);
-
-	/* Create packets. */
-	knot_pkt_t *ans = knot_pkt_new(tx->iov_base, tx->iov_len, tcp->layer.mm);
-	knot_pkt_t *query = knot_pkt_new(rx->iov_base, rx->iov_len, tcp->layer.mm);
-
 	/* Input packet. */
-	(void) knot_pkt_parse(query, 0);
-	knot_layer_consume(&tcp->layer, query);
+	(void) knot_pkt_parse(conn->query, 0);
+	knot_layer_consume(&conn->layer, conn->query);
 
-	/* Resolve until NOOP or finished. */
-	ret = KNOT_EOK;
-	while (tcp_active_state(tcp->layer.state)) {
-		knot_layer_produce(&tcp->layer, ans);
-		/* Send, if response generation passed and wasn't ignored. */
-		if (ans->size > 0 && tcp_send_state(tcp->layer.state)) {
-			if (net_dns_tcp_send(fd, ans->wire, ans->size, timeout) != ans->size) {
-				ret = KNOT_ECONNREFUSED;
-				break;
-			}
-		}
-	}
-
-	/* Reset after processing. */
-	knot_layer_finish(&tcp->layer);
-
-	/* Cleanup. */
-	knot_pkt_free(query);
-	knot_pkt_free(ans);
-
-	return ret;
+	/* Resolve until NOOP, finished, or the client falls behind. */
+	return tcp_conn_produce(conn, fd);
 }
 
 int tcp_accept(int fd)
@@ -200,12 +378,20 @@ int tcp_accept(int fd)
 static int tcp_event_accept(tcp_context_t *tcp, unsigned i)
 {
 	/* Accept client. */
-	int fd = tcp->set.pfd[i].fd;
+	int fd = fdset_get_fd(&tcp->set, i);
 	int client = tcp_accept(fd);
 	if (client >= 0) {
+		/* Create connection state. */
+		tcp_conn_t *conn = tcp_conn_new(client);
+		if (conn == NULL) {
+			close(client);
+			return KNOT_ENOMEM;
+		}
+
 		/* Assign to fdset. */
-		int next_id = fdset_add(&tcp->set, client, POLLIN, NULL);
+		int next_id = fdset_add(&tcp->set, client, POLLIN, conn);
 		if (next_id < 0) {
+			tcp_conn_free(conn);
 			close(client);
 			return next_id; /* Contains errno. */
 		}
@@ -222,30 +408,129 @@ static int tcp_event_accept(tcp_context_t *tcp, unsigned i)
 	return client;
 }
 
-static int tcp_event_serve(tcp_context_t *tcp, unsigned i)
+/*! \brief Wait for the client to accept the queued responses if any. */
+static void tcp_conn_set_events(tcp_context_t *tcp, unsigned i, const tcp_conn_t *conn)
 {
-	int fd = tcp->set.pfd[i].fd;
-	int ret = tcp_handle(tcp, fd, &tcp->iov[0], &tcp->iov[1]);
+	if (tcp_conn_blocked(conn)) {
+		/* Don't read further queries until the backlog is drained. */
+		fdset_set_events(&tcp->set, i, POLLOUT);
+	} else if (conn->tx_len > 0) {
+		fdset_set_events(&tcp->set, i, POLLIN | POLLOUT);
+	} else {
+		fdset_set_events(&tcp->set, i, POLLIN);
+	}
+}
+
+static int tcp_event_serve(tcp_context_t *tcp, unsigned i, bool readable)
+{
+	int fd = fdset_get_fd(&tcp->set, i);
+	tcp_conn_t *conn = tcp->set.ctx[i];
+
+	/* Resume the unprocessed data. */
+	uint8_t *buf = tcp->iov[0].iov_base;
+	size_t len = conn->rx_len;
+	assert(len <= TCP_RX_SIZE);
+	if (len > 0) {
+		memcpy(buf, conn->rx, len);
+		free(conn->rx);
+		conn->rx = NULL;
+		conn->rx_len = 0;
+	}
 
-	/* Flush per-query memory. */
-	mp_flush(tcp->layer.mm->ctx);
+	/* Receive whatever is available. */
+	if (readable && len < TCP_RX_SIZE) {
+		ssize_t ret;
+		do {
+			ret = recv(fd, buf + len, TCP_RX_SIZE - len, MSG_DONTWAIT | MSG_NOSIGNAL);
+		} while (ret == -1 && errno == EINTR);
+		if (ret == 0 || (ret == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+			return KNOT_ECONNREFUSED;
+		}
+		if (ret > 0) {
+			len += ret;
+		}
+	}
 
-	if (ret == KNOT_EOK) {
-		/* Update socket activity timer. */
+	/* Process complete messages (pipelining) while the client keeps up. */
+	size_t off = 0;
+	while (len - off >= sizeof(uint16_t) && !tcp_conn_blocked(conn)) {
+		uint16_t msg_len = knot_wire_read_u16(buf + off);
+		if (msg_len == 0) {
+			return KNOT_ECONNREFUSED;
+		}
+		if (len - off < sizeof(uint16_t) + msg_len) {
+			break;
+		}
+
+		int ret = tcp_handle(tcp, fd, conn, buf + off + sizeof(uint16_t), msg_len);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		off += sizeof(uint16_t) + msg_len;
+	}
+
+	/* Keep the unprocessed data. */
+	if (off < len && tcp_conn_append(&conn->rx, &conn->rx_len, buf + off,
+	                                 len - off) != KNOT_EOK) {
+		return KNOT_ENOMEM;
+	}
+
+	tcp_conn_set_events(tcp, i, conn);
+
+	/* Update socket activity timer. */
+	rcu_read_lock();
+	int timeout = conf()->cache.srv_tcp_idle_timeout;
+	fdset_set_watchdog(&tcp->set, i, timeout);
+	rcu_read_unlock();
+
+	return KNOT_EOK;
+}
+
+static int tcp_event_send(tcp_context_t *tcp, unsigned i)
+{
+	int fd = fdset_get_fd(&tcp->set, i);
+	tcp_conn_t *conn = tcp->set.ctx[i];
+
+	bool blocked = tcp_conn_blocked(conn);
+	size_t queued = conn->tx_len;
+	int ret = tcp_conn_flush(conn, fd);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+	bool progress = (conn->tx_len < queued);
+
+	/* Resume the paused answer. */
+	if (conn->query != NULL) {
+		ret = tcp_conn_produce(conn, fd);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	/* Update socket activity timer if the client keeps reading. */
+	if (progress) {
 		rcu_read_lock();
 		int timeout = conf()->cache.srv_tcp_idle_timeout;
 		fdset_set_watchdog(&tcp->set, i, timeout);
 		rcu_read_unlock();
 	}
 
-	return ret;
+	/* Continue with the queries received meanwhile. */
+	if (blocked && !tcp_conn_blocked(conn)) {
+		return tcp_event_serve(tcp, i, false);
+	}
+
+	tcp_conn_set_events(tcp, i, conn);
+
+	return KNOT_EOK;
 }
 
 static int tcp_wait_for_events(tcp_context_t *tcp)
 {
 	/* Wait for events. */
 	fdset_t *set = &tcp->set;
-	int nfds = poll(set->pfd, set->n, TCP_SWEEP_INTERVAL * 1000);
+	fdset_it_t it;
+	int nfds = fdset_wait(set, &it, TCP_SWEEP_INTERVAL * 1000);
 
 	/* Mark the time of last poll call. */
 	tcp->last_poll_time = time_now();
@@ -261,41 +546,49 @@ static int tcp_wait_for_events(tcp_context_t *tcp)
 	}
 
 	/* Process events. */
-	unsigned i = 0;
-	while (nfds > 0 && i < set->n) {
+	for (; !fdset_it_done(&it); fdset_it_next(&it)) {
 		bool should_close = false;
-		int fd = set->pfd[i].fd;
-		if (set->pfd[i].revents & (POLLERR|POLLHUP|POLLNVAL)) {
+		unsigned i = it.idx;
+		int fd = fdset_get_fd(set, i);
+		unsigned events = fdset_it_events(&it);
+		if (events & (POLLERR|POLLHUP|POLLNVAL)) {
 			should_close = (i >= tcp->client_threshold);
-			--nfds;
-		} else if (set->pfd[i].revents & (POLLIN)) {
+		} else if (i < tcp->client_threshold) {
 			/* Master sockets */
-			if (i < tcp->client_threshold) {
-				if (!is_throttled && tcp_event_accept(tcp, i) == KNOT_EBUSY) {
-					tcp->throttle_end = time_now();
-					tcp->throttle_end.tv_sec += tcp_throttle();
-				}
+			if ((events & POLLIN) && !is_throttled &&
+			    tcp_event_accept(tcp, i) == KNOT_EBUSY) {
+				tcp->throttle_end = time_now();
+				tcp->throttle_end.tv_sec += tcp_throttle();
+			}
+		} else {
 			/* Client sockets */
-			} else {
-				if (tcp_event_serve(tcp, i) != KNOT_EOK) {
-					should_close = true;
-				}
+			if ((events & POLLOUT) && tcp_event_send(tcp, i) != KNOT_EOK) {
+				should_close = true;
+			} else if ((events & POLLIN) && tcp_event_serve(tcp, i, true) != KNOT_EOK) {
+				should_close = true;
 			}
-			--nfds;
 		}
 
 		/* Evaluate */
 		if (should_close) {
-			fdset_remove(set, i);
+			tcp_conn_free(set->ctx[i]);
+			fdset_it_remove(&it);
 			close(fd);
-		} else {
-			++i;
 		}
 	}
 
 	return nfds;
 }
 
+/*! \brief Close all client connections. */
+static void tcp_close_clients(tcp_context_t *tcp)
+{
+	for (unsigned i = tcp->client_threshold; i < tcp->set.n; ++i) {
+		tcp_conn_free(tcp->set.ctx[i]);
+		close(fdset_get_fd(&tcp->set, i));
+	}
+}
+
 int tcp_master(dthread_t *thread)
 {
 	if (!thread || !thread->data) {
@@ -310,14 +603,9 @@ int tcp_master(dthread_t *thread)
 	tcp_context_t tcp;
 	memset(&tcp, 0, sizeof(tcp_context_t));
 
-	/* Create big enough memory cushion. */
-	knot_mm_t mm = { 0 };
-	mm_ctx_mempool(&mm, 16 * MM_DEFAULT_BLKSIZE);
-
 	/* Create TCP answering context. */
 	tcp.server = handler->server;
 	tcp.thread_id = handler->thread_id[dt_get_id(thread)];
-	knot_layer_init(&tcp.layer, &mm, process_query_layer());
 
 	/* Prepare structures for bound sockets. */
 	conf_val_t val = conf_get(conf(), C_SRV, C_LISTEN);
@@ -325,7 +613,7 @@ int tcp_master(dthread_t *thread)
 
 	/* Create iovec abstraction. */
 	for (unsigned i = 0; i < 2; ++i) {
-		tcp.iov[i].iov_len = KNOT_WIRE_MAX_PKTSIZE;
+		tcp.iov[i].iov_len = (i == 0) ? TCP_RX_SIZE : KNOT_WIRE_MAX_PKTSIZE;
 		tcp.iov[i].iov_base = malloc(tcp.iov[i].iov_len);
 		if (tcp.iov[i].iov_base == NULL) {
 			ret = KNOT_ENOMEM;
@@ -344,9 +632,7 @@ int tcp_master(dthread_t *thread)
 			*iostate &= ~ServerReload;
 
 			/* Cancel client connections. */
-			for (unsigned i = tcp.client_threshold; i < tcp.set.n; ++i) {
-				close(tcp.set.pfd[i].fd);
-			}
+			tcp_close_clients(&tcp);
 
 			ref_release(ref);
 			ref = server_set_ifaces(handler->server, &tcp.set, IO_TCP, tcp.thread_id);
@@ -376,7 +662,7 @@ int tcp_master(dthread_t *thread)
 finish:
 	free(tcp.iov[0].iov_base);
 	free(tcp.iov[1].iov_base);
-	mp_delete(mm.ctx);
+	tcp_close_clients(&tcp);
 	fdset_clear(&tcp.set);
 	ref_release(ref);
 
@@ -362,59 +362,6 @@ void __attribute__ ((constructor)) udp_master_init(void)
 #endif /* ENABLE_RECVMMSG */
 }
 
-/*! \brief Get interface UDP descriptor for a given thread. */
-static int iface_udp_fd(const iface_t *iface, int thread_id)
-{
-#ifdef ENABLE_REUSEPORT
-		return iface->fd_udp[thread_id % iface->fd_udp_count];
-#else
-		return iface->fd_udp[0];
-#endif
-}
-
-/*! \brief Release the interface list reference and free watched descriptor set. */
-static void forget_ifaces(ifacelist_t *ifaces, struct pollfd **fds_ptr)
-{
-	ref_release((ref_t *)ifaces);
-	free(*fds_ptr);
-	*fds_ptr = NULL;
-}
-
-/*!
- * \brief Make a set of watched descriptors based on the interface list.
- *
- * \param[in]   ifaces  New interface list.
- * \param[in]   thrid   Thread ID.
- * \param[out]  fds_ptr Allocated set of descriptors.
- *
- * \return Number of watched descriptors, zero on error.
- */
-static nfds_t track_ifaces(const ifacelist_t *ifaces, int thrid,
-                           struct pollfd **fds_ptr)
-{
-	assert(ifaces && fds_ptr);
-
-	nfds_t nfds = list_size(&ifaces->l);
-	struct pollfd *fds = malloc(nfds * sizeof(*fds));
-	if (!fds) {
-		*fds_ptr = NULL;
-		return 0;
-	}
-
-	iface_t *iface = NULL;
-	int i = 0;
-	WALK_LIST(iface, ifaces->l) {
-		fds[i].fd = iface_udp_fd(iface, thrid);
-		fds[i].events = POLLIN;
-		fds[i].revents = 0;
-		i += 1;
-	}
-	assert(i == nfds);
-
-	*fds_ptr = fds;
-	return nfds;
-}
-
 int udp_master(dthread_t *thread)
 {
 	unsigned cpu = dt_online_cpus();
@@ -428,7 +375,7 @@ int udp_master(dthread_t *thread)
 	iohandler_t *handler = (iohandler_t *)thread->data;
 	unsigned *iostate = &handler->thread_state[thr_id];
 	void *rq = _udp_init();
-	ifacelist_t *ref = NULL;
+	ref_t *ref = NULL;
 
 	/* Create big enough memory cushion. */
 	knot_mm_t mm;
@@ -442,8 +389,10 @@ int udp_master(dthread_t *thread)
 	knot_layer_init(&udp.layer, &mm, process_query_layer());
 
 	/* Event source. */
-	struct pollfd *fds = NULL;
-	nfds_t nfds = 0;
+	fdset_t fds;
+	if (fdset_init(&fds, FDSET_INIT_SIZE) != KNOT_EOK) {
+		goto finish;
+	}
 
 	/* Loop until all data is read. */
 	for (;;) {
@@ -453,12 +402,9 @@ int udp_master(dthread_t *thread)
 			*iostate &= ~ServerReload;
 			udp.thread_id = handler->thread_id[thr_id];
 
-			rcu_read_lock();
-			forget_ifaces(ref, &fds);
-			ref = handler->server->ifaces;
-			nfds = track_ifaces(ref, udp.thread_id, &fds);
-			rcu_read_unlock();
-			if (nfds == 0) {
+			ref_release(ref);
+			ref = server_set_ifaces(handler->server, &fds, IO_UDP, udp.thread_id);
+			if (fds.n == 0) {
 				break;
 			}
 		}
@@ -469,20 +415,17 @@ int udp_master(dthread_t *thread)
 		}
 
 		/* Wait for events. */
-		int events = poll(fds, nfds, -1);
+		fdset_it_t it;
+		int events = fdset_wait(&fds, &it, -1);
 		if (events <= 0) {
 			if (errno == EINTR) continue;
 			break;
 		}
 
 		/* Process the events. */
-		for (nfds_t i = 0; i < nfds && events > 0; i++) {
-			if (fds[i].revents == 0) {
-				continue;
-			}
-			events -= 1;
+		for (; !fdset_it_done(&it); fdset_it_next(&it)) {
 			int rcvd = 0;
-			if ((rcvd = _udp_recv(fds[i].fd, rq)) > 0) {
+			if ((rcvd = _udp_recv(fdset_get_fd(&fds, it.idx), rq)) > 0) {
 				_udp_handle(&udp, rq);
 				/* Flush allocated memory. */
 				mp_flush(mm.ctx);
@@ -491,8 +434,10 @@ int udp_master(dthread_t *thread)
 		}
 	}
 
+finish:
 	_udp_deinit(rq);
-	forget_ifaces(ref, &fds);
+	fdset_clear(&fds);
+	ref_release(ref);
 	mp_delete(mm.ctx);
 	return KNOT_EOK;
 }
@@ -14,7 +14,12 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "knot/updates/acl.h"
+#include "contrib/qp-trie/trie.h"
+#include "contrib/sockaddr.h"
 
 bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
                  const struct sockaddr_storage *addr, knot_tsig_key_t *tsig)
@@ -102,3 +107,412 @@ next_acl:
 
 	return false;
 }
+
+/*! \brief Sorted list of rule indices. */
+typedef struct {
+	uint32_t *idx;
+	size_t count;
+} rule_list_t;
+
+/*! \brief Compiled ACL rule. */
+typedef struct {
+	unsigned actions; /*!< Bitmask of (1 << acl_action_t). */
+	bool deny;
+	bool keys;        /*!< Rule has a key list. */
+} acl_rule_t;
+
+/*! \brief TSIG key with rules it's listed in. */
+typedef struct {
+	knot_tsig_key_t key;
+	rule_list_t rules;
+} acl_key_t;
+
+/*! \brief Binary address prefix trie node. */
+typedef struct acl_node {
+	struct acl_node *child[2];
+	rule_list_t rules; /*!< Rules with a prefix ending in this node. */
+} acl_node_t;
+
+struct acl {
+	acl_rule_t *rules;
+	size_t count;
+	rule_list_t any;   /*!< Rules without an address list. */
+	acl_node_t *ipv4;
+	acl_node_t *ipv6;
+	trie_t *keys;      /*!< Key name -> acl_key_t. */
+};
+
+static int list_add(rule_list_t *list, uint32_t idx)
+{
+	/* Rules are added in order, skip duplicates. */
+	if (list->count > 0 && list->idx[list->count - 1] == idx) {
+		return KNOT_EOK;
+	}
+
+	/* Grow to the next power of two. */
+	if ((list->count & (list->count - 1)) == 0) {
+		size_t size = (list->count == 0) ? 1 : 2 * list->count;
+		uint32_t *idx_new = realloc(list->idx, size * sizeof(*idx_new));
+		if (idx_new == NULL) {
+			return KNOT_ENOMEM;
+		}
+		list->idx = idx_new;
+	}
+
+	list->idx[list->count++] = idx;
+
+	return KNOT_EOK;
+}
+
+static bool list_contains(const rule_list_t *list, uint32_t idx)
+{
+	size_t lo = 0, hi = list->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (list->idx[mid] < idx) {
+			lo = mid + 1;
+		} else if (list->idx[mid] > idx) {
+			hi = mid;
+		} else {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static unsigned addr_bit(const uint8_t *addr, unsigned pos)
+{
+	return (addr[pos / 8] >> (7 - pos % 8)) & 1;
+}
+
+static int prefix_add(acl_node_t **root, const uint8_t *addr, unsigned prefix,
+                      uint32_t idx)
+{
+	acl_node_t **node = root;
+	for (unsigned pos = 0; ; pos++) {
+		if (*node == NULL) {
+			*node = calloc(1, sizeof(**node));
+			if (*node == NULL) {
+				return KNOT_ENOMEM;
+			}
+		}
+		if (pos == prefix) {
+			return list_add(&(*node)->rules, idx);
+		}
+		node = &(*node)->child[addr_bit(addr, pos)];
+	}
+}
+
+/*! \brief Adds the address range split into covering prefixes. */
+static int range_add(acl_node_t **root, const uint8_t *min, const uint8_t *max,
+                     size_t len, uint32_t idx)
+{
+	const unsigned bits = len * 8;
+	uint8_t addr[16], end[16];
+	memcpy(addr, min, len);
+
+	while (memcmp(addr, max, len) <= 0) {
+		/* Find the largest aligned block starting at addr within the range. */
+		unsigned host = 0;
+		memcpy(end, addr, len);
+		while (host < bits) {
+			uint8_t *byte = &end[len - 1 - host / 8];
+			uint8_t mask = 1 << (host % 8);
+			if (*byte & mask) {
+				break;
+			}
+			*byte |= mask;
+			if (memcmp(end, max, len) > 0) {
+				*byte &= ~mask;
+				break;
+			}
+			host++;
+		}
+
+		int ret = prefix_add(root, addr, bits - host, idx);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+
+		/* Continue after the block end, stop on overflow. */
+		memcpy(addr, end, len);
+		int i = len - 1;
+		while (i >= 0 && ++addr[i] == 0) {
+			i--;
+		}
+		if (i < 0) {
+			break;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int addr_add(acl_t *acl, conf_val_t *val, uint32_t idx)
+{
+	int prefix;
+	struct sockaddr_storage max;
+	struct sockaddr_storage min = conf_addr_range(val, &max, &prefix);
+
+	acl_node_t **root;
+	switch (min.ss_family) {
+	case AF_INET:
+		root = &acl->ipv4;
+		break;
+	case AF_INET6:
+		root = &acl->ipv6;
+		break;
+	default:
+		return KNOT_EOK;
+	}
+
+	size_t len = 0;
+	const uint8_t *min_raw = sockaddr_raw((struct sockaddr *)&min, &len);
+
+	if (max.ss_family == AF_UNSPEC) {
+		unsigned bits = len * 8;
+		if (prefix < 0 || prefix > bits) {
+			prefix = bits;
+		}
+		return prefix_add(root, min_raw, prefix, idx);
+	} else if (max.ss_family == min.ss_family) {
+		const uint8_t *max_raw = sockaddr_raw((struct sockaddr *)&max, &len);
+		return range_add(root, min_raw, max_raw, len, idx);
+	}
+
+	return KNOT_EOK;
+}
+
+static int key_add(acl_t *acl, conf_t *conf, conf_val_t *val, uint32_t idx)
+{
+	const knot_dname_t *name = conf_dname(val);
+	trie_val_t *slot = trie_get_ins(acl->keys, (const char *)name,
+	                                knot_dname_size(name));
+	if (slot == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	acl_key_t *key = *slot;
+	if (key == NULL) {
+		key = calloc(1, sizeof(*key));
+		if (key == NULL) {
+			return KNOT_ENOMEM;
+		}
+		*slot = key;
+
+		conf_val_t alg_val = conf_id_get(conf, C_KEY, C_ALG, val);
+		conf_val_t secret_val = conf_id_get(conf, C_KEY, C_SECRET, val);
+		knot_tsig_key_t conf_key = {
+			.algorithm = conf_opt(&alg_val),
+			.name = (knot_dname_t *)name
+		};
+		conf_key.secret.data = (uint8_t *)conf_bin(&secret_val,
+		                                           &conf_key.secret.size);
+
+		int ret = knot_tsig_key_copy(&key->key, &conf_key);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return list_add(&key->rules, idx);
+}
+
+static int rule_add(acl_t *acl, conf_t *conf, conf_val_t *id, uint32_t idx)
+{
+	acl_rule_t *rule = &acl->rules[idx];
+
+	conf_val_t val = conf_id_get(conf, C_ACL, C_ADDR, id);
+	if (val.code != KNOT_EOK) {
+		int ret = list_add(&acl->any, idx);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+	while (val.code == KNOT_EOK) {
+		int ret = addr_add(acl, &val, idx);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		conf_val_next(&val);
+	}
+
+	val = conf_id_get(conf, C_ACL, C_KEY, id);
+	rule->keys = (val.code == KNOT_EOK);
+	while (val.code == KNOT_EOK) {
+		int ret = key_add(acl, conf, &val, idx);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		conf_val_next(&val);
+	}
+
+	val = conf_id_get(conf, C_ACL, C_ACTION, id);
+	while (val.code == KNOT_EOK) {
+		rule->actions |= 1 << conf_opt(&val);
+		conf_val_next(&val);
+	}
+
+	val = conf_id_get(conf, C_ACL, C_DENY, id);
+	rule->deny = conf_bool(&val);
+
+	return KNOT_EOK;
+}
+
+acl_t *acl_new(conf_t *conf, conf_val_t *acl)
+{
+	if (conf == NULL || acl == NULL) {
+		return NULL;
+	}
+
+	acl_t *out = calloc(1, sizeof(*out));
+	if (out == NULL) {
+		return NULL;
+	}
+
+	out->keys = trie_create(NULL);
+	size_t count = conf_val_count(acl);
+	if (count > 0) {
+		out->rules = calloc(count, sizeof(*out->rules));
+	}
+	if (out->keys == NULL || (count > 0 && out->rules == NULL)) {
+		acl_free(out);
+		return NULL;
+	}
+
+	while (acl->code == KNOT_EOK) {
+		if (rule_add(out, conf, acl, out->count++) != KNOT_EOK) {
+			acl_free(out);
+			return NULL;
+		}
+		conf_val_next(acl);
+	}
+
+	return out;
+}
+
+static void node_free(acl_node_t *node)
+{
+	if (node == NULL) {
+		return;
+	}
+
+	node_free(node->child[0]);
+	node_free(node->child[1]);
+	free(node->rules.idx);
+	free(node);
+}
+
+static int key_free(trie_val_t *val, void *ctx)
+{
+	acl_key_t *key = *val;
+	if (key != NULL) {
+		knot_tsig_key_deinit(&key->key);
+		free(key->rules.idx);
+		free(key);
+	}
+
+	return KNOT_EOK;
+}
+
+void acl_free(acl_t *acl)
+{
+	if (acl == NULL) {
+		return;
+	}
+
+	if (acl->keys != NULL) {
+		trie_apply(acl->keys, key_free, NULL);
+		trie_free(acl->keys);
+	}
+	node_free(acl->ipv4);
+	node_free(acl->ipv6);
+	free(acl->any.idx);
+	free(acl->rules);
+	free(acl);
+}
+
+/*! \brief Finds the first rule in the list matching the key and the action. */
+static void list_match(const acl_t *acl, const rule_list_t *list,
+                       acl_action_t action, const acl_key_t *key,
+                       uint32_t *first)
+{
+	for (size_t i = 0; i < list->count && list->idx[i] < *first; i++) {
+		uint32_t idx = list->idx[i];
+		const acl_rule_t *rule = &acl->rules[idx];
+
+		/* Check for key match or empty list without key provided. */
+		if (key != NULL ? !list_contains(&key->rules, idx) : rule->keys) {
+			continue;
+		}
+
+		/* Check if the action is allowed, empty list decides (deny only). */
+		if (action != ACL_ACTION_NONE && rule->actions != 0 &&
+		    !(rule->actions & (1 << action))) {
+			continue;
+		}
+
+		*first = idx;
+		return;
+	}
+}
+
+bool acl_match(const acl_t *acl, acl_action_t action,
+               const struct sockaddr_storage *addr, knot_tsig_key_t *tsig)
+{
+	if (acl == NULL || addr == NULL || tsig == NULL) {
+		return false;
+	}
+
+	/* Find the provided key, an unknown key can't match any rule. */
+	const acl_key_t *key = NULL;
+	if (tsig->name != NULL) {
+		trie_val_t *val = trie_get_try(acl->keys, (const char *)tsig->name,
+		                               knot_dname_size(tsig->name));
+		if (val == NULL) {
+			return false;
+		}
+		key = *val;
+		if (key->key.algorithm != tsig->algorithm) {
+			return false;
+		}
+	}
+
+	/* Find the first matching rule along the address prefix path. */
+	uint32_t first = acl->count;
+	list_match(acl, &acl->any, action, key, &first);
+
+	const acl_node_t *node = NULL;
+	unsigned bits = 0;
+	size_t len = 0;
+	const uint8_t *raw = sockaddr_raw((struct sockaddr *)addr, &len);
+	if (addr->ss_family == AF_INET) {
+		node = acl->ipv4;
+		bits = len * 8;
+	} else if (addr->ss_family == AF_INET6) {
+		node = acl->ipv6;
+		bits = len * 8;
+	}
+	for (unsigned pos = 0; node != NULL; pos++) {
+		list_match(acl, &node->rules, action, key, &first);
+		node = (pos < bits) ? node->child[addr_bit(raw, pos)] : NULL;
+	}
+
+	if (first == acl->count) {
+		return false;
+	}
+
+	/* Check if denied. */
+	const acl_rule_t *rule = &acl->rules[first];
+	if ((action != ACL_ACTION_NONE && rule->actions == 0) || rule->deny) {
+		return false;
+	}
+
+	/* Fill the output with tsig secret if provided. */
+	if (key != NULL) {
+		tsig->secret = key->key.secret;
+	}
+
+	return true;
+}
@@ -54,4 +54,45 @@ typedef enum {
 bool acl_allowed(conf_t *conf, conf_val_t *acl, acl_action_t action,
                  const struct sockaddr_storage *addr, knot_tsig_key_t *tsig);
 
+/*!
+ * \brief ACL list compiled from the configuration.
+ *
+ * Address ranges are stored in a binary prefix trie per address family and
+ * TSIG keys are indexed by name, so the evaluation cost doesn't depend on
+ * the number of rules. Holds copies of all the needed data, so it doesn't
+ * depend on the configuration database it was created from.
+ */
+typedef struct acl acl_t;
+
+/*!
+ * \brief Compiles an ACL list from the configuration.
+ *
+ * \param conf  Configuration.
+ * \param acl   Pointer to ACL config multivalued identifier.
+ *
+ * \return Compiled ACL list or NULL if out of memory.
+ */
+acl_t *acl_new(conf_t *conf, conf_val_t *acl);
+
+/*!
+ * \brief Frees the compiled ACL list.
+ */
+void acl_free(acl_t *acl);
+
+/*!
+ * \brief Checks if the address and/or tsig key matches the compiled ACL list.
+ *
+ * Same semantics as \ref acl_allowed. The filled tsig.secret points to the
+ * ACL memory and is valid as long as the ACL list.
+ *
+ * \param acl     Compiled ACL list.
+ * \param action  ACL action.
+ * \param addr    IP address.
+ * \param tsig    TSIG parameters.
+ *
+ * \retval True if authenticated.
+ */
+bool acl_match(const acl_t *acl, acl_action_t action,
+               const struct sockaddr_storage *addr, knot_tsig_key_t *tsig);
+
 /*! @} */
@@ -40,20 +40,6 @@ static void rrs_list_clear(list_t *l, knot_mm_t *mm)
 	};
 }
 
-/*! \brief Frees additional data from single node */
-static int free_additional(zone_node_t **node, void *data)
-{
-	UNUSED(data);
-
-	for (uint16_t i = 0; i < (*node)->rrset_count; ++i) {
-		struct rr_data *data = &(*node)->rrs[i];
-		additional_clear(data->additional);
-		data->additional = NULL;
-	}
-
-	return KNOT_EOK;
-}
-
 /* -------------------- Changeset application helpers ----------------------- */
 
 /*! \brief Replaces rdataset of given type with a copy. */
@@ -233,15 +219,16 @@ int apply_prepare_zone_copy(zone_contents_t *old_contents,
 	}
 
 	/*
-	 * Create a shallow copy of the zone, so that the structures may be
+	 * Create a lazy copy of the zone, so that the structures may be
 	 * updated.
 	 *
 	 * This will create new zone contents structures (normal nodes' tree,
-	 * NSEC3 tree), and copy all nodes.
+	 * NSEC3 tree) sharing the nodes with the old contents. The nodes are
+	 * copied once they are modified.
 	 * The data in the nodes (RRSets) remain the same though.
 	 */
 	zone_contents_t *contents_copy = NULL;
-	int ret = zone_contents_shallow_copy(old_contents, &contents_copy);
+	int ret = zone_contents_cow(old_contents, &contents_copy);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -265,13 +252,14 @@ int apply_add_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 	if (!knot_rrset_empty(&changed_rrset)) {
 		// Modifying existing RRSet.
 		knot_rdata_t *old_data = changed_rrset.rrs.data;
+		bool embedded = node_rdataset_embedded(node, &changed_rrset.rrs);
 		int ret = replace_rdataset_with_copy(node, rr->type);
 		if (ret != KNOT_EOK) {
 			return ret;
 		}
 
-		// Store old RRS for cleanup.
-		ret = add_old_data(ctx, old_data);
+		// Store old RRS for cleanup, embedded ones go with the node.
+		ret = embedded ? KNOT_EOK : add_old_data(ctx, old_data);
 		if (ret != KNOT_EOK) {
 			clear_new_rrs(node, rr->type);
 			return ret;
@@ -279,7 +267,7 @@ int apply_add_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 	}
 
 	// Insert new RR to RRSet, data will be copied.
-	int ret = node_add_rrset(node, rr, NULL);
+	int ret = node_add_rrset(node, rr, &contents->mm);
 	if (ret == KNOT_EOK || ret == KNOT_ETTL) {
 		// RR added, store for possible rollback.
 		knot_rdataset_t *rrs = node_rdataset(node, rr->type);
@@ -322,18 +310,25 @@ int apply_remove_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 		return KNOT_EOK;
 	}
 
+	// Get a private copy of the node.
+	node = zone_contents_get_node_for_rr(contents, rr);
+	if (node == NULL) {
+		return KNOT_ENOMEM;
+	}
+
 	zone_tree_t *tree = knot_rrset_is_nsec3rel(rr) ?
 	                    contents->nsec3_nodes : contents->nodes;
 
 	knot_rrset_t removed_rrset = node_rrset(node, rr->type);
 	knot_rdata_t *old_data = removed_rrset.rrs.data;
+	bool embedded = node_rdataset_embedded(node, &removed_rrset.rrs);
 	int ret = replace_rdataset_with_copy(node, rr->type);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
 
-	// Store old data for cleanup.
-	ret = add_old_data(ctx, old_data);
+	// Store old data for cleanup, embedded ones go with the node.
+	ret = embedded ? KNOT_EOK : add_old_data(ctx, old_data);
 	if (ret != KNOT_EOK) {
 		clear_new_rrs(node, rr->type);
 		return ret;
@@ -359,7 +354,7 @@ int apply_remove_rr(apply_ctx_t *ctx, const knot_rrset_t *rr)
 		node_remove_rdataset(node, rr->type);
 		// If node is empty now, delete it from zone tree.
 		if (node->rrset_count == 0 && node != contents->apex) {
-			zone_tree_delete_empty(tree, node);
+			return zone_contents_delete_empty_node(contents, tree, node);
 		}
 	}
 
@@ -390,6 +385,12 @@ int apply_replace_soa(apply_ctx_t *ctx, const changeset_t *chset)
 
 int apply_prepare_to_sign(apply_ctx_t *ctx)
 {
+	// Signing modifies the nodes in place.
+	int ret = zone_contents_unshare(ctx->contents);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	return zone_contents_adjust_pointers(ctx->contents);
 }
 
@@ -470,12 +471,6 @@ void update_free_zone(zone_contents_t **contents)
 		return;
 	}
 
-	(void)zone_tree_apply((*contents)->nodes, free_additional, NULL);
-	zone_tree_deep_free(&(*contents)->nodes);
-	zone_tree_deep_free(&(*contents)->nsec3_nodes);
-
-	dnssec_nsec3_params_free(&(*contents)->nsec3_params);
-
-	free(*contents);
-	*contents = NULL;
+	zone_contents_clear_additionals(*contents);
+	zone_contents_free(contents);
 }
@@ -630,41 +630,63 @@ static int commit_full(conf_t *conf, zone_update_t *update, zone_contents_t **co
 	return KNOT_EOK;
 }
 
-/*! \brief Routine for calling call_rcu() easier way.
- *
- * Consider moving elsewhere, as it has no direct relation to zone-update.
- */
+static void release_deep_copied(zone_contents_t *contents, void *a_ctx)
+{
+	zone_contents_deep_free(&contents);
+	update_cleanup(a_ctx);
+	free(a_ctx);
+}
+
+static void release_shallow_copied(zone_contents_t *contents, void *a_ctx)
+{
+	update_free_zone(&contents);
+	update_cleanup(a_ctx);
+	free(a_ctx);
+}
+
+/*! \brief Replaced zone contents and the RR data freed by the update. */
 typedef struct {
 	struct rcu_head rcuhead;
-	void (*callback)(void *);
-	void *ctx;
-	bool call_ctx_addr;
-} callrcu_wrapper_t;
+	zone_contents_t *contents;
+	zone_contents_release_cb_t release;
+	apply_ctx_t *a_ctx;
+} retired_contents_t;
 
-static void callrcu_wrapper_cb(struct rcu_head *param)
+static void retired_contents_cb(struct rcu_head *param)
 {
-	callrcu_wrapper_t *wrap = (callrcu_wrapper_t *)param;
-	if (wrap->call_ctx_addr) {
-		// Paradigm free_fun(type_t **t) freeing the pointer completely.
-		wrap->callback(&wrap->ctx);
+	retired_contents_t *retired = (retired_contents_t *)param;
+
+	/* Outgoing transfers may still hold a snapshot of the contents. */
+	if (retired->contents != NULL) {
+		zone_contents_retire(retired->contents, retired->release, retired->a_ctx);
 	} else {
-		// Paradigm clear_fun(type_t *t) just clearing the contents of type_t.
-		wrap->callback(wrap->ctx);
-		free(wrap->ctx);
+		retired->release(NULL, retired->a_ctx);
 	}
-	free(wrap);
+	free(retired);
 }
 
-/* NOTE: Does nothing if not enough memory. */
-static void callrcu_wrapper(void *ctx, void (*callback)(void *), bool call_ctx_addr)
+static void retire_contents(zone_contents_t *contents, apply_ctx_t *a_ctx,
+                            bool deep_copied)
 {
-	callrcu_wrapper_t *wrap = calloc(1, sizeof(callrcu_wrapper_t));
-	if (wrap != NULL) {
-		wrap->callback = callback;
-		wrap->ctx = ctx;
-		wrap->call_ctx_addr = call_ctx_addr;
-		call_rcu((struct rcu_head *)wrap, callrcu_wrapper_cb);
+	zone_contents_release_cb_t release = deep_copied ? release_deep_copied :
+	                                                   release_shallow_copied;
+
+	retired_contents_t *retired = malloc(sizeof(*retired));
+	if (retired == NULL) {
+		/* Release synchronously rather than leaking the version chain. */
+		synchronize_rcu();
+		if (contents != NULL) {
+			zone_contents_retire(contents, release, a_ctx);
+		} else {
+			release(NULL, a_ctx);
+		}
+		return;
 	}
+
+	retired->contents = contents;
+	retired->release = release;
+	retired->a_ctx = a_ctx;
+	call_rcu((struct rcu_head *)retired, retired_contents_cb);
 }
 
 int zone_update_commit(conf_t *conf, zone_update_t *update)
@@ -702,19 +724,13 @@ int zone_update_commit(conf_t *conf, zone_update_t *update)
 	zone_contents_t *old_contents;
 	old_contents = zone_switch_contents(update->zone, new_contents);
 
-	/* Sync RCU. */
+	/* Sync RCU, release old contents once no longer referenced. */
 	if (update->flags & UPDATE_FULL) {
 		assert(update->new_cont_deep_copy);
-		callrcu_wrapper(old_contents, (void (*)(void *))zone_contents_deep_free, true);
 	} else if (update->flags & UPDATE_INCREMENTAL) {
-		if (update->new_cont_deep_copy) {
-			callrcu_wrapper(old_contents, (void (*)(void *))zone_contents_deep_free, true);
-		} else {
-			callrcu_wrapper(old_contents, (void (*)(void *))update_free_zone, true);
-		}
 		changeset_clear(&update->change);
 	}
-	callrcu_wrapper(update->a_ctx, (void (*)(void *))update_cleanup, false);
+	retire_contents(old_contents, update->a_ctx, update->new_cont_deep_copy);
 	update->a_ctx = NULL;
 	update->new_cont = NULL;
 
@@ -24,26 +24,145 @@
 #include "knot/server/dthreads.h"
 #include "knot/worker/pool.h"
 
+/*!
+ * \brief Worker state.
+ */
+typedef struct worker {
+	struct worker_pool *pool;
+
+	pthread_mutex_t lock;	/*!< Task queue lock. */
+	worker_queue_t tasks;	/*!< Tasks assigned to this worker. */
+
+	pthread_cond_t wake;	/*!< Wakeup of the sleeping worker. */
+	bool sleeping;		/*!< Is the worker waiting for a task? (pool lock) */
+} worker_t;
+
 /*!
  * \brief Worker pool state.
+ *
+ * Each worker has its own task queue. The tasks assigned by a worker go to
+ * its own queue, other tasks are distributed round-robin. An idle worker
+ * steals the tasks from the other queues, always taking the task of the
+ * highest priority class available. Only one sleeping worker is woken up
+ * for a new task.
  */
 struct worker_pool {
 	dt_unit_t *threads;
 
-	pthread_mutex_t lock;
-	pthread_cond_t wake;
+	pthread_mutex_t lock;	/*!< Protects the sleeping workers and the flags. */
+	pthread_cond_t done;	/*!< No pending tasks. */
 
 	bool terminating;	/*!< Is the pool terminating? .*/
 	bool suspended;		/*!< Is execution temporarily suspended? .*/
-	int running;		/*!< Number of running threads. */
-	worker_queue_t tasks;
+	unsigned sleeping;	/*!< Number of sleeping workers (atomic). */
+	unsigned queued;	/*!< Number of queued tasks (atomic). */
+	unsigned pending;	/*!< Number of queued and running tasks (atomic). */
+	unsigned next;		/*!< Next queue for a task from outside (atomic). */
+
+	unsigned count;		/*!< Number of workers. */
+	worker_t workers[];
 };
 
+/*! \brief Worker of the calling thread. */
+static __thread worker_t *current_worker = NULL;
+
+static bool pool_flag(const bool *flag)
+{
+	return __atomic_load_n(flag, __ATOMIC_SEQ_CST);
+}
+
+static void task_done(worker_pool_t *pool, unsigned count)
+{
+	if (__atomic_sub_fetch(&pool->pending, count, __ATOMIC_SEQ_CST) == 0) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_broadcast(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+/*!
+ * \brief Take a task from the worker queue.
+ */
+static task_t *worker_dequeue(worker_t *worker, task_prio_t prio)
+{
+	if (worker_queue_count(&worker->tasks, prio) == 0) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&worker->lock);
+	task_t *task = worker_queue_dequeue_prio(&worker->tasks, prio);
+	if (task != NULL) {
+		__atomic_store_n(&task->queued, false, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	if (task != NULL) {
+		__atomic_sub_fetch(&worker->pool->queued, 1, __ATOMIC_SEQ_CST);
+	}
+
+	return task;
+}
+
+/*!
+ * \brief Take the task of the highest priority, the own queue is preferred.
+ */
+static task_t *worker_take(worker_t *self)
+{
+	worker_pool_t *pool = self->pool;
+	unsigned id = self - pool->workers;
+
+	for (task_prio_t prio = 0; prio < TASK_PRIO_COUNT; prio++) {
+		for (unsigned i = 0; i < pool->count; i++) {
+			worker_t *victim = &pool->workers[(id + i) % pool->count];
+			task_t *task = worker_dequeue(victim, prio);
+			if (task != NULL) {
+				return task;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*!
+ * \brief Wake up one sleeping worker, the preferred one if possible.
+ *
+ * \note Pool lock must be held.
+ */
+static void wake_one(worker_pool_t *pool, worker_t *preferred)
+{
+	worker_t *worker = preferred->sleeping ? preferred : NULL;
+	for (unsigned i = 0; worker == NULL && i < pool->count; i++) {
+		if (pool->workers[i].sleeping) {
+			worker = &pool->workers[i];
+		}
+	}
+
+	if (worker != NULL) {
+		worker->sleeping = false;
+		__atomic_sub_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+		pthread_cond_signal(&worker->wake);
+	}
+}
+
+/*!
+ * \brief Wake up all sleeping workers.
+ *
+ * \note Pool lock must be held.
+ */
+static void wake_all(worker_pool_t *pool)
+{
+	for (unsigned i = 0; i < pool->count; i++) {
+		wake_one(pool, &pool->workers[i]);
+	}
+}
+
 /*!
  * \brief Worker thread.
  *
- * The thread takes a task from the tasks queue and runs it, while checking
- * if the dispatching of new tasks is allowed by the thread pool.
+ * The thread takes a task from its own queue or steals one from the other
+ * workers and runs it, while checking if the dispatching of new tasks is
+ * allowed by the thread pool.
  *
  * An execution of a running thread cannot be enforced.
  *
@@ -53,36 +172,46 @@ static int worker_main(dthread_t *thread)
 	assert(thread);
 
 	worker_pool_t *pool = thread->data;
-
-	pthread_mutex_lock(&pool->lock);
+	worker_t *self = &pool->workers[dt_get_id(thread)];
+	current_worker = self;
 
 	for (;;) {
-		if (pool->terminating) {
+		if (pool_flag(&pool->terminating)) {
 			break;
 		}
 
 		task_t *task = NULL;
-		if (!pool->suspended) {
-			task = worker_queue_dequeue(&pool->tasks);
+		if (!pool_flag(&pool->suspended)) {
+			task = worker_take(self);
 		}
 
-		if (task == NULL) {
-			pthread_cond_wait(&pool->wake, &pool->lock);
+		if (task != NULL) {
+			assert(task->run);
+			task->run(task);
+			task_done(pool, 1);
 			continue;
 		}
 
-		assert(task->run);
-		pool->running += 1;
-
-		pthread_mutex_unlock(&pool->lock);
-		task->run(task);
 		pthread_mutex_lock(&pool->lock);
-
-		pool->running -= 1;
-		pthread_cond_broadcast(&pool->wake);
+		if (!pool->terminating) {
+			self->sleeping = true;
+			__atomic_add_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+
+			/* Recheck after announcing the sleep, so no wakeup is lost. */
+			if (pool->suspended ||
+			    __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0) {
+				pthread_cond_wait(&self->wake, &pool->lock);
+			}
+
+			if (self->sleeping) {
+				self->sleeping = false;
+				__atomic_sub_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+			}
+		}
+		pthread_mutex_unlock(&pool->lock);
 	}
 
-	pthread_mutex_unlock(&pool->lock);
+	current_worker = NULL;
 
 	return KNOT_EOK;
 }
@@ -91,33 +220,34 @@ static int worker_main(dthread_t *thread)
 
 worker_pool_t *worker_pool_create(unsigned threads)
 {
-	worker_pool_t *pool = malloc(sizeof(worker_pool_t));
-	if (pool == NULL) {
+	if (threads == 0) {
 		return NULL;
 	}
 
-	memset(pool, 0, sizeof(worker_pool_t));
-	pool->threads = dt_create(threads, worker_main, NULL, pool);
-	if (pool->threads == NULL) {
-		goto fail;
+	worker_pool_t *pool = calloc(1, sizeof(worker_pool_t) + threads * sizeof(worker_t));
+	if (pool == NULL) {
+		return NULL;
 	}
 
-	if (pthread_mutex_init(&pool->lock, NULL) != 0) {
-		goto fail;
-	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->done, NULL);
 
-	if (pthread_cond_init(&pool->wake, NULL) != 0) {
-		goto fail;
+	pool->count = threads;
+	for (unsigned i = 0; i < threads; i++) {
+		worker_t *worker = &pool->workers[i];
+		worker->pool = pool;
+		pthread_mutex_init(&worker->lock, NULL);
+		pthread_cond_init(&worker->wake, NULL);
+		worker_queue_init(&worker->tasks);
 	}
 
-	worker_queue_init(&pool->tasks);
+	pool->threads = dt_create(threads, worker_main, NULL, pool);
+	if (pool->threads == NULL) {
+		worker_pool_destroy(pool);
+		return NULL;
+	}
 
 	return pool;
-
-fail:
-	dt_delete(&pool->threads);
-	free(pool);
-	return NULL;
 }
 
 void worker_pool_destroy(worker_pool_t *pool)
@@ -129,9 +259,14 @@ void worker_pool_destroy(worker_pool_t *pool)
 	dt_delete(&pool->threads);
 
 	pthread_mutex_destroy(&pool->lock);
-	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->done);
 
-	worker_queue_deinit(&pool->tasks);
+	for (unsigned i = 0; i < pool->count; i++) {
+		worker_t *worker = &pool->workers[i];
+		pthread_mutex_destroy(&worker->lock);
+		pthread_cond_destroy(&worker->wake);
+		worker_queue_deinit(&worker->tasks);
+	}
 
 	free(pool);
 }
@@ -152,8 +287,8 @@ void worker_pool_stop(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	pool->terminating = true;
-	pthread_cond_broadcast(&pool->wake);
+	__atomic_store_n(&pool->terminating, true, __ATOMIC_SEQ_CST);
+	wake_all(pool);
 	pthread_mutex_unlock(&pool->lock);
 
 	dt_stop(pool->threads);
@@ -166,7 +301,7 @@ void worker_pool_suspend(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	pool->suspended = true;
+	__atomic_store_n(&pool->suspended, true, __ATOMIC_SEQ_CST);
 	pthread_mutex_unlock(&pool->lock);
 }
 
@@ -177,8 +312,8 @@ void worker_pool_resume(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	pool->suspended = false;
-	pthread_cond_broadcast(&pool->wake);
+	__atomic_store_n(&pool->suspended, false, __ATOMIC_SEQ_CST);
+	wake_all(pool);
 	pthread_mutex_unlock(&pool->lock);
 }
 
@@ -198,8 +333,8 @@ void worker_pool_wait(worker_pool_t *pool)
 	}
 
 	pthread_mutex_lock(&pool->lock);
-	while (!EMPTY_LIST(pool->tasks.list) || pool->running > 0) {
-		pthread_cond_wait(&pool->wake, &pool->lock);
+	while (__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
 	}
 	pthread_mutex_unlock(&pool->lock);
 }
@@ -210,10 +345,29 @@ void worker_pool_assign(worker_pool_t *pool, struct task *task)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	worker_queue_enqueue(&pool->tasks, task);
-	pthread_cond_signal(&pool->wake);
-	pthread_mutex_unlock(&pool->lock);
+	/* The task is linked into the queue, it can't be queued twice. */
+	if (__atomic_exchange_n(&task->queued, true, __ATOMIC_ACQ_REL)) {
+		return;
+	}
+
+	worker_t *worker = current_worker;
+	if (worker == NULL || worker->pool != pool) {
+		unsigned next = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+		worker = &pool->workers[next % pool->count];
+	}
+
+	__atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+
+	pthread_mutex_lock(&worker->lock);
+	worker_queue_enqueue(&worker->tasks, task);
+	pthread_mutex_unlock(&worker->lock);
+
+	if (__atomic_load_n(&pool->sleeping, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&pool->lock);
+		wake_one(pool, worker);
+		pthread_mutex_unlock(&pool->lock);
+	}
 }
 
 void worker_pool_clear(worker_pool_t *pool)
@@ -222,8 +376,21 @@ void worker_pool_clear(worker_pool_t *pool)
 		return;
 	}
 
-	pthread_mutex_lock(&pool->lock);
-	worker_queue_deinit(&pool->tasks);
-	worker_queue_init(&pool->tasks);
-	pthread_mutex_unlock(&pool->lock);
+	unsigned cleared = 0;
+	for (unsigned i = 0; i < pool->count; i++) {
+		worker_t *worker = &pool->workers[i];
+
+		pthread_mutex_lock(&worker->lock);
+		task_t *task;
+		while ((task = worker_queue_dequeue(&worker->tasks)) != NULL) {
+			__atomic_store_n(&task->queued, false, __ATOMIC_RELEASE);
+			cleared++;
+		}
+		pthread_mutex_unlock(&worker->lock);
+	}
+
+	if (cleared > 0) {
+		__atomic_sub_fetch(&pool->queued, cleared, __ATOMIC_SEQ_CST);
+		task_done(pool, cleared);
+	}
 }
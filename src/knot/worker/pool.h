@@ -68,6 +68,9 @@ void worker_pool_wait(worker_pool_t *pool);
 
 /*!
  * \brief Assign a task to be performed by a worker in the pool.
+ *
+ * The task is queued by its priority class. A task already queued and not
+ * yet taken by a worker is not queued again.
  */
 void worker_pool_assign(worker_pool_t *pool, struct task *task);
 
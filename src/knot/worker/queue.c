@@ -14,8 +14,9 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+
 #include "knot/worker/queue.h"
-#include "contrib/mempattern.h"
 
 void worker_queue_init(worker_queue_t *queue)
 {
@@ -24,14 +25,11 @@ void worker_queue_init(worker_queue_t *queue)
 	}
 
 	memset(queue, 0, sizeof(worker_queue_t));
-
-	init_list(&queue->list);
-	mm_ctx_init(&queue->mm_ctx);
 }
 
 void worker_queue_deinit(worker_queue_t *queue)
 {
-	ptrlist_free(&queue->list, &queue->mm_ctx);
+	worker_queue_init(queue);
 }
 
 void worker_queue_enqueue(worker_queue_t *queue, task_t *task)
@@ -40,23 +38,50 @@ void worker_queue_enqueue(worker_queue_t *queue, task_t *task)
 		return;
 	}
 
-	ptrlist_add(&queue->list, task, &queue->mm_ctx);
+	task_prio_t prio = task->prio;
+	if (prio >= TASK_PRIO_COUNT) {
+		prio = TASK_PRIO_LOW;
+	}
+
+	task->next = NULL;
+	if (queue->tail[prio] != NULL) {
+		queue->tail[prio]->next = task;
+	} else {
+		queue->head[prio] = task;
+	}
+	queue->tail[prio] = task;
+
+	__atomic_add_fetch(&queue->count[prio], 1, __ATOMIC_RELAXED);
 }
 
-task_t *worker_queue_dequeue(worker_queue_t *queue)
+task_t *worker_queue_dequeue_prio(worker_queue_t *queue, task_prio_t prio)
 {
-	if (!queue) {
+	if (!queue || prio >= TASK_PRIO_COUNT) {
 		return NULL;
 	}
 
-	task_t *task = NULL;
+	task_t *task = queue->head[prio];
+	if (task != NULL) {
+		queue->head[prio] = task->next;
+		if (queue->head[prio] == NULL) {
+			queue->tail[prio] = NULL;
+		}
+		task->next = NULL;
 
-	if (!EMPTY_LIST(queue->list)) {
-		ptrnode_t *node = HEAD(queue->list);
-		task = (void *)node->d;
-		rem_node(&node->n);
-		queue->mm_ctx.free(&node->n);
+		__atomic_sub_fetch(&queue->count[prio], 1, __ATOMIC_RELAXED);
 	}
 
 	return task;
 }
+
+task_t *worker_queue_dequeue(worker_queue_t *queue)
+{
+	for (task_prio_t prio = 0; prio < TASK_PRIO_COUNT; prio++) {
+		task_t *task = worker_queue_dequeue_prio(queue, prio);
+		if (task != NULL) {
+			return task;
+		}
+	}
+
+	return NULL;
+}
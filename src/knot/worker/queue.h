@@ -16,25 +16,43 @@
 
 #pragma once
 
-#include "contrib/ucw/lists.h"
+#include <stdbool.h>
+#include <stddef.h>
 
 struct task;
 typedef void (*task_cb)(struct task *);
 
+/*!
+ * \brief Task priority classes.
+ */
+typedef enum {
+	TASK_PRIO_HIGH = 0, /*!< Urgent tasks (e.g. zone expiration, refresh). */
+	TASK_PRIO_NORMAL,   /*!< Default class. */
+	TASK_PRIO_LOW,      /*!< Bulk tasks (e.g. zone loading). */
+	TASK_PRIO_COUNT
+} task_prio_t;
+
 /*!
  * \brief Task executable by a worker.
+ *
+ * The task is linked into the queue directly, so it can be queued only once
+ * at a time.
  */
 typedef struct task {
 	void *ctx;
 	task_cb run;
+	struct task *next;  /*!< Next task in the queue. */
+	task_prio_t prio;   /*!< Priority class. */
+	bool queued;        /*!< The task is queued (managed by the worker pool). */
 } task_t;
 
 /*!
- * \brief Worker queue.
+ * \brief Worker queue with a FIFO per priority class.
  */
 typedef struct worker_queue {
-	knot_mm_t mm_ctx;
-	list_t list;
+	task_t *head[TASK_PRIO_COUNT];
+	task_t *tail[TASK_PRIO_COUNT];
+	size_t count[TASK_PRIO_COUNT]; /*!< Updated atomically, see worker_queue_count(). */
 } worker_queue_t;
 
 /*!
@@ -43,7 +61,7 @@ typedef struct worker_queue {
 void worker_queue_init(worker_queue_t *queue);
 
 /*!
- * \brief Deinitialize worker queue.
+ * \brief Deinitialize worker queue (the tasks are not owned by the queue).
  */
 void worker_queue_deinit(worker_queue_t *queue);
 
@@ -53,8 +71,25 @@ void worker_queue_deinit(worker_queue_t *queue);
 void worker_queue_enqueue(worker_queue_t *queue, task_t *task);
 
 /*!
- * \brief Remove item from the queue.
+ * \brief Remove item of the given priority class from the queue.
+ *
+ * \return Task or NULL if there is no such task.
+ */
+task_t *worker_queue_dequeue_prio(worker_queue_t *queue, task_prio_t prio);
+
+/*!
+ * \brief Remove the item of the highest priority class from the queue.
  *
  * \return Task or NULL if the queue is empty.
  */
 task_t *worker_queue_dequeue(worker_queue_t *queue);
+
+/*!
+ * \brief Get the number of queued tasks of the priority class.
+ *
+ * \note Can be called without the lock protecting the queue.
+ */
+static inline size_t worker_queue_count(const worker_queue_t *queue, task_prio_t prio)
+{
+	return __atomic_load_n(&queue->count[prio], __ATOMIC_RELAXED);
+}
@@ -0,0 +1,186 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dnssec/error.h"
+#include "dnssec/random.h"
+#include "knot/zone/answer-cache.h"
+#include "libknot/errcode.h"
+#include "contrib/openbsd/siphash.h"
+
+/*! \brief Number of locks guarding the slots. */
+#define ANSWER_CACHE_LOCKS 64
+
+typedef struct {
+	uint64_t hash;
+	uint16_t qtype;
+	uint16_t qclass;
+	uint16_t limit;
+	bool dnssec;
+	uint8_t qname_size;
+	answer_cache_val_t val;
+	uint8_t data[];       /*!< QNAME followed by the answer sections. */
+} answer_entry_t;
+
+struct answer_cache {
+	SIPHASH_KEY key;
+	unsigned mask;
+	pthread_mutex_t locks[ANSWER_CACHE_LOCKS];
+	answer_entry_t *slots[];
+};
+
+static uint64_t key_hash(const answer_cache_t *cache, const answer_cache_key_t *key,
+                         size_t qname_size)
+{
+	SIPHASH_CTX ctx;
+	SipHash24_Init(&ctx, &cache->key);
+	SipHash24_Update(&ctx, key->qname, qname_size);
+	SipHash24_Update(&ctx, &key->qtype, sizeof(key->qtype));
+	SipHash24_Update(&ctx, &key->qclass, sizeof(key->qclass));
+	SipHash24_Update(&ctx, &key->limit, sizeof(key->limit));
+	SipHash24_Update(&ctx, &key->dnssec, sizeof(key->dnssec));
+	return SipHash24_End(&ctx);
+}
+
+static bool entry_match(const answer_entry_t *entry, const answer_cache_key_t *key,
+                        uint64_t hash, size_t qname_size)
+{
+	return entry != NULL && entry->hash == hash &&
+	       entry->qtype == key->qtype && entry->qclass == key->qclass &&
+	       entry->limit == key->limit && entry->dnssec == key->dnssec &&
+	       entry->qname_size == qname_size &&
+	       memcmp(entry->data, key->qname, qname_size) == 0;
+}
+
+answer_cache_t *answer_cache_new(unsigned size)
+{
+	if (size == 0) {
+		return NULL;
+	}
+
+	unsigned slots = 1;
+	while (slots < size) {
+		slots <<= 1;
+	}
+
+	answer_cache_t *cache = calloc(1, sizeof(*cache) + slots * sizeof(answer_entry_t *));
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->mask = slots - 1;
+
+	if (dnssec_random_buffer((uint8_t *)&cache->key, sizeof(cache->key)) != DNSSEC_EOK) {
+		free(cache);
+		return NULL;
+	}
+
+	for (int i = 0; i < ANSWER_CACHE_LOCKS; i++) {
+		pthread_mutex_init(&cache->locks[i], NULL);
+	}
+
+	return cache;
+}
+
+void answer_cache_free(answer_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (unsigned i = 0; i <= cache->mask; i++) {
+		free(cache->slots[i]);
+	}
+	for (int i = 0; i < ANSWER_CACHE_LOCKS; i++) {
+		pthread_mutex_destroy(&cache->locks[i]);
+	}
+
+	free(cache);
+}
+
+int answer_cache_get(answer_cache_t *cache, const answer_cache_key_t *key,
+                     answer_cache_val_t *val, uint8_t *wire, size_t maxlen)
+{
+	if (cache == NULL || key == NULL || key->qname == NULL || val == NULL ||
+	    wire == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	size_t qname_size = knot_dname_size(key->qname);
+	uint64_t hash = key_hash(cache, key, qname_size);
+	unsigned slot = hash & cache->mask;
+	pthread_mutex_t *lock = &cache->locks[slot % ANSWER_CACHE_LOCKS];
+
+	int ret = KNOT_ENOENT;
+
+	pthread_mutex_lock(lock);
+	const answer_entry_t *entry = cache->slots[slot];
+	if (entry_match(entry, key, hash, qname_size)) {
+		if (entry->val.size <= maxlen) {
+			*val = entry->val;
+			memcpy(wire, entry->data + qname_size, entry->val.size);
+			val->wire = wire;
+			ret = KNOT_EOK;
+		} else {
+			ret = KNOT_ESPACE;
+		}
+	}
+	pthread_mutex_unlock(lock);
+
+	return ret;
+}
+
+int answer_cache_put(answer_cache_t *cache, const answer_cache_key_t *key,
+                     const answer_cache_val_t *val)
+{
+	if (cache == NULL || key == NULL || key->qname == NULL || val == NULL ||
+	    (val->wire == NULL && val->size > 0)) {
+		return KNOT_EINVAL;
+	}
+
+	size_t qname_size = knot_dname_size(key->qname);
+	answer_entry_t *entry = malloc(sizeof(*entry) + qname_size + val->size);
+	if (entry == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	entry->hash = key_hash(cache, key, qname_size);
+	entry->qtype = key->qtype;
+	entry->qclass = key->qclass;
+	entry->limit = key->limit;
+	entry->dnssec = key->dnssec;
+	entry->qname_size = qname_size;
+	entry->val = *val;
+	entry->val.wire = NULL;
+	memcpy(entry->data, key->qname, qname_size);
+	if (val->size > 0) {
+		memcpy(entry->data + qname_size, val->wire, val->size);
+	}
+
+	unsigned slot = entry->hash & cache->mask;
+	pthread_mutex_t *lock = &cache->locks[slot % ANSWER_CACHE_LOCKS];
+
+	pthread_mutex_lock(lock);
+	answer_entry_t *old = cache->slots[slot];
+	cache->slots[slot] = entry;
+	pthread_mutex_unlock(lock);
+
+	free(old);
+
+	return KNOT_EOK;
+}
@@ -0,0 +1,107 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * Cache of pre-rendered answers.
+ *
+ * The cache holds the wire format of the answer, authority and additional
+ * sections of responses rendered from one version of zone contents. It's
+ * owned by the contents, so any contents switch drops it implicitly. The
+ * cache is direct-mapped: a colliding entry replaces the previous one.
+ *
+ * \addtogroup zone
+ * @{
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libknot/dname.h"
+
+/*! \brief Default number of cached answers per zone contents. */
+#define ANSWER_CACHE_SIZE 1024
+
+typedef struct answer_cache answer_cache_t;
+
+/*!
+ * \brief Cached answer key.
+ */
+typedef struct {
+	const knot_dname_t *qname; /*!< Lowercase QNAME. */
+	uint16_t qtype;            /*!< QTYPE. */
+	uint16_t qclass;           /*!< QCLASS. */
+	uint16_t limit;            /*!< Space available for the response. */
+	bool dnssec;               /*!< DNSSEC records included. */
+} answer_cache_key_t;
+
+/*!
+ * \brief Cached answer.
+ */
+typedef struct {
+	const uint8_t *wire;  /*!< Sections following the question. */
+	uint16_t size;        /*!< Size of the sections. */
+	uint16_t count[3];    /*!< Answer, authority and additional RR counts. */
+	uint16_t rcode;       /*!< Response RCODE. */
+	bool aa;              /*!< Authoritative answer flag. */
+} answer_cache_val_t;
+
+/*!
+ * \brief Creates a new answer cache.
+ *
+ * \param size  Number of cache slots (rounded up to a power of two).
+ *
+ * \return New cache or NULL on error.
+ */
+answer_cache_t *answer_cache_new(unsigned size);
+
+/*!
+ * \brief Releases the answer cache.
+ */
+void answer_cache_free(answer_cache_t *cache);
+
+/*!
+ * \brief Looks up an answer and copies it out.
+ *
+ * \param cache   Answer cache.
+ * \param key     Answer key.
+ * \param val     Output answer metadata (the wire points to \a wire).
+ * \param wire    Output buffer for the answer sections.
+ * \param maxlen  Output buffer size.
+ *
+ * \retval KNOT_EOK     Answer found and copied.
+ * \retval KNOT_ENOENT  No such answer cached.
+ * \retval KNOT_ESPACE  Answer doesn't fit into the buffer.
+ */
+int answer_cache_get(answer_cache_t *cache, const answer_cache_key_t *key,
+                     answer_cache_val_t *val, uint8_t *wire, size_t maxlen);
+
+/*!
+ * \brief Stores the answer, replacing any colliding one.
+ *
+ * \param cache  Answer cache.
+ * \param key    Answer key.
+ * \param val    Answer to store (copied).
+ *
+ * \return KNOT_E*
+ */
+int answer_cache_put(answer_cache_t *cache, const answer_cache_key_t *key,
+                     const answer_cache_val_t *val);
+
+/*! @} */
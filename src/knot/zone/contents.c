@@ -15,6 +15,7 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 
 #include "dnssec/error.h"
 #include "knot/zone/contents.h"
@@ -23,6 +24,8 @@
 #include "libknot/libknot.h"
 #include "contrib/qp-trie/trie.h"
 #include "contrib/macros.h"
+#include "contrib/mempattern.h"
+#include "contrib/ucw/mempool.h"
 
 typedef struct {
 	zone_contents_apply_cb_t func;
@@ -35,6 +38,233 @@ typedef struct {
 	zone_node_t *previous_node;
 } zone_adjust_arg_t;
 
+/*! \brief Node changed in lazily copied zone contents, see zone_contents_cow(). */
+typedef struct {
+	zone_node_t *node;
+	bool nsec3;    /*!< Node of the NSEC3 tree. */
+	bool created;  /*!< Node without a counterpart in the previous version. */
+} cow_node_t;
+
+/*! \brief Growing array of nodes. */
+typedef struct {
+	cow_node_t *items;
+	size_t count;
+	size_t capacity;
+} node_list_t;
+
+/*! \brief Nodes referring to a name in their additionals. */
+typedef struct {
+	uint32_t count;
+	uint32_t capacity;
+	zone_node_t *nodes[];
+} referrers_t;
+
+/*!
+ * \brief Generation of nodes shared by zone contents versions.
+ *
+ * Lazily copied contents allocate nodes from the generation of the version
+ * they are copied from. Nodes replaced in a newer version stay allocated,
+ * so that stale references to them remain valid, until the generation is
+ * released with its last version.
+ */
+struct zone_gen {
+	pthread_mutex_t lock;  /*!< Lock for concurrent copies of one version. */
+	size_t refs;           /*!< Versions using the generation. */
+	struct mempool *pool;  /*!< Memory of the nodes. */
+	size_t nodes;          /*!< Count of nodes allocated. */
+	node_list_t garbage;   /*!< Replaced nodes with additionals to be freed. */
+	trie_t *referrers;     /*!< Additional owners to referrers_t (built lazily). */
+};
+
+/*! \brief Nodes of lazily copied zone contents. */
+struct zone_cow {
+	node_list_t changed;   /*!< Nodes to be adjusted. */
+	node_list_t removed;   /*!< Nodes removed since the last adjusting. */
+	node_list_t owned;     /*!< Nodes allocated for this version. */
+	node_list_t replaced;  /*!< Nodes replaced or removed in this version. */
+};
+
+static int node_list_add(node_list_t *list, zone_node_t *node, bool nsec3,
+                         bool created)
+{
+	if (list->count == list->capacity) {
+		size_t capacity = MAX(16, 2 * list->capacity);
+		cow_node_t *items = realloc(list->items, capacity * sizeof(*items));
+		if (items == NULL) {
+			return KNOT_ENOMEM;
+		}
+		list->items = items;
+		list->capacity = capacity;
+	}
+
+	list->items[list->count++] = (cow_node_t) {
+		.node = node,
+		.nsec3 = nsec3,
+		.created = created
+	};
+
+	return KNOT_EOK;
+}
+
+static void node_list_free(node_list_t *list)
+{
+	free(list->items);
+	memset(list, 0, sizeof(*list));
+}
+
+static void *gen_alloc(void *ctx, size_t size)
+{
+	struct zone_gen *gen = ctx;
+
+	pthread_mutex_lock(&gen->lock);
+	void *mem = mp_alloc(gen->pool, size);
+	pthread_mutex_unlock(&gen->lock);
+
+	return mem;
+}
+
+/*! \brief Creates a new generation and sets the memory context for its nodes. */
+static struct zone_gen *gen_new(knot_mm_t *mm)
+{
+	struct zone_gen *gen = calloc(1, sizeof(*gen));
+	if (gen == NULL) {
+		return NULL;
+	}
+
+	gen->pool = mp_new(MM_DEFAULT_BLKSIZE);
+	if (gen->pool == NULL) {
+		free(gen);
+		return NULL;
+	}
+
+	pthread_mutex_init(&gen->lock, NULL);
+	gen->refs = 1;
+
+	/* Nodes are released at once with the generation. */
+	mm->ctx = gen;
+	mm->alloc = gen_alloc;
+	mm->free = NULL;
+
+	return gen;
+}
+
+static void gen_count_node(struct zone_gen *gen)
+{
+	__atomic_add_fetch(&gen->nodes, 1, __ATOMIC_RELAXED);
+}
+
+static int free_referrers(trie_val_t *val, void *data)
+{
+	UNUSED(data);
+	free(*val);
+	return KNOT_EOK;
+}
+
+static void gen_release(struct zone_gen *gen)
+{
+	if (gen == NULL || __atomic_sub_fetch(&gen->refs, 1, __ATOMIC_ACQ_REL) > 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < gen->garbage.count; i++) {
+		zone_node_t *node = gen->garbage.items[i].node;
+		for (uint16_t j = 0; j < node->rrset_count; j++) {
+			additional_clear(node->rrs[j].additional);
+			node->rrs[j].additional = NULL;
+		}
+	}
+	node_list_free(&gen->garbage);
+
+	if (gen->referrers != NULL) {
+		(void)trie_apply(gen->referrers, free_referrers, NULL);
+		trie_free(gen->referrers);
+	}
+
+	pthread_mutex_destroy(&gen->lock);
+	mp_delete(gen->pool);
+	free(gen);
+}
+
+/*!
+ * \brief Queues a replaced node for release of its additionals.
+ *
+ * \note The generation must be locked.
+ */
+static void gen_collect(struct zone_gen *gen, zone_node_t *node)
+{
+	uint8_t flags = __atomic_fetch_or(&node->flags, NODE_FLAGS_SUPERSEDED |
+	                                  NODE_FLAGS_GARBAGE, __ATOMIC_RELAXED);
+	if (!(flags & NODE_FLAGS_GARBAGE)) {
+		/* On failure, the additionals leak rather than being freed twice. */
+		(void)node_list_add(&gen->garbage, node, false, false);
+	}
+}
+
+/*!
+ * \brief Notes the node referring to the name in its additionals.
+ *
+ * \note The generation must be locked.
+ */
+static int gen_add_referrer(struct zone_gen *gen, const knot_dname_t *name,
+                            zone_node_t *node)
+{
+	knot_dname_storage_t lf_storage;
+	uint8_t *lf = knot_dname_lf(name, &lf_storage);
+	assert(lf);
+
+	trie_val_t *val = trie_get_ins(gen->referrers, (char *)lf + 1, *lf);
+	if (val == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	referrers_t *refs = *val;
+	if (refs != NULL && refs->count > 0 &&
+	    knot_dname_is_equal(refs->nodes[refs->count - 1]->owner, node->owner)) {
+		/* Most likely a newer copy of the last referrer. */
+		refs->nodes[refs->count - 1] = node;
+		return KNOT_EOK;
+	}
+
+	if (refs == NULL || refs->count == refs->capacity) {
+		uint32_t capacity = (refs == NULL) ? 2 : 2 * refs->capacity;
+		referrers_t *grown = realloc(refs, sizeof(*refs) +
+		                             capacity * sizeof(refs->nodes[0]));
+		if (grown == NULL) {
+			return KNOT_ENOMEM;
+		}
+		if (refs == NULL) {
+			grown->count = 0;
+		}
+		grown->capacity = capacity;
+		refs = grown;
+		*val = refs;
+	}
+
+	refs->nodes[refs->count++] = node;
+	return KNOT_EOK;
+}
+
+/*! \brief Notes the additional owners of the node RRSets in the generation. */
+static int gen_add_node_referrers(struct zone_gen *gen, zone_node_t *node)
+{
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		const struct rr_data *rr_data = &node->rrs[i];
+		if (!knot_rrtype_additional_needed(rr_data->type)) {
+			continue;
+		}
+		for (uint16_t j = 0; j < rr_data->rrs.rr_count; j++) {
+			const knot_dname_t *name = knot_rdata_name(&rr_data->rrs, j,
+			                                           rr_data->type);
+			int ret = gen_add_referrer(gen, name, node);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		}
+	}
+
+	return KNOT_EOK;
+}
+
 static int tree_apply_cb(zone_node_t **node, void *data)
 {
 	if (node == NULL || data == NULL) {
@@ -83,11 +313,10 @@ static int check_node(const zone_contents_t *contents, const zone_node_t *node)
 static int destroy_node_rrsets_from_tree(zone_node_t **node, void *data)
 {
 	assert(node);
-	UNUSED(data);
+	knot_mm_t *mm = data;
 
 	if (*node != NULL) {
-		node_free_rrsets(*node, NULL);
-		node_free(node, NULL);
+		node_free_rrsets(*node, mm);
 	}
 
 	return KNOT_EOK;
@@ -398,6 +627,137 @@ static bool nsec3_params_match(const knot_rdataset_t *rrs,
 		          params->salt.size) == 0);
 }
 
+static void cow_free(struct zone_cow *cow)
+{
+	node_list_free(&cow->changed);
+	node_list_free(&cow->removed);
+	node_list_free(&cow->owned);
+	node_list_free(&cow->replaced);
+	free(cow);
+}
+
+/*! \brief Notes a node allocated for the contents. */
+static int cow_add(zone_contents_t *zone, zone_node_t *node, bool nsec3, bool created)
+{
+	gen_count_node(zone->gen);
+	if (zone->cow == NULL) {
+		return KNOT_EOK;
+	}
+
+	node->flags |= NODE_FLAGS_NEW;
+	int ret = node_list_add(&zone->cow->owned, node, nsec3, created);
+	if (ret == KNOT_EOK) {
+		ret = node_list_add(&zone->cow->changed, node, nsec3, created);
+	}
+
+	return ret;
+}
+
+static size_t node_size(zone_node_t *node)
+{
+	size_t size = 0;
+	measure_size(node, &size);
+	return size;
+}
+
+/*! \brief Creates a new node of the contents. */
+static zone_node_t *contents_node_new(zone_contents_t *zone, const knot_dname_t *owner,
+                                      bool nsec3)
+{
+	zone_node_t *node = node_new(owner, &zone->mm);
+	if (node != NULL && cow_add(zone, node, nsec3, true) != KNOT_EOK) {
+		node->flags |= NODE_FLAGS_SUPERSEDED;
+		return NULL;
+	}
+
+	return node;
+}
+
+/*! \brief Frees a new node which couldn't be inserted into the contents. */
+static void contents_node_free(zone_contents_t *zone, zone_node_t **node)
+{
+	/* Mark it as not adjustable, the memory is released with the generation. */
+	(*node)->flags |= NODE_FLAGS_SUPERSEDED;
+	node_free(node, &zone->mm);
+}
+
+/*!
+ * \brief Makes the node private to the contents.
+ *
+ * A node of lazily copied contents shared with the previous version is
+ * replaced by its copy in the contents, the previous version keeps the node.
+ *
+ * \return The private node, or NULL on error.
+ */
+static zone_node_t *cow_unshare(zone_contents_t *zone, zone_node_t *node, bool nsec3)
+{
+	if (zone->cow == NULL || node == NULL || (node->flags & NODE_FLAGS_NEW)) {
+		return node;
+	}
+
+	zone_node_t *copy = node_shallow_copy(node, &zone->mm);
+	if (copy == NULL) {
+		return NULL;
+	}
+	copy->flags = node->flags & ~NODE_FLAGS_VERSIONING;
+	copy->parent = node->parent;
+	copy->children = node->children;
+	copy->prev = node->prev;
+	copy->nsec3_node = node->nsec3_node;
+
+	int ret = cow_add(zone, copy, nsec3, false);
+	if (ret != KNOT_EOK) {
+		copy->flags |= NODE_FLAGS_SUPERSEDED;
+		return NULL;
+	}
+
+	zone_tree_t *tree = nsec3 ? zone->nsec3_nodes : zone->nodes;
+	knot_dname_storage_t lf_storage;
+	uint8_t *lf = knot_dname_lf(node->owner, &lf_storage);
+	assert(lf);
+
+	trie_val_t *val = trie_get_ins(tree, (char *)lf + 1, *lf);
+	if (val == NULL ||
+	    node_list_add(&zone->cow->replaced, node, nsec3, false) != KNOT_EOK) {
+		copy->flags |= NODE_FLAGS_SUPERSEDED;
+		return NULL;
+	}
+	assert(*val == node);
+	*val = copy;
+
+	if (node == zone->apex) {
+		zone->apex = copy;
+	}
+
+	/* Readers of these contents now look the node up by the owner. */
+	__atomic_fetch_or(&node->flags, NODE_FLAGS_SUPERSEDED, __ATOMIC_RELAXED);
+	zone->size -= node_size(node);
+
+	return copy;
+}
+
+/*! \brief Notes a node removed from the contents. */
+static int cow_remove(zone_contents_t *zone, zone_node_t *node, bool nsec3)
+{
+	if (zone->cow == NULL) {
+		node_free(&node, &zone->mm);
+		return KNOT_EOK;
+	}
+
+	/* New nodes are not measured yet. */
+	if (!(node->flags & NODE_FLAGS_NEW)) {
+		zone->size -= node_size(node);
+	}
+	__atomic_fetch_or(&node->flags, NODE_FLAGS_SUPERSEDED, __ATOMIC_RELAXED);
+
+	int ret = node_list_add(&zone->cow->removed, node, nsec3, false);
+	if (ret == KNOT_EOK) {
+		ret = node_list_add(&zone->cow->replaced, node, nsec3, false);
+	}
+
+	return ret;
+}
+
 zone_contents_t *zone_contents_new(const knot_dname_t *apex_name)
 {
 	if (apex_name == NULL) {
@@ -410,7 +770,15 @@ zone_contents_t *zone_contents_new(const knot_dname_t *apex_name)
 	}
 
 	memset(contents, 0, sizeof(zone_contents_t));
-	contents->apex = node_new(apex_name, NULL);
+	contents->refs = 1;
+
+	contents->gen = gen_new(&contents->mm);
+	if (contents->gen == NULL) {
+		free(contents);
+		return NULL;
+	}
+
+	contents->apex = contents_node_new(contents, apex_name, false);
 	if (contents->apex == NULL) {
 		goto cleanup;
 	}
@@ -427,9 +795,7 @@ zone_contents_t *zone_contents_new(const knot_dname_t *apex_name)
 	return contents;
 
 cleanup:
-	free(contents->nodes);
-	free(contents->nsec3_nodes);
-	free(contents);
+	zone_contents_free(&contents);
 	return NULL;
 }
 
@@ -470,17 +836,21 @@ static int add_node(zone_contents_t *zone, zone_node_t *node, bool create_parent
 	const uint8_t *parent = knot_wire_next_label(node->owner, NULL);
 
 	if (knot_dname_is_equal(zone->apex->owner, parent)) {
-		node_set_parent(node, zone->apex);
+		zone_node_t *apex = cow_unshare(zone, zone->apex, false);
+		if (apex == NULL) {
+			return KNOT_ENOMEM;
+		}
+		node_set_parent(node, apex);
 
 		// check if the node is not wildcard child of the parent
 		if (knot_dname_is_wildcard(node->owner)) {
-			zone->apex->flags |= NODE_FLAGS_WILDCARD_CHILD;
+			apex->flags |= NODE_FLAGS_WILDCARD_CHILD;
 		}
 	} else {
 		while (parent != NULL && !(next_node = get_node(zone, parent))) {
 
 			/* Create a new node. */
-			next_node = node_new(parent, NULL);
+			next_node = contents_node_new(zone, parent, false);
 			if (next_node == NULL) {
 				return KNOT_ENOMEM;
 			}
@@ -488,7 +858,7 @@ static int add_node(zone_contents_t *zone, zone_node_t *node, bool create_parent
 			/* Insert node to a tree. */
 			ret = zone_tree_insert(zone->nodes, next_node);
 			if (ret != KNOT_EOK) {
-				node_free(&next_node, NULL);
+				contents_node_free(zone, &next_node);
 				return ret;
 			}
 
@@ -504,8 +874,15 @@ static int add_node(zone_contents_t *zone, zone_node_t *node, bool create_parent
 
 		// set the found parent (in the zone) as the parent of the last
 		// inserted node
+		next_node = cow_unshare(zone, next_node, false);
+		if (next_node == NULL) {
+			return KNOT_ENOMEM;
+		}
 		assert(node->parent == NULL);
 		node_set_parent(node, next_node);
+		if (knot_dname_is_wildcard(node->owner)) {
+			next_node->flags |= NODE_FLAGS_WILDCARD_CHILD;
+		}
 	}
 
 	return KNOT_EOK;
@@ -538,7 +915,11 @@ static int add_nsec3_node(zone_contents_t *zone, zone_node_t *node)
 
 	// no parents to be created, the only parent is the zone apex
 	// set the apex as the parent of the node
-	node_set_parent(node, zone->apex);
+	zone_node_t *apex = cow_unshare(zone, zone->apex, false);
+	if (apex == NULL) {
+		return KNOT_ENOMEM;
+	}
+	node_set_parent(node, apex);
 
 	// cannot be wildcard child, so nothing to be done
 
@@ -571,18 +952,24 @@ static int insert_rr(zone_contents_t *z, const knot_rrset_t *rr,
 		*n = nsec3 ? get_nsec3_node(z, rr->owner) : get_node(z, rr->owner);
 		if (*n == NULL) {
 			// Create new, insert
-			*n = node_new(rr->owner, NULL);
+			*n = contents_node_new(z, rr->owner, nsec3);
 			if (*n == NULL) {
 				return KNOT_ENOMEM;
 			}
 			int ret = nsec3 ? add_nsec3_node(z, *n) : add_node(z, *n, true);
 			if (ret != KNOT_EOK) {
-				node_free(n, NULL);
+				contents_node_free(z, n);
+				return ret;
 			}
 		}
 	}
 
-	return node_add_rrset(*n, rr, NULL);
+	*n = cow_unshare(z, *n, nsec3);
+	if (*n == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	return node_add_rrset(*n, rr, &z->mm);
 }
 
 static int remove_rr(zone_contents_t *z, const knot_rrset_t *rr,
@@ -608,9 +995,19 @@ static int remove_rr(zone_contents_t *z, const knot_rrset_t *rr,
 		node = *n;
 	}
 
+	node = cow_unshare(z, node, nsec3);
+	if (node == NULL) {
+		return KNOT_ENOMEM;
+	}
+
 	knot_rdataset_t *node_rrs = node_rdataset(node, rr->type);
+	int ret = node_unpack_rdataset(node, node_rrs);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
 	// Subtract changeset RRS from node RRS.
-	int ret = knot_rdataset_subtract(node_rrs, &rr->rrs, NULL);
+	ret = knot_rdataset_subtract(node_rrs, &rr->rrs, NULL);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -620,7 +1017,11 @@ static int remove_rr(zone_contents_t *z, const knot_rrset_t *rr,
 		node_remove_rdataset(node, rr->type);
 		// If node is empty now, delete it from zone tree.
 		if (node->rrset_count == 0 && node != z->apex) {
-			zone_tree_delete_empty(nsec3 ? z->nsec3_nodes : z->nodes, node);
+			ret = zone_contents_delete_empty_node(z, nsec3 ? z->nsec3_nodes : z->nodes,
+			                                      node);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
 		}
 	}
 
@@ -628,92 +1029,82 @@ static int remove_rr(zone_contents_t *z, const knot_rrset_t *rr,
 	return KNOT_EOK;
 }
 
-static int recreate_normal_tree(const zone_contents_t *z, zone_contents_t *out)
+/*! \brief Context of copying nodes of a cloned zone tree. */
+typedef struct {
+	const zone_node_t *apex;     /*!< Original zone apex. */
+	zone_node_t *apex_copy;      /*!< Copy of the zone apex. */
+	zone_node_t *nsec3_parent;   /*!< Parent of all nodes in NSEC3 tree. */
+	knot_mm_t *mm;               /*!< Memory context for the copies. */
+	bool pack;                   /*!< Pack the RR data into the copies. */
+	unsigned depth;              /*!< Depth of the path to the last node. */
+	struct {
+		const zone_node_t *orig;
+		zone_node_t *copy;
+	} path[KNOT_DNAME_MAXLABELS + 1]; /*!< Ancestors of the last node. */
+} copy_ctx_t;
+
+static int copy_node(zone_node_t **node, void *data)
 {
-	out->nodes = trie_create(NULL);
-	if (out->nodes == NULL) {
-		return KNOT_ENOMEM;
-	}
+	copy_ctx_t *ctx = data;
 
-	// Insert APEX first.
-	zone_node_t *apex_cpy = node_shallow_copy(z->apex, NULL);
-	if (apex_cpy == NULL) {
+	const zone_node_t *orig = *node;
+	zone_node_t *copy = ctx->pack ? node_pack(orig, ctx->mm) :
+	                                node_shallow_copy(orig, ctx->mm);
+	if (copy == NULL) {
 		return KNOT_ENOMEM;
 	}
+	copy->flags &= ~NODE_FLAGS_VERSIONING;
+	*node = copy;
 
-	// Normal additions need apex ... so we need to insert directly.
-	int ret = zone_tree_insert(out->nodes, apex_cpy);
-	if (ret != KNOT_EOK) {
-		node_free(&apex_cpy, NULL);
-		return ret;
+	if (ctx->nsec3_parent != NULL) {
+		node_set_parent(copy, ctx->nsec3_parent);
+		return KNOT_EOK;
 	}
 
-	out->apex = apex_cpy;
-
-	trie_it_t *itt = trie_it_begin(z->nodes);
-	if (itt == NULL) {
-		return KNOT_ENOMEM;
+	if (orig == ctx->apex) {
+		ctx->apex_copy = copy;
 	}
 
-	while (!trie_it_finished(itt)) {
-		const zone_node_t *to_cpy = (zone_node_t *)*trie_it_val(itt);
-		if (to_cpy == z->apex) {
-			// Inserted already.
-			trie_it_next(itt);
-			continue;
-		}
-		zone_node_t *to_add = node_shallow_copy(to_cpy, NULL);
-		if (to_add == NULL) {
-			trie_it_free(itt);
-			return KNOT_ENOMEM;
-		}
-
-		int ret = add_node(out, to_add, true);
-		if (ret != KNOT_EOK) {
-			node_free(&to_add, NULL);
-			trie_it_free(itt);
-			return ret;
-		}
-		trie_it_next(itt);
+	// Parents precede their children in the canonical order. The parent
+	// is matched by name, lazily copied nodes may refer to a replaced one.
+	const knot_dname_t *parent = (*orig->owner == '\0') ? NULL :
+	                             knot_wire_next_label(orig->owner, NULL);
+	while (ctx->depth > 0 && (parent == NULL ||
+	       !knot_dname_is_equal(ctx->path[ctx->depth - 1].orig->owner, parent))) {
+		ctx->depth--;
+	}
+	if (ctx->depth > 0) {
+		node_set_parent(copy, ctx->path[ctx->depth - 1].copy);
+	}
+	if (ctx->depth < sizeof(ctx->path) / sizeof(ctx->path[0])) {
+		ctx->path[ctx->depth].orig = orig;
+		ctx->path[ctx->depth].copy = copy;
+		ctx->depth++;
 	}
-
-	trie_it_free(itt);
 
 	return KNOT_EOK;
 }
 
-static int recreate_nsec3_tree(const zone_contents_t *z, zone_contents_t *out)
+/*!
+ * \brief Clone the tree and replace all nodes with their copies.
+ *
+ * The tree structure and the lookup keys are shared with the original tree.
+ */
+static int copy_tree(zone_tree_t *from, zone_tree_t **to, copy_ctx_t *ctx)
 {
-	out->nsec3_nodes = trie_create(NULL);
-	if (out->nsec3_nodes == NULL) {
-		return KNOT_ENOMEM;
-	}
-
-	trie_it_t *itt = trie_it_begin(z->nsec3_nodes);
-	if (itt == NULL) {
+	*to = trie_cow(from);
+	if (*to == NULL) {
 		return KNOT_ENOMEM;
 	}
-	while (!trie_it_finished(itt)) {
-		const zone_node_t *to_cpy = (zone_node_t *)*trie_it_val(itt);
-		zone_node_t *to_add = node_shallow_copy(to_cpy, NULL);
-		if (to_add == NULL) {
-			trie_it_free(itt);
-			return KNOT_ENOMEM;
-		}
-
-		int ret = add_nsec3_node(out, to_add);
-		if (ret != KNOT_EOK) {
-			trie_it_free(itt);
-			node_free(&to_add, NULL);
-			return ret;
-		}
 
-		trie_it_next(itt);
+	ctx->depth = 0;
+	int ret = trie_apply_cow(*to, (int (*)(trie_val_t *, void *))copy_node, ctx);
+	if (ret != KNOT_EOK) {
+		// The copied nodes are released with the memory pool.
+		zone_tree_free(to);
 	}
 
-	trie_it_free(itt);
-
-	return KNOT_EOK;
+	return ret;
 }
 
 // Public API
@@ -748,17 +1139,61 @@ zone_node_t *zone_contents_get_node_for_rr(zone_contents_t *zone, const knot_rrs
 	zone_node_t *node = nsec3 ? get_nsec3_node(zone, rrset->owner) :
 	                            get_node(zone, rrset->owner);
 	if (node == NULL) {
-		node = node_new(rrset->owner, NULL);
+		node = contents_node_new(zone, rrset->owner, nsec3);
+		if (node == NULL) {
+			return NULL;
+		}
 		int ret = nsec3 ? add_nsec3_node(zone, node) : add_node(zone, node, true);
 		if (ret != KNOT_EOK) {
-			node_free(&node, NULL);
+			contents_node_free(zone, &node);
 			return NULL;
 		}
 
 		return node;
 	} else {
-		return node;
+		return cow_unshare(zone, node, nsec3);
+	}
+}
+
+int zone_contents_delete_empty_node(zone_contents_t *contents, zone_tree_t *tree,
+                                    zone_node_t *node)
+{
+	if (contents == NULL || tree == NULL || node == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	const bool nsec3 = (tree == contents->nsec3_nodes);
+
+	while (node != contents->apex && node->rrset_count == 0 && node->children == 0) {
+		zone_node_t *parent = zone_contents_node_parent(contents, node);
+
+		knot_dname_storage_t lf_storage;
+		uint8_t *lf = knot_dname_lf(node->owner, &lf_storage);
+		assert(lf);
+		trie_del(tree, (char *)lf + 1, *lf, NULL);
+
+		int ret = cow_remove(contents, node, nsec3);
+		if (ret != KNOT_EOK || parent == NULL) {
+			return ret;
+		}
+
+		const bool wildcard = knot_dname_is_wildcard(node->owner);
+		node = cow_unshare(contents, parent, false);
+		if (node == NULL) {
+			return KNOT_ENOMEM;
+		}
+		node->children--;
+		if (wildcard) {
+			node->flags &= ~NODE_FLAGS_WILDCARD_CHILD;
+		}
+
+		// The only parent of NSEC3 nodes is the apex.
+		if (nsec3) {
+			break;
+		}
 	}
+
+	return KNOT_EOK;
 }
 
 const zone_node_t *zone_contents_find_node(const zone_contents_t *zone, const knot_dname_t *name)
@@ -820,7 +1255,7 @@ int zone_contents_find_dname(const zone_contents_t *zone,
 		node = prev;
 		size_t matched_labels = knot_dname_matched_labels(node->owner, name);
 		while (matched_labels < knot_dname_labels(node->owner, NULL)) {
-			node = node->parent;
+			node = zone_contents_node_parent(zone, node);
 			assert(node);
 		}
 
@@ -874,7 +1309,7 @@ int zone_contents_find_nsec3_for_name(const zone_contents_t *zone,
 		// set the previous node of the found node
 		assert(match);
 		assert(*nsec3_node != NULL);
-		*nsec3_previous = (*nsec3_node)->prev;
+		*nsec3_previous = zone_tree_current(zone->nsec3_nodes, (*nsec3_node)->prev);
 	} else {
 		*nsec3_previous = prev;
 	}
@@ -896,7 +1331,8 @@ int zone_contents_find_nsec3_for_name(const zone_contents_t *zone,
 		}
 
 		/* This RRSET was not a match, try the one from previous node. */
-		*nsec3_previous = (*nsec3_previous)->prev;
+		*nsec3_previous = zone_tree_current(zone->nsec3_nodes,
+		                                    (*nsec3_previous)->prev);
 		nsec3_rrs = node_rdataset(*nsec3_previous, KNOT_RRTYPE_NSEC3);
 		if (*nsec3_previous == original_prev || nsec3_rrs == NULL) {
 			// cycle
@@ -976,16 +1412,588 @@ static int load_nsec3param(zone_contents_t *contents)
 	return KNOT_EOK;
 }
 
-static int contents_adjust(zone_contents_t *contents, bool normal)
+/*! \brief Checks if the apex NSEC3PARAM differs from the loaded NSEC3 parameters. */
+static bool nsec3param_changed(const zone_contents_t *contents)
 {
-	if (contents == NULL || contents->apex == NULL) {
-		return KNOT_EINVAL;
-	}
+	const knot_rdataset_t *rrs = node_rdataset(contents->apex, KNOT_RRTYPE_NSEC3PARAM);
+	const dnssec_nsec3_params_t *params = &contents->nsec3_params;
+	if (rrs == NULL || rrs->rr_count == 0) {
+		return params->algorithm != 0;
+	}
+
+	return knot_nsec3param_algorithm(rrs, 0) != params->algorithm ||
+	       knot_nsec3param_flags(rrs, 0) != params->flags ||
+	       knot_nsec3param_iterations(rrs, 0) != params->iterations ||
+	       knot_nsec3param_salt_length(rrs, 0) != params->salt.size ||
+	       memcmp(knot_nsec3param_salt(rrs, 0), params->salt.data,
+	              params->salt.size) != 0;
+}
 
-	int ret = load_nsec3param(contents);
-	if (ret != KNOT_EOK) {
-		log_zone_error(contents->apex->owner,
-		               "failed to load NSEC3 parameters (%s)",
+static bool is_cut(const zone_node_t *node)
+{
+	return node->flags & (NODE_FLAGS_DELEG | NODE_FLAGS_NONAUTH);
+}
+
+/*! \brief Sets the delegation flags of a node of lazily copied contents. */
+static void cow_adjust_flags(zone_contents_t *zone, zone_node_t *node)
+{
+	const zone_node_t *parent = zone_contents_node_parent(zone, node);
+
+	node->flags &= ~(NODE_FLAGS_DELEG | NODE_FLAGS_NONAUTH |
+	                 NODE_FLAGS_REMOVED_NSEC | NODE_FLAGS_EMPTY);
+	if (parent != NULL && is_cut(parent)) {
+		node->flags |= NODE_FLAGS_NONAUTH;
+	} else if (node_rrtype_exists(node, KNOT_RRTYPE_NS) && node != zone->apex) {
+		node->flags |= NODE_FLAGS_DELEG;
+	}
+}
+
+static int compare_cow_nodes(const void *a, const void *b)
+{
+	const cow_node_t *x = a, *y = b;
+	return knot_dname_cmp(x->node->owner, y->node->owner);
+}
+
+/*! \brief Positions the iterator at the first key not less than the given one. */
+static int it_seek(trie_it_t *it, const uint8_t *lf)
+{
+	int ret = trie_it_get_leq(it, (char *)lf + 1, *lf);
+	if (ret == 1) {
+		trie_it_next(it);
+	} else if (ret == KNOT_ENOENT) {
+		trie_it_first(it);
+	} else if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	return KNOT_EOK;
+}
+
+static bool it_in_subtree(trie_it_t *it, const uint8_t *lf)
+{
+	if (trie_it_finished(it)) {
+		return false;
+	}
+
+	size_t len = 0;
+	const char *key = trie_it_key(it, &len);
+	return len >= *lf && memcmp(key, lf + 1, *lf) == 0;
+}
+
+/*! \brief Collects the nodes below the given name (in canonical order). */
+static int collect_subtree(zone_tree_t *tree, const knot_dname_t *name,
+                           node_list_t *out)
+{
+	knot_dname_storage_t lf_storage;
+	uint8_t *lf = knot_dname_lf(name, &lf_storage);
+	assert(lf);
+
+	trie_it_t *it = trie_it_begin(tree);
+	if (it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = it_seek(it, lf);
+	while (ret == KNOT_EOK && it_in_subtree(it, lf)) {
+		zone_node_t *node = *trie_it_val(it);
+		if (!knot_dname_is_equal(node->owner, name)) {
+			ret = node_list_add(out, node, false, false);
+		}
+		trie_it_next(it);
+	}
+	trie_it_free(it);
+
+	return ret;
+}
+
+/*!
+ * \brief Sets the flags of the changed nodes, and of the nodes below them
+ *        if they became or stopped being a zone cut.
+ */
+static int cow_adjust_cuts(zone_contents_t *zone, node_list_t *recut)
+{
+	node_list_t *changed = &zone->cow->changed;
+	qsort(changed->items, changed->count, sizeof(*changed->items), compare_cow_nodes);
+
+	// Nodes appended meanwhile are adjusted right away.
+	size_t count = changed->count;
+	for (size_t i = 0; i < count; i++) {
+		cow_node_t item = changed->items[i];
+		zone_node_t *node = item.node;
+		if (item.nsec3 || (node->flags & NODE_FLAGS_SUPERSEDED)) {
+			continue;
+		}
+
+		bool was_cut = is_cut(node);
+		cow_adjust_flags(zone, node);
+
+		zone_node_t *parent = zone_contents_node_parent(zone, node);
+		if (knot_dname_is_wildcard(node->owner) && parent != NULL &&
+		    !(parent->flags & NODE_FLAGS_WILDCARD_CHILD)) {
+			parent = cow_unshare(zone, parent, false);
+			if (parent == NULL) {
+				return KNOT_ENOMEM;
+			}
+			parent->flags |= NODE_FLAGS_WILDCARD_CHILD;
+		}
+
+		if (item.created || was_cut == is_cut(node)) {
+			continue;
+		}
+		int ret = node_list_add(recut, node, false, false);
+		if (ret != KNOT_EOK) {
+			return ret;
+		} else if (node->children == 0) {
+			continue;
+		}
+
+		node_list_t subtree = { 0 };
+		ret = collect_subtree(zone->nodes, node->owner, &subtree);
+		for (size_t j = 0; ret == KNOT_EOK && j < subtree.count; j++) {
+			zone_node_t *child = cow_unshare(zone, subtree.items[j].node, false);
+			if (child == NULL) {
+				ret = KNOT_ENOMEM;
+				break;
+			}
+			was_cut = is_cut(child);
+			cow_adjust_flags(zone, child);
+			if (was_cut != is_cut(child)) {
+				ret = node_list_add(recut, child, false, false);
+			}
+		}
+		node_list_free(&subtree);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+static int compare_ptrs(const void *a, const void *b)
+{
+	const cow_node_t *x = a, *y = b;
+	return (x->node > y->node) - (x->node < y->node);
+}
+
+/*!
+ * \brief Links the changed nodes to their NSEC3 nodes.
+ *
+ * \param complete  Set to false if a new NSEC3 node isn't linked to any.
+ */
+static int cow_adjust_nsec3(zone_contents_t *zone, bool *complete)
+{
+	node_list_t *changed = &zone->cow->changed;
+
+	node_list_t created = { 0 };
+	for (size_t i = 0; i < changed->count; i++) {
+		cow_node_t *item = &changed->items[i];
+		if (item->nsec3 && item->created &&
+		    !(item->node->flags & NODE_FLAGS_SUPERSEDED) &&
+		    node_list_add(&created, item->node, true, false) != KNOT_EOK) {
+			node_list_free(&created);
+			return KNOT_ENOMEM;
+		}
+	}
+	qsort(created.items, created.count, sizeof(*created.items), compare_ptrs);
+
+	int ret = KNOT_EOK;
+	for (size_t i = 0; i < changed->count; i++) {
+		cow_node_t *item = &changed->items[i];
+		zone_node_t *node = item->node;
+		if (item->nsec3 || (node->flags & NODE_FLAGS_SUPERSEDED)) {
+			continue;
+		}
+
+		uint8_t nsec3_name[KNOT_DNAME_MAXLEN];
+		ret = create_nsec3_name(nsec3_name, sizeof(nsec3_name), zone, node->owner);
+		if (ret == KNOT_ENSEC3PAR) {
+			node->nsec3_node = NULL;
+			ret = KNOT_EOK;
+			continue;
+		} else if (ret != KNOT_EOK) {
+			break;
+		}
+		node->nsec3_node = zone_tree_get(zone->nsec3_nodes, nsec3_name);
+
+		// Mark the new NSEC3 node as linked.
+		cow_node_t key = { .node = node->nsec3_node };
+		cow_node_t *found = bsearch(&key, created.items, created.count,
+		                            sizeof(*created.items), compare_ptrs);
+		if (found != NULL) {
+			found->created = true;
+		}
+	}
+
+	*complete = true;
+	for (size_t i = 0; i < created.count; i++) {
+		*complete &= created.items[i].created;
+	}
+	node_list_free(&created);
+
+	return ret;
+}
+
+static bool is_prev_target(const zone_node_t *node, bool nsec3)
+{
+	return nsec3 || (!(node->flags & NODE_FLAGS_NONAUTH) && node->rrset_count > 0);
+}
+
+/*!
+ * \brief Finds the nodes around the given name with wrong previous nodes.
+ *
+ * Previous node is the closest authoritative node before in canonical order,
+ * the first node refers to the last one.
+ */
+static int find_prev_fixes(zone_tree_t *tree, trie_it_t *it, const knot_dname_t *name,
+                           bool nsec3, node_list_t *fixes)
+{
+	size_t weight = zone_tree_count(tree);
+	if (weight == 0) {
+		return KNOT_EOK;
+	}
+
+	knot_dname_storage_t lf_storage;
+	uint8_t *lf = knot_dname_lf(name, &lf_storage);
+	assert(lf);
+
+	// Find the previous node of the name.
+	int ret = trie_it_get_leq(it, (char *)lf + 1, *lf);
+	if (ret == KNOT_EOK) {
+		trie_it_prev(it);
+	} else if (ret != 1 && ret != KNOT_ENOENT) {
+		return ret;
+	}
+	zone_node_t *prev = NULL;
+	for (size_t steps = 0; steps < weight; steps++) {
+		if (trie_it_finished(it)) {
+			trie_it_last(it);
+		}
+		zone_node_t *node = *trie_it_val(it);
+		if (is_prev_target(node, nsec3)) {
+			prev = node;
+			break;
+		}
+		trie_it_prev(it);
+	}
+
+	// Check the nodes up to the next target after the name.
+	ret = it_seek(it, lf);
+	for (size_t steps = 0; ret == KNOT_EOK && steps <= weight; steps++) {
+		if (trie_it_finished(it)) {
+			trie_it_first(it);
+		}
+		zone_node_t *node = *trie_it_val(it);
+		if (zone_tree_current(tree, node->prev) != prev) {
+			ret = node_list_add(fixes, node, nsec3, false);
+			if (ret == KNOT_EOK) {
+				ret = node_list_add(fixes, prev, nsec3, false);
+			}
+		}
+		if (is_prev_target(node, nsec3)) {
+			if (!knot_dname_is_equal(node->owner, name)) {
+				break;
+			}
+			prev = node;
+		}
+		trie_it_next(it);
+	}
+
+	return ret;
+}
+
+/*! \brief Fixes previous nodes around the changed and removed nodes. */
+static int cow_adjust_prev(zone_contents_t *zone, bool nsec3)
+{
+	zone_tree_t *tree = nsec3 ? zone->nsec3_nodes : zone->nodes;
+	if (zone_tree_is_empty(tree)) {
+		return KNOT_EOK;
+	}
+
+	trie_it_t *it = trie_it_begin(tree);
+	if (it == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	// Pairs of the node to fix and its previous node.
+	node_list_t fixes = { 0 };
+	const node_list_t *seeds[] = { &zone->cow->changed, &zone->cow->removed };
+	int ret = KNOT_EOK;
+	for (int i = 0; i < 2; i++) {
+		for (size_t j = 0; ret == KNOT_EOK && j < seeds[i]->count; j++) {
+			const cow_node_t *item = &seeds[i]->items[j];
+			if (item->nsec3 == nsec3) {
+				ret = find_prev_fixes(tree, it, item->node->owner, nsec3, &fixes);
+			}
+		}
+	}
+	trie_it_free(it);
+
+	// The tree can't be modified while iterated.
+	for (size_t i = 0; ret == KNOT_EOK && i < fixes.count; i += 2) {
+		zone_node_t *node = zone_tree_current(tree, fixes.items[i].node);
+		fixes.items[i].node = cow_unshare(zone, node, nsec3);
+		if (fixes.items[i].node == NULL) {
+			ret = KNOT_ENOMEM;
+		}
+	}
+	for (size_t i = 0; ret == KNOT_EOK && i < fixes.count; i += 2) {
+		fixes.items[i].node->prev = zone_tree_current(tree, fixes.items[i + 1].node);
+	}
+	node_list_free(&fixes);
+
+	return ret;
+}
+
+/*! \brief Collects the nodes referring to the name (or the names below) in additionals. */
+static int collect_referrers(struct zone_gen *gen, const knot_dname_t *name,
+                             bool subtree, node_list_t *out)
+{
+	knot_dname_storage_t lf_storage;
+	uint8_t *lf = knot_dname_lf(name, &lf_storage);
+	assert(lf);
+
+	int ret = KNOT_EOK;
+	pthread_mutex_lock(&gen->lock);
+	if (!subtree) {
+		trie_val_t *val = trie_get_try(gen->referrers, (char *)lf + 1, *lf);
+		const referrers_t *refs = (val != NULL) ? *val : NULL;
+		for (uint32_t i = 0; ret == KNOT_EOK && refs != NULL && i < refs->count; i++) {
+			ret = node_list_add(out, refs->nodes[i], false, false);
+		}
+	} else {
+		trie_it_t *it = trie_it_begin(gen->referrers);
+		ret = (it == NULL) ? KNOT_ENOMEM : it_seek(it, lf);
+		while (ret == KNOT_EOK && it_in_subtree(it, lf)) {
+			const referrers_t *refs = *trie_it_val(it);
+			for (uint32_t i = 0; ret == KNOT_EOK && i < refs->count; i++) {
+				ret = node_list_add(out, refs->nodes[i], false, false);
+			}
+			trie_it_next(it);
+		}
+		trie_it_free(it);
+	}
+	pthread_mutex_unlock(&gen->lock);
+
+	return ret;
+}
+
+/*!
+ * \brief Copies the nodes with additionals which may point elsewhere now.
+ *
+ * Additionals of the shared nodes refer to the nodes by the owner (replaced
+ * nodes are looked up), only the nodes referring to names which appeared,
+ * disappeared, or changed the zone cut status are rediscovered.
+ */
+static int cow_unshare_referrers(zone_contents_t *zone, const node_list_t *recut)
+{
+	struct zone_cow *cow = zone->cow;
+	node_list_t referrers = { 0 };
+
+	int ret = KNOT_EOK;
+	for (size_t i = 0; ret == KNOT_EOK && i < recut->count; i++) {
+		ret = collect_referrers(zone->gen, recut->items[i].node->owner, false,
+		                        &referrers);
+	}
+
+	const node_list_t *lists[] = { &cow->changed, &cow->removed };
+	for (int i = 0; i < 2; i++) {
+		for (size_t j = 0; ret == KNOT_EOK && j < lists[i]->count; j++) {
+			const cow_node_t *item = &lists[i]->items[j];
+			if (item->nsec3 || (lists[i] == &cow->changed && !item->created)) {
+				continue;
+			}
+			// Closest enclosers below the name changed.
+			const knot_dname_t *owner = item->node->owner;
+			ret = collect_referrers(zone->gen, owner, true, &referrers);
+			// Wildcard expansion of the names below the parent changed.
+			if (ret == KNOT_EOK && knot_dname_is_wildcard(owner)) {
+				ret = collect_referrers(zone->gen, knot_wire_next_label(owner, NULL),
+				                        true, &referrers);
+			}
+		}
+	}
+
+	for (size_t i = 0; ret == KNOT_EOK && i < referrers.count; i++) {
+		zone_node_t *node = get_node(zone, referrers.items[i].node->owner);
+		if (node != NULL && cow_unshare(zone, node, false) == NULL) {
+			ret = KNOT_ENOMEM;
+		}
+	}
+	node_list_free(&referrers);
+
+	return ret;
+}
+
+/*!
+ * \brief Adjusts lazily copied contents, only around the changed nodes.
+ *
+ * \param complete  Set to false if the contents need full adjusting.
+ */
+static int cow_adjust(zone_contents_t *zone, bool *complete)
+{
+	struct zone_cow *cow = zone->cow;
+
+	zone->dnssec = node_rrtype_is_signed(zone->apex, KNOT_RRTYPE_SOA);
+
+	node_list_t recut = { 0 };
+	int ret = cow_adjust_cuts(zone, &recut);
+	if (ret == KNOT_EOK) {
+		ret = cow_adjust_nsec3(zone, complete);
+	}
+	if (ret != KNOT_EOK || !*complete) {
+		node_list_free(&recut);
+		return ret;
+	}
+
+	ret = cow_adjust_prev(zone, false);
+	if (ret == KNOT_EOK) {
+		ret = cow_adjust_prev(zone, true);
+	}
+	if (ret == KNOT_EOK) {
+		ret = cow_unshare_referrers(zone, &recut);
+	}
+	node_list_free(&recut);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	// All nodes changed and copied so far are final.
+	for (size_t i = 0; i < cow->changed.count; i++) {
+		cow_node_t *item = &cow->changed.items[i];
+		zone_node_t *node = item->node;
+		if (node->flags & NODE_FLAGS_SUPERSEDED) {
+			continue;
+		}
+
+		if (!item->nsec3) {
+			zone_adjust_arg_t arg = { .zone = zone };
+			ret = adjust_additional(&node, &arg);
+			if (ret == KNOT_EOK) {
+				pthread_mutex_lock(&zone->gen->lock);
+				ret = gen_add_node_referrers(zone->gen, node);
+				pthread_mutex_unlock(&zone->gen->lock);
+			}
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+		}
+
+		measure_size(node, &zone->size);
+	}
+
+	for (size_t i = 0; i < cow->changed.count; i++) {
+		cow->changed.items[i].node->flags &= ~NODE_FLAGS_NEW;
+	}
+	cow->changed.count = 0;
+	cow->removed.count = 0;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Queues the nodes allocated for the contents for release. */
+static void cow_discard(zone_contents_t *zone)
+{
+	struct zone_gen *gen = zone->gen;
+
+	pthread_mutex_lock(&gen->lock);
+	for (size_t i = 0; i < zone->cow->owned.count; i++) {
+		gen_collect(gen, zone->cow->owned.items[i].node);
+	}
+	pthread_mutex_unlock(&gen->lock);
+
+	cow_free(zone->cow);
+	zone->cow = NULL;
+}
+
+/*!
+ * \brief Replaces all nodes of the contents by copies in a new generation.
+ *
+ * \param zone  Zone contents.
+ * \param pack  Make packed copies, the contents must not share RR data.
+ */
+static int replace_nodes(zone_contents_t *zone, bool pack)
+{
+	knot_mm_t mm;
+	struct zone_gen *gen = gen_new(&mm);
+	if (gen == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	copy_ctx_t ctx = {
+		.apex = zone->apex,
+		.mm = &mm,
+		.pack = pack
+	};
+
+	zone_tree_t *nodes = NULL, *nsec3_nodes = NULL;
+	int ret = copy_tree(zone->nodes, &nodes, &ctx);
+	if (ret == KNOT_EOK && zone->nsec3_nodes != NULL) {
+		ctx.nsec3_parent = ctx.apex_copy;
+		ret = copy_tree(zone->nsec3_nodes, &nsec3_nodes, &ctx);
+	}
+	if (ret != KNOT_EOK) {
+		zone_tree_free(&nodes);
+		gen_release(gen);
+		return ret;
+	}
+	gen->nodes = zone_tree_count(nodes) + zone_tree_count(nsec3_nodes);
+
+	if (zone->cow != NULL) {
+		cow_discard(zone);
+	}
+	if (pack) {
+		// The packed copies own the RR data now.
+		(void)zone_tree_apply(zone->nodes, destroy_node_rrsets_from_tree, &zone->mm);
+		(void)zone_tree_apply(zone->nsec3_nodes, destroy_node_rrsets_from_tree, &zone->mm);
+	}
+	zone_tree_free(&zone->nodes);
+	zone_tree_free(&zone->nsec3_nodes);
+	zone->nodes = nodes;
+	zone->nsec3_nodes = nsec3_nodes;
+	zone->apex = ctx.apex_copy;
+
+	gen_release(zone->gen);
+	zone->gen = gen;
+	zone->mm = mm;
+
+	return KNOT_EOK;
+}
+
+/*! \brief Replaces all nodes of lazily copied contents by copies in a new generation. */
+static int cow_materialize(zone_contents_t *zone)
+{
+	if (zone->cow == NULL) {
+		return KNOT_EOK;
+	}
+
+	return replace_nodes(zone, false);
+}
+
+static int contents_adjust(zone_contents_t *contents, bool normal)
+{
+	if (contents == NULL || contents->apex == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	if (contents->cow != NULL && normal && !nsec3param_changed(contents)) {
+		bool complete = false;
+		int ret = cow_adjust(contents, &complete);
+		if (ret != KNOT_EOK || complete) {
+			return ret;
+		}
+	}
+
+	/* Lazily copied nodes can't be adjusted in place. */
+	int ret = cow_materialize(contents);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	ret = load_nsec3param(contents);
+	if (ret != KNOT_EOK) {
+		log_zone_error(contents->apex->owner,
+		               "failed to load NSEC3 parameters (%s)",
 		               knot_strerror(ret));
 		return ret;
 	}
@@ -1021,6 +2029,16 @@ int zone_contents_adjust_full(zone_contents_t *contents)
 	return contents_adjust(contents, true);
 }
 
+int zone_contents_pack(zone_contents_t *contents)
+{
+	if (contents == NULL || contents->cow != NULL ||
+	    __atomic_load_n(&contents->gen->refs, __ATOMIC_ACQUIRE) > 1) {
+		return KNOT_EINVAL;
+	}
+
+	return replace_nodes(contents, true);
+}
+
 int zone_contents_apply(zone_contents_t *contents,
                         zone_contents_apply_cb_t function, void *data)
 {
@@ -1066,42 +2084,201 @@ int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to
 	if (contents == NULL) {
 		return KNOT_ENOMEM;
 	}
+	contents->refs = 1;
 
-	int ret = recreate_normal_tree(from, contents);
-	if (ret != KNOT_EOK) {
-		zone_tree_free(&contents->nodes);
+	contents->gen = gen_new(&contents->mm);
+	if (contents->gen == NULL) {
 		free(contents);
+		return KNOT_ENOMEM;
+	}
+
+	copy_ctx_t ctx = {
+		.apex = from->apex,
+		.mm = &contents->mm
+	};
+
+	int ret = copy_tree(from->nodes, &contents->nodes, &ctx);
+	if (ret != KNOT_EOK) {
+		zone_contents_free(&contents);
 		return ret;
 	}
+	assert(ctx.apex_copy != NULL);
+	contents->apex = ctx.apex_copy;
 
 	if (from->nsec3_nodes) {
-		ret = recreate_nsec3_tree(from, contents);
+		ctx.nsec3_parent = contents->apex;
+		ret = copy_tree(from->nsec3_nodes, &contents->nsec3_nodes, &ctx);
 		if (ret != KNOT_EOK) {
-			zone_tree_free(&contents->nodes);
-			zone_tree_free(&contents->nsec3_nodes);
-			free(contents);
+			zone_contents_free(&contents);
 			return ret;
 		}
 	} else {
 		contents->nsec3_nodes = NULL;
 	}
+	contents->gen->nodes = zone_tree_count(contents->nodes) +
+	                       zone_tree_count(contents->nsec3_nodes);
+
+	*to = contents;
+	return KNOT_EOK;
+}
+
+static int index_referrers(zone_node_t **node, void *data)
+{
+	return gen_add_node_referrers(data, *node);
+}
+
+/*!
+ * \brief Builds the index of the nodes with additionals in the generation.
+ *
+ * \note The generation must be locked.
+ */
+static int gen_index(struct zone_gen *gen, zone_contents_t *contents)
+{
+	gen->referrers = trie_create(NULL);
+	if (gen->referrers == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int ret = zone_tree_apply(contents->nodes, index_referrers, gen);
+	if (ret != KNOT_EOK) {
+		(void)trie_apply(gen->referrers, free_referrers, NULL);
+		trie_free(gen->referrers);
+		gen->referrers = NULL;
+	}
+
+	return ret;
+}
+
+int zone_contents_cow(zone_contents_t *from, zone_contents_t **to)
+{
+	if (from == NULL || to == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	/* Start a new generation once most of the nodes are replaced ones. */
+	struct zone_gen *gen = from->gen;
+	size_t live = zone_tree_count(from->nodes) + zone_tree_count(from->nsec3_nodes);
+	if (__atomic_load_n(&gen->nodes, __ATOMIC_RELAXED) > 2 * live) {
+		return zone_contents_shallow_copy(from, to);
+	}
+
+	pthread_mutex_lock(&gen->lock);
+	int ret = (gen->referrers == NULL) ? gen_index(gen, from) : KNOT_EOK;
+	pthread_mutex_unlock(&gen->lock);
+	if (ret != KNOT_EOK) {
+		return ret;
+	}
+
+	zone_contents_t *contents = calloc(1, sizeof(zone_contents_t));
+	if (contents == NULL) {
+		return KNOT_ENOMEM;
+	}
+	contents->refs = 1;
+
+	contents->cow = calloc(1, sizeof(struct zone_cow));
+	contents->nodes = trie_cow(from->nodes);
+	if (from->nsec3_nodes != NULL) {
+		contents->nsec3_nodes = trie_cow(from->nsec3_nodes);
+	}
+	if (contents->cow == NULL || contents->nodes == NULL ||
+	    (from->nsec3_nodes != NULL && contents->nsec3_nodes == NULL) ||
+	    (from->nsec3_params.salt.size > 0 &&
+	     dnssec_binary_dup(&from->nsec3_params.salt,
+	                       &contents->nsec3_params.salt) != DNSSEC_EOK)) {
+		free(contents->cow);
+		zone_tree_free(&contents->nodes);
+		zone_tree_free(&contents->nsec3_nodes);
+		free(contents);
+		return KNOT_ENOMEM;
+	}
+	contents->nsec3_params.algorithm = from->nsec3_params.algorithm;
+	contents->nsec3_params.flags = from->nsec3_params.flags;
+	contents->nsec3_params.iterations = from->nsec3_params.iterations;
+
+	contents->apex = from->apex;
+	contents->size = from->size;
+	contents->dnssec = from->dnssec;
+
+	__atomic_add_fetch(&gen->refs, 1, __ATOMIC_RELAXED);
+	contents->gen = gen;
+	contents->mm = from->mm;
 
 	*to = contents;
 	return KNOT_EOK;
 }
 
+int zone_contents_unshare(zone_contents_t *contents)
+{
+	if (contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	return cow_materialize(contents);
+}
+
+static int free_additional(zone_node_t **node, void *data)
+{
+	UNUSED(data);
+
+	/* Queued ones are released with the generation. */
+	if ((*node)->flags & NODE_FLAGS_GARBAGE) {
+		return KNOT_EOK;
+	}
+
+	for (uint16_t i = 0; i < (*node)->rrset_count; ++i) {
+		struct rr_data *data = &(*node)->rrs[i];
+		additional_clear(data->additional);
+		data->additional = NULL;
+	}
+
+	return KNOT_EOK;
+}
+
+void zone_contents_clear_additionals(zone_contents_t *contents)
+{
+	if (contents == NULL) {
+		return;
+	}
+
+	/* Only the nodes replaced in the successor are not used anymore. */
+	zone_contents_t *next = contents->next;
+	if (next != NULL && next->gen == contents->gen) {
+		assert(next->cow != NULL);
+		pthread_mutex_lock(&contents->gen->lock);
+		for (size_t i = 0; i < next->cow->replaced.count; i++) {
+			gen_collect(contents->gen, next->cow->replaced.items[i].node);
+		}
+		pthread_mutex_unlock(&contents->gen->lock);
+		return;
+	}
+
+	/* Abandoned update, the previous version keeps its nodes. */
+	if (next == NULL && contents->cow != NULL) {
+		cow_discard(contents);
+		return;
+	}
+
+	(void)zone_tree_apply(contents->nodes, free_additional, NULL);
+}
+
 void zone_contents_free(zone_contents_t **contents)
 {
 	if (contents == NULL || *contents == NULL) {
 		return;
 	}
 
-	// free the zone tree, but only the structure
+	// free the zone tree, the nodes are released with the memory pool
 	zone_tree_free(&(*contents)->nodes);
 	zone_tree_free(&(*contents)->nsec3_nodes);
 
 	dnssec_nsec3_params_free(&(*contents)->nsec3_params);
 
+	if ((*contents)->cow != NULL) {
+		cow_free((*contents)->cow);
+	}
+	gen_release((*contents)->gen);
+	answer_cache_free((*contents)->answer_cache);
+	ixfr_cache_free((*contents)->ixfr_cache);
 	free(*contents);
 	*contents = NULL;
 }
@@ -1115,16 +2292,61 @@ void zone_contents_deep_free(zone_contents_t **contents)
 	if (*contents != NULL) {
 		// Delete NSEC3 tree
 		(void)zone_tree_apply((*contents)->nsec3_nodes,
-		                      destroy_node_rrsets_from_tree, NULL);
+		                      destroy_node_rrsets_from_tree, &(*contents)->mm);
 
 		// Delete normal tree
 		(void)zone_tree_apply((*contents)->nodes,
-		                      destroy_node_rrsets_from_tree, NULL);
+		                      destroy_node_rrsets_from_tree, &(*contents)->mm);
 	}
 
 	zone_contents_free(contents);
 }
 
+zone_contents_t *zone_contents_retain(zone_contents_t *contents)
+{
+	if (contents != NULL) {
+		__sync_add_and_fetch(&contents->refs, 1);
+	}
+
+	return contents;
+}
+
+void zone_contents_release(zone_contents_t *contents)
+{
+	/* Releasing a version may release the chained successors too. */
+	while (contents != NULL && __sync_sub_and_fetch(&contents->refs, 1) == 0) {
+		zone_contents_t *next = contents->next;
+		if (contents->release != NULL) {
+			contents->release(contents, contents->release_data);
+		} else {
+			zone_contents_deep_free(&contents);
+		}
+		contents = next;
+	}
+}
+
+void zone_contents_chain(zone_contents_t *prev, zone_contents_t *next)
+{
+	if (prev == NULL || next == NULL) {
+		return;
+	}
+
+	assert(prev->next == NULL);
+	prev->next = zone_contents_retain(next);
+}
+
+void zone_contents_retire(zone_contents_t *contents,
+                          zone_contents_release_cb_t release, void *data)
+{
+	if (contents == NULL) {
+		return;
+	}
+
+	contents->release = release;
+	contents->release_data = data;
+	zone_contents_release(contents);
+}
+
 uint32_t zone_contents_serial(const zone_contents_t *zone)
 {
 	if (zone == NULL) {
@@ -1166,3 +2388,56 @@ size_t zone_contents_measure_size(zone_contents_t *zone)
 	zone_contents_apply(zone, measure_size, &zone->size);
 	return zone->size;
 }
+
+answer_cache_t *zone_contents_answer_cache(zone_contents_t *zone, unsigned size)
+{
+	if (zone == NULL) {
+		return NULL;
+	}
+
+	answer_cache_t *cache = __atomic_load_n(&zone->answer_cache, __ATOMIC_ACQUIRE);
+	if (cache != NULL) {
+		return cache;
+	}
+
+	/* Concurrent creators race, the loser releases its cache. */
+	cache = answer_cache_new(size);
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	answer_cache_t *expected = NULL;
+	if (!__atomic_compare_exchange_n(&zone->answer_cache, &expected, cache, false,
+	                                 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		answer_cache_free(cache);
+		cache = expected;
+	}
+
+	return cache;
+}
+
+ixfr_cache_t *zone_contents_ixfr_cache(zone_contents_t *zone)
+{
+	if (zone == NULL) {
+		return NULL;
+	}
+
+	ixfr_cache_t *cache = __atomic_load_n(&zone->ixfr_cache, __ATOMIC_ACQUIRE);
+	if (cache != NULL) {
+		return cache;
+	}
+
+	cache = ixfr_cache_new();
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	ixfr_cache_t *expected = NULL;
+	if (!__atomic_compare_exchange_n(&zone->ixfr_cache, &expected, cache, false,
+	                                 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		ixfr_cache_free(cache);
+		cache = expected;
+	}
+
+	return cache;
+}
@@ -26,6 +26,8 @@
 
 #include "dnssec/nsec.h"
 #include "libknot/rrtype/nsec3param.h"
+#include "knot/zone/answer-cache.h"
+#include "knot/zone/ixfr-cache.h"
 #include "knot/zone/node.h"
 #include "knot/zone/zone-tree.h"
 
@@ -34,6 +36,13 @@ enum zone_contents_find_dname_result {
 	ZONE_NAME_FOUND     = 1
 };
 
+struct zone_contents;
+
+/*!
+ * \brief Signature of callback releasing retired zone contents.
+ */
+typedef void (*zone_contents_release_cb_t)(struct zone_contents *contents, void *data);
+
 typedef struct zone_contents {
 	zone_node_t *apex;       /*!< Apex node of the zone (holding SOA) */
 
@@ -43,8 +52,57 @@ typedef struct zone_contents {
 	dnssec_nsec3_params_t nsec3_params;
 	size_t size;
 	bool dnssec;
+
+	knot_mm_t mm;                       /*!< Memory context for the nodes. */
+	struct zone_gen *gen;               /*!< Generation the nodes are allocated in. */
+	struct zone_cow *cow;               /*!< Changes of a lazy copy (NULL if full). */
+	answer_cache_t *answer_cache;       /*!< Pre-rendered answers (lazily created). */
+	ixfr_cache_t *ixfr_cache;           /*!< Histories leading here (lazily created). */
+
+	size_t refs;                        /*!< Snapshot references (incl. owner). */
+	struct zone_contents *next;         /*!< Successor sharing data with these. */
+	zone_contents_release_cb_t release; /*!< Release callback (once retired). */
+	void *release_data;                 /*!< Release callback context. */
 } zone_contents_t;
 
+/*!
+ * \brief Returns the current parent of the node in the contents.
+ *
+ * Nodes shared with the previous version (see zone_contents_cow()) may point
+ * to replaced nodes, which are looked up instead (see zone_tree_current()).
+ */
+inline static zone_node_t *zone_contents_node_parent(const zone_contents_t *contents,
+                                                     const zone_node_t *node)
+{
+	const zone_node_t *parent = node->parent;
+	if (parent != NULL && parent->parent == NULL) {
+		return contents->apex;
+	}
+
+	return zone_tree_current(contents->nodes, parent);
+}
+
+/*! \brief Returns the current previous node of the (non-NSEC3) node in the contents. */
+inline static zone_node_t *zone_contents_node_prev(const zone_contents_t *contents,
+                                                   const zone_node_t *node)
+{
+	return zone_tree_current(contents->nodes, node->prev);
+}
+
+/*! \brief Returns the current NSEC3 node of the node in the contents. */
+inline static zone_node_t *zone_contents_node_nsec3(const zone_contents_t *contents,
+                                                    const zone_node_t *node)
+{
+	return zone_tree_current(contents->nsec3_nodes, node->nsec3_node);
+}
+
+/*! \brief Returns the current glue node in the contents (NULL if removed). */
+inline static zone_node_t *zone_contents_glue_node(const zone_contents_t *contents,
+                                                   const glue_t *glue)
+{
+	return zone_tree_current(contents->nodes, glue->node);
+}
+
 /*!
  * \brief Signature of callback for zone contents apply functions.
  */
@@ -82,7 +140,10 @@ int zone_contents_add_rr(zone_contents_t *z, const knot_rrset_t *rr, zone_node_t
 int zone_contents_remove_rr(zone_contents_t *z, const knot_rrset_t *rr, zone_node_t **n);
 
 /*!
- * \brief Get the node with this RR (the RR's owner).
+ * \brief Get the node with this RR (the RR's owner) for modification.
+ *
+ * A node of lazily copied contents shared with the previous version is
+ * replaced by its private copy.
  *
  * \param zone   Contents to add to.
  * \param rrset  The RR to add.
@@ -91,6 +152,19 @@ int zone_contents_remove_rr(zone_contents_t *z, const knot_rrset_t *rr, zone_nod
  */
 zone_node_t *zone_contents_get_node_for_rr(zone_contents_t *zone, const knot_rrset_t *rrset);
 
+/*!
+ * \brief Delete a node that has no RRSets and no children, and its parents
+ *        that become empty (except for the apex).
+ *
+ * \param contents  Contents to delete from.
+ * \param tree      The tree of the node (normal or NSEC3).
+ * \param node      The node to delete (as returned by zone_contents_get_node_for_rr()).
+ *
+ * \return KNOT_E*
+ */
+int zone_contents_delete_empty_node(zone_contents_t *contents, zone_tree_t *tree,
+                                    zone_node_t *node);
+
 /*!
  * \brief Tries to find a node with the specified name in the zone.
  *
@@ -188,6 +262,19 @@ int zone_contents_adjust_pointers(zone_contents_t *contents);
  */
 int zone_contents_adjust_full(zone_contents_t *contents);
 
+/*!
+ * \brief Replaces all nodes by packed ones with the RR data embedded.
+ *
+ * A lookup ending with the RRSet retrieval then stays within one memory
+ * block. Meant for freshly loaded contents not shared with other versions,
+ * the contents must be adjusted afterwards.
+ *
+ * \param contents Zone contents to be packed.
+ *
+ * \return KNOT_E*
+ */
+int zone_contents_pack(zone_contents_t *contents);
+
 /*!
  * \brief Applies the given function to each regular node in the zone.
  *
@@ -227,9 +314,52 @@ int zone_contents_nsec3_apply(zone_contents_t *contents,
  */
 int zone_contents_shallow_copy(const zone_contents_t *from, zone_contents_t **to);
 
+/*!
+ * \brief Creates a lazy copy of the zone for an update.
+ *
+ * The copy shares the trees and the nodes with the original. A node is
+ * copied once it's modified in the copy, the adjusting of the copy is then
+ * limited to the surroundings of the changed nodes. A shallow copy is made
+ * instead if the nodes replaced by the copies take too much memory.
+ *
+ * \param from  Original zone.
+ * \param to    Copy of the zone.
+ *
+ * \retval KNOT_EOK
+ * \retval KNOT_EINVAL
+ * \retval KNOT_ENOMEM
+ */
+int zone_contents_cow(zone_contents_t *from, zone_contents_t **to);
+
+/*!
+ * \brief Replaces all nodes of a lazy copy by private ones.
+ *
+ * Needed before modifying the nodes other than by adding and removing RRs
+ * (e.g. by DNSSEC signing). Nothing is done for a shallow copy.
+ *
+ * \param contents  Zone contents.
+ *
+ * \return KNOT_E*
+ */
+int zone_contents_unshare(zone_contents_t *contents);
+
+/*!
+ * \brief Frees the additionals of the nodes not used by the successor.
+ *
+ * For a version with a successor sharing the nodes (see zone_contents_cow()),
+ * only the nodes replaced by the successor are released, once the nodes
+ * are released. Additionals of an unused lazy copy are released likewise.
+ *
+ * \param contents  Zone contents.
+ */
+void zone_contents_clear_additionals(zone_contents_t *contents);
+
 /*!
  * \brief Deallocate directly owned data of zone contents.
  *
+ * The nodes are released at once with the last contents of their generation,
+ * the RR data in them are kept. The answer and IXFR caches are released too.
+ *
  * \param contents  Zone contents to free.
  */
 void zone_contents_free(zone_contents_t **contents);
@@ -241,6 +371,55 @@ void zone_contents_free(zone_contents_t **contents);
  */
 void zone_contents_deep_free(zone_contents_t **contents);
 
+/*!
+ * \brief Take a snapshot reference to published zone contents.
+ *
+ * The contents stay valid until zone_contents_release() even outside of
+ * the RCU read section, so long-running readers (e.g. outgoing transfers)
+ * don't hold back zone updates.
+ *
+ * \note Must be called within the RCU read section the contents were
+ *       obtained in.
+ *
+ * \param contents  Zone contents.
+ *
+ * \return The same contents.
+ */
+zone_contents_t *zone_contents_retain(zone_contents_t *contents);
+
+/*!
+ * \brief Drop a snapshot reference, see zone_contents_retain().
+ *
+ * \param contents  Zone contents (may be NULL).
+ */
+void zone_contents_release(zone_contents_t *contents);
+
+/*!
+ * \brief Link zone contents with their successor version.
+ *
+ * The successor shares data with the predecessor and its update frees some
+ * of them, so it isn't released before all the older versions are.
+ *
+ * \param prev  Replaced zone contents.
+ * \param next  New zone contents.
+ */
+void zone_contents_chain(zone_contents_t *prev, zone_contents_t *next);
+
+/*!
+ * \brief Drop the owner reference of unpublished zone contents.
+ *
+ * The release callback is called once the last snapshot reference is dropped
+ * and all older versions are released, possibly immediately.
+ *
+ * \note Must be called after the RCU grace period following unpublishing.
+ *
+ * \param contents  Zone contents to be released (may be NULL).
+ * \param release   Release callback, NULL for zone_contents_deep_free().
+ * \param data      Release callback context.
+ */
+void zone_contents_retire(zone_contents_t *contents,
+                          zone_contents_release_cb_t release, void *data);
+
 /*!
  * \brief Fetch zone serial.
  *
@@ -274,4 +453,23 @@ bool zone_contents_is_empty(const zone_contents_t *zone);
  */
 size_t zone_contents_measure_size(zone_contents_t *zone);
 
+/*!
+ * \brief Get the answer cache of the zone contents, create it if needed.
+ *
+ * \param zone  Zone contents.
+ * \param size  Cache size used if the cache doesn't exist yet.
+ *
+ * \return Answer cache or NULL on error.
+ */
+answer_cache_t *zone_contents_answer_cache(zone_contents_t *zone, unsigned size);
+
+/*!
+ * \brief Get the IXFR cache of the zone contents, create it if needed.
+ *
+ * \param zone  Zone contents.
+ *
+ * \return IXFR cache or NULL on error.
+ */
+ixfr_cache_t *zone_contents_ixfr_cache(zone_contents_t *zone);
+
 /*! @} */
@@ -0,0 +1,101 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "knot/zone/ixfr-cache.h"
+
+struct ixfr_cache {
+	pthread_mutex_t lock;
+	unsigned count;
+	ixfr_range_t ranges[IXFR_CACHE_SIZE];
+};
+
+static const ixfr_range_t *find_range(const ixfr_cache_t *cache, uint32_t serial_from)
+{
+	for (unsigned i = 0; i < cache->count; i++) {
+		if (cache->ranges[i].serial_from == serial_from) {
+			return &cache->ranges[i];
+		}
+	}
+
+	return NULL;
+}
+
+ixfr_cache_t *ixfr_cache_new(void)
+{
+	ixfr_cache_t *cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_init(&cache->lock, NULL);
+
+	return cache;
+}
+
+void ixfr_cache_free(ixfr_cache_t *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	for (unsigned i = 0; i < cache->count; i++) {
+		free((uint8_t *)cache->ranges[i].data);
+	}
+	pthread_mutex_destroy(&cache->lock);
+
+	free(cache);
+}
+
+const ixfr_range_t *ixfr_cache_get(ixfr_cache_t *cache, uint32_t serial_from)
+{
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	const ixfr_range_t *range = find_range(cache, serial_from);
+	pthread_mutex_unlock(&cache->lock);
+
+	return range;
+}
+
+const ixfr_range_t *ixfr_cache_put(ixfr_cache_t *cache, uint32_t serial_from,
+                                   uint8_t *data, size_t size)
+{
+	if (cache == NULL || data == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	const ixfr_range_t *range = find_range(cache, serial_from);
+	if (range != NULL) {
+		/* Stored by a concurrent transfer meanwhile. */
+		free(data);
+	} else if (cache->count < IXFR_CACHE_SIZE) {
+		ixfr_range_t *new_range = &cache->ranges[cache->count];
+		new_range->serial_from = serial_from;
+		new_range->data = data;
+		new_range->size = size;
+		cache->count++;
+		range = new_range;
+	}
+	pthread_mutex_unlock(&cache->lock);
+
+	return range;
+}
@@ -0,0 +1,90 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * Cache of serialized IXFR histories.
+ *
+ * Secondary servers usually ask for the same difference shortly after a zone
+ * change. The cache keeps serialized changesets leading to one version of the
+ * zone contents, keyed by the starting serial, so that concurrent and repeated
+ * IXFR-out transfers don't read the journal again. It's owned by the contents
+ * and the entries are never replaced, so they stay valid as long as the
+ * contents do.
+ *
+ * \addtogroup zone
+ * @{
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*! \brief Maximal number of cached histories per zone contents. */
+#define IXFR_CACHE_SIZE 8
+
+typedef struct ixfr_cache ixfr_cache_t;
+
+/*!
+ * \brief Cached history in the journal serialization format.
+ */
+typedef struct {
+	uint32_t serial_from;  /*!< Starting serial. */
+	const uint8_t *data;   /*!< Serialized changesets. */
+	size_t size;           /*!< Size of the serialized changesets. */
+} ixfr_range_t;
+
+/*!
+ * \brief Creates a new IXFR cache.
+ *
+ * \return New cache or NULL on error.
+ */
+ixfr_cache_t *ixfr_cache_new(void);
+
+/*!
+ * \brief Releases the IXFR cache including the cached data.
+ */
+void ixfr_cache_free(ixfr_cache_t *cache);
+
+/*!
+ * \brief Looks up a history starting at the given serial.
+ *
+ * \param cache        IXFR cache.
+ * \param serial_from  Starting serial.
+ *
+ * \return Cached history or NULL if not found.
+ */
+const ixfr_range_t *ixfr_cache_get(ixfr_cache_t *cache, uint32_t serial_from);
+
+/*!
+ * \brief Stores the history, taking ownership of the data.
+ *
+ * If the same history is already cached, the data are freed and the cached
+ * entry is returned instead.
+ *
+ * \param cache        IXFR cache.
+ * \param serial_from  Starting serial.
+ * \param data         Serialized changesets (malloc'ed).
+ * \param size         Size of the serialized changesets.
+ *
+ * \return Cached history or NULL if the cache is full (the data stay owned
+ *         by the caller).
+ */
+const ixfr_range_t *ixfr_cache_put(ixfr_cache_t *cache, uint32_t serial_from,
+                                   uint8_t *data, size_t size);
+
+/*! @} */
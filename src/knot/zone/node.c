@@ -29,16 +29,18 @@ void additional_clear(additional_t *additional)
 }
 
 /*! \brief Clears allocated data in RRSet entry. */
-static void rr_data_clear(struct rr_data *data, knot_mm_t *mm)
+static void rr_data_clear(const zone_node_t *node, struct rr_data *data)
 {
-	knot_rdataset_clear(&data->rrs, mm);
+	if (!node_rdataset_embedded(node, &data->rrs)) {
+		knot_rdataset_clear(&data->rrs, NULL);
+	}
 	additional_clear(data->additional);
 }
 
 /*! \brief Clears allocated data in RRSet entry. */
-static int rr_data_from(const knot_rrset_t *rrset, struct rr_data *data, knot_mm_t *mm)
+static int rr_data_from(const knot_rrset_t *rrset, struct rr_data *data)
 {
-	int ret = knot_rdataset_copy(&data->rrs, &rrset->rrs, mm);
+	int ret = knot_rdataset_copy(&data->rrs, &rrset->rrs, NULL);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -49,6 +51,63 @@ static int rr_data_from(const knot_rrset_t *rrset, struct rr_data *data, knot_mm
 	return KNOT_EOK;
 }
 
+/*! \brief Returns the RRSet array embedded in the node. */
+static struct rr_data *embedded_rrs(const zone_node_t *node)
+{
+	return (struct rr_data *)(node + 1);
+}
+
+/*! \brief Returns the offset of the RR data area behind the embedded owner. */
+static size_t rdata_offset(size_t owner_end)
+{
+	size_t align = sizeof(uint32_t);
+	return (owner_end + align - 1) / align * align;
+}
+
+/*! \brief Returns the size header of the RR data area embedded in the node. */
+static uint32_t *rdata_header(const zone_node_t *node)
+{
+	size_t owner_end = sizeof(*node) + node->rrs_embedded * sizeof(struct rr_data);
+	if (node->owner != NULL) {
+		owner_end += knot_dname_size(node->owner);
+	}
+
+	return (uint32_t *)((uint8_t *)node + rdata_offset(owner_end));
+}
+
+/*!
+ * \brief Allocates a node with embedded RRSet array, owner, and RR data.
+ *
+ * The RR data area is preceded by its size, so that the embedded RR data
+ * can be told apart from the separately allocated ones.
+ */
+static zone_node_t *node_alloc(const knot_dname_t *owner, uint8_t rrs_capacity,
+                               uint32_t rdata_size, knot_mm_t *mm)
+{
+	size_t owner_size = (owner != NULL) ? knot_dname_size(owner) : 0;
+	size_t rrs_size = rrs_capacity * sizeof(struct rr_data);
+	size_t header_pos = rdata_offset(sizeof(zone_node_t) + rrs_size + owner_size);
+
+	zone_node_t *node = mm_alloc(mm, header_pos + sizeof(uint32_t) + rdata_size);
+	if (node == NULL) {
+		return NULL;
+	}
+	memset(node, 0, sizeof(*node));
+
+	node->rrs = embedded_rrs(node);
+	node->rrs_embedded = rrs_capacity;
+	if (owner != NULL) {
+		node->owner = (knot_dname_t *)node->rrs + rrs_size;
+		memcpy(node->owner, owner, owner_size);
+	}
+	*rdata_header(node) = rdata_size;
+
+	// Node is authoritative by default.
+	node->flags = NODE_FLAGS_AUTH;
+
+	return node;
+}
+
 /*! \brief Adds RRSet to node directly. */
 static int add_rrset_no_merge(zone_node_t *node, const knot_rrset_t *rrset,
                               knot_mm_t *mm)
@@ -59,12 +118,22 @@ static int add_rrset_no_merge(zone_node_t *node, const knot_rrset_t *rrset,
 
 	const size_t prev_nlen = node->rrset_count * sizeof(struct rr_data);
 	const size_t nlen = (node->rrset_count + 1) * sizeof(struct rr_data);
-	void *p = mm_realloc(mm, node->rrs, nlen, prev_nlen);
-	if (p == NULL) {
-		return KNOT_ENOMEM;
+	if (node->rrs != embedded_rrs(node)) {
+		void *p = mm_realloc(mm, node->rrs, nlen, prev_nlen);
+		if (p == NULL) {
+			return KNOT_ENOMEM;
+		}
+		node->rrs = p;
+	} else if (node->rrset_count == node->rrs_embedded) {
+		// Move out of the embedded array.
+		void *p = mm_alloc(mm, nlen);
+		if (p == NULL) {
+			return KNOT_ENOMEM;
+		}
+		memcpy(p, node->rrs, prev_nlen);
+		node->rrs = p;
 	}
-	node->rrs = p;
-	int ret = rr_data_from(rrset, node->rrs + node->rrset_count, mm);
+	int ret = rr_data_from(rrset, node->rrs + node->rrset_count);
 	if (ret != KNOT_EOK) {
 		return ret;
 	}
@@ -85,24 +154,8 @@ static bool ttl_changed(struct rr_data *node_data, const knot_rrset_t *rrset)
 
 zone_node_t *node_new(const knot_dname_t *owner, knot_mm_t *mm)
 {
-	zone_node_t *ret = mm_alloc(mm, sizeof(zone_node_t));
-	if (ret == NULL) {
-		return NULL;
-	}
-	memset(ret, 0, sizeof(*ret));
-
-	if (owner) {
-		ret->owner = knot_dname_copy(owner, mm);
-		if (ret->owner == NULL) {
-			mm_free(mm, ret);
-			return NULL;
-		}
-	}
-
-	// Node is authoritative by default.
-	ret->flags = NODE_FLAGS_AUTH;
-
-	return ret;
+	// Most of the nodes are created for an RRSet.
+	return node_alloc(owner, 1, 0, mm);
 }
 
 void node_free_rrsets(zone_node_t *node, knot_mm_t *mm)
@@ -112,11 +165,13 @@ void node_free_rrsets(zone_node_t *node, knot_mm_t *mm)
 	}
 
 	for (uint16_t i = 0; i < node->rrset_count; ++i) {
-		rr_data_clear(&node->rrs[i], mm);
+		rr_data_clear(node, &node->rrs[i]);
 	}
 
-	mm_free(mm, node->rrs);
-	node->rrs = NULL;
+	if (node->rrs != embedded_rrs(node)) {
+		mm_free(mm, node->rrs);
+		node->rrs = embedded_rrs(node);
+	}
 	node->rrset_count = 0;
 }
 
@@ -126,24 +181,42 @@ void node_free(zone_node_t **node, knot_mm_t *mm)
 		return;
 	}
 
-	if ((*node)->rrs != NULL) {
+	if ((*node)->rrs != embedded_rrs(*node)) {
 		mm_free(mm, (*node)->rrs);
 	}
 
-	knot_dname_free(&(*node)->owner, mm);
-
 	mm_free(mm, *node);
 	*node = NULL;
 }
 
-zone_node_t *node_shallow_copy(const zone_node_t *src, knot_mm_t *mm)
+/*!
+ * \brief Copies the node, the RR data embedded in the copy are selected.
+ *
+ * \param src   Source of the copy.
+ * \param pack  Embed all RR data, otherwise only those embedded in the source.
+ * \param mm    Memory context for the copy.
+ */
+static zone_node_t *node_copy(const zone_node_t *src, bool pack, knot_mm_t *mm)
 {
 	if (src == NULL) {
 		return NULL;
 	}
 
-	// create new node
-	zone_node_t *dst = node_new(src->owner, mm);
+	size_t rdata_size = 0;
+	for (uint16_t i = 0; i < src->rrset_count; ++i) {
+		const knot_rdataset_t *rrs = &src->rrs[i].rrs;
+		if (pack || node_rdataset_embedded(src, rrs)) {
+			rdata_size += knot_rdataset_size(rrs);
+		}
+	}
+	if (rdata_size > UINT32_MAX) {
+		return NULL;
+	}
+
+	// create new node with exactly fitting RRSet array
+	bool fits = (src->rrset_count <= UINT8_MAX);
+	zone_node_t *dst = node_alloc(src->owner, fits ? src->rrset_count : 0,
+	                              rdata_size, mm);
 	if (dst == NULL) {
 		return NULL;
 	}
@@ -151,23 +224,74 @@ zone_node_t *node_shallow_copy(const zone_node_t *src, knot_mm_t *mm)
 	dst->flags = src->flags;
 
 	// copy RRSets
-	dst->rrset_count = src->rrset_count;
 	size_t rrlen = sizeof(struct rr_data) * src->rrset_count;
-	dst->rrs = mm_alloc(mm, rrlen);
-	if (dst->rrs == NULL) {
-		node_free(&dst, mm);
-		return NULL;
+	if (!fits) {
+		dst->rrs = mm_alloc(mm, rrlen);
+		if (dst->rrs == NULL) {
+			mm_free(mm, dst);
+			return NULL;
+		}
 	}
+	dst->rrset_count = src->rrset_count;
 	memcpy(dst->rrs, src->rrs, rrlen);
 
+	uint8_t *rdata = (uint8_t *)(rdata_header(dst) + 1);
 	for (uint16_t i = 0; i < src->rrset_count; ++i) {
 		// Clear additionals in the copy.
 		dst->rrs[i].additional = NULL;
+
+		// Embedded RR data are owned by the node they are embedded in.
+		knot_rdataset_t *rrs = &dst->rrs[i].rrs;
+		size_t size = knot_rdataset_size(rrs);
+		if (size > 0 && (pack || node_rdataset_embedded(src, rrs))) {
+			memcpy(rdata, rrs->data, size);
+			rrs->data = (knot_rdata_t *)rdata;
+			rdata += size;
+		}
 	}
 
 	return dst;
 }
 
+zone_node_t *node_shallow_copy(const zone_node_t *src, knot_mm_t *mm)
+{
+	return node_copy(src, false, mm);
+}
+
+zone_node_t *node_pack(const zone_node_t *src, knot_mm_t *mm)
+{
+	return node_copy(src, true, mm);
+}
+
+bool node_rdataset_embedded(const zone_node_t *node, const knot_rdataset_t *rrs)
+{
+	if (node == NULL || rrs == NULL || rrs->data == NULL) {
+		return false;
+	}
+
+	const uint32_t *header = rdata_header(node);
+	const uint8_t *begin = (const uint8_t *)(header + 1);
+	const uint8_t *data = (const uint8_t *)rrs->data;
+
+	return data >= begin && data < begin + *header;
+}
+
+int node_unpack_rdataset(zone_node_t *node, knot_rdataset_t *rrs)
+{
+	if (!node_rdataset_embedded(node, rrs)) {
+		return KNOT_EOK;
+	}
+
+	// The embedded data are released with the node.
+	knot_rdataset_t embedded = *rrs;
+	int ret = knot_rdataset_copy(rrs, &embedded, NULL);
+	if (ret != KNOT_EOK) {
+		*rrs = embedded;
+	}
+
+	return ret;
+}
+
 int node_add_rrset(zone_node_t *node, const knot_rrset_t *rrset, knot_mm_t *mm)
 {
 	if (node == NULL || rrset == NULL) {
@@ -177,13 +301,17 @@ int node_add_rrset(zone_node_t *node, const knot_rrset_t *rrset, knot_mm_t *mm)
 	for (uint16_t i = 0; i < node->rrset_count; ++i) {
 		if (node->rrs[i].type == rrset->type) {
 			struct rr_data *node_data = &node->rrs[i];
+			int ret = node_unpack_rdataset(node, &node_data->rrs);
+			if (ret != KNOT_EOK) {
+				return ret;
+			}
+
 			const bool ttl_change = ttl_changed(node_data, rrset);
 			if (ttl_change) {
 				node_data->ttl = rrset->ttl;
 			}
 
-			int ret = knot_rdataset_merge(&node_data->rrs,
-			                              &rrset->rrs, mm);
+			ret = knot_rdataset_merge(&node_data->rrs, &rrset->rrs, NULL);
 			if (ret != KNOT_EOK) {
 				return ret;
 			} else {
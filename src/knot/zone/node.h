@@ -26,6 +26,10 @@ struct rr_data;
 /*!
  * \brief Structure representing one node in a domain name tree, i.e. one domain
  *        name in a zone.
+ *
+ * The node is allocated as a single block followed by the embedded RRSet
+ * array (used until the RRSets don't fit), the owner, and the area for
+ * embedded RR data. The area is empty unless the node is packed.
  */
 typedef struct zone_node {
 	knot_dname_t *owner; /*!< Domain name being the owner of this node. */
@@ -43,6 +47,7 @@ typedef struct zone_node {
 	uint32_t children; /*!< Count of children nodes in DNS hierarchy. */
 	uint16_t rrset_count; /*!< Number of RRSets stored in the node. */
 	uint8_t flags; /*!< \ref node_flags enum. */
+	uint8_t rrs_embedded; /*!< Capacity of the RRSet array embedded in the node. */
 } zone_node_t;
 
 /*!< \brief Glue node context. */
@@ -79,7 +84,16 @@ enum node_flags {
 	/*! \brief Node is empty and will be deleted after update. */
 	NODE_FLAGS_EMPTY =           1 << 3,
 	/*! \brief Node has a wildcard child. */
-	NODE_FLAGS_WILDCARD_CHILD =  1 << 4
+	NODE_FLAGS_WILDCARD_CHILD =  1 << 4,
+	/*! \brief Node was replaced or removed in a newer zone contents version. */
+	NODE_FLAGS_SUPERSEDED =      1 << 5,
+	/*! \brief Node is private to the zone contents being updated. */
+	NODE_FLAGS_NEW =             1 << 6,
+	/*! \brief Node is queued for release of its additionals. */
+	NODE_FLAGS_GARBAGE =         1 << 7,
+	/*! \brief Flags private to zone contents versioning. */
+	NODE_FLAGS_VERSIONING =      NODE_FLAGS_SUPERSEDED | NODE_FLAGS_NEW |
+	                             NODE_FLAGS_GARBAGE
 };
 
 /*!
@@ -92,6 +106,11 @@ void additional_clear(additional_t *additional);
 /*!
  * \brief Creates and initializes new node structure.
  *
+ * The memory context is used for the node structure, its owner, and the
+ * RRSet array. Added RR data are allocated from the heap, as they may be
+ * shared among zone contents versions. There is room for one RRSet embedded
+ * in the node.
+ *
  * \param owner  Node's owner, will be duplicated.
  * \param mm     Memory context to use.
  *
@@ -104,7 +123,7 @@ zone_node_t *node_new(const knot_dname_t *owner, knot_mm_t *mm);
  *        structure, but not the node itself.
  *
  * \param node  Node that contains data to be destroyed.
- * \param mm    Memory context to use.
+ * \param mm    Memory context of the node.
  */
 void node_free_rrsets(zone_node_t *node, knot_mm_t *mm);
 
@@ -115,27 +134,64 @@ void node_free_rrsets(zone_node_t *node, knot_mm_t *mm);
  * Also sets the given pointer to NULL.
  *
  * \param node  Node to be destroyed.
- * \param mm    Memory context to use.
+ * \param mm    Memory context of the node.
  */
 void node_free(zone_node_t **node, knot_mm_t *mm);
 
 /*!
  * \brief Creates a shallow copy of node structure, RR data are shared.
  *
+ * RR data embedded in the source node are copied into the new node.
+ *
  * \param src  Source of the copy.
- * \param mm   Memory context to use.
+ * \param mm   Memory context for the copy.
  *
  * \return Copied node if success, NULL otherwise.
  */
 zone_node_t *node_shallow_copy(const zone_node_t *src, knot_mm_t *mm);
 
+/*!
+ * \brief Creates a packed copy of the node.
+ *
+ * All RR data are copied into the new node block right behind the RRSet
+ * array and the owner. The source node keeps its RR data.
+ *
+ * \param src  Source of the copy.
+ * \param mm   Memory context for the copy.
+ *
+ * \return Packed node if success, NULL otherwise.
+ */
+zone_node_t *node_pack(const zone_node_t *src, knot_mm_t *mm);
+
+/*!
+ * \brief Checks if the RR data are embedded in the node block.
+ *
+ * Embedded RR data are released with the node and can't be resized.
+ *
+ * \param node  Node the RR data belong to.
+ * \param rrs   RR data to check.
+ *
+ * \return True/False.
+ */
+bool node_rdataset_embedded(const zone_node_t *node, const knot_rdataset_t *rrs);
+
+/*!
+ * \brief Moves RR data embedded in the node to the heap, so they can be modified.
+ *
+ * \param node  Node the RR data belong to.
+ * \param rrs   RR data of the node.
+ *
+ * \return KNOT_E*
+ */
+int node_unpack_rdataset(zone_node_t *node, knot_rdataset_t *rrs);
+
 /*!
  * \brief Adds an RRSet to the node. All data are copied. Owner and class are
  *        not used at all.
  *
  * \param node     Node to add the RRSet to.
  * \param rrset    RRSet to add.
- * \param mm       Memory context to use.
+ * \param mm       Memory context of the node.
  *
  * \return KNOT_E*
  * \retval KNOT_ETTL  RRSet TTL was updated.
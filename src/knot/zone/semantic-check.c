@@ -706,11 +706,12 @@ static int check_nsec_bitmap(const zone_node_t *node, semchecks_data_t *data)
 
 	bool nsec = data->level & NSEC;
 	knot_rdataset_t *nsec_rrs = NULL;
+	const zone_node_t *nsec3_node = zone_contents_node_nsec3(data->zone, node);
 
 	if (nsec) {
 		nsec_rrs = node_rdataset(node, KNOT_RRTYPE_NSEC);
-	} else if (node->nsec3_node != NULL) {
-		nsec_rrs = node_rdataset(node->nsec3_node, KNOT_RRTYPE_NSEC3);
+	} else if (nsec3_node != NULL) {
+		nsec_rrs = node_rdataset(nsec3_node, KNOT_RRTYPE_NSEC3);
 	}
 	if (nsec_rrs == NULL) {
 		return KNOT_EOK;
@@ -744,7 +745,7 @@ static int check_nsec_bitmap(const zone_node_t *node, semchecks_data_t *data)
 	if (node_wire_size != nsec_wire_size ||
 	    memcmp(node_wire, nsec_wire, node_wire_size) != 0) {
 		char buff[50 + KNOT_DNAME_TXT_MAXLEN];
-		char *info = nsec ? NULL : nsec3_info(node->nsec3_node->owner,
+		char *info = nsec ? NULL : nsec3_info(nsec3_node->owner,
 		                                      buff, sizeof(buff));
 		data->handler->cb(data->handler, data->zone, node,
 		                  (nsec ? SEM_ERR_NSEC_RDATA_BITMAP : SEM_ERR_NSEC3_RDATA_BITMAP),
@@ -821,7 +822,7 @@ static int check_nsec3_presence(const zone_node_t *node, semchecks_data_t *data)
 	bool deleg = (node->flags & NODE_FLAGS_DELEG) != 0;
 
 	if ((deleg && node_rrtype_exists(node, KNOT_RRTYPE_DS)) || (auth && !deleg)) {
-		if (node->nsec3_node == NULL) {
+		if (zone_contents_node_nsec3(data->zone, node) == NULL) {
 			data->handler->cb(data->handler, data->zone, node,
 			                  SEM_ERR_NSEC3_NONE, NULL);
 		}
@@ -838,7 +839,7 @@ static int check_nsec3_presence(const zone_node_t *node, semchecks_data_t *data)
  */
 static int check_nsec3_opt_out(const zone_node_t *node, semchecks_data_t *data)
 {
-	if (!(node->nsec3_node == NULL && node->flags & NODE_FLAGS_DELEG)) {
+	if (!(zone_contents_node_nsec3(data->zone, node) == NULL && node->flags & NODE_FLAGS_DELEG)) {
 		return KNOT_EOK;
 	}
 	/* Insecure delegation, check whether it is part of opt-out span. */
@@ -885,7 +886,8 @@ static int check_nsec3(const zone_node_t *node, semchecks_data_t *data)
 	if (!auth && !deleg) {
 		return KNOT_EOK;
 	}
-	if (node->nsec3_node == NULL) {
+	const zone_node_t *nsec3_node = zone_contents_node_nsec3(data->zone, node);
+	if (nsec3_node == NULL) {
 		return KNOT_EOK;
 	}
 
@@ -893,9 +895,9 @@ static int check_nsec3(const zone_node_t *node, semchecks_data_t *data)
 	int ret = KNOT_EOK;
 
 	char buff[50 + KNOT_DNAME_TXT_MAXLEN];
-	char *info = nsec3_info(node->nsec3_node->owner, buff, sizeof(buff));
+	char *info = nsec3_info(nsec3_node->owner, buff, sizeof(buff));
 
-	knot_rrset_t nsec3_rrs = node_rrset(node->nsec3_node, KNOT_RRTYPE_NSEC3);
+	knot_rrset_t nsec3_rrs = node_rrset(nsec3_node, KNOT_RRTYPE_NSEC3);
 	if (knot_rrset_empty(&nsec3_rrs)) {
 		data->handler->cb(data->handler, data->zone, node,
 		                  SEM_ERR_NSEC3_NONE, info);
@@ -961,7 +963,8 @@ static int check_nsec3(const zone_node_t *node, semchecks_data_t *data)
 
 	const zone_node_t *next_nsec3 = zone_contents_find_nsec3_node(data->zone,
 	                                                              next_dname);
-	if (next_nsec3 == NULL || next_nsec3->prev != node->nsec3_node) {
+	if (next_nsec3 == NULL ||
+	    zone_tree_current(data->zone->nsec3_nodes, next_nsec3->prev) != nsec3_node) {
 		uint8_t *next = NULL;
 		int32_t next_len = base32hex_encode_alloc(next_dname_str,
 		                                          next_dname_str_size,
@@ -976,17 +979,17 @@ static int check_nsec3(const zone_node_t *node, semchecks_data_t *data)
 		free(hash_info);
 	}
 
-	ret = check_rrsig(node->nsec3_node, data);
+	ret = check_rrsig(nsec3_node, data);
 	if (ret != KNOT_EOK) {
 		goto nsec3_cleanup;
 	}
 
 	// Check that the node only contains NSEC3 and RRSIG.
-	for (int i = 0; ret == KNOT_EOK && i < node->nsec3_node->rrset_count; i++) {
-		knot_rrset_t rrset = node_rrset_at(node->nsec3_node, i);
+	for (int i = 0; ret == KNOT_EOK && i < nsec3_node->rrset_count; i++) {
+		knot_rrset_t rrset = node_rrset_at(nsec3_node, i);
 		uint16_t type = rrset.type;
 		if (type != KNOT_RRTYPE_NSEC3 && type != KNOT_RRTYPE_RRSIG) {
-			data->handler->cb(data->handler, data->zone, node->nsec3_node,
+			data->handler->cb(data->handler, data->zone, nsec3_node,
 			                  SEM_ERR_NSEC3_EXTRA_RECORD, NULL);
 		}
 	}
@@ -1041,7 +1044,8 @@ static int check_cname(const zone_node_t *node, semchecks_data_t *data)
  */
 static int check_dname(const zone_node_t *node, semchecks_data_t *data)
 {
-	if (node->parent != NULL && node_rrtype_exists(node->parent, KNOT_RRTYPE_DNAME)) {
+	const zone_node_t *parent = zone_contents_node_parent(data->zone, node);
+	if (parent != NULL && node_rrtype_exists(parent, KNOT_RRTYPE_DNAME)) {
 		data->handler->fatal_error = true;
 		data->handler->cb(data->handler, data->zone, node,
 		                  SEM_ERR_DNAME_CHILDREN, NULL);
@@ -18,6 +18,7 @@
 #include "knot/journal/journal.h"
 #include "knot/zone/zone-diff.h"
 #include "knot/zone/zone-load.h"
+#include "knot/zone/zone-snapshot.h"
 #include "knot/zone/zonefile.h"
 #include "knot/dnssec/key-events.h"
 #include "knot/dnssec/zone-events.h"
@@ -25,19 +26,36 @@
 #include "libknot/libknot.h"
 
 int zone_load_contents(conf_t *conf, const knot_dname_t *zone_name,
-                       zone_contents_t **contents)
+                       zone_contents_t **contents, bool snapshot)
 {
 	if (conf == NULL || zone_name == NULL || contents == NULL) {
 		return KNOT_EINVAL;
 	}
 
 	char *zonefile = conf_zonefile(conf, zone_name);
-	conf_val_t val = conf_zone_get(conf, C_SEM_CHECKS, zone_name);
+
+	/* Try the binary snapshot first, fall back to the zone file. */
+	conf_val_t val = conf_zone_get(conf, C_ZONEFILE_SNAPSHOT, zone_name);
+	snapshot = snapshot && conf_bool(&val);
+	if (snapshot) {
+		int ret = zone_snapshot_load(zonefile, zone_name, contents);
+		if (ret == KNOT_EOK) {
+			log_zone_info(zone_name, "zone loaded from snapshot, serial %u",
+			              zone_contents_serial(*contents));
+			free(zonefile);
+			return KNOT_EOK;
+		} else if (ret != KNOT_ENOENT) {
+			log_zone_warning(zone_name, "failed to load zone snapshot (%s)",
+			                 knot_strerror(ret));
+		}
+	}
+
+	val = conf_zone_get(conf, C_SEM_CHECKS, zone_name);
 
 	zloader_t zl;
 	int ret = zonefile_open(&zl, zonefile, zone_name, conf_bool(&val), time(NULL));
-	free(zonefile);
 	if (ret != KNOT_EOK) {
+		free(zonefile);
 		return ret;
 	}
 
@@ -46,14 +64,27 @@ int zone_load_contents(conf_t *conf, const knot_dname_t *zone_name,
 	};
 
 	zl.err_handler = &handler;
+	val = conf_zone_get(conf, C_ZONEFILE_LOAD_THREADS, zone_name);
+	zl.threads = conf_int(&val);
 	zl.creator->master = !zone_load_can_bootstrap(conf, zone_name);
 
 	*contents = zonefile_load(&zl);
 	zonefile_close(&zl);
 	if (*contents == NULL) {
+		free(zonefile);
 		return KNOT_ERROR;
 	}
 
+	/* Store the snapshot for the next load. */
+	if (snapshot) {
+		ret = zone_snapshot_write(zonefile, *contents);
+		if (ret != KNOT_EOK) {
+			log_zone_warning(zone_name, "failed to write zone snapshot (%s)",
+			                 knot_strerror(ret));
+		}
+	}
+	free(zonefile);
+
 	return KNOT_EOK;
 }
 
@@ -26,10 +26,12 @@
  * \param conf
  * \param zone_name
  * \param contents
+ * \param snapshot   Use the zone snapshot if configured, otherwise always
+ *                   parse the zone file and don't update the snapshot.
  * \return KNOT_EOK or an error
  */
 int zone_load_contents(conf_t *conf, const knot_dname_t *zone_name,
-                       zone_contents_t **contents);
+                       zone_contents_t **contents, bool snapshot);
 
 /*!
  * \brief Update zone contents from the journal.
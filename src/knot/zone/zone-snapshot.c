@@ -0,0 +1,374 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "knot/zone/zone-snapshot.h"
+#include "libknot/libknot.h"
+#include "contrib/files.h"
+#include "contrib/openbsd/siphash.h"
+#include "contrib/string.h"
+#include "contrib/wire_ctx.h"
+
+#define SNAPSHOT_SUFFIX		".snapshot"
+#define SNAPSHOT_MAGIC		"KNOTSNAP"
+#define SNAPSHOT_VERSION	2
+#define SNAPSHOT_BYTE_ORDER	0x0102
+
+/*
+ * Snapshot layout (integers in network byte order unless noted otherwise):
+ *
+ * Header:
+ *   magic[8], version u32, byte order u16 (host order), reserved u16,
+ *   zone file mtime seconds u64, zone file mtime nanoseconds u32,
+ *   reserved u32, zone file size u64, RRSet count u64,
+ *   data length u64, data checksum u64 (SipHash-2-4).
+ *
+ * Data, for each RRSet:
+ *   owner (wire format), type u16, TTL u32, RR count u16, rdataset size u32,
+ *   padding to an even offset, rdataset (knot_rdata_t array in host order).
+ */
+#define HEADER_SIZE		64
+#define HEADER_COUNT_OFFSET	40
+
+/*! \brief Fixed checksum key, the checksum only detects corruption. */
+static const SIPHASH_KEY checksum_key = { 0 };
+
+typedef struct {
+	FILE *file;
+	SIPHASH_CTX hash;
+	uint64_t count;
+	uint64_t length;
+	int ret;
+} snapshot_writer_t;
+
+static char *snapshot_path(const char *zonefile)
+{
+	return sprintf_alloc("%s%s", zonefile, SNAPSHOT_SUFFIX);
+}
+
+static void write_data(snapshot_writer_t *writer, const void *data, size_t len)
+{
+	if (writer->ret != KNOT_EOK || len == 0) {
+		return;
+	}
+
+	if (fwrite(data, len, 1, writer->file) != 1) {
+		writer->ret = KNOT_EFILE;
+		return;
+	}
+
+	SipHash24_Update(&writer->hash, data, len);
+	writer->length += len;
+}
+
+static int write_node(zone_node_t *node, void *data)
+{
+	snapshot_writer_t *writer = data;
+
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		knot_rrset_t rrset = node_rrset_at(node, i);
+		size_t rrs_size = knot_rdataset_size(&rrset.rrs);
+
+		uint8_t buf[KNOT_DNAME_MAXLEN + 13];
+		wire_ctx_t wire = wire_ctx_init(buf, sizeof(buf));
+		wire_ctx_write(&wire, node->owner, knot_dname_size(node->owner));
+		wire_ctx_write_u16(&wire, rrset.type);
+		wire_ctx_write_u32(&wire, rrset.ttl);
+		wire_ctx_write_u16(&wire, rrset.rrs.rr_count);
+		wire_ctx_write_u32(&wire, rrs_size);
+		if ((writer->length + wire_ctx_offset(&wire)) % 2 != 0) {
+			wire_ctx_write_u8(&wire, 0);
+		}
+		if (wire.error != KNOT_EOK) {
+			return wire.error;
+		}
+
+		write_data(writer, buf, wire_ctx_offset(&wire));
+		write_data(writer, rrset.rrs.data, rrs_size);
+		writer->count++;
+	}
+
+	return writer->ret;
+}
+
+static int write_header(snapshot_writer_t *writer, const struct stat *st)
+{
+	uint8_t buf[HEADER_SIZE];
+	wire_ctx_t wire = wire_ctx_init(buf, sizeof(buf));
+	uint16_t byte_order = SNAPSHOT_BYTE_ORDER;
+
+	wire_ctx_write(&wire, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC));
+	wire_ctx_write_u32(&wire, SNAPSHOT_VERSION);
+	wire_ctx_write(&wire, &byte_order, sizeof(byte_order));
+	wire_ctx_write_u16(&wire, 0);
+	wire_ctx_write_u64(&wire, st->st_mtim.tv_sec);
+	wire_ctx_write_u32(&wire, st->st_mtim.tv_nsec);
+	wire_ctx_write_u32(&wire, 0);
+	wire_ctx_write_u64(&wire, st->st_size);
+	assert(wire_ctx_offset(&wire) == HEADER_COUNT_OFFSET);
+	wire_ctx_write_u64(&wire, writer->count);
+	wire_ctx_write_u64(&wire, writer->length);
+	wire_ctx_write_u64(&wire, SipHash24_End(&writer->hash));
+	assert(wire.error == KNOT_EOK && wire_ctx_available(&wire) == 0);
+
+	if (fseek(writer->file, 0, SEEK_SET) != 0 ||
+	    fwrite(buf, sizeof(buf), 1, writer->file) != 1) {
+		return KNOT_EFILE;
+	}
+
+	return KNOT_EOK;
+}
+
+int zone_snapshot_write(const char *zonefile, const zone_contents_t *contents)
+{
+	if (zonefile == NULL || contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	/* The snapshot is bound to the current zone file version. */
+	struct stat st;
+	if (stat(zonefile, &st) < 0) {
+		return knot_map_errno();
+	}
+
+	char *path = snapshot_path(zonefile);
+	if (path == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	char *tmp_name = NULL;
+	snapshot_writer_t writer = { 0 };
+	int ret = open_tmp_file(path, &tmp_name, &writer.file,
+	                        S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	if (ret != KNOT_EOK) {
+		free(path);
+		return ret;
+	}
+
+	SipHash24_Init(&writer.hash, &checksum_key);
+
+	/* Reserve space for the header. */
+	if (fseek(writer.file, HEADER_SIZE, SEEK_SET) != 0) {
+		ret = KNOT_EFILE;
+	}
+
+	zone_contents_t *conts = (zone_contents_t *)contents;
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_apply(conts, write_node, &writer);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_nsec3_apply(conts, write_node, &writer);
+	}
+	if (ret == KNOT_EOK) {
+		ret = write_header(&writer, &st);
+	}
+	if (fclose(writer.file) != 0 && ret == KNOT_EOK) {
+		ret = KNOT_EFILE;
+	}
+
+	if (ret == KNOT_EOK && rename(tmp_name, path) != 0) {
+		ret = knot_map_errno();
+	}
+	if (ret != KNOT_EOK) {
+		unlink(tmp_name);
+	}
+
+	free(tmp_name);
+	free(path);
+
+	return ret;
+}
+
+static int check_header(wire_ctx_t *wire, const struct stat *zf_st,
+                        uint64_t *count, uint64_t *length)
+{
+	char magic[sizeof(SNAPSHOT_MAGIC) - 1];
+	wire_ctx_read(wire, magic, sizeof(magic));
+	uint32_t version = wire_ctx_read_u32(wire);
+	uint16_t byte_order = 0;
+	wire_ctx_read(wire, &byte_order, sizeof(byte_order));
+	wire_ctx_skip(wire, sizeof(uint16_t));
+	uint64_t mtime = wire_ctx_read_u64(wire);
+	uint32_t mtime_nsec = wire_ctx_read_u32(wire);
+	wire_ctx_skip(wire, sizeof(uint32_t));
+	uint64_t size = wire_ctx_read_u64(wire);
+	*count = wire_ctx_read_u64(wire);
+	*length = wire_ctx_read_u64(wire);
+	uint64_t checksum = wire_ctx_read_u64(wire);
+
+	if (wire->error != KNOT_EOK ||
+	    memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0 ||
+	    version != SNAPSHOT_VERSION || byte_order != SNAPSHOT_BYTE_ORDER) {
+		return KNOT_EMALF;
+	}
+
+	/* Zone file changed since the snapshot was written. */
+	if (mtime != (uint64_t)zf_st->st_mtim.tv_sec ||
+	    mtime_nsec != (uint32_t)zf_st->st_mtim.tv_nsec ||
+	    size != (uint64_t)zf_st->st_size) {
+		return KNOT_ENOENT;
+	}
+
+	if (*length != wire_ctx_available(wire) ||
+	    SipHash24(&checksum_key, wire->position, *length) != checksum) {
+		return KNOT_EMALF;
+	}
+
+	return KNOT_EOK;
+}
+
+static int check_rdataset(const knot_rdataset_t *rrs, size_t size)
+{
+	size_t offset = 0;
+	for (uint16_t i = 0; i < rrs->rr_count; i++) {
+		if (size - offset < sizeof(uint16_t)) {
+			return KNOT_EMALF;
+		}
+		const knot_rdata_t *rr = (const knot_rdata_t *)((uint8_t *)rrs->data + offset);
+		offset += knot_rdata_size(rr->len);
+		if (offset > size) {
+			return KNOT_EMALF;
+		}
+	}
+
+	return (offset == size) ? KNOT_EOK : KNOT_EMALF;
+}
+
+static int load_rrsets(wire_ctx_t *wire, uint64_t count, zone_contents_t *contents)
+{
+	for (uint64_t i = 0; i < count; i++) {
+		const uint8_t *end = wire->position + wire_ctx_available(wire);
+		int owner_size = knot_dname_wire_check(wire->position, end, NULL);
+		if (owner_size <= 0) {
+			return KNOT_EMALF;
+		}
+
+		knot_rrset_t rrset;
+		knot_rrset_init(&rrset, (knot_dname_t *)wire->position, 0,
+		                KNOT_CLASS_IN, 0);
+		wire_ctx_skip(wire, owner_size);
+		rrset.type = wire_ctx_read_u16(wire);
+		rrset.ttl = wire_ctx_read_u32(wire);
+		rrset.rrs.rr_count = wire_ctx_read_u16(wire);
+		uint32_t rrs_size = wire_ctx_read_u32(wire);
+		if (wire_ctx_offset(wire) % 2 != 0) {
+			wire_ctx_skip(wire, 1);
+		}
+		if (wire->error != KNOT_EOK || wire_ctx_available(wire) < rrs_size) {
+			return KNOT_EMALF;
+		}
+
+		/* Use the mapped rdataset directly, it's copied into the zone. */
+		rrset.rrs.data = (knot_rdata_t *)wire->position;
+		int ret = check_rdataset(&rrset.rrs, rrs_size);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+		wire_ctx_skip(wire, rrs_size);
+
+		zone_node_t *node = NULL;
+		ret = zone_contents_add_rr(contents, &rrset, &node);
+		if (ret != KNOT_EOK) {
+			return ret;
+		}
+	}
+
+	return (wire_ctx_available(wire) == 0) ? KNOT_EOK : KNOT_EMALF;
+}
+
+int zone_snapshot_load(const char *zonefile, const knot_dname_t *origin,
+                       zone_contents_t **contents)
+{
+	if (zonefile == NULL || origin == NULL || contents == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	struct stat zf_st;
+	if (stat(zonefile, &zf_st) < 0) {
+		return knot_map_errno();
+	}
+
+	char *path = snapshot_path(zonefile);
+	if (path == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	int fd = open(path, O_RDONLY);
+	free(path);
+	if (fd < 0) {
+		return knot_map_errno();
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		int ret = knot_map_errno();
+		close(fd);
+		return ret;
+	}
+	if (st.st_size < HEADER_SIZE) {
+		close(fd);
+		return KNOT_EMALF;
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return knot_map_errno();
+	}
+	(void)madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	wire_ctx_t wire = wire_ctx_init_const(map, st.st_size);
+	uint64_t count, length;
+	int ret = check_header(&wire, &zf_st, &count, &length);
+	if (ret != KNOT_EOK) {
+		munmap(map, st.st_size);
+		return ret;
+	}
+
+	zone_contents_t *conts = zone_contents_new(origin);
+	if (conts == NULL) {
+		munmap(map, st.st_size);
+		return KNOT_ENOMEM;
+	}
+
+	ret = load_rrsets(&wire, count, conts);
+	munmap(map, st.st_size);
+	if (ret == KNOT_EOK && !node_rrtype_exists(conts->apex, KNOT_RRTYPE_SOA)) {
+		ret = KNOT_EMALF;
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_pack(conts);
+	}
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(conts);
+	}
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&conts);
+		return ret;
+	}
+
+	*contents = conts;
+
+	return KNOT_EOK;
+}
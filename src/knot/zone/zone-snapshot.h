@@ -0,0 +1,62 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!
+ * \file
+ *
+ * Binary zone snapshot.
+ *
+ * The snapshot stores zone records in a versioned binary format next to
+ * the zone file (with a ".snapshot" suffix). It's bound to the zone file
+ * modification time and size, so it's only used if the zone file hasn't
+ * changed since the snapshot was written. The records are loaded from the
+ * mapped file without any parsing, the rdatasets are copied as a whole.
+ *
+ * \addtogroup zone
+ * @{
+ */
+
+#pragma once
+
+#include "knot/zone/contents.h"
+
+/*!
+ * \brief Writes a binary snapshot of the zone contents.
+ *
+ * \param zonefile  Zone file path the snapshot belongs to.
+ * \param contents  Zone contents to store (should correspond to the zone file).
+ *
+ * \return KNOT_E*
+ */
+int zone_snapshot_write(const char *zonefile, const zone_contents_t *contents);
+
+/*!
+ * \brief Loads zone contents from the binary snapshot.
+ *
+ * The loaded contents are adjusted, but no semantic checks are performed.
+ *
+ * \param zonefile  Zone file path the snapshot belongs to.
+ * \param origin    Zone origin.
+ * \param contents  Output zone contents.
+ *
+ * \retval KNOT_EOK      Contents loaded.
+ * \retval KNOT_ENOENT   No snapshot or the zone file has changed since.
+ * \retval KNOT_EMALF    Corrupted or incompatible snapshot.
+ * \return KNOT_E*       Other errors.
+ */
+int zone_snapshot_load(const char *zonefile, const knot_dname_t *origin,
+                       zone_contents_t **contents);
+
+/*! @} */
@@ -91,7 +91,7 @@ int zone_tree_get_less_or_equal(zone_tree_t *tree,
 	int exact_match = 0;
 	if (ret == KNOT_EOK) {
 		if (fval != NULL) {
-			*previous = (*found)->prev;
+			*previous = zone_tree_current(tree, (*found)->prev);
 		}
 		exact_match = 1;
 	} else if (ret == 1) {
@@ -105,7 +105,7 @@ int zone_tree_get_less_or_equal(zone_tree_t *tree,
 		/*! \todo We could store rightmost node in zonetree probably. */
 		trie_it_t *i = trie_it_begin(tree);
 		*previous = *(zone_node_t **)trie_it_val(i); /* leftmost */
-		*previous = (*previous)->prev; /* rightmost */
+		*previous = zone_tree_current(tree, (*previous)->prev); /* rightmost */
 		*found = NULL;
 		trie_it_free(i);
 	}
@@ -141,7 +141,7 @@ static void fix_wildcard_child(zone_node_t *node, const knot_dname_t *owner)
 	}
 }
 
-void zone_tree_delete_empty(zone_tree_t *tree, zone_node_t *node)
+void zone_tree_delete_empty(zone_tree_t *tree, zone_node_t *node, knot_mm_t *mm)
 {
 	if (tree == NULL || node == NULL) {
 		return;
@@ -154,13 +154,13 @@ void zone_tree_delete_empty(zone_tree_t *tree, zone_node_t *node)
 			fix_wildcard_child(parent_node, node->owner);
 			if (parent_node->parent != NULL) { /* Is not apex */
 				// Recurse using the parent node, do not delete possibly empty parent.
-				zone_tree_delete_empty(tree, parent_node);
+				zone_tree_delete_empty(tree, parent_node, mm);
 			}
 		}
 
 		// Delete node
 		remove_node(tree, node->owner);
-		node_free(&node, NULL);
+		node_free(&node, mm);
 	}
 }
 
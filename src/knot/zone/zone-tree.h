@@ -83,6 +83,27 @@ int zone_tree_insert(zone_tree_t *tree, zone_node_t *node);
  */
 zone_node_t *zone_tree_get(zone_tree_t *tree, const knot_dname_t *owner);
 
+/*!
+ * \brief Resolves a node reference to the node in the given tree.
+ *
+ * Nodes shared with a previous zone contents version may reference nodes
+ * which have been replaced or removed since, these are looked up by owner.
+ *
+ * \param tree Zone tree the referenced node belongs to.
+ * \param node Referenced node.
+ *
+ * \retval The node itself, its replacement, or NULL if removed.
+ */
+inline static zone_node_t *zone_tree_current(zone_tree_t *tree, const zone_node_t *node)
+{
+	if (node == NULL ||
+	    !(__atomic_load_n(&node->flags, __ATOMIC_RELAXED) & NODE_FLAGS_SUPERSEDED)) {
+		return (zone_node_t *)node;
+	}
+
+	return zone_tree_get(tree, node->owner);
+}
+
 /*!
  * \brief Tries to find the given domain name in the zone tree and returns the
  *        associated node and previous node in canonical order.
@@ -112,8 +133,9 @@ int zone_tree_get_less_or_equal(zone_tree_t *tree,
  *
  * \param tree  The tree to remove from.
  * \param node  The node to remove.
+ * \param mm    Memory context of the node.
  */
-void zone_tree_delete_empty(zone_tree_t *tree, zone_node_t *node);
+void zone_tree_delete_empty(zone_tree_t *tree, zone_node_t *node, knot_mm_t *mm);
 
 /*!
  * \brief Applies the given function to each node in the zone in order.
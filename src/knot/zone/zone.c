@@ -28,6 +28,7 @@
 #include "knot/zone/contents.h"
 #include "knot/zone/serial.h"
 #include "knot/zone/zone.h"
+#include "knot/zone/zone-snapshot.h"
 #include "knot/zone/zonefile.h"
 #include "libknot/libknot.h"
 #include "contrib/sockaddr.h"
@@ -140,6 +141,16 @@ static int flush_journal(conf_t *conf, zone_t *zone, bool allow_empty_zone)
 		goto flush_journal_replan;
 	}
 
+	/* Store binary snapshot of the new zone file. */
+	val = conf_zone_get(conf, C_ZONEFILE_SNAPSHOT, zone->name);
+	if (conf_bool(&val)) {
+		int snap_ret = zone_snapshot_write(zonefile, contents);
+		if (snap_ret != KNOT_EOK) {
+			log_zone_warning(zone->name, "failed to write zone snapshot (%s)",
+			                 knot_strerror(snap_ret));
+		}
+	}
+
 	free(zonefile);
 
 	/* Update zone file serial and journal. */
@@ -258,14 +269,73 @@ void zone_free(zone_t **zone_ptr)
 	free(zone->preferred_master);
 
 	/* Free zone contents. */
-	zone_contents_deep_free(&zone->contents);
+	zone_contents_retire(zone->contents, NULL, NULL);
+	zone->contents = NULL;
 
 	conf_deactivate_modules(&zone->query_modules, &zone->query_plan);
 
+	zone_query_conf_free(zone->query_conf);
+
 	free(zone);
 	*zone_ptr = NULL;
 }
 
+zone_query_conf_t *zone_query_conf_new(conf_t *conf, const knot_dname_t *name)
+{
+	if (conf == NULL || name == NULL) {
+		return NULL;
+	}
+
+	zone_query_conf_t *query_conf = calloc(1, sizeof(*query_conf));
+	if (query_conf == NULL) {
+		return NULL;
+	}
+
+	conf_val_t val = conf_zone_get(conf, C_DISABLE_ANY, name);
+	query_conf->disable_any = conf_bool(&val);
+
+	val = conf_zone_get(conf, C_ANSWER_CACHE, name);
+	query_conf->answer_cache = conf_int(&val);
+
+	val = conf_zone_get(conf, C_ACL, name);
+	query_conf->acl = acl_new(conf, &val);
+	if (query_conf->acl == NULL) {
+		free(query_conf);
+		return NULL;
+	}
+
+	return query_conf;
+}
+
+void zone_query_conf_free(zone_query_conf_t *query_conf)
+{
+	if (query_conf == NULL) {
+		return;
+	}
+
+	acl_free(query_conf->acl);
+	free(query_conf);
+}
+
+static void query_conf_free_cb(struct rcu_head *head)
+{
+	zone_query_conf_free((zone_query_conf_t *)head);
+}
+
+void zone_query_conf_update(conf_t *conf, zone_t *zone)
+{
+	if (conf == NULL || zone == NULL) {
+		return;
+	}
+
+	/* On failure, query processing falls back to the configuration. */
+	zone_query_conf_t *query_conf = zone_query_conf_new(conf, zone->name);
+	zone_query_conf_t *old = rcu_xchg_pointer(&zone->query_conf, query_conf);
+	if (old != NULL) {
+		call_rcu((struct rcu_head *)old, query_conf_free_cb);
+	}
+}
+
 int zone_change_store(conf_t *conf, zone_t *zone, changeset_t *change)
 {
 	if (conf == NULL || zone == NULL || change == NULL) {
@@ -312,6 +382,26 @@ int zone_changes_load(conf_t *conf, zone_t *zone, list_t *dst, uint32_t from)
 	return ret;
 }
 
+int zone_changes_load_serialized(conf_t *conf, zone_t *zone, uint32_t from,
+                                 uint32_t to, uint8_t **data, size_t *size)
+{
+	if (conf == NULL || zone == NULL || data == NULL || size == NULL) {
+		return KNOT_EINVAL;
+	}
+
+	int ret = KNOT_ENOENT;
+
+	if (journal_exists(zone->journal_db, zone->name)) {
+		ret = open_journal(zone);
+	}
+
+	if (ret == KNOT_EOK) {
+		ret = journal_load_serialized(zone->journal, from, to, data, size);
+	}
+
+	return ret;
+}
+
 int zone_in_journal_load(conf_t *conf, zone_t *zone, list_t *dst)
 {
 	if (conf == NULL || zone == NULL || dst == NULL) {
@@ -387,6 +477,9 @@ zone_contents_t *zone_switch_contents(zone_t *zone, zone_contents_t *new_content
 	zone_contents_t **current_contents = &zone->contents;
 	old_contents = rcu_xchg_pointer(current_contents, new_contents);
 
+	/* Keep the new version until snapshots of the old one are released. */
+	zone_contents_chain(old_contents, new_contents);
+
 	return old_contents;
 }
 
@@ -535,6 +628,48 @@ int zone_master_try(conf_t *conf, zone_t *zone, zone_master_cb callback,
 	return success ? KNOT_EOK : KNOT_ENOMASTER;
 }
 
+size_t zone_master_list(conf_t *conf, zone_t *zone, conf_remote_t *masters, size_t max)
+{
+	if (conf == NULL || zone == NULL || masters == NULL) {
+		return 0;
+	}
+
+	size_t count = 0;
+
+	conf_remote_t preferred = { { AF_UNSPEC } };
+	if (preferred_master(conf, zone, &preferred) == KNOT_EOK) {
+		if (count < max) {
+			masters[count] = preferred;
+		}
+		count++;
+	}
+
+	conf_val_t val = conf_zone_get(conf, C_MASTER, zone->name);
+	while (val.code == KNOT_EOK) {
+		conf_val_t addr = conf_id_get(conf, C_RMT, C_ADDR, &val);
+		size_t addr_count = conf_val_count(&addr);
+
+		for (size_t i = 0; i < addr_count; i++) {
+			conf_remote_t master = conf_remote(conf, &val, i);
+			if (preferred.addr.ss_family != AF_UNSPEC &&
+			    sockaddr_net_match((struct sockaddr *)&master.addr,
+			                       (struct sockaddr *)&preferred.addr,
+			                       -1)) {
+				preferred.addr.ss_family = AF_UNSPEC;
+				continue;
+			}
+			if (count < max) {
+				masters[count] = master;
+			}
+			count++;
+		}
+
+		conf_val_next(&val);
+	}
+
+	return count;
+}
+
 int zone_update_enqueue(zone_t *zone, knot_pkt_t *pkt, knotd_qdata_params_t *params)
 {
 	if (zone == NULL || pkt == NULL || params == NULL) {
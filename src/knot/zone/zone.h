@@ -16,10 +16,14 @@
 
 #pragma once
 
+#include <urcu.h>
+
 #include "knot/conf/conf.h"
 #include "knot/conf/confio.h"
 #include "knot/journal/journal.h"
+#include "knot/updates/acl.h"
 #include "knot/events/events.h"
+#include "knot/events/soa-check.h"
 #include "knot/zone/contents.h"
 #include "knot/zone/timers.h"
 #include "libknot/dname.h"
@@ -36,6 +40,19 @@ typedef enum zone_flag_t {
 	ZONE_FORCE_FLUSH  = 1 << 2, /* Force zone flush. */
 } zone_flag_t;
 
+/*!
+ * \brief Zone configuration resolved for query processing.
+ *
+ * Immutable, replaced as a whole on reconfiguration and freed after
+ * the RCU grace period.
+ */
+typedef struct zone_query_conf {
+	struct rcu_head rcu;
+	bool disable_any;
+	unsigned answer_cache;
+	acl_t *acl;
+} zone_query_conf_t;
+
 /*!
  * \brief Structure for holding DNS zone.
  */
@@ -76,6 +93,11 @@ typedef struct zone
 	/*! \brief Ptr to journal DB (in struct server) */
 	journal_db_t **journal_db;
 
+	/*! \brief Ptr to SOA check engine (in struct server). */
+	soa_check_t *soa_check;
+	/*! \brief Result of the last asynchronous SOA check. */
+	soa_check_result_t soa_result;
+
 	/*! \brief Preferred master lock. */
 	pthread_mutex_t preferred_lock;
 	/*! \brief Preferred master for remote operation. */
@@ -84,6 +106,9 @@ typedef struct zone
 	/*! \brief Query modules. */
 	list_t query_modules;
 	struct query_plan *query_plan;
+
+	/*! \brief Resolved query processing configuration (RCU protected). */
+	zone_query_conf_t *query_conf;
 } zone_t;
 
 /*!
@@ -104,6 +129,31 @@ zone_t* zone_new(const knot_dname_t *name);
  */
 void zone_free(zone_t **zone_ptr);
 
+/*!
+ * \brief Resolves the zone configuration needed for query processing.
+ *
+ * \param conf  Configuration.
+ * \param name  Zone name.
+ *
+ * \return Resolved configuration or NULL if out of memory.
+ */
+zone_query_conf_t *zone_query_conf_new(conf_t *conf, const knot_dname_t *name);
+
+/*!
+ * \brief Frees the resolved query processing configuration.
+ */
+void zone_query_conf_free(zone_query_conf_t *query_conf);
+
+/*!
+ * \brief Replaces the zone query processing configuration.
+ *
+ * The previous configuration is freed after the RCU grace period.
+ *
+ * \param conf  New configuration.
+ * \param zone  Zone to be updated.
+ */
+void zone_query_conf_update(conf_t *conf, zone_t *zone);
+
 /*!
  * \brief Clears possible control update transaction.
  *
@@ -113,6 +163,8 @@ void zone_control_clear(zone_t *zone);
 
 int zone_change_store(conf_t *conf, zone_t *zone, changeset_t *change);
 int zone_changes_load(conf_t *conf, zone_t *zone, list_t *dst, uint32_t from);
+int zone_changes_load_serialized(conf_t *conf, zone_t *zone, uint32_t from,
+                                 uint32_t to, uint8_t **data, size_t *size);
 int zone_in_journal_load(conf_t *conf, zone_t *zone, list_t *dst);
 int zone_in_journal_store(conf_t *conf, zone_t *zone, zone_contents_t *new_contents);
 int zone_journal_serial(conf_t *conf, zone_t *zone, bool *is_empty, uint32_t *serial_to);
@@ -155,6 +207,20 @@ typedef int (*zone_master_cb)(conf_t *conf, zone_t *zone, const conf_remote_t *r
 int zone_master_try(conf_t *conf, zone_t *zone, zone_master_cb callback,
                     void *callback_data, const char *err_str);
 
+/*!
+ * \brief Lists the master addresses in the order they should be tried.
+ *
+ * The preferred master comes first, followed by the other addresses.
+ *
+ * \param conf     Configuration.
+ * \param zone     Zone.
+ * \param masters  Output array of addresses.
+ * \param max      Size of the output array.
+ *
+ * \return Number of the master addresses (can be greater than \a max).
+ */
+size_t zone_master_list(conf_t *conf, zone_t *zone, conf_remote_t *masters, size_t max);
+
 
 /*! \brief Enqueue UPDATE request for processing. */
 int zone_update_enqueue(zone_t *zone, knot_pkt_t *pkt, knotd_qdata_params_t *params);
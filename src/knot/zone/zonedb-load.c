@@ -51,6 +51,7 @@ static zone_t *create_zone_from(const knot_dname_t *name, server_t *server)
 	}
 
 	zone->journal_db = &server->journal_db;
+	zone->soa_check = server->soa_check;
 
 	int result = zone_events_setup(zone, server->workers, &server->sched,
 	                               server->timers_db);
@@ -246,6 +247,7 @@ static knot_zonedb_t *create_zonedb(conf_t *conf, server_t *server)
 		if (old_zone != NULL && !full) {
 			/* Reuse unchanged zone. */
 			if (!(old_zone->change_type & CONF_IO_TRELOAD)) {
+				zone_query_conf_update(conf, old_zone);
 				knot_zonedb_insert(db_new, old_zone);
 				continue;
 			}
@@ -259,6 +261,7 @@ static knot_zonedb_t *create_zonedb(conf_t *conf, server_t *server)
 
 		conf_activate_modules(conf, zone->name, &zone->query_modules,
 		                      &zone->query_plan);
+		zone_query_conf_update(conf, zone);
 
 		knot_zonedb_insert(db_new, zone);
 	}
@@ -16,6 +16,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "knot/zone/zonedb.h"
 #include "libknot/packet/wire.h"
@@ -120,20 +121,34 @@ zone_t *knot_zonedb_find_suffix(knot_zonedb_t *db, const knot_dname_t *zone_name
 		return NULL;
 	}
 
-	while (true) {
-		knot_dname_storage_t lf_storage;
-		uint8_t *lf = knot_dname_lf(zone_name, &lf_storage);
-		assert(lf);
+	knot_dname_storage_t lf_storage;
+	uint8_t *lf = knot_dname_lf(zone_name, &lf_storage);
+	assert(lf);
 
-		trie_val_t *val = trie_get_try(db->trie, (char *)lf + 1, *lf);
-		if (val != NULL) {
-			return *val;
-		} else if (zone_name[0] == 0) {
-			return NULL;
-		}
+	trie_val_t *val = NULL;
+	int ret = trie_get_lpm(db->trie, (char *)lf + 1, *lf, &val);
+	if (ret == KNOT_EOK) {
+		return *val;
+	} else if (ret != 1) {
+		return NULL;
+	}
+
+	/* Zero bytes within labels may misalign the match, fall back then. */
+	zone_t *zone = *val;
+	if (memchr(zone_name, '\0', *lf) == NULL ||
+	    knot_dname_is_sub(zone_name, zone->name)) {
+		return zone;
+	}
 
+	while (*zone_name != 0) {
 		zone_name = knot_wire_next_label(zone_name, NULL);
+		zone = knot_zonedb_find(db, zone_name);
+		if (zone != NULL) {
+			return zone;
+		}
 	}
+
+	return NULL;
 }
 
 size_t knot_zonedb_size(const knot_zonedb_t *db)
@@ -24,11 +24,16 @@
 #include <time.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <strings.h>
 
 #include "libknot/libknot.h"
+#include "contrib/dynarray.h"
 #include "contrib/files.h"
+#include "contrib/macros.h"
 #include "knot/common/log.h"
 #include "knot/dnssec/zone-nsec.h"
+#include "knot/server/dthreads.h"
 #include "knot/zone/semantic-check.h"
 #include "knot/zone/contents.h"
 #include "knot/zone/zonefile.h"
@@ -38,6 +43,8 @@
 #define WARNING(zone, fmt, ...) log_zone_warning(zone, "zone loader, " fmt, ##__VA_ARGS__)
 #define NOTICE(zone, fmt, ...) log_zone_notice(zone, "zone loader, " fmt, ##__VA_ARGS__)
 
+#define DEFAULT_TTL 3600
+
 static void process_error(zs_scanner_t *s)
 {
 	zcreator_t *zc = s->process.data;
@@ -170,7 +177,7 @@ int zonefile_open(zloader_t *loader, const char *source,
 		return KNOT_ENOMEM;
 	}
 
-	if (zs_init(&loader->scanner, origin_str, KNOT_CLASS_IN, 3600) != 0 ||
+	if (zs_init(&loader->scanner, origin_str, KNOT_CLASS_IN, DEFAULT_TTL) != 0 ||
 	    zs_set_input_file(&loader->scanner, source) != 0 ||
 	    zs_set_processing(&loader->scanner, process_data, process_error, zc) != 0) {
 		zs_deinit(&loader->scanner);
@@ -185,10 +192,451 @@ int zonefile_open(zloader_t *loader, const char *source,
 	loader->creator = zc;
 	loader->semantic_checks = semantic_checks;
 	loader->time = time;
+	loader->threads = 1;
+	loader->chunk_size = ZONEFILE_CHUNK_SIZE;
+
+	return KNOT_EOK;
+}
+
+dynarray_declare(rrset, knot_rrset_t, DYNARRAY_VISIBILITY_STATIC, 16)
+dynarray_define(rrset, knot_rrset_t, DYNARRAY_VISIBILITY_STATIC)
+
+/*! \brief Zone file chunk for parallel parsing. */
+typedef struct {
+	const char *start;
+	size_t size;
+	uint64_t line;           /*!< Line number of the chunk start. */
+	char *preamble;          /*!< Directives in effect at the chunk start. */
+	rrset_dynarray_t rrsets; /*!< Parsed records. */
+	uint64_t errors;         /*!< Number of scanner errors. */
+	int error_code;          /*!< Last scanner error code. */
+	int ret;                 /*!< Processing error. */
+	bool done;
+} zchunk_t;
+
+/*! \brief Parallel parsing context. */
+typedef struct {
+	zloader_t *loader;
+	char *origin;
+	zchunk_t *chunks;
+	size_t count;
+	size_t next;      /*!< Next chunk to be parsed. */
+	size_t merged;    /*!< Number of chunks merged into the zone. */
+	size_t window;    /*!< Maximum number of parsed chunks waiting for merge. */
+	bool stop;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} zparallel_t;
+
+typedef struct {
+	zparallel_t *parallel;
+	zchunk_t *chunk;
+} zchunk_ctx_t;
+
+/*! \brief Directives affecting the records that follow. */
+typedef struct {
+	char *origin; /*!< Last $ORIGIN line. */
+	char *ttl;    /*!< Last $TTL line. */
+} zdirectives_t;
+
+static int str_append(char **dst, const char *src, size_t len)
+{
+	size_t dst_len = (*dst != NULL) ? strlen(*dst) : 0;
+	char *out = realloc(*dst, dst_len + len + 2);
+	if (out == NULL) {
+		return KNOT_ENOMEM;
+	}
+
+	memcpy(out + dst_len, src, len);
+	out[dst_len + len] = '\n';
+	out[dst_len + len + 1] = '\0';
+	*dst = out;
+
+	return KNOT_EOK;
+}
+
+static bool is_blank(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static bool is_owner_start(char c)
+{
+	return !is_blank(c) && strchr("\r\n;$()", c) == NULL;
+}
+
+static bool is_directive(const char *pos, const char *end, const char *name)
+{
+	size_t len = strlen(name);
+	return (end - pos > len && strncasecmp(pos, name, len) == 0 &&
+	        is_blank(pos[len]));
+}
+
+/*! \brief Remembers $ORIGIN and $TTL directives for the following chunks. */
+static int directive_add(zdirectives_t *dirs, const char *pos, const char *end)
+{
+	char **dir = NULL;
+	if (is_directive(pos, end, "$ORIGIN")) {
+		dir = &dirs->origin;
+	} else if (is_directive(pos, end, "$TTL")) {
+		dir = &dirs->ttl;
+	} else {
+		return KNOT_EOK;
+	}
+
+	const char *eol = memchr(pos, '\n', end - pos);
+	free(*dir);
+	*dir = NULL;
+
+	return str_append(dir, pos, ((eol != NULL) ? eol : end) - pos);
+}
+
+static int chunk_add(zparallel_t *p, const char *start, const char *end,
+                     uint64_t line, char *preamble)
+{
+	zchunk_t *chunks = realloc(p->chunks, (p->count + 1) * sizeof(*chunks));
+	if (chunks == NULL) {
+		free(preamble);
+		return KNOT_ENOMEM;
+	}
+	p->chunks = chunks;
+
+	zchunk_t *chunk = &p->chunks[p->count++];
+	memset(chunk, 0, sizeof(*chunk));
+	chunk->start = start;
+	chunk->size = end - start;
+	chunk->line = line;
+	chunk->preamble = preamble;
+
+	return KNOT_EOK;
+}
+
+static char *preamble_new(const zdirectives_t *dirs)
+{
+	char *preamble = NULL;
+	if ((dirs->origin != NULL &&
+	     str_append(&preamble, dirs->origin, strlen(dirs->origin)) != KNOT_EOK) ||
+	    (dirs->ttl != NULL &&
+	     str_append(&preamble, dirs->ttl, strlen(dirs->ttl)) != KNOT_EOK)) {
+		free(preamble);
+		return NULL;
+	}
+
+	return preamble;
+}
+
+/*!
+ * \brief Splits the zone file into chunks at record boundaries.
+ *
+ * A chunk starts at a line with an explicit owner outside of parentheses and
+ * quoted strings, so no record spans two chunks and no owner is inherited
+ * from the previous chunk.
+ */
+static int split_chunks(zparallel_t *p, const char *data, size_t size,
+                        size_t chunk_size)
+{
+	zdirectives_t dirs = { NULL };
+	const char *end = data + size;
+	const char *chunk_start = data;
+	char *chunk_preamble = NULL;
+	uint64_t chunk_line = 1, line = 1;
+	unsigned depth = 0;
+	bool quoted = false, line_start = true;
+	int ret = KNOT_EOK;
+
+	for (const char *pos = data; pos < end && ret == KNOT_EOK; pos++) {
+		if (line_start && depth == 0 && !quoted) {
+			if (*pos == '$') {
+				ret = directive_add(&dirs, pos, end);
+			} else if (pos - chunk_start >= chunk_size && is_owner_start(*pos)) {
+				ret = chunk_add(p, chunk_start, pos, chunk_line, chunk_preamble);
+				chunk_preamble = NULL;
+				if (ret == KNOT_EOK && (dirs.origin != NULL || dirs.ttl != NULL)) {
+					chunk_preamble = preamble_new(&dirs);
+					if (chunk_preamble == NULL) {
+						ret = KNOT_ENOMEM;
+					}
+				}
+				chunk_start = pos;
+				chunk_line = line;
+			}
+		}
+		line_start = false;
+
+		switch (*pos) {
+		case '\\':
+			if (pos + 1 < end && pos[1] == '\n') {
+				line++;
+			}
+			pos++;
+			break;
+		case '"':
+			quoted = !quoted;
+			break;
+		case ';':
+			if (!quoted) {
+				const char *eol = memchr(pos, '\n', end - pos);
+				pos = (eol != NULL) ? eol - 1 : end - 1;
+			}
+			break;
+		case '(':
+			depth += quoted ? 0 : 1;
+			break;
+		case ')':
+			depth -= (quoted || depth == 0) ? 0 : 1;
+			break;
+		case '\n':
+			line++;
+			line_start = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (ret == KNOT_EOK) {
+		ret = chunk_add(p, chunk_start, end, chunk_line, chunk_preamble);
+	} else {
+		free(chunk_preamble);
+	}
+
+	free(dirs.origin);
+	free(dirs.ttl);
+
+	return ret;
+}
+
+static void process_chunk_error(zs_scanner_t *s)
+{
+	zchunk_ctx_t *ctx = s->process.data;
+	const knot_dname_t *zname = ctx->parallel->loader->creator->z->apex->owner;
+
+	ERROR(zname, "%s in zone, file '%s', line %"PRIu64" (%s)",
+	      s->error.fatal ? "fatal error" : "error",
+	      s->file.name, s->line_counter,
+	      zs_strerror(s->error.code));
+}
+
+static void process_chunk_data(zs_scanner_t *s)
+{
+	zchunk_ctx_t *ctx = s->process.data;
+	zchunk_t *chunk = ctx->chunk;
+	if (chunk->ret != KNOT_EOK || ctx->parallel->stop) {
+		s->state = ZS_STATE_STOP;
+		return;
+	}
+
+	knot_dname_t *owner = knot_dname_copy(s->r_owner, NULL);
+	if (owner == NULL) {
+		chunk->ret = KNOT_ENOMEM;
+		return;
+	}
+
+	knot_rrset_t rr;
+	knot_rrset_init(&rr, owner, s->r_type, s->r_class, s->r_ttl);
+
+	int ret = knot_rrset_add_rdata(&rr, s->r_data, s->r_data_length, NULL);
+	if (ret == KNOT_EOK) {
+		ret = knot_rrset_rr_to_canonical(&rr);
+	}
+	if (ret == KNOT_EOK) {
+		rrset_dynarray_add(&chunk->rrsets, &rr);
+		if (chunk->rrsets.capacity < 0) {
+			ret = KNOT_ENOMEM;
+		}
+	}
+	if (ret != KNOT_EOK) {
+		knot_rrset_clear(&rr, NULL);
+		chunk->ret = ret;
+	}
+}
+
+static void parse_chunk(zparallel_t *p, zchunk_t *chunk)
+{
+	zchunk_ctx_t ctx = { p, chunk };
+	zs_scanner_t s;
+
+	if (zs_init(&s, p->origin, KNOT_CLASS_IN, DEFAULT_TTL) != 0) {
+		chunk->error_code = s.error.code;
+		zs_deinit(&s);
+		return;
+	}
+
+	/* Restore the directives in effect at the chunk start. Errors in them
+	 * are reported by the chunk containing them. */
+	if (chunk->preamble != NULL) {
+		if (zs_set_input_string(&s, chunk->preamble, strlen(chunk->preamble)) != 0 ||
+		    zs_parse_all(&s) != 0) {
+			chunk->errors = MAX(s.error.counter, 1);
+			chunk->error_code = s.error.code;
+			zs_deinit(&s);
+			return;
+		}
+		s.state = ZS_STATE_NONE;
+	}
+
+	if (zs_set_input_chunk(&s, p->loader->source, chunk->start, chunk->size,
+	                       chunk->line) != 0 ||
+	    zs_set_processing(&s, process_chunk_data, process_chunk_error, &ctx) != 0 ||
+	    zs_parse_all(&s) != 0) {
+		chunk->errors = s.error.counter;
+		chunk->error_code = s.error.code;
+	}
+
+	zs_deinit(&s);
+}
+
+static int parse_thread_run(dthread_t *thread)
+{
+	zparallel_t *p = thread->data;
+
+	pthread_mutex_lock(&p->lock);
+	while (true) {
+		/* Limit the number of chunks waiting for merge. */
+		while (!p->stop && p->next < p->count &&
+		       p->next >= p->merged + p->window) {
+			pthread_cond_wait(&p->cond, &p->lock);
+		}
+		if (p->stop || p->next >= p->count) {
+			break;
+		}
+
+		zchunk_t *chunk = &p->chunks[p->next++];
+		pthread_mutex_unlock(&p->lock);
+
+		parse_chunk(p, chunk);
+
+		pthread_mutex_lock(&p->lock);
+		chunk->done = true;
+		pthread_cond_broadcast(&p->cond);
+	}
+	pthread_mutex_unlock(&p->lock);
 
 	return KNOT_EOK;
 }
 
+static void chunk_clear(zchunk_t *chunk)
+{
+	dynarray_foreach(rrset, knot_rrset_t, rr, chunk->rrsets) {
+		knot_rrset_clear(rr, NULL);
+	}
+	rrset_dynarray_free(&chunk->rrsets);
+	memset(&chunk->rrsets, 0, sizeof(chunk->rrsets));
+	free(chunk->preamble);
+	chunk->preamble = NULL;
+}
+
+/*! \brief Merges the parsed chunks into the zone in the zone file order. */
+static void merge_chunks(zparallel_t *p)
+{
+	zloader_t *loader = p->loader;
+	zcreator_t *zc = loader->creator;
+
+	for (size_t i = 0; i < p->count; i++) {
+		zchunk_t *chunk = &p->chunks[i];
+
+		pthread_mutex_lock(&p->lock);
+		while (!chunk->done) {
+			pthread_cond_wait(&p->cond, &p->lock);
+		}
+		pthread_mutex_unlock(&p->lock);
+
+		/* Keep parsing after record errors to report them all. */
+		bool fatal = (chunk->error_code != 0 && chunk->errors == 0);
+		loader->scanner.error.counter += chunk->errors;
+		if (chunk->error_code != 0) {
+			loader->scanner.error.code = chunk->error_code;
+		}
+		if (zc->ret == KNOT_EOK) {
+			zc->ret = chunk->ret;
+		}
+
+		if (loader->scanner.error.counter == 0 && !fatal) {
+			dynarray_foreach(rrset, knot_rrset_t, rr, chunk->rrsets) {
+				if (zc->ret != KNOT_EOK) {
+					break;
+				}
+				zc->ret = zcreator_step(zc, rr);
+			}
+		}
+		chunk_clear(chunk);
+
+		pthread_mutex_lock(&p->lock);
+		p->merged = i + 1;
+		if (zc->ret != KNOT_EOK || fatal) {
+			p->stop = true;
+		}
+		pthread_cond_broadcast(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+
+		if (p->stop) {
+			break;
+		}
+	}
+}
+
+/*!
+ * \brief Parses the zone file in parallel.
+ *
+ * Errors are stored in the loader scanner and creator the same way as
+ * if the zone file was parsed sequentially.
+ *
+ * \return 0 or -1 as zs_parse_all().
+ */
+static int parse_parallel(zloader_t *loader)
+{
+	zcreator_t *zc = loader->creator;
+	zs_scanner_t *scanner = &loader->scanner;
+
+	zparallel_t p = {
+		.loader = loader,
+		.origin = knot_dname_to_str_alloc(zc->z->apex->owner)
+	};
+	if (p.origin == NULL) {
+		zc->ret = KNOT_ENOMEM;
+		return 0;
+	}
+
+	zc->ret = split_chunks(&p, scanner->input.start,
+	                       scanner->input.end - scanner->input.start,
+	                       loader->chunk_size);
+
+	unsigned threads = MIN(loader->threads, p.count);
+	p.window = 2 * threads;
+	pthread_mutex_init(&p.lock, NULL);
+	pthread_cond_init(&p.cond, NULL);
+
+	dt_unit_t *unit = NULL;
+	if (zc->ret == KNOT_EOK) {
+		unit = dt_create(threads, parse_thread_run, NULL, &p);
+		if (unit == NULL || dt_start(unit) != KNOT_EOK) {
+			zc->ret = KNOT_ENOMEM;
+		}
+	}
+
+	if (zc->ret == KNOT_EOK) {
+		merge_chunks(&p);
+
+		/* Stop parsing of the remaining chunks on error. */
+		pthread_mutex_lock(&p.lock);
+		p.stop = true;
+		pthread_cond_broadcast(&p.cond);
+		pthread_mutex_unlock(&p.lock);
+		dt_join(unit);
+	}
+	dt_delete(&unit);
+
+	for (size_t i = 0; i < p.count; i++) {
+		chunk_clear(&p.chunks[i]);
+	}
+	free(p.chunks);
+	free(p.origin);
+	pthread_cond_destroy(&p.cond);
+	pthread_mutex_destroy(&p.lock);
+
+	return (scanner->error.counter > 0 || scanner->error.code != 0) ? -1 : 0;
+}
+
 zone_contents_t *zonefile_load(zloader_t *loader)
 {
 	if (!loader) {
@@ -199,7 +647,9 @@ zone_contents_t *zonefile_load(zloader_t *loader)
 	const knot_dname_t *zname = zc->z->apex->owner;
 
 	assert(zc);
-	int ret = zs_parse_all(&loader->scanner);
+	size_t size = loader->scanner.input.end - loader->scanner.input.start;
+	int ret = (loader->threads > 1 && size > loader->chunk_size) ?
+	          parse_parallel(loader) : zs_parse_all(&loader->scanner);
 	if (ret != 0 && loader->scanner.error.counter == 0) {
 		ERROR(zname, "failed to load zone, file '%s' (%s)",
 		      loader->source, zs_strerror(loader->scanner.error.code));
@@ -225,7 +675,11 @@ zone_contents_t *zonefile_load(zloader_t *loader)
 		goto fail;
 	}
 
-	ret = zone_contents_adjust_full(zc->z);
+	ret = zone_contents_pack(zc->z);
+	zname = zc->z->apex->owner;
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_adjust_full(zc->z);
+	}
 	if (ret != KNOT_EOK) {
 		ERROR(zname, "failed to finalize zone contents (%s)",
 		      knot_strerror(ret));
@@ -41,8 +41,13 @@ typedef struct {
 	zcreator_t *creator;         /*!< Loader context. */
 	zs_scanner_t scanner;        /*!< Zone scanner. */
 	time_t time;                 /*!< time for zone check. */
+	unsigned threads;            /*!< Number of parsing threads. */
+	size_t chunk_size;           /*!< Minimal size of a parallel parsing chunk. */
 } zloader_t;
 
+/*! \brief Default minimal size of a zone file chunk for parallel parsing. */
+#define ZONEFILE_CHUNK_SIZE	(4 * 1024 * 1024)
+
 void err_handler_logger(sem_handler_t *handler, const zone_contents_t *zone,
                         const zone_node_t *node, sem_error_t error, const char *data);
 
@@ -64,6 +69,9 @@ int zonefile_open(zloader_t *loader, const char *source,
 /*!
  * \brief Loads zone from a zone file.
  *
+ * If more threads are configured and the zone file is bigger than the chunk
+ * size, it's split at record boundaries and the chunks are parsed in parallel.
+ *
  * \param loader Zone loader instance.
  *
  * \retval Loaded zone contents on success.
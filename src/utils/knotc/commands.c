@@ -552,8 +552,9 @@ static int zone_check(const knot_dname_t *dname, void *data)
 {
 	UNUSED(data);
 
+	/* Check the zone file itself, not its snapshot. */
 	zone_contents_t *contents;
-	int ret = zone_load_contents(conf(), dname, &contents);
+	int ret = zone_load_contents(conf(), dname, &contents, false);
 	if (ret == KNOT_EOK) {
 		zone_contents_deep_free(&contents);
 	}
@@ -312,6 +312,32 @@ int zs_set_input_file(
 	const char *file_name
 );
 
+/*!
+ * \brief Sets the scanner to parse a chunk of a zone file.
+ *
+ * The scanner keeps its current origin and default TTL, so a zone file
+ * split at record boundaries can be parsed by several scanners, each one
+ * prepared with the directives preceding its chunk.
+ *
+ * \note Error code is stored in the scanner context.
+ *
+ * \param scanner    Scanner context.
+ * \param file_name  Name of the file the chunk belongs to.
+ * \param input      Chunk of the zone file data.
+ * \param size       Size of the chunk.
+ * \param line       Line number of the chunk start in the file.
+ *
+ * \retval  0  if success.
+ * \retval -1  if error.
+ */
+int zs_set_input_chunk(
+	zs_scanner_t *scanner,
+	const char *file_name,
+	const char *input,
+	size_t size,
+	uint64_t line
+);
+
 /*!
  * \brief Sets the scanner processing callbacks for automatic processing.
  *
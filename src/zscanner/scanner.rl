@@ -314,6 +314,56 @@ int zs_set_input_file(
 	return 0;
 }
 
+__attribute__((visibility("default")))
+int zs_set_input_chunk(
+	zs_scanner_t *s,
+	const char *file_name,
+	const char *input,
+	size_t size,
+	uint64_t line)
+{
+	if (s == NULL) {
+		return -1;
+	}
+
+	if (file_name == NULL) {
+		ERR(ZS_EINVAL);
+		return -1;
+	}
+
+	if (set_input_string(s, input, size, false) != 0) {
+		return -1;
+	}
+
+	// Relative includes are relative to the zone file.
+	char *full_name = realpath(file_name, NULL);
+	if (full_name != NULL) {
+		free(s->path);
+		s->path = strdup(dirname(full_name));
+		free(full_name);
+		if (s->path == NULL) {
+			ERR(ZS_ENOMEM);
+			input_deinit(s, false);
+			return -1;
+		}
+	} else {
+		ERR(ZS_FILE_PATH);
+		input_deinit(s, false);
+		return -1;
+	}
+
+	s->file.name = strdup(file_name);
+	if (s->file.name == NULL) {
+		ERR(ZS_ENOMEM);
+		input_deinit(s, false);
+		return -1;
+	}
+
+	s->line_counter = line;
+
+	return 0;
+}
+
 __attribute__((visibility("default")))
 int zs_set_processing(
 	zs_scanner_t *s,
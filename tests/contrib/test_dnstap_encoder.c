@@ -0,0 +1,179 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tap/basic.h>
+
+#include "contrib/dnstap/encoder.h"
+#include "contrib/sockaddr.h"
+
+static const uint8_t TEST_IDENTITY[] = "ns1.example";
+static const uint8_t TEST_VERSION[] = "Knot DNS";
+static const uint8_t TEST_WIRE[] = "\x12\x34\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00"
+                                   "\x07""example""\x03""com""\x00""\x00\x01""\x00\x01";
+
+static bool bytes_eq(const ProtobufCBinaryData *data, const void *expected, size_t len)
+{
+	return data->len == len && memcmp(data->data, expected, len) == 0;
+}
+
+/*! \brief Encodes the frame and decodes it with protobuf-c. */
+static Dnstap__Dnstap *encode_decode(const dt_frame_t *frame, const char *desc)
+{
+	size_t size = dt_frame_encode(frame, NULL, 0);
+	uint8_t *buf = malloc(size);
+	if (buf == NULL) {
+		return NULL;
+	}
+
+	ok(dt_frame_encode(frame, buf, size - 1) == size,
+	   "%s: short buffer reports the frame size", desc);
+	ok(dt_frame_encode(frame, buf, size) == size, "%s: encode", desc);
+
+	Dnstap__Dnstap *dnstap = dnstap__dnstap__unpack(NULL, size, buf);
+	free(buf);
+
+	ok(dnstap != NULL && dnstap->type == DNSTAP__DNSTAP__TYPE__MESSAGE &&
+	   dnstap->message != NULL, "%s: decode", desc);
+	if (dnstap != NULL && dnstap->message == NULL) {
+		dnstap__dnstap__free_unpacked(dnstap, NULL);
+		return NULL;
+	}
+
+	return dnstap;
+}
+
+static void test_query(void)
+{
+	struct sockaddr_storage remote;
+	sockaddr_set(&remote, AF_INET, "192.0.2.1", 53535);
+	const struct sockaddr_in *sin = (struct sockaddr_in *)&remote;
+	struct timespec query_time = { 1500000000, 123456789 };
+
+	dt_frame_t frame = {
+		.identity = TEST_IDENTITY,
+		.identity_len = sizeof(TEST_IDENTITY) - 1,
+		.version = TEST_VERSION,
+		.version_len = sizeof(TEST_VERSION) - 1,
+		.type = DNSTAP__MESSAGE__TYPE__AUTH_QUERY,
+		.query_sa = (struct sockaddr *)&remote,
+		.protocol = IPPROTO_UDP,
+		.query_time = &query_time,
+		.wire = TEST_WIRE,
+		.wire_len = sizeof(TEST_WIRE) - 1
+	};
+
+	Dnstap__Dnstap *dnstap = encode_decode(&frame, "query");
+	if (dnstap == NULL) {
+		return;
+	}
+	const Dnstap__Message *msg = dnstap->message;
+
+	ok(dnstap->has_identity &&
+	   bytes_eq(&dnstap->identity, TEST_IDENTITY, sizeof(TEST_IDENTITY) - 1) &&
+	   dnstap->has_version &&
+	   bytes_eq(&dnstap->version, TEST_VERSION, sizeof(TEST_VERSION) - 1) &&
+	   !dnstap->has_extra, "query: identity and version");
+	ok(msg->type == DNSTAP__MESSAGE__TYPE__AUTH_QUERY, "query: type");
+	ok(msg->has_socket_family && msg->socket_family == DNSTAP__SOCKET_FAMILY__INET &&
+	   msg->has_socket_protocol && msg->socket_protocol == DNSTAP__SOCKET_PROTOCOL__UDP,
+	   "query: socket family and protocol");
+	ok(msg->has_query_address &&
+	   bytes_eq(&msg->query_address, &sin->sin_addr, sizeof(sin->sin_addr)) &&
+	   msg->has_query_port && msg->query_port == 53535,
+	   "query: query address and port");
+	ok(!msg->has_response_address && !msg->has_response_port,
+	   "query: no response address and port");
+	ok(msg->has_query_time_sec && msg->query_time_sec == 1500000000 &&
+	   msg->has_query_time_nsec && msg->query_time_nsec == 123456789,
+	   "query: query time");
+	ok(!msg->has_response_time_sec && !msg->has_response_time_nsec,
+	   "query: no response time");
+	ok(msg->has_query_message &&
+	   bytes_eq(&msg->query_message, TEST_WIRE, sizeof(TEST_WIRE) - 1) &&
+	   !msg->has_response_message && !msg->has_query_zone,
+	   "query: query message");
+
+	dnstap__dnstap__free_unpacked(dnstap, NULL);
+}
+
+static void test_response(void)
+{
+	struct sockaddr_storage remote, local;
+	sockaddr_set(&remote, AF_INET6, "2001:db8::1", 1);
+	sockaddr_set(&local, AF_INET6, "2001:db8::53", 65535);
+	const struct sockaddr_in6 *remote6 = (struct sockaddr_in6 *)&remote;
+	const struct sockaddr_in6 *local6 = (struct sockaddr_in6 *)&local;
+	/* Seconds beyond 32 bits, nanoseconds with the high bits set. */
+	struct timespec query_time = { 0x100000000LL, 999999999 };
+	struct timespec response_time = { 0x100000001LL, 0 };
+
+	dt_frame_t frame = {
+		.type = DNSTAP__MESSAGE__TYPE__AUTH_RESPONSE,
+		.query_sa = (struct sockaddr *)&remote,
+		.response_sa = (struct sockaddr *)&local,
+		.protocol = IPPROTO_TCP,
+		.query_time = &query_time,
+		.response_time = &response_time,
+		.wire = TEST_WIRE,
+		.wire_len = sizeof(TEST_WIRE) - 1
+	};
+
+	Dnstap__Dnstap *dnstap = encode_decode(&frame, "response");
+	if (dnstap == NULL) {
+		return;
+	}
+	const Dnstap__Message *msg = dnstap->message;
+
+	ok(!dnstap->has_identity && !dnstap->has_version, "response: no identity and version");
+	ok(msg->type == DNSTAP__MESSAGE__TYPE__AUTH_RESPONSE, "response: type");
+	ok(msg->has_socket_family && msg->socket_family == DNSTAP__SOCKET_FAMILY__INET6 &&
+	   msg->has_socket_protocol && msg->socket_protocol == DNSTAP__SOCKET_PROTOCOL__TCP,
+	   "response: socket family and protocol");
+	ok(msg->has_query_address &&
+	   bytes_eq(&msg->query_address, &remote6->sin6_addr, sizeof(remote6->sin6_addr)) &&
+	   msg->has_query_port && msg->query_port == 1,
+	   "response: query address and port");
+	ok(msg->has_response_address &&
+	   bytes_eq(&msg->response_address, &local6->sin6_addr, sizeof(local6->sin6_addr)) &&
+	   msg->has_response_port && msg->response_port == 65535,
+	   "response: response address and port");
+	ok(msg->has_query_time_sec && msg->query_time_sec == 0x100000000ULL &&
+	   msg->has_query_time_nsec && msg->query_time_nsec == 999999999,
+	   "response: query time");
+	ok(msg->has_response_time_sec && msg->response_time_sec == 0x100000001ULL &&
+	   msg->has_response_time_nsec && msg->response_time_nsec == 0,
+	   "response: response time");
+	ok(msg->has_response_message &&
+	   bytes_eq(&msg->response_message, TEST_WIRE, sizeof(TEST_WIRE) - 1) &&
+	   !msg->has_query_message, "response: response message");
+
+	dnstap__dnstap__free_unpacked(dnstap, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	test_query();
+	test_response();
+
+	ok(dt_frame_encode(NULL, NULL, 0) == 0, "no frame");
+
+	return 0;
+}
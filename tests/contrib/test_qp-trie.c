@@ -102,6 +102,142 @@ static bool str_key_get_leq(trie_t *trie, char **keys, size_t i, size_t size)
 
 }
 
+/*! \brief Check that all keys from the array are present with given values. */
+static bool str_key_check(trie_t *trie, char **keys, size_t from, size_t to,
+                          bool present, void *value)
+{
+	for (size_t i = from; i < to; ++i) {
+		trie_val_t *val = trie_get_try(trie, keys[i], strlen(keys[i]) + 1);
+		if (!present && val != NULL) {
+			diag("%s: key %zu/'%s' unexpectedly found", __func__, i, keys[i]);
+			return false;
+		}
+		if (present && (val == NULL || (value != NULL && *val != value) ||
+		                (value == NULL && strcmp(*val, keys[i]) != 0))) {
+			diag("%s: key %zu/'%s' not found or mismatching", __func__, i, keys[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static int str_key_replace(trie_val_t *val, void *data)
+{
+	*val = data;
+	return KNOT_EOK;
+}
+
+/*! \brief Test copy-on-write clones, the keys are expected to be unique. */
+/*! \brief Check longest prefix match on keys ending with a separator. */
+static void test_lpm(void)
+{
+	static const struct {
+		const char *key;
+		uint32_t len;
+	} keys[] = {
+		{ "", 0 },
+		{ "a\0", 2 },
+		{ "a\0b\0", 4 },
+		{ "a\0bc\0", 5 },
+		{ "a\0bc\0d\0e\0", 9 },
+		{ "x\0", 2 },
+	};
+	static const struct {
+		const char *key;
+		uint32_t len;
+		int ret;
+		int match;
+	} queries[] = {
+		{ "a\0b\0", 4, KNOT_EOK, 2 },   /* exact */
+		{ "a\0b\0z\0", 6, 1, 2 },      /* direct prefix */
+		{ "a\0bc\0d\0", 7, 1, 3 },     /* key with a longer sibling */
+		{ "a\0bcd\0", 6, 1, 1 },        /* longer label */
+		{ "a\0c\0", 4, 1, 1 },          /* missing twig */
+		{ "b\0", 2, 1, 0 },              /* empty key only */
+		{ "", 0, KNOT_EOK, 0 },          /* empty key */
+	};
+
+	trie_t *trie = trie_create(NULL);
+	trie_val_t *val = NULL;
+	for (int i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+		*trie_get_ins(trie, keys[i].key, keys[i].len) = (void *)&keys[i];
+	}
+
+	bool passed = true;
+	for (int i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+		int ret = trie_get_lpm(trie, queries[i].key, queries[i].len, &val);
+		if (ret != queries[i].ret || val == NULL || *val != &keys[queries[i].match]) {
+			diag("trie: lpm query %d ret = %d", i, ret);
+			passed = false;
+		}
+	}
+	ok(passed, "trie: longest prefix match");
+
+	/* Without the empty key. */
+	trie_del(trie, "", 0, NULL);
+	int ret = trie_get_lpm(trie, "b\0", 2, &val);
+	ok(ret == KNOT_ENOENT && val == NULL, "trie: longest prefix match not found");
+	ret = trie_get_lpm(trie, "x\0y\0", 4, &val);
+	ok(ret == 1 && *val == &keys[5], "trie: longest prefix match last key");
+
+	trie_free(trie);
+}
+
+static void test_cow(char **keys, size_t key_count)
+{
+	static char tag1, tag2;
+	const size_t half = key_count / 2;
+
+	trie_t *orig = trie_create(NULL);
+	for (size_t i = 0; i < half; ++i) {
+		*trie_get_ins(orig, keys[i], strlen(keys[i]) + 1) = keys[i];
+	}
+
+	trie_t *clone = trie_cow(orig);
+	ok(clone != NULL && trie_weight(clone) == half, "trie: cow clone");
+
+	/* Modify the clone: delete, insert and rewrite values. */
+	bool passed = true;
+	for (size_t i = 0; i < half / 2; ++i) {
+		passed &= (trie_del(clone, keys[i], strlen(keys[i]) + 1, NULL) == KNOT_EOK);
+	}
+	for (size_t i = half; i < key_count; ++i) {
+		*trie_get_ins(clone, keys[i], strlen(keys[i]) + 1) = keys[i];
+	}
+	for (size_t i = half / 2; i < half; i += 2) {
+		*trie_get_ins(clone, keys[i], strlen(keys[i]) + 1) = &tag1;
+	}
+	ok(passed && trie_weight(clone) == key_count - half / 2, "trie: cow modify clone");
+
+	/* The original must stay intact. */
+	ok(trie_weight(orig) == half && str_key_check(orig, keys, 0, half, true, NULL) &&
+	   str_key_check(orig, keys, half, key_count, false, NULL),
+	   "trie: cow original intact");
+
+	passed = str_key_check(clone, keys, 0, half / 2, false, NULL) &&
+	         str_key_check(clone, keys, half, key_count, true, NULL);
+	for (size_t i = half / 2; i < half; ++i) {
+		passed &= str_key_check(clone, keys, i, i + 1, true,
+		                        (i - half / 2) % 2 == 0 ? &tag1 : NULL);
+	}
+	ok(passed, "trie: cow clone contents");
+
+	/* Rewrite all values in a second clone. */
+	trie_t *clone2 = trie_cow(clone);
+	int ret = trie_apply_cow(clone2, str_key_replace, &tag2);
+	ok(ret == KNOT_EOK && str_key_check(clone2, keys, half, key_count, true, &tag2) &&
+	   str_key_check(clone, keys, half, key_count, true, NULL),
+	   "trie: cow apply");
+
+	/* Free the original first, the clones must stay valid. */
+	trie_free(orig);
+	trie_free(clone);
+	ok(trie_weight(clone2) == key_count - half / 2 &&
+	   str_key_check(clone2, keys, half / 2, key_count, true, &tag2),
+	   "trie: cow clone outlives original");
+	trie_free(clone2);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -172,6 +308,9 @@ int main(int argc, char *argv[])
 	}
 	ok(passed, "trie: find lesser or equal for all keys");
 
+	/* Longest prefix match. */
+	test_lpm();
+
 	/* Sorted iteration. */
 	char key_buf[KEY_MAXLEN] = {'\0'};
 	size_t iterated = 0;
@@ -190,8 +329,53 @@ int main(int argc, char *argv[])
 		trie_it_next(it);
 	}
 	is_int(inserted, iterated, "trie: sorted iteration");
+
+	/* Reverse iteration. */
+	iterated = 0;
+	trie_it_last(it);
+	while (!trie_it_finished(it)) {
+		size_t cur_key_len = 0;
+		const char *cur_key = trie_it_key(it, &cur_key_len);
+		if (iterated > 0 && strcmp(key_buf, cur_key) < 0) {
+			diag("'%s' >= '%s' FAIL\n", key_buf, cur_key);
+			break;
+		}
+		++iterated;
+		memcpy(key_buf, cur_key, cur_key_len);
+		trie_it_prev(it);
+	}
+	is_int(inserted, iterated, "trie: reverse iteration");
+
+	/* Iterator positioned at lesser or equal keys. */
+	passed = true;
+	for (unsigned i = 0; i < key_count && passed; ++i) {
+		size_t key_len = strlen(keys[i]) + 1;
+		int ret = trie_it_get_leq(it, keys[i], key_len);
+		passed = (ret == KNOT_EOK && strcmp(trie_it_key(it, NULL), keys[i]) == 0);
+		if (passed && i > 0 && strcmp(keys[i - 1], keys[i]) != 0) {
+			trie_it_prev(it);
+			passed = !trie_it_finished(it) &&
+			         strcmp(trie_it_key(it, NULL), keys[i - 1]) == 0;
+		}
+	}
+	ok(passed, "trie: iterator at lesser or equal keys");
+	trie_it_first(it);
+	ok(!trie_it_finished(it) && strcmp(trie_it_key(it, NULL), keys[0]) == 0,
+	   "trie: iterator at the first key");
 	trie_it_free(it);
 
+	/* Copy-on-write clones, with unique keys. */
+	size_t unique = 0;
+	for (unsigned i = 0; i < key_count; ++i) {
+		if (unique == 0 || strcmp(keys[unique - 1], keys[i]) != 0) {
+			keys[unique++] = keys[i];
+		} else {
+			free(keys[i]);
+		}
+	}
+	key_count = unique;
+	test_cow(keys, key_count);
+
 	/* Cleanup */
 	for (unsigned i = 0; i < key_count; ++i) {
 		free(keys[i]);
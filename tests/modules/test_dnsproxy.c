@@ -0,0 +1,206 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <tap/basic.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "knot/modules/dnsproxy/forwarder.h"
+#include "libknot/libknot.h"
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+
+#define TIMEOUT		300
+#define ROTATE_QUERIES	5000
+#define QUERY_ID	0x1234
+
+static const uint8_t QNAME[] = "\x07""example""\x03""com";
+static const uint8_t ORIG_QNAME[] = "\x07""ExAmPlE""\x03""CoM";
+
+static int bound_socket(struct sockaddr_storage *addr)
+{
+	sockaddr_set(addr, AF_INET, "127.0.0.1", 0);
+	int fd = net_bound_socket(SOCK_DGRAM, (struct sockaddr *)addr, 0);
+	if (fd >= 0) {
+		socklen_t len = sizeof(*addr);
+		getsockname(fd, (struct sockaddr *)addr, &len);
+	}
+
+	return fd;
+}
+
+static ssize_t receive(int fd, knot_pkt_t *pkt, struct sockaddr_storage *from,
+                       int timeout)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	if (poll(&pfd, 1, timeout) != 1) {
+		return -1;
+	}
+
+	socklen_t from_len = sizeof(*from);
+	knot_pkt_clear(pkt);
+	ssize_t got = recvfrom(fd, pkt->wire, pkt->max_size, 0,
+	                       (struct sockaddr *)from, &from_len);
+	if (got > 0) {
+		pkt->size = got;
+		if (knot_pkt_parse(pkt, 0) != KNOT_EOK) {
+			return -1;
+		}
+	}
+
+	return got;
+}
+
+/*! \brief Answers the upstream query, optionally with a different ID. */
+static void answer(int fd, knot_pkt_t *query, const struct sockaddr_storage *to,
+                   int id_shift)
+{
+	knot_pkt_t *resp = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	knot_pkt_init_response(resp, query);
+	knot_wire_set_id(resp->wire, knot_wire_get_id(query->wire) + id_shift);
+	sendto(fd, resp->wire, resp->size, 0, (const struct sockaddr *)to,
+	       sockaddr_len((const struct sockaddr *)to));
+	knot_pkt_free(resp);
+}
+
+static bool has_port(in_port_t *ports, size_t count, in_port_t port)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (ports[i] == port) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	struct sockaddr_storage upstream_addr, server_addr, client_addr;
+	struct sockaddr_storage via = { AF_UNSPEC }, from;
+	int upstream = bound_socket(&upstream_addr);
+	int server = bound_socket(&server_addr);
+	int client = bound_socket(&client_addr);
+	ok(upstream >= 0 && server >= 0 && client >= 0, "create sockets");
+
+	fwd_t *fwd = NULL;
+	int ret = fwd_new(&upstream_addr, &via, TIMEOUT, &fwd);
+	is_int(KNOT_EOK, ret, "create forwarder");
+
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	knot_pkt_put_question(query, QNAME, KNOT_CLASS_IN, KNOT_RRTYPE_A);
+	knot_wire_set_id(query->wire, QUERY_ID);
+	knot_pkt_t *pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+
+	/* Forwarded query. */
+	ret = fwd_query(fwd, query, ORIG_QNAME, server, &client_addr);
+	is_int(KNOT_EOK, ret, "query handed over");
+	knot_pkt_t *fwd_pkt = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	ok(receive(upstream, fwd_pkt, &from, 1000) > 0 &&
+	   memcmp(knot_pkt_qname(fwd_pkt), QNAME, sizeof(QNAME)) == 0,
+	   "query forwarded");
+
+	/* Unknown upstream ID. */
+	answer(upstream, fwd_pkt, &from, 1);
+	ok(receive(client, pkt, &from, 100) < 0, "unmatched answer dropped");
+
+	/* Matching answer. */
+	struct sockaddr_storage server_from;
+	answer(upstream, fwd_pkt, &from, 0);
+	ok(receive(client, pkt, &server_from, 1000) > 0 &&
+	   knot_wire_get_qr(pkt->wire) && knot_wire_get_id(pkt->wire) == QUERY_ID &&
+	   sockaddr_cmp((struct sockaddr *)&server_from,
+	                (struct sockaddr *)&server_addr) == 0,
+	   "answer relayed from the query socket");
+	ok(memcmp(pkt->wire + KNOT_WIRE_HEADER_SIZE, ORIG_QNAME, sizeof(ORIG_QNAME)) == 0,
+	   "original QNAME case restored");
+	answer(upstream, fwd_pkt, &from, 0);
+	ok(receive(client, pkt, &from, 100) < 0, "answer relayed once");
+
+	/* Query socket closed meanwhile (e.g. reload). */
+	struct sockaddr_storage reload_addr;
+	int reload = bound_socket(&reload_addr);
+	ret = fwd_query(fwd, query, NULL, reload, &client_addr);
+	close(reload);
+	ok(ret == KNOT_EOK && receive(upstream, fwd_pkt, &from, 1000) > 0,
+	   "query forwarded before reload");
+	answer(upstream, fwd_pkt, &from, 0);
+	ok(receive(client, pkt, &server_from, 1000) > 0 &&
+	   sockaddr_cmp((struct sockaddr *)&server_from,
+	                (struct sockaddr *)&reload_addr) == 0,
+	   "answer relayed after reload");
+
+	/* Timeout. */
+	ret = fwd_query(fwd, query, ORIG_QNAME, server, &client_addr);
+	ok(ret == KNOT_EOK && receive(upstream, fwd_pkt, &from, 1000) > 0,
+	   "unanswered query forwarded");
+	ok(receive(client, pkt, &from, 10 * TIMEOUT) > 0 &&
+	   knot_wire_get_rcode(pkt->wire) == KNOT_RCODE_SERVFAIL &&
+	   knot_wire_get_id(pkt->wire) == QUERY_ID &&
+	   memcmp(pkt->wire + KNOT_WIRE_HEADER_SIZE, ORIG_QNAME, sizeof(ORIG_QNAME)) == 0,
+	   "SERVFAIL after timeout");
+	answer(upstream, fwd_pkt, &from, 0);
+	ok(receive(client, pkt, &from, 100) < 0, "late answer dropped");
+
+	/* Source port rotation and random IDs. */
+	in_port_t ports[64];
+	size_t ports_count = 0;
+	uint16_t prev_id = 0;
+	unsigned sequential = 0;
+	bool relayed = true;
+	for (int i = 0; i < ROTATE_QUERIES && relayed; i++) {
+		for (int tries = 0; tries < 100; tries++) {
+			ret = fwd_query(fwd, query, NULL, server, &client_addr);
+			if (ret != KNOT_ELIMIT) {
+				break;
+			}
+			usleep(10000);
+		}
+		relayed = (ret == KNOT_EOK && receive(upstream, fwd_pkt, &from, 1000) > 0);
+		if (!relayed) {
+			break;
+		}
+		/* The low bits must not identify a slot. */
+		uint16_t id = knot_wire_get_id(fwd_pkt->wire);
+		if (((id - prev_id) & 0xff) <= 1) {
+			sequential++;
+		}
+		prev_id = id;
+		in_port_t port = ((struct sockaddr_in *)&from)->sin_port;
+		if (!has_port(ports, ports_count, port) &&
+		    ports_count < sizeof(ports) / sizeof(*ports)) {
+			ports[ports_count++] = port;
+		}
+		answer(upstream, fwd_pkt, &from, 0);
+		relayed = (receive(client, pkt, &from, 1000) > 0);
+	}
+	ok(relayed, "queries relayed");
+	ok(sequential < ROTATE_QUERIES / 20, "message ID randomized");
+	ok(ports_count > 16, "source ports rotated (%zu ports)", ports_count);
+
+	fwd_free(fwd);
+	knot_pkt_free(query);
+	knot_pkt_free(pkt);
+	knot_pkt_free(fwd_pkt);
+	close(upstream);
+	close(server);
+	close(client);
+
+	return 0;
+}
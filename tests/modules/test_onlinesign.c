@@ -18,9 +18,11 @@
 #include <assert.h>
 
 #include "knot/modules/onlinesign/nsec_next.h"
+#include "knot/modules/onlinesign/rrsig_cache.h"
 #include "libknot/consts.h"
 #include "libknot/dname.h"
 #include "libknot/errcode.h"
+#include "libknot/rrset.h"
 
 /*!
  * \brief Assert that a domain name in a static buffer is valid.
@@ -58,10 +60,74 @@ static void _test_nsec_next(const char *msg,
 	_test_nsec_next(msg, input, apex, expected); \
 }
 
+static void test_rrsig_cache(void)
+{
+	rrsig_cache_t *cache = rrsig_cache_new(16);
+	ok(cache != NULL, "rrsig_cache, create");
+
+	uint8_t owner[] = "\x03""www""\x07""example""\x03""com";
+	uint8_t addr1[] = { 192, 0, 2, 1 };
+	uint8_t addr2[] = { 192, 0, 2, 2 };
+	uint8_t sig[] = "signature";
+
+	knot_rrset_t covered;
+	knot_rrset_init(&covered, owner, KNOT_RRTYPE_A, KNOT_CLASS_IN, 300);
+	knot_rrset_add_rdata(&covered, addr1, sizeof(addr1), NULL);
+
+	knot_rrset_t rrsig;
+	knot_rrset_init(&rrsig, owner, KNOT_RRTYPE_RRSIG, KNOT_CLASS_IN, 300);
+	knot_rrset_add_rdata(&rrsig, sig, sizeof(sig), NULL);
+	const knot_rdataset_t rrsigs = rrsig.rrs;
+
+	knot_rdataset_t found;
+	knot_rdataset_init(&found);
+	int ret = rrsig_cache_get(cache, &covered, 100, &found, NULL);
+	is_int(KNOT_ENOENT, ret, "rrsig_cache, empty");
+
+	ret = rrsig_cache_put(cache, &covered, &rrsigs, 200);
+	is_int(KNOT_EOK, ret, "rrsig_cache, put");
+
+	ret = rrsig_cache_get(cache, &covered, 100, &found, NULL);
+	ok(ret == KNOT_EOK && knot_rdataset_eq(&found, &rrsigs), "rrsig_cache, hit");
+	knot_rdataset_clear(&found, NULL);
+
+	ret = rrsig_cache_get(cache, &covered, 200, &found, NULL);
+	is_int(KNOT_ENOENT, ret, "rrsig_cache, expired");
+
+	covered.ttl = 600;
+	ret = rrsig_cache_get(cache, &covered, 100, &found, NULL);
+	is_int(KNOT_ENOENT, ret, "rrsig_cache, different TTL");
+	covered.ttl = 300;
+
+	knot_rdataset_clear(&covered.rrs, NULL);
+	knot_rrset_add_rdata(&covered, addr2, sizeof(addr2), NULL);
+	ret = rrsig_cache_get(cache, &covered, 100, &found, NULL);
+	is_int(KNOT_ENOENT, ret, "rrsig_cache, different RDATA");
+
+	knot_rdataset_clear(&covered.rrs, NULL);
+	knot_rrset_add_rdata(&covered, addr1, sizeof(addr1), NULL);
+	rrsig_cache_set_gen(cache, &covered);
+	ret = rrsig_cache_get(cache, &covered, 100, &found, NULL);
+	is_int(KNOT_ENOENT, ret, "rrsig_cache, flushed on generation change");
+
+	rrsig_cache_put(cache, &covered, &rrsigs, 200);
+	rrsig_cache_set_gen(cache, &covered);
+	ret = rrsig_cache_get(cache, &covered, 100, &found, NULL);
+	ok(ret == KNOT_EOK && knot_rdataset_eq(&found, &rrsigs),
+	   "rrsig_cache, kept for the same generation");
+	knot_rdataset_clear(&found, NULL);
+
+	knot_rdataset_clear(&covered.rrs, NULL);
+	knot_rdataset_clear(&rrsig.rrs, NULL);
+	rrsig_cache_free(cache);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
 
+	test_rrsig_cache();
+
 	// adding a single zero-byte label
 
 	test_nsec_next(
@@ -88,6 +88,89 @@ static void rrl_hopscotch(struct runnable_data* rd)
 }
 #endif
 
+#define RRL_STRESS_ADDRS 1024
+#define RRL_STRESS_QUERIES 16 /* Per address and thread. */
+
+/*! \brief Stress test runnable. */
+struct stress_data {
+	rrl_table_t *rrl;
+	rrl_req_t *rq;
+	knot_dname_t *zone;
+	uint32_t now;
+	unsigned offset;
+	unsigned *passed;
+};
+
+static void stress_addr(struct sockaddr_storage *addr, unsigned i)
+{
+	/* Each address in a different /24 netblock. */
+	sockaddr_set(addr, AF_INET, "10.0.0.1", 0);
+	((struct sockaddr_in *)addr)->sin_addr.s_addr ^= htonl(i << 8);
+}
+
+static void *rrl_stress_runnable(void *arg)
+{
+	struct stress_data *d = arg;
+	struct sockaddr_storage addr;
+	for (unsigned q = 0; q < RRL_STRESS_QUERIES; ++q) {
+		for (unsigned j = 0; j < RRL_STRESS_ADDRS; ++j) {
+			/* Threads start at different addresses to mix the shards. */
+			unsigned i = (j + d->offset) % RRL_STRESS_ADDRS;
+			stress_addr(&addr, i);
+			if (rrl_update(d->rrl, &addr, d->rq, d->zone, NULL, d->now) == KNOT_EOK) {
+				__atomic_add_fetch(d->passed + i, 1, __ATOMIC_RELAXED);
+			}
+		}
+	}
+	return NULL;
+}
+
+static bool rrl_stress(rrl_req_t *rq, knot_dname_t *zone, uint32_t rate)
+{
+	const uint32_t now = time(NULL);
+	unsigned *expect = calloc(RRL_STRESS_ADDRS, sizeof(unsigned));
+	unsigned *passed = calloc(RRL_STRESS_ADDRS, sizeof(unsigned));
+	rrl_table_t *seq = rrl_create(RRL_SIZE, rate);
+	rrl_table_t *par = rrl_create(RRL_SIZE, rate);
+
+	/* Sequential reference decisions. */
+	struct sockaddr_storage addr;
+	for (unsigned i = 0; i < RRL_STRESS_ADDRS; ++i) {
+		stress_addr(&addr, i);
+		for (unsigned q = 0; q < RRL_THREADS * RRL_STRESS_QUERIES; ++q) {
+			if (rrl_update(seq, &addr, rq, zone, NULL, now) == KNOT_EOK) {
+				expect[i]++;
+			}
+		}
+	}
+
+	/* Concurrent decisions for the same requests. */
+	pthread_t thr[RRL_THREADS];
+	struct stress_data sd[RRL_THREADS];
+	for (unsigned i = 0; i < RRL_THREADS; ++i) {
+		sd[i] = (struct stress_data) {
+			par, rq, zone, now, i * RRL_STRESS_ADDRS / RRL_THREADS, passed
+		};
+		pthread_create(thr + i, NULL, &rrl_stress_runnable, sd + i);
+	}
+	for (unsigned i = 0; i < RRL_THREADS; ++i) {
+		pthread_join(thr[i], NULL);
+	}
+
+	bool equal = true;
+	for (unsigned i = 0; i < RRL_STRESS_ADDRS; ++i) {
+		if (passed[i] != expect[i] || expect[i] != rate * RRL_CAPACITY) {
+			equal = false;
+		}
+	}
+
+	rrl_destroy(seq);
+	rrl_destroy(par);
+	free(expect);
+	free(passed);
+	return equal;
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -159,6 +242,20 @@ int main(int argc, char *argv[])
 	ok(rd.passed, "rrl: hashtable is ~ consistent");
 #endif
 
+	/* 9. concurrent requests */
+	ok(rrl_stress(&rq, zone, rate), "rrl: concurrent decisions equal to sequential");
+
+	/* 10. small table */
+	rrl_table_t *small = rrl_create(1, rate);
+	ok(small != NULL && small->shard_count == 1, "rrl: create small table");
+	ret = KNOT_EOK;
+	for (unsigned i = 0; i < rate * RRL_CAPACITY && ret == KNOT_EOK; ++i) {
+		ret = rrl_update(small, &addr, &rq, zone, NULL, 1);
+	}
+	ok(ret == KNOT_EOK && rrl_update(small, &addr, &rq, zone, NULL, 1) == KNOT_ELIMIT,
+	   "rrl: small table limit");
+	rrl_destroy(small);
+
 	knot_dname_free(&zone, NULL);
 	knot_pkt_free(query);
 	rrl_destroy(rrl);
@@ -14,6 +14,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <tap/basic.h>
@@ -35,6 +36,16 @@ static void check_sockaddr_set(struct sockaddr_storage *ss, int family,
 	ok(ret == 0, "set address '%s'", straddr);
 }
 
+static void check_match(const acl_t *acl, acl_action_t action,
+                        const struct sockaddr_storage *addr,
+                        const knot_tsig_key_t *tsig, bool expected,
+                        const char *msg)
+{
+	knot_tsig_key_t key = *tsig;
+	bool ret = acl_match(acl, action, addr, &key);
+	ok(ret == expected, "compiled: %s", msg);
+}
+
 static void test_acl_allowed(void)
 {
 	int ret;
@@ -98,97 +109,203 @@ static void test_acl_allowed(void)
 	ret = test_conf(conf_str, NULL);
 	is_int(KNOT_EOK, ret, "Prepare configuration");
 
+	acl = conf_zone_get(conf(), C_ACL, zone_name);
+	acl_t *compiled = acl_new(conf(), &acl);
+	ok(compiled != NULL, "Compile zone ACL");
+
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET6, "2001::1", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_NONE, &addr, &key1);
 	ok(ret == true, "Address, key, empty action");
+	check_match(compiled, ACL_ACTION_NONE, &addr, &key1, true, "Address, key, empty action");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET6, "2001::1", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_TRANSFER, &addr, &key1);
 	ok(ret == true, "Address, key, action match");
+	check_match(compiled, ACL_ACTION_TRANSFER, &addr, &key1, true, "Address, key, action match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET6, "2001::2", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_TRANSFER, &addr, &key1);
 	ok(ret == false, "Address not match, key, action match");
+	check_match(compiled, ACL_ACTION_TRANSFER, &addr, &key1, false, "Address not match, key, action match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET6, "2001::1", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_TRANSFER, &addr, &key0);
 	ok(ret == false, "Address match, no key, action match");
+	check_match(compiled, ACL_ACTION_TRANSFER, &addr, &key0, false, "Address match, no key, action match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET6, "2001::1", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_TRANSFER, &addr, &key2);
 	ok(ret == false, "Address match, key not match, action match");
+	check_match(compiled, ACL_ACTION_TRANSFER, &addr, &key2, false, "Address match, key not match, action match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET6, "2001::1", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_NOTIFY, &addr, &key1);
 	ok(ret == false, "Address, key match, action not match");
+	check_match(compiled, ACL_ACTION_NOTIFY, &addr, &key1, false, "Address, key match, action not match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET, "240.0.0.1", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_NOTIFY, &addr, &key0);
 	ok(ret == true, "Second address match, no key, action match");
+	check_match(compiled, ACL_ACTION_NOTIFY, &addr, &key0, true, "Second address match, no key, action match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET, "240.0.0.1", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_NOTIFY, &addr, &key1);
 	ok(ret == false, "Second address match, extra key, action match");
+	check_match(compiled, ACL_ACTION_NOTIFY, &addr, &key1, false, "Second address match, extra key, action match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET, "240.0.0.2", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_NOTIFY, &addr, &key0);
 	ok(ret == false, "Denied address match, no key, action match");
+	check_match(compiled, ACL_ACTION_NOTIFY, &addr, &key0, false, "Denied address match, no key, action match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET, "240.0.0.2", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_UPDATE, &addr, &key0);
 	ok(ret == true, "Denied address match, no key, action not match");
+	check_match(compiled, ACL_ACTION_UPDATE, &addr, &key0, true, "Denied address match, no key, action not match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET, "240.0.0.3", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_UPDATE, &addr, &key0);
 	ok(ret == false, "Denied address match, no key, no action");
+	check_match(compiled, ACL_ACTION_UPDATE, &addr, &key0, false, "Denied address match, no key, no action");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET, "1.1.1.1", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_UPDATE, &addr, &key3);
 	ok(ret == true, "Arbitrary address, second key, action match");
+	check_match(compiled, ACL_ACTION_UPDATE, &addr, &key3, true, "Arbitrary address, second key, action match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET, "100.0.0.1", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_TRANSFER, &addr, &key0);
 	ok(ret == true, "IPv4 address from range, no key, action match");
+	check_match(compiled, ACL_ACTION_TRANSFER, &addr, &key0, true, "IPv4 address from range, no key, action match");
 
 	acl = conf_zone_get(conf(), C_ACL, zone_name);
 	ok(acl.code == KNOT_EOK, "Get zone ACL");
 	check_sockaddr_set(&addr, AF_INET6, "::1", 0);
 	ret = acl_allowed(conf(), &acl, ACL_ACTION_TRANSFER, &addr, &key0);
 	ok(ret == true, "IPv6 address from range, no key, action match");
+	check_match(compiled, ACL_ACTION_TRANSFER, &addr, &key0, true, "IPv6 address from range, no key, action match");
+
+	knot_tsig_key_t key = key2;
+	check_sockaddr_set(&addr, AF_INET, "1.1.1.1", 0);
+	ret = acl_match(compiled, ACL_ACTION_NOTIFY, &addr, &key);
+	ok(ret == true && key.secret.size == 3 &&
+	   memcmp(key.secret.data, "foo", 3) == 0, "compiled: TSIG secret filled");
 
-	conf_free(conf());
+	acl_free(compiled);
+	conf_update(NULL, CONF_UPD_FNONE);
 	knot_dname_free(&zone_name, NULL);
 	knot_dname_free(&key1_name, NULL);
 	knot_dname_free(&key2_name, NULL);
 	knot_dname_free(&key3_name, NULL);
 }
 
+static void test_acl_match(void)
+{
+	int ret;
+	struct sockaddr_storage addr = { 0 };
+
+	knot_dname_t *zone_name = knot_dname_from_str_alloc(ZONE);
+	knot_dname_t *key1_name = knot_dname_from_str_alloc(KEY1);
+	knot_dname_t *key3_name = knot_dname_from_str_alloc(KEY3);
+
+	knot_tsig_key_t key0 = { 0 };
+	knot_tsig_key_t key1 = { DNSSEC_TSIG_HMAC_MD5,    key1_name };
+	knot_tsig_key_t key1_alg = { DNSSEC_TSIG_HMAC_SHA256, key1_name };
+	knot_tsig_key_t key3 = { DNSSEC_TSIG_HMAC_SHA256, key3_name };
+
+	const char *conf_str =
+		"key:\n"
+		"  - id: "KEY1"\n"
+		"    algorithm: hmac-md5\n"
+		"    secret: Zm9v\n"
+		"  - id: "KEY3"\n"
+		"    algorithm: hmac-sha256\n"
+		"    secret: Zm8=\n"
+		"\n"
+		"acl:\n"
+		"  - id: acl_deny_host\n"
+		"    address: [ 10.0.1.1 ]\n"
+		"    action: [ transfer ]\n"
+		"    deny: on\n"
+		"  - id: acl_range\n"
+		"    address: [ 10.0.0.255-10.0.2.0, 2001:db8::ffff-2001:db8::1:0 ]\n"
+		"    action: [ transfer ]\n"
+		"  - id: acl_net_key\n"
+		"    address: [ 10.0.0.0/8 ]\n"
+		"    key: [ key1_md5 ]\n"
+		"    action: [ transfer ]\n"
+		"  - id: acl_key\n"
+		"    key: [ key3_sha256 ]\n"
+		"    action: [ update ]\n"
+		"\n"
+		"zone:\n"
+		"  - domain: "ZONE"\n"
+		"    acl: [ acl_deny_host, acl_range, acl_net_key, acl_key ]";
+
+	ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "Prepare configuration");
+
+	conf_val_t val = conf_zone_get(conf(), C_ACL, zone_name);
+	acl_t *acl = acl_new(conf(), &val);
+	ok(acl != NULL, "Compile zone ACL");
+
+	check_sockaddr_set(&addr, AF_INET, "10.0.0.255", 0);
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key0, true, "Range lower bound");
+	check_sockaddr_set(&addr, AF_INET, "10.0.1.128", 0);
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key0, true, "Range inside");
+	check_sockaddr_set(&addr, AF_INET, "10.0.2.0", 0);
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key0, true, "Range upper bound");
+	check_sockaddr_set(&addr, AF_INET, "10.0.2.1", 0);
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key0, false, "Above range");
+	check_sockaddr_set(&addr, AF_INET, "10.5.0.0", 0);
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key0, false, "Outside range");
+	check_sockaddr_set(&addr, AF_INET, "10.0.1.1", 0);
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key0, false, "Denied host in range");
+	check_sockaddr_set(&addr, AF_INET6, "2001:db8::1:0", 0);
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key0, true, "IPv6 range upper bound");
+	check_sockaddr_set(&addr, AF_INET6, "2001:db8::fffe", 0);
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key0, false, "Below IPv6 range");
+	check_sockaddr_set(&addr, AF_INET, "10.5.0.0", 0);
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key1, true, "Network, key");
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key1_alg, false, "Network, key algorithm not match");
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key3, false, "Network, other key");
+	check_match(acl, ACL_ACTION_UPDATE, &addr, &key3, true, "Key only");
+	check_sockaddr_set(&addr, AF_INET, "10.0.1.1", 0);
+	check_match(acl, ACL_ACTION_TRANSFER, &addr, &key1, true, "Denied host, key");
+
+	acl_free(acl);
+	conf_update(NULL, CONF_UPD_FNONE);
+	knot_dname_free(&zone_name, NULL);
+	knot_dname_free(&key1_name, NULL);
+	knot_dname_free(&key3_name, NULL);
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -196,5 +313,8 @@ int main(int argc, char *argv[])
 	diag("acl_allowed");
 	test_acl_allowed();
 
+	diag("acl_match");
+	test_acl_match();
+
 	return 0;
 }
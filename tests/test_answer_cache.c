@@ -0,0 +1,88 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <tap/basic.h>
+
+#include "knot/zone/answer-cache.h"
+#include "libknot/errcode.h"
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	answer_cache_t *cache = answer_cache_new(4);
+	ok(cache != NULL, "create cache");
+
+	const uint8_t sections[] = { 0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01 };
+	answer_cache_key_t key = {
+		.qname = (const knot_dname_t *)"\x03""www""\x07""example",
+		.qtype = 1, .qclass = 1, .limit = 1232, .dnssec = false
+	};
+	answer_cache_val_t val = {
+		.wire = sections, .size = sizeof(sections),
+		.count = { 1, 0, 2 }, .rcode = 0, .aa = true
+	};
+
+	uint8_t wire[64];
+	answer_cache_val_t out;
+	int ret = answer_cache_get(cache, &key, &out, wire, sizeof(wire));
+	is_int(KNOT_ENOENT, ret, "get from empty cache");
+
+	ret = answer_cache_put(cache, &key, &val);
+	is_int(KNOT_EOK, ret, "put answer");
+
+	ret = answer_cache_get(cache, &key, &out, wire, sizeof(wire));
+	is_int(KNOT_EOK, ret, "get answer");
+	ok(out.wire == wire && out.size == sizeof(sections) &&
+	   memcmp(wire, sections, sizeof(sections)) == 0, "answer sections");
+	ok(out.count[0] == 1 && out.count[1] == 0 && out.count[2] == 2 &&
+	   out.rcode == 0 && out.aa, "answer metadata");
+
+	ret = answer_cache_get(cache, &key, &out, wire, sizeof(sections) - 1);
+	is_int(KNOT_ESPACE, ret, "get answer into a small buffer");
+
+	answer_cache_key_t other = key;
+	other.dnssec = true;
+	ret = answer_cache_get(cache, &other, &out, wire, sizeof(wire));
+	is_int(KNOT_ENOENT, ret, "get with different DO bit");
+	other = key;
+	other.limit = 512;
+	ret = answer_cache_get(cache, &other, &out, wire, sizeof(wire));
+	is_int(KNOT_ENOENT, ret, "get with different size limit");
+	other = key;
+	other.qtype = 28;
+	ret = answer_cache_get(cache, &other, &out, wire, sizeof(wire));
+	is_int(KNOT_ENOENT, ret, "get with different type");
+	other = key;
+	other.qname = (const knot_dname_t *)"\x03""ftp""\x07""example";
+	ret = answer_cache_get(cache, &other, &out, wire, sizeof(wire));
+	is_int(KNOT_ENOENT, ret, "get with different name");
+
+	/* Replace the answer. */
+	val.rcode = 3;
+	val.size = 0;
+	ret = answer_cache_put(cache, &key, &val);
+	is_int(KNOT_EOK, ret, "replace answer");
+	ret = answer_cache_get(cache, &key, &out, wire, sizeof(wire));
+	ok(ret == KNOT_EOK && out.rcode == 3 && out.size == 0, "get replaced answer");
+
+	answer_cache_free(cache);
+
+	ok(answer_cache_new(0) == NULL, "create cache of zero size");
+
+	return 0;
+}
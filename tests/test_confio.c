@@ -19,7 +19,11 @@
 #include "test_conf.h"
 #include "knot/conf/confio.h"
 #include "knot/conf/tools.h"
+#include "knot/server/server.h"
+#include "knot/updates/acl.h"
+#include "knot/zone/zonedb.h"
 #include "libknot/yparser/yptrafo.h"
+#include "contrib/sockaddr.h"
 #include "contrib/string.h"
 #include "contrib/openbsd/strlcat.h"
 
@@ -906,6 +910,7 @@ static void test_conf_io_list(void)
 	      "server.tcp-idle-timeout\n"
 	      "server.tcp-reply-timeout\n"
 	      "server.max-tcp-clients\n"
+	      "server.max-refresh-queries\n"
 	      "server.max-udp-payload\n"
 	      "server.max-ipv4-udp-payload\n"
 	      "server.max-ipv6-udp-payload";
@@ -921,6 +926,7 @@ static const yp_item_t desc_server[] = {
 	{ C_TCP_IDLE_TIMEOUT,	  YP_TINT,  YP_VNONE },
 	{ C_TCP_REPLY_TIMEOUT,	  YP_TINT,  YP_VNONE },
 	{ C_MAX_TCP_CLIENTS,	  YP_TINT,  YP_VNONE },
+	{ C_MAX_REFRESH_QUERIES,  YP_TINT,  YP_VNONE },
 	{ C_MAX_UDP_PAYLOAD,      YP_TINT,  YP_VNONE },
 	{ C_MAX_IPV4_UDP_PAYLOAD, YP_TINT,  YP_VNONE },
 	{ C_MAX_IPV6_UDP_PAYLOAD, YP_TINT,  YP_VNONE },
@@ -956,6 +962,57 @@ static const yp_item_t desc_zone[] = {
 	{ NULL }
 };
 
+static bool acl_allows(zone_t *zone, const char *addr_str)
+{
+	struct sockaddr_storage addr;
+	sockaddr_set(&addr, AF_INET, addr_str, 0);
+	knot_tsig_key_t tsig = { 0 };
+
+	return acl_match(zone->query_conf->acl, ACL_ACTION_TRANSFER, &addr, &tsig);
+}
+
+static void test_conf_io_reload_acl(void)
+{
+	const char *conf_str =
+		"acl:\n"
+		"  - id: acl\n"
+		"    address: 127.0.0.1\n"
+		"    action: transfer\n"
+		"zone:\n"
+		"  - domain: " ZONE1 "\n"
+		"    acl: acl\n";
+
+	ok(test_conf(conf_str, NULL) == KNOT_EOK, "Prepare default configuration");
+
+	server_t server = { 0 };
+	server.zone_db = knot_zonedb_new();
+	knot_dname_t *name = knot_dname_from_str_alloc(ZONE1);
+	zone_t *zone = zone_new(name);
+	knot_dname_free(&name, NULL);
+	zone->query_conf = zone_query_conf_new(conf(), zone->name);
+	knot_zonedb_insert(server.zone_db, zone);
+
+	ok(acl_allows(zone, "127.0.0.1") && !acl_allows(zone, "127.0.0.2"),
+	   "initial zone ACL");
+
+	// Change only the referenced ACL item.
+	ok(conf_io_begin(false) == KNOT_EOK &&
+	   conf_io_unset("acl", "address", "acl", NULL) == KNOT_EOK &&
+	   conf_io_set("acl", "address", "acl", "127.0.0.2") == KNOT_EOK &&
+	   conf_io_commit(false) == KNOT_EOK, "change ACL address");
+	ok(!(conf()->io.flags & (CONF_IO_FRLD_ZONES | CONF_IO_FRLD_ZONE)),
+	   "no zone reload required");
+
+	ok(server_reload(&server) == KNOT_EOK, "reload server");
+	ok(!acl_allows(zone, "127.0.0.1") && acl_allows(zone, "127.0.0.2"),
+	   "zone ACL updated");
+
+	rcu_barrier();
+	knot_zonedb_free(&server.zone_db);
+	zone_free(&zone);
+	conf_free(conf());
+}
+
 const yp_item_t test_schema[] = {
 	{ C_SRV,  YP_TGRP, YP_VGRP = { desc_server } },
 	{ C_CTL,  YP_TGRP, YP_VGRP = { desc_control } },
@@ -999,7 +1056,10 @@ int main(int argc, char *argv[])
 	diag("conf_io_list");
 	test_conf_io_list();
 
-	conf_free(conf());
+	conf_update(NULL, CONF_UPD_FNONE);
+
+	diag("conf_io_commit reload");
+	test_conf_io_reload_acl();
 
 	return 0;
 }
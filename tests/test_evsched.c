@@ -0,0 +1,156 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <tap/basic.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "knot/common/evsched.h"
+#include "libknot/errcode.h"
+#include "contrib/time.h"
+
+#define BENCH_EVENTS 1000000
+#define BENCH_MAX_DT (24 * 3600 * 1000)
+
+static int fired[8];
+static int fired_count;
+
+static void test_cb(event_t *ev)
+{
+	int *order = ev->data;
+	fired[__atomic_fetch_add(&fired_count, 1, __ATOMIC_SEQ_CST)] = *order;
+}
+
+static bool wait_fired(int count, int timeout_ms)
+{
+	for (int waited = 0; waited <= timeout_ms; waited += 10) {
+		if (__atomic_load_n(&fired_count, __ATOMIC_SEQ_CST) >= count) {
+			return true;
+		}
+		usleep(10000);
+	}
+
+	return false;
+}
+
+static void interrupt_handle(int s)
+{
+}
+
+static double bench_ns(const struct timespec *begin)
+{
+	struct timespec end = time_now();
+	return time_diff_ms(begin, &end) * 1000000.0 / BENCH_EVENTS;
+}
+
+static void test_benchmark(evsched_t *sched)
+{
+	event_t **events = malloc(BENCH_EVENTS * sizeof(event_t *));
+	if (events == NULL) {
+		skip_block(3, "no memory for the benchmark");
+		return;
+	}
+
+	bool created = true;
+	for (int i = 0; i < BENCH_EVENTS; i++) {
+		events[i] = evsched_event_create(sched, test_cb, NULL);
+		created = created && events[i] != NULL;
+	}
+	ok(created, "benchmark: create %i events", BENCH_EVENTS);
+
+	struct timespec begin = time_now();
+	for (int i = 0; i < BENCH_EVENTS; i++) {
+		evsched_schedule(events[i], 1000 + random() % BENCH_MAX_DT);
+	}
+	diag("schedule: %.1f ns/event", bench_ns(&begin));
+
+	begin = time_now();
+	for (int i = 0; i < BENCH_EVENTS; i++) {
+		evsched_schedule(events[i], 1000 + random() % BENCH_MAX_DT);
+	}
+	diag("reschedule: %.1f ns/event", bench_ns(&begin));
+
+	begin = time_now();
+	for (int i = 0; i < BENCH_EVENTS; i++) {
+		evsched_cancel(events[i]);
+	}
+	diag("cancel: %.1f ns/event", bench_ns(&begin));
+
+	bool empty = true;
+	for (int level = 0; level < EVSCHED_LEVELS; level++) {
+		empty = empty && sched->occupied[level] == 0;
+	}
+	ok(empty, "benchmark: wheel empty after cancel");
+	is_int(0, fired_count, "benchmark: no event fired");
+
+	for (int i = 0; i < BENCH_EVENTS; i++) {
+		evsched_event_free(events[i]);
+	}
+	free(events);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	/* The scheduler thread is interrupted by SIGALRM on stop. */
+	struct sigaction sa;
+	sa.sa_handler = interrupt_handle;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGALRM, &sa, NULL);
+
+	evsched_t sched;
+	int ret = evsched_init(&sched, NULL);
+	is_int(KNOT_EOK, ret, "init scheduler");
+	evsched_start(&sched);
+
+	/* Benchmark first, the scheduler has no other events. */
+	test_benchmark(&sched);
+
+	/* Ordering across the wheel levels. */
+	int order[] = { 0, 1, 2, 3 };
+	event_t *ev[4];
+	for (int i = 0; i < 4; i++) {
+		ev[i] = evsched_event_create(&sched, test_cb, &order[i]);
+	}
+
+	evsched_schedule(ev[2], 300);
+	evsched_schedule(ev[0], 1);
+	evsched_schedule(ev[1], 70);
+	evsched_schedule(ev[3], 5000);
+	ok(evsched_schedule(ev[3], 150) == KNOT_EOK, "reschedule event");
+	ok(wait_fired(4, 5000), "events fired");
+	ok(fired[0] == 0 && fired[1] == 1 && fired[2] == 3 && fired[3] == 2,
+	   "events fired in order");
+
+	/* Cancel. */
+	evsched_schedule(ev[0], 200);
+	ok(evsched_cancel(ev[0]) == KNOT_EOK, "cancel event");
+	usleep(400000);
+	is_int(4, fired_count, "canceled event not fired");
+
+	evsched_stop(&sched);
+	evsched_join(&sched);
+
+	for (int i = 0; i < 4; i++) {
+		evsched_event_free(ev[i]);
+	}
+	evsched_deinit(&sched);
+
+	return 0;
+}
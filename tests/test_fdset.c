@@ -79,9 +79,165 @@ void* thr_action(void *arg)
 	return NULL;
 }
 
+static enum fdset_sweep_state sweep_cb(fdset_t *set, int i, void *data)
+{
+	int *sweeped = data;
+	sweeped[fdset_get_fd(set, i)] = 1;
+	return FDSET_SWEEP;
+}
+
+static void test_watchdog(void)
+{
+	fdset_t set;
+	fdset_init(&set, 4);
+
+	/* Descriptors are only watched, use pipe ends. */
+	int fds[8];
+	int sweeped[64] = { 0 };
+	for (int i = 0; i < 8; i += 2) {
+		if (pipe(fds + i) != 0) {
+			return;
+		}
+	}
+	for (int i = 0; i < 8; i++) {
+		fdset_add(&set, fds[i], POLLIN, NULL);
+	}
+
+	/* Expired, far future, disabled, and expired again after removals. */
+	fdset_set_watchdog(&set, 0, 0);
+	fdset_set_watchdog(&set, 1, 1000);
+	fdset_set_watchdog(&set, 2, 0);
+	fdset_set_watchdog(&set, 2, -1);
+	fdset_set_watchdog(&set, 5, 0);
+	fdset_set_watchdog(&set, 7, 0);
+
+	int ret = fdset_sweep(&set, sweep_cb, sweeped);
+	ok(ret == 3 && set.n == 5 &&
+	   sweeped[fds[0]] && sweeped[fds[5]] && sweeped[fds[7]] &&
+	   !sweeped[fds[1]] && !sweeped[fds[2]], "fdset: sweep expired watchdogs");
+
+	bool found = false;
+	for (unsigned i = 0; i < set.n; i++) {
+		found |= (fdset_get_fd(&set, i) == fds[1]);
+	}
+	ok(found, "fdset: watched descriptor kept");
+
+	/* Moved descriptors keep their timers. */
+	int moved = fdset_get_fd(&set, set.n - 1);
+	fdset_set_watchdog(&set, set.n - 1, 0);
+	fdset_remove(&set, 0);
+	ret = fdset_sweep(&set, sweep_cb, sweeped);
+	ok(ret == 1 && sweeped[moved] && set.n == 3, "fdset: sweep moved descriptor");
+
+	for (int i = 0; i < 8; i++) {
+		close(fds[i]);
+	}
+	fdset_clear(&set);
+}
+
+static void test_iterator(void)
+{
+	fdset_t set;
+	fdset_init(&set, 2);
+
+	/* All pipes readable, remove every other descriptor during iteration. */
+	int fds[6][2];
+	for (int i = 0; i < 6; i++) {
+		if (pipe(fds[i]) != 0 || write(fds[i][1], "x", 1) != 1) {
+			return;
+		}
+		fdset_add(&set, fds[i][0], POLLIN, NULL);
+	}
+
+	fdset_it_t it;
+	int nfds = fdset_wait(&set, &it, 1000);
+	int visited = 0;
+	bool valid = true;
+	for (; !fdset_it_done(&it); fdset_it_next(&it)) {
+		int fd = fdset_get_fd(&set, it.idx);
+		char buf;
+		valid &= (fdset_it_events(&it) & POLLIN) && read(fd, &buf, 1) == 1;
+		if (visited++ % 2 == 0) {
+			valid &= (fdset_it_remove(&it) == 0);
+		}
+	}
+	ok(nfds == 6 && visited == 6 && valid && set.n == 3,
+	   "fdset: iterate and remove");
+
+	for (int i = 0; i < 6; i++) {
+		close(fds[i][0]);
+		close(fds[i][1]);
+	}
+	fdset_clear(&set);
+}
+
+static void test_iterator_add(void)
+{
+	fdset_t set;
+	fdset_init(&set, 2);
+
+	int fds[2][2];
+	for (int i = 0; i < 2; i++) {
+		if (pipe(fds[i]) != 0 || write(fds[i][1], "x", 1) != 1) {
+			return;
+		}
+		fdset_add(&set, fds[i][0], POLLIN, NULL);
+	}
+
+	/* Adding a descriptor resizes the full set during the iteration. */
+	fdset_it_t it;
+	int added[2] = { -1, -1 };
+	int nfds = fdset_wait(&set, &it, 1000);
+	int visited = 0;
+	bool valid = true;
+	for (; !fdset_it_done(&it); fdset_it_next(&it)) {
+		int fd = fdset_get_fd(&set, it.idx);
+		valid &= (fd == fds[0][0] || fd == fds[1][0]) &&
+		         (fdset_it_events(&it) & POLLIN);
+		added[visited] = dup(fds[visited][1]);
+		valid &= fdset_add(&set, added[visited], POLLOUT, NULL) >= 0;
+		valid &= (fdset_it_remove(&it) == 0);
+		visited++;
+	}
+	ok(nfds == 2 && visited == 2 && valid && set.n == 2,
+	   "fdset: iterate and add");
+
+	for (int i = 0; i < 2; i++) {
+		close(added[i]);
+		close(fds[i][0]);
+		close(fds[i][1]);
+	}
+	fdset_clear(&set);
+}
+
+static void test_events(void)
+{
+	fdset_t set;
+	fdset_init(&set, 2);
+
+	/* Empty pipe is writable, but not readable. */
+	int fds[2];
+	if (pipe(fds) != 0) {
+		return;
+	}
+	fdset_add(&set, fds[1], POLLIN, NULL);
+
+	fdset_it_t it;
+	int nfds = fdset_wait(&set, &it, 0);
+	ok(nfds == 0, "fdset: no events watched");
+
+	fdset_set_events(&set, 0, POLLIN | POLLOUT);
+	nfds = fdset_wait(&set, &it, 1000);
+	ok(nfds == 1 && (fdset_it_events(&it) & POLLOUT), "fdset: change watched events");
+
+	close(fds[0]);
+	close(fds[1]);
+	fdset_clear(&set);
+}
+
 int main(int argc, char *argv[])
 {
-	plan(12);
+	plan(19);
 
 	/* 1. Create fdset. */
 	fdset_t set;
@@ -107,18 +263,19 @@ int main(int argc, char *argv[])
 	pthread_create(&t, 0, thr_action, &fds[1]);
 
 	/* 4. Watch fdset. */
-	int nfds = poll(set.pfd, set.n, 60 * 1000);
+	fdset_it_t it;
+	int nfds = fdset_wait(&set, &it, 60 * 1000);
 	gettimeofday(&te, 0);
 	size_t diff = timeval_diff(&ts, &te);
 
 	ok(nfds > 0, "fdset: poll returned %d events in %zu ms", nfds, diff);
 
 	/* 5. Prepare event set. */
-	ok(set.pfd[0].revents & POLLIN, "fdset: pipe is active");
+	ok(it.idx == 0 && (fdset_it_events(&it) & POLLIN), "fdset: pipe is active");
 
 	/* 6. Receive data. */
 	char buf = 0x00;
-	ret = read(set.pfd[0].fd, &buf, WRITE_PATTERN_LEN);
+	ret = read(fdset_get_fd(&set, it.idx), &buf, WRITE_PATTERN_LEN);
 	ok(ret >= 0 && buf == WRITE_PATTERN, "fdset: contains valid data");
 
 	/* 7-9. Remove from event set. */
@@ -145,6 +302,16 @@ int main(int argc, char *argv[])
 	ret = fdset_clear(&set);
 	is_int(0, ret, "fdset: destroyed");
 
+	/* 12-14. Watchdog timers. */
+	test_watchdog();
+
+	/* 15. Iterator. */
+	test_iterator();
+	test_iterator_add();
+
+	/* 16-17. Watched events. */
+	test_events();
+
 	/* Cleanup. */
 	pthread_join(t, 0);
 
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <tap/basic.h>
@@ -29,6 +30,7 @@
 #include "knot/zone/zone.h"
 #include "knot/zone/zone-diff.h"
 #include "libknot/rrtype/soa.h"
+#include "contrib/string.h"
 #include "test_conf.h"
 
 #define RAND_RR_LABEL 16
@@ -489,6 +491,313 @@ static void test_store_load(void)
 	unset_conf();
 }
 
+/*! \brief Compare serialized changesets with the changesets. */
+static bool serialized_eq(const uint8_t *data, size_t size, list_t *l)
+{
+	wire_ctx_t wire = wire_ctx_init_const(data, size);
+	static uint8_t buf[64 * 1024];
+	bool equal = true;
+
+	changeset_t *ch = NULL;
+	WALK_LIST(ch, *l) {
+		changeset_iter_t it;
+		knot_rrset_t expect[2] = { *ch->soa_from, *ch->soa_to };
+		for (int section = 0; section < 2 && equal; section++) {
+			if (section == 0) {
+				changeset_iter_rem(&it, ch);
+			} else {
+				changeset_iter_add(&it, ch);
+			}
+			knot_rrset_t rr = expect[section];
+			while (equal && !knot_rrset_empty(&rr)) {
+				knot_rrset_t read;
+				size_t buf_size = sizeof(buf);
+				equal = serialized_rrset_read(&wire, &read, buf, &buf_size) == KNOT_EOK &&
+				        knot_rrset_equal(&rr, &read, KNOT_RRSET_COMPARE_WHOLE);
+				rr = changeset_iter_next(&it);
+			}
+			changeset_iter_clear(&it);
+		}
+	}
+
+	knot_rrset_t read;
+	size_t buf_size = sizeof(buf);
+	return equal && serialized_rrset_read(&wire, &read, buf, &buf_size) == KNOT_ENOENT;
+}
+
+/*! \brief Test loading of serialized changesets. */
+static void test_load_serialized(void)
+{
+	set_conf(1000, 512 * 1024);
+
+	int ret = drop_journal(j, NULL);
+	is_int(KNOT_EOK, ret, "journal: drop_journal must be ok");
+
+	/* Changesets spanning more chunks. */
+	list_t k;
+	init_list(&k);
+	int stored = 0;
+	for (uint32_t serial = 0; serial < 3; serial++) {
+		changeset_t *ch = changeset_new(apex);
+		init_random_changeset(ch, serial, serial + 1, 1000, apex, false);
+		if (journal_store_changeset(j, ch) == KNOT_EOK) {
+			stored++;
+		}
+		add_tail(&k, &ch->n);
+	}
+	is_int(3, stored, "journal: store changesets");
+
+	uint8_t *data = NULL;
+	size_t size = 0;
+	ret = journal_load_serialized(j, 0, 3, &data, &size);
+	ok(ret == KNOT_EOK && serialized_eq(data, size, &k),
+	   "journal: load serialized changesets (%d)", ret);
+	free(data);
+
+	changeset_t *first = HEAD(k);
+	rem_node(&first->n);
+	data = NULL;
+	ret = journal_load_serialized(j, 1, 3, &data, &size);
+	ok(ret == KNOT_EOK && serialized_eq(data, size, &k),
+	   "journal: load serialized changesets since serial (%d)", ret);
+	free(data);
+	changeset_free(first);
+
+	changeset_t *last = TAIL(k);
+	rem_node(&last->n);
+	data = NULL;
+	ret = journal_load_serialized(j, 1, 2, &data, &size);
+	ok(ret == KNOT_EOK && serialized_eq(data, size, &k),
+	   "journal: load serialized changesets up to serial (%d)", ret);
+	free(data);
+	changeset_free(last);
+
+	ret = journal_load_serialized(j, 1, 4, &data, &size);
+	is_int(KNOT_ENOENT, ret, "journal: load serialized beyond history");
+	ret = journal_load_serialized(j, 4, 5, &data, &size);
+	is_int(KNOT_ENOENT, ret, "journal: load serialized without history");
+
+	/* Malformed data. */
+	uint8_t malformed[] = { 4, 't', 'e', 's', 't', 0, 0, KNOT_RRTYPE_A, 0, 1, 0, 1 };
+	wire_ctx_t wire = wire_ctx_init(malformed, sizeof(malformed));
+	knot_rrset_t rr;
+	uint8_t buf[16];
+	size_t buf_size = sizeof(buf);
+	ret = serialized_rrset_read(&wire, &rr, buf, &buf_size);
+	is_int(KNOT_EMALF, ret, "journal: read malformed serialized RRSet");
+
+	changesets_free(&k);
+
+	ret = drop_journal(j, NULL);
+	is_int(KNOT_EOK, ret, "journal: drop_journal must be ok");
+
+	unset_conf();
+}
+
+#define GROUP_ZONES 8
+#define GROUP_CHANGESETS 20
+
+typedef struct {
+	pthread_t thread;
+	knot_dname_t *apex;
+	journal_t *j;
+	list_t changesets;
+	int stored;
+} group_zone_t;
+
+static void *group_store(void *arg)
+{
+	group_zone_t *zone = arg;
+
+	for (uint32_t serial = 0; serial < GROUP_CHANGESETS; serial++) {
+		changeset_t *ch = changeset_new(zone->apex);
+		init_random_changeset(ch, serial, serial + 1, 20, zone->apex, false);
+		if (journal_store_changeset(zone->j, ch) == KNOT_EOK) {
+			zone->stored++;
+		}
+		add_tail(&zone->changesets, &ch->n);
+	}
+
+	return NULL;
+}
+
+/*! \brief Test concurrent inserts into a robust journal DB (group commit). */
+static void test_group_commit(void)
+{
+	set_conf(1000, 512 * 1024);
+
+	char *path = sprintf_alloc("%s/robust", test_dir_name);
+	journal_db_t *robust_db = NULL;
+	int ret = journal_db_init(&robust_db, path, 10 * 1024 * 1024, JOURNAL_MODE_ROBUST);
+	is_int(KNOT_EOK, ret, "journal: init robust db");
+
+	group_zone_t zones[GROUP_ZONES] = { { 0 } };
+	for (int i = 0; i < GROUP_ZONES; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "z%d.test.", i);
+		zones[i].apex = knot_dname_from_str_alloc(name);
+		zones[i].j = journal_new();
+		init_list(&zones[i].changesets);
+		ret = journal_open(zones[i].j, &robust_db, zones[i].apex);
+		assert(ret == KNOT_EOK);
+	}
+
+	for (int i = 0; i < GROUP_ZONES; i++) {
+		pthread_create(&zones[i].thread, NULL, group_store, &zones[i]);
+	}
+	int stored = 0;
+	for (int i = 0; i < GROUP_ZONES; i++) {
+		pthread_join(zones[i].thread, NULL);
+		stored += zones[i].stored;
+	}
+	is_int(GROUP_ZONES * GROUP_CHANGESETS, stored, "journal: concurrent stores");
+
+	bool loaded = true;
+	for (int i = 0; i < GROUP_ZONES; i++) {
+		list_t l;
+		init_list(&l);
+		ret = journal_load_changesets(zones[i].j, &l, 0);
+		loaded = loaded && ret == KNOT_EOK &&
+		         changesets_list_eq(&l, &zones[i].changesets) &&
+		         journal_check(zones[i].j, JOURNAL_CHECK_SILENT) == KNOT_EOK;
+		changesets_free(&l);
+		changesets_free(&zones[i].changesets);
+		journal_close(zones[i].j);
+		journal_free(&zones[i].j);
+		knot_dname_free(&zones[i].apex, NULL);
+	}
+	ok(loaded, "journal: load concurrently stored changesets");
+
+	journal_db_close(&robust_db);
+	free(path);
+
+	unset_conf();
+}
+
+static void *batch_store(void *arg)
+{
+	group_zone_t *zone = arg;
+	zone->stored = journal_store_changesets(zone->j, &zone->changesets);
+
+	return NULL;
+}
+
+static void batch_add(group_zone_t *zone, uint32_t from, uint32_t to, bool bootstrap)
+{
+	changeset_t *ch = changeset_new(zone->apex);
+	init_random_changeset(ch, from, to, 20, zone->apex, bootstrap);
+	add_tail(&zone->changesets, &ch->n);
+}
+
+static bool batch_loaded(group_zone_t *zone, uint32_t from, list_t *expected)
+{
+	list_t l;
+	init_list(&l);
+	int ret = journal_load_changesets(zone->j, &l, from);
+	bool loaded = ret == KNOT_EOK && changesets_list_eq(&l, expected) &&
+	              journal_check(zone->j, JOURNAL_CHECK_SILENT) == KNOT_EOK;
+	changesets_free(&l);
+
+	return loaded;
+}
+
+/*! \brief Test a batch with a failing store and a store dropping the history. */
+static void test_group_commit_failure(void)
+{
+	int ret = test_conf("zone:\n"
+	                    " - domain: fail.test.\n"
+	                    "   max-journal-depth: 2\n", NULL);
+	assert(ret == KNOT_EOK);
+
+	char *path = sprintf_alloc("%s/robust-batch", test_dir_name);
+	journal_db_t *robust_db = NULL;
+	ret = journal_db_init(&robust_db, path, 10 * 1024 * 1024, JOURNAL_MODE_ROBUST);
+	is_int(KNOT_EOK, ret, "journal: init robust db");
+
+	const char *names[] = { "ok0.test.", "ok1.test.", "drop.test.", "fail.test." };
+	enum { OK0, OK1, DROP, FAIL, BATCH_ZONES };
+	group_zone_t zones[BATCH_ZONES] = { { 0 } };
+	for (int i = 0; i < BATCH_ZONES; i++) {
+		zones[i].apex = knot_dname_from_str_alloc(names[i]);
+		zones[i].j = journal_new();
+		init_list(&zones[i].changesets);
+		ret = journal_open(zones[i].j, &robust_db, zones[i].apex);
+		assert(ret == KNOT_EOK);
+	}
+
+	/* Preceding history, stored one by one. */
+	list_t drop_prev, fail_prev;
+	init_list(&drop_prev);
+	init_list(&fail_prev);
+	batch_add(&zones[DROP], 0, 1, false);
+	ret = journal_store_changesets(zones[DROP].j, &zones[DROP].changesets);
+	ret += journal_flush(zones[DROP].j);
+	add_tail_list(&drop_prev, &zones[DROP].changesets);
+	init_list(&zones[DROP].changesets);
+	batch_add(&zones[FAIL], 0, 1, true);
+	batch_add(&zones[FAIL], 1, 2, false);
+	batch_add(&zones[FAIL], 2, 3, false);
+	ret += journal_store_changesets(zones[FAIL].j, &zones[FAIL].changesets);
+	add_tail_list(&fail_prev, &zones[FAIL].changesets);
+	init_list(&zones[FAIL].changesets);
+	is_int(KNOT_EOK, ret, "journal: store history");
+
+	/* The discontinuity drops the history, the depth limit can't be kept. */
+	batch_add(&zones[OK0], 0, 1, false);
+	batch_add(&zones[OK1], 0, 1, false);
+	batch_add(&zones[DROP], 5, 6, false);
+	batch_add(&zones[FAIL], 3, 4, false);
+
+	/* Hold the commit until all the stores are queued, so they make one batch. */
+	pthread_mutex_lock(&robust_db->commit_lock);
+	robust_db->committing = true;
+	pthread_mutex_unlock(&robust_db->commit_lock);
+	for (int i = 0; i < BATCH_ZONES; i++) {
+		pthread_create(&zones[i].thread, NULL, batch_store, &zones[i]);
+	}
+	size_t queued = 0;
+	while (queued < BATCH_ZONES) {
+		usleep(1000);
+		pthread_mutex_lock(&robust_db->commit_lock);
+		queued = list_size(&robust_db->commit_queue);
+		pthread_mutex_unlock(&robust_db->commit_lock);
+	}
+	pthread_mutex_lock(&robust_db->commit_lock);
+	robust_db->committing = false;
+	pthread_cond_broadcast(&robust_db->commit_cond);
+	pthread_mutex_unlock(&robust_db->commit_lock);
+	for (int i = 0; i < BATCH_ZONES; i++) {
+		pthread_join(zones[i].thread, NULL);
+	}
+
+	ok(zones[OK0].stored == KNOT_EOK && zones[OK1].stored == KNOT_EOK,
+	   "journal: batch stores succeeded");
+	is_int(KNOT_ESPACE, zones[FAIL].stored, "journal: batch store failed");
+	is_int(KNOT_EOK, zones[DROP].stored, "journal: batch store dropping history");
+	ok(batch_loaded(&zones[OK0], 0, &zones[OK0].changesets) &&
+	   batch_loaded(&zones[OK1], 0, &zones[OK1].changesets),
+	   "journal: load batch stored changesets");
+	ok(batch_loaded(&zones[DROP], 5, &zones[DROP].changesets),
+	   "journal: load changeset stored after the batch");
+	changeset_t *bootstrap = HEAD(fail_prev);
+	rem_node(&bootstrap->n);
+	changeset_free(bootstrap);
+	ok(batch_loaded(&zones[FAIL], 1, &fail_prev), "journal: failed store rolled back");
+
+	for (int i = 0; i < BATCH_ZONES; i++) {
+		changesets_free(&zones[i].changesets);
+		journal_close(zones[i].j);
+		journal_free(&zones[i].j);
+		knot_dname_free(&zones[i].apex, NULL);
+	}
+	changesets_free(&drop_prev);
+	changesets_free(&fail_prev);
+	journal_db_close(&robust_db);
+	free(path);
+
+	unset_conf();
+}
+
 const uint8_t *rdA = (const uint8_t *) "\x01\x02\x03\x04";
 const uint8_t *rdB = (const uint8_t *) "\x01\x02\x03\x05";
 const uint8_t *rdC = (const uint8_t *) "\x01\x02\x03\x06";
@@ -720,6 +1029,12 @@ int main(int argc, char *argv[])
 
 	test_store_load();
 
+	test_load_serialized();
+
+	test_group_commit();
+
+	test_group_commit_failure();
+
 	test_merge();
 
 	test_stress(j);
@@ -0,0 +1,125 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <tap/basic.h>
+#include <string.h>
+
+#include "knot/common/latency.h"
+#include "libknot/errcode.h"
+
+typedef struct {
+	char item[64];
+	uint64_t total;
+	unsigned items;
+} dump_t;
+
+static int dump_cb(const char *item, uint64_t bound, uint64_t count,
+                   bool first, void *data)
+{
+	dump_t *dump = data;
+	if (first) {
+		dump->items++;
+		strncpy(dump->item, item, sizeof(dump->item) - 1);
+	}
+	dump->total += count;
+
+	return KNOT_EOK;
+}
+
+static void test_buckets(void)
+{
+	bool ok_bound = true;
+	bool ok_monotonic = true;
+	unsigned prev = 0;
+
+	for (uint64_t ns = 0; ns < (1ULL << 34); ns = ns * 9 / 8 + 1) {
+		unsigned bucket = latency_bucket(ns);
+		ok_monotonic = ok_monotonic && bucket >= prev;
+		prev = bucket;
+
+		/* The value fits the bucket bounds. */
+		uint64_t lower = (bucket == 0) ? 0 : latency_bucket_bound(bucket - 1) + 1;
+		ok_bound = ok_bound && lower <= ns && ns <= latency_bucket_bound(bucket);
+	}
+	ok(ok_monotonic, "bucket: monotonic");
+	ok(ok_bound, "bucket: within bounds");
+
+	is_int(0, latency_bucket(0), "bucket: zero");
+	is_int(4, latency_bucket(4), "bucket: exact values");
+	is_int(latency_bucket(1024), latency_bucket(1279), "bucket: sub-bucket");
+	ok(latency_bucket(1280) == latency_bucket(1279) + 1, "bucket: next sub-bucket");
+	is_int(LATENCY_BUCKETS - 2, latency_bucket((1ULL << 32) - 1), "bucket: last");
+	is_int(LATENCY_BUCKETS - 1, latency_bucket(1ULL << 40), "bucket: overflow");
+	ok(latency_bucket_bound(LATENCY_BUCKETS - 1) == UINT64_MAX, "bound: overflow");
+}
+
+static void test_dump(void)
+{
+	knotd_qdata_params_t udp = { .flags = KNOTD_QUERY_FLAG_LIMIT_SIZE };
+	knotd_qdata_params_t tcp = { 0 };
+
+	unsigned mod = latency_module("mod-test");
+	is_int(0, mod, "module: register");
+	is_int(mod, latency_module("mod-test"), "module: register again");
+
+	for (int i = 0; i < 10; i++) {
+		latency_record_stage(&udp, KNOTD_STAGE_ANSWER, latency_now());
+	}
+	latency_record_stage(&tcp, LATENCY_STAGE_TOTAL, latency_now());
+	latency_record_module(&udp, mod, latency_now());
+	latency_record_module(&udp, LATENCY_MODULE_NONE, latency_now());
+
+	dump_t dump = { { 0 } };
+	int ret = latency_dump("udp-answer", false, dump_cb, &dump);
+	is_int(KNOT_EOK, ret, "dump: stage");
+	ok(dump.total == 10 && dump.items == 1, "dump: stage count");
+
+	memset(&dump, 0, sizeof(dump));
+	ret = latency_dump("udp-mod-test", false, dump_cb, &dump);
+	is_int(KNOT_EOK, ret, "dump: module");
+	ok(dump.total == 1 && dump.items == 1, "dump: module count");
+
+	memset(&dump, 0, sizeof(dump));
+	ret = latency_dump(NULL, false, dump_cb, &dump);
+	is_int(KNOT_EOK, ret, "dump: all");
+	ok(dump.total == 12 && dump.items == 3, "dump: only non-empty");
+
+	memset(&dump, 0, sizeof(dump));
+	ret = latency_dump("udp-end", true, dump_cb, &dump);
+	is_int(KNOT_EOK, ret, "dump: forced empty");
+	ok(dump.total == 0 && dump.items == 1, "dump: forced empty count");
+
+	ret = latency_dump("udp-none", false, dump_cb, &dump);
+	is_int(KNOT_ENOENT, ret, "dump: unknown item");
+
+	latency_deinit();
+
+	memset(&dump, 0, sizeof(dump));
+	ret = latency_dump(NULL, false, dump_cb, &dump);
+	ok(ret == KNOT_EOK && dump.items == 0, "dump: empty after deinit");
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	latency_init();
+
+	test_buckets();
+	test_dump();
+
+	return 0;
+}
@@ -69,6 +69,9 @@ int main(int argc, char *argv[])
 	int ret = node_add_rrset(node, dummy_rrset, NULL);
 	ok(ret == KNOT_EOK && node->rrset_count == 1 &&
 	   knot_rdataset_eq(&dummy_rrset->rrs, &node->rrs[0].rrs), "Node: add RRSet.");
+	ok((void *)node->rrs == (void *)(node + 1) &&
+	   (uint8_t *)node->owner == (uint8_t *)(node->rrs + node->rrs_embedded),
+	   "Node: RRSet and owner embedded.");
 
 	// Test shallow copy
 	node->flags |= NODE_FLAGS_DELEG;
@@ -81,6 +84,8 @@ int main(int argc, char *argv[])
 	                            copy->rrset_count * sizeof(struct rr_data)) == 0 &&
 	                     copy->flags == node->flags;
 	ok(copy_ok, "Node: shallow copy - set fields.");
+	ok((void *)copy->rrs == (void *)(copy + 1) &&
+	   copy->rrs_embedded == copy->rrset_count, "Node: shallow copy - fitting RRSets.");
 
 	node_free(&copy, NULL);
 
@@ -130,9 +135,50 @@ int main(int argc, char *argv[])
 	assert(ret == KNOT_EOK);
 
 	ok(node_rrtype_is_signed(node, KNOT_RRTYPE_TXT), "Node: type is signed.");
+	ok((void *)node->rrs != (void *)(node + 1) && node->rrset_count == 2 &&
+	   node_rrtype_exists(node, KNOT_RRTYPE_TXT), "Node: RRSets moved out.");
 
 	knot_rrset_free(&dummy_rrset, NULL);
 
+	// Test packing
+	zone_node_t *packed = node_pack(node, NULL);
+	ok(packed != NULL && packed->rrset_count == 2 &&
+	   (void *)packed->rrs == (void *)(packed + 1), "Node: pack.");
+	assert(packed);
+	bool packed_ok = true;
+	const uint8_t *rdata_end = (const uint8_t *)packed->owner +
+	                           knot_dname_size(packed->owner);
+	for (uint16_t i = 0; i < packed->rrset_count; i++) {
+		const knot_rdataset_t *rrs = &packed->rrs[i].rrs;
+		packed_ok = packed_ok && node_rdataset_embedded(packed, rrs) &&
+		            !node_rdataset_embedded(node, rrs) &&
+		            (const uint8_t *)rrs->data >= rdata_end &&
+		            knot_rdataset_eq(rrs, &node->rrs[i].rrs);
+		rdata_end = (const uint8_t *)rrs->data + knot_rdataset_size(rrs);
+	}
+	ok(packed_ok, "Node: pack - RR data embedded after owner.");
+
+	copy = node_shallow_copy(packed, NULL);
+	assert(copy);
+	ok(node_rdataset_embedded(copy, &copy->rrs[0].rrs) &&
+	   knot_rdataset_eq(&copy->rrs[0].rrs, &packed->rrs[0].rrs),
+	   "Node: shallow copy - embedded RR data copied.");
+	node_free(&copy, NULL);
+
+	dummy_rrset = create_dummy_rrset(dummy_owner, KNOT_RRTYPE_TXT);
+	dummy_rrset->rrs.data->data[0] ^= 0xff;
+	dummy_rrset->ttl = 1800;
+	ret = node_add_rrset(packed, dummy_rrset, NULL);
+	knot_rdataset_t *merged = node_rdataset(packed, KNOT_RRTYPE_TXT);
+	ok(ret == KNOT_EOK && merged->rr_count == 2 &&
+	   !node_rdataset_embedded(packed, merged) &&
+	   node_rdataset_embedded(packed, node_rdataset(packed, KNOT_RRTYPE_RRSIG)),
+	   "Node: pack - merged RR data moved out.");
+	knot_rrset_free(&dummy_rrset, NULL);
+
+	node_free_rrsets(packed, NULL);
+	node_free(&packed, NULL);
+
 	// Test remove RRset
 	node_remove_rdataset(node, KNOT_RRTYPE_AAAA);
 	ok(node->rrset_count == 2, "Node: remove non-existent rdataset.");
@@ -15,6 +15,7 @@
  */
 
 #include <tap/basic.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -35,6 +36,74 @@ unsigned state_visit(unsigned state, knot_pkt_t *pkt, knotd_qdata_t *qdata,
 	return state + 1;
 }
 
+#define STATS_THREADS 4
+#define STATS_INCRS   10000
+
+struct stats_thread {
+	knotd_mod_t *mod;
+	unsigned id;
+};
+
+static void *stats_runnable(void *arg)
+{
+	struct stats_thread *t = arg;
+	knotd_mod_stats_thread(t->id);
+	for (unsigned i = 0; i < STATS_INCRS; i++) {
+		knotd_mod_stats_incr(t->mod, 0, 0, 1);
+		knotd_mod_stats_incr(t->mod, 1, i % 3, 2);
+	}
+	return NULL;
+}
+
+static void test_stats(knot_mm_t *mm)
+{
+	knotd_mod_t mod = { .mm = mm };
+	mod.stats_vals.slots = STATS_THREADS;
+
+	int ret = knotd_mod_stats_add(&mod, "single", 1, NULL);
+	is_int(KNOT_EOK, ret, "stats: add single counter");
+	ret = knotd_mod_stats_add(&mod, "multi", 3, NULL);
+	is_int(KNOT_EOK, ret, "stats: add multi counter");
+	ok(mod.stats[1].offset == 1 && mod.stats_vals.slot_size % 8 == 0,
+	   "stats: counters layout");
+
+	/* Concurrent updates from separate slots. */
+	pthread_t thr[STATS_THREADS];
+	struct stats_thread data[STATS_THREADS];
+	for (unsigned i = 0; i < STATS_THREADS; i++) {
+		data[i] = (struct stats_thread){ &mod, i };
+		pthread_create(thr + i, NULL, stats_runnable, data + i);
+	}
+	for (unsigned i = 0; i < STATS_THREADS; i++) {
+		pthread_join(thr[i], NULL);
+	}
+
+	uint64_t multi = 0;
+	for (unsigned i = 0; i < 3; i++) {
+		multi += knotd_mod_stats_get(&mod, 1, i);
+	}
+	ok(knotd_mod_stats_get(&mod, 0, 0) == STATS_THREADS * STATS_INCRS &&
+	   multi == 2 * STATS_THREADS * STATS_INCRS, "stats: aggregated values");
+
+	/* Counters registered later don't change the former values. */
+	ret = knotd_mod_stats_add(&mod, "large", 100, NULL);
+	ok(ret == KNOT_EOK && knotd_mod_stats_get(&mod, 0, 0) == STATS_THREADS * STATS_INCRS,
+	   "stats: add counter after updates");
+
+	/* Decrement and store. */
+	knotd_mod_stats_thread(STATS_THREADS + 1);
+	knotd_mod_stats_decr(&mod, 0, 0, STATS_INCRS);
+	ok(knotd_mod_stats_get(&mod, 0, 0) == (STATS_THREADS - 1) * STATS_INCRS,
+	   "stats: decrement in other slot");
+	knotd_mod_stats_store(&mod, 2, 99, 42);
+	knotd_mod_stats_store(&mod, 0, 0, 7);
+	ok(knotd_mod_stats_get(&mod, 2, 99) == 42 && knotd_mod_stats_get(&mod, 0, 0) == 7,
+	   "stats: store");
+
+	knotd_mod_stats_free(&mod);
+	ok(mod.stats == NULL && mod.stats_count == 0, "stats: free");
+}
+
 int main(int argc, char *argv[])
 {
 	plan_lazy();
@@ -85,6 +154,9 @@ int main(int argc, char *argv[])
 	/* Free the query plan. */
 	query_plan_free(plan);
 
+	/* Module statistics. */
+	test_stats(&mm);
+
 	/* Cleanup. */
 	mp_delete((struct mempool *)mm.ctx);
 
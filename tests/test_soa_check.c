@@ -0,0 +1,281 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <tap/basic.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "knot/events/soa-check.h"
+#include "knot/zone/zone.h"
+#include "libknot/libknot.h"
+#include "contrib/net.h"
+#include "contrib/sockaddr.h"
+#include "test_conf.h"
+
+#define ZONES 3
+
+static const char *config_str =
+	"server:\n"
+	"  tcp-reply-timeout: 1\n"
+	"  max-refresh-queries: 2\n";
+
+static uint32_t master_serial = 5;
+static int drop_queries = 0;
+
+static in_port_t ports[256];
+static size_t ports_count = 0;
+
+static void port_seen(const struct sockaddr_storage *from)
+{
+	in_port_t port = ((const struct sockaddr_in *)from)->sin_port;
+	for (size_t i = 0; i < ports_count; i++) {
+		if (ports[i] == port) {
+			return;
+		}
+	}
+	if (ports_count < sizeof(ports) / sizeof(*ports)) {
+		ports[ports_count++] = port;
+	}
+}
+
+/*! \brief Answers SOA queries with the master serial until a short message arrives. */
+static void *master_thread(void *arg)
+{
+	int fd = *(int *)arg;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+	knot_pkt_t *resp = knot_pkt_new(NULL, KNOT_WIRE_MAX_PKTSIZE, NULL);
+
+	const uint8_t rdata[] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+	};
+
+	while (true) {
+		struct sockaddr_storage from;
+		socklen_t from_len = sizeof(from);
+
+		knot_pkt_clear(query);
+		ssize_t got = recvfrom(fd, query->wire, query->max_size, 0,
+		                       (struct sockaddr *)&from, &from_len);
+		if (got < KNOT_WIRE_HEADER_SIZE) {
+			break;
+		}
+		query->size = got;
+		if (knot_pkt_parse(query, 0) != KNOT_EOK) {
+			continue;
+		}
+		port_seen(&from);
+
+		/* Simulate a lost query. */
+		if (__atomic_load_n(&drop_queries, __ATOMIC_SEQ_CST) > 0) {
+			__atomic_sub_fetch(&drop_queries, 1, __ATOMIC_SEQ_CST);
+			continue;
+		}
+
+		knot_rrset_t *soa = knot_rrset_new(knot_pkt_qname(query), KNOT_RRTYPE_SOA,
+		                                   KNOT_CLASS_IN, 3600, NULL);
+		knot_rrset_add_rdata(soa, rdata, sizeof(rdata), NULL);
+		knot_soa_serial_set(&soa->rrs, master_serial);
+
+		knot_pkt_init_response(resp, query);
+		knot_pkt_begin(resp, KNOT_ANSWER);
+		knot_pkt_put(resp, 0, soa, 0);
+		knot_rrset_free(&soa, NULL);
+
+		sendto(fd, resp->wire, resp->size, 0, (struct sockaddr *)&from, from_len);
+	}
+
+	knot_pkt_free(query);
+	knot_pkt_free(resp);
+
+	return NULL;
+}
+
+static int master_socket(struct sockaddr_storage *addr)
+{
+	sockaddr_set(addr, AF_INET, "127.0.0.1", 0);
+	int fd = net_bound_socket(SOCK_DGRAM, (struct sockaddr *)addr, 0);
+	if (fd >= 0) {
+		socklen_t len = sizeof(*addr);
+		getsockname(fd, (struct sockaddr *)addr, &len);
+	}
+
+	return fd;
+}
+
+static int wait_done(zone_t **zones, size_t count, int timeout_ms)
+{
+	for (int waited = 0; waited <= timeout_ms; waited += 10) {
+		size_t done = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (__atomic_load_n(&zones[i]->soa_result.state, __ATOMIC_ACQUIRE) ==
+			    SOA_CHECK_DONE) {
+				done++;
+			}
+		}
+		if (done == count) {
+			return KNOT_EOK;
+		}
+		usleep(10000);
+	}
+
+	return KNOT_ETIMEOUT;
+}
+
+static size_t drain(int fd)
+{
+	uint8_t buf[KNOT_WIRE_MAX_PKTSIZE];
+	size_t count = 0;
+	while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+		count++;
+	}
+
+	return count;
+}
+
+static void reset(zone_t **zones, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		memset(&zones[i]->soa_result, 0, sizeof(zones[i]->soa_result));
+		zone_events_schedule_at(zones[i], ZONE_EVENT_REFRESH, (time_t)0);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	ok(test_conf(config_str, NULL) == KNOT_EOK, "load configuration");
+
+	conf_remote_t live = { { AF_UNSPEC } };
+	int live_fd = master_socket(&live.addr);
+	conf_remote_t silent = { { AF_UNSPEC } };
+	int silent_fd = master_socket(&silent.addr);
+	ok(live_fd >= 0 && silent_fd >= 0, "create master sockets");
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, master_thread, &live_fd);
+
+	zone_t *zones[ZONES];
+	for (int i = 0; i < ZONES; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "zone%i.", i);
+		knot_dname_t *dname = knot_dname_from_str_alloc(name);
+		zones[i] = zone_new(dname);
+		knot_dname_free(&dname, NULL);
+	}
+
+	soa_check_t *engine = soa_check_new();
+	ok(engine != NULL, "create engine");
+
+	int ret = soa_check_submit(engine, conf(), zones[0], 1, &live, 1);
+	is_int(KNOT_ENOTRUNNING, ret, "submit to stopped engine");
+
+	ret = soa_check_start(engine);
+	is_int(KNOT_EOK, ret, "start engine");
+
+	/* Changed zone. */
+	ret = soa_check_submit(engine, conf(), zones[0], 1, &live, 1);
+	is_int(KNOT_EOK, ret, "submit zone");
+	ok(wait_done(zones, 1, 5000) == KNOT_EOK, "check finished");
+	soa_check_result_t *res = &zones[0]->soa_result;
+	ok(res->ret == KNOT_EOK && res->serial == master_serial &&
+	   sockaddr_cmp((struct sockaddr *)&res->master, (struct sockaddr *)&live.addr) == 0,
+	   "master answered");
+	ok(zone_events_get_time(zones[0], ZONE_EVENT_REFRESH) > 0, "refresh scheduled");
+	reset(zones, ZONES);
+
+	/* Outdated master. */
+	ret = soa_check_submit(engine, conf(), zones[0], master_serial + 1, &live, 1);
+	ok(ret == KNOT_EOK && wait_done(zones, 1, 5000) == KNOT_EOK &&
+	   res->ret == KNOT_ENOMASTER, "outdated master not usable");
+	reset(zones, ZONES);
+
+	/* Unresponsive master tried first. */
+	conf_remote_t masters[] = { silent, live };
+	ret = soa_check_submit(engine, conf(), zones[0], 1, masters, 2);
+	ok(ret == KNOT_EOK && wait_done(zones, 1, 5000) == KNOT_EOK &&
+	   res->ret == KNOT_EOK &&
+	   sockaddr_cmp((struct sockaddr *)&res->master, (struct sockaddr *)&live.addr) == 0,
+	   "next master answered after timeout");
+	is_int(SOA_CHECK_TRIES, drain(silent_fd), "query retransmitted to unresponsive master");
+	reset(zones, ZONES);
+
+	/* Per-master limit. */
+	for (int i = 0; i < ZONES; i++) {
+		soa_check_submit(engine, conf(), zones[i], 1, &silent, 1);
+	}
+	usleep(200000);
+	is_int(2, drain(silent_fd), "outstanding queries limited");
+	ok(wait_done(zones, ZONES, 5000) == KNOT_EOK, "checks finished");
+	is_int(2 * (SOA_CHECK_TRIES - 1) + (ZONES - 2) * SOA_CHECK_TRIES,
+	       drain(silent_fd), "waiting query sent");
+	ok(zones[0]->soa_result.ret == KNOT_ENOMASTER &&
+	   zones[ZONES - 1]->soa_result.ret == KNOT_ENOMASTER, "checks timed out");
+	reset(zones, ZONES);
+
+	/* Lost query. */
+	__atomic_store_n(&drop_queries, 1, __ATOMIC_SEQ_CST);
+	ret = soa_check_submit(engine, conf(), zones[0], 1, &live, 1);
+	ok(ret == KNOT_EOK && wait_done(zones, 1, 5000) == KNOT_EOK &&
+	   res->ret == KNOT_EOK &&
+	   sockaddr_cmp((struct sockaddr *)&res->master, (struct sockaddr *)&live.addr) == 0,
+	   "lost query retransmitted");
+	reset(zones, ZONES);
+
+	/* Source port rotation. */
+	ports_count = 0;
+	bool answered = true;
+	for (int i = 0; i < 100; i++) {
+		ret = soa_check_submit(engine, conf(), zones[0], 1, &live, 1);
+		answered &= (ret == KNOT_EOK && wait_done(zones, 1, 5000) == KNOT_EOK &&
+		             res->ret == KNOT_EOK);
+		reset(zones, ZONES);
+	}
+	ok(answered && ports_count > 1, "source port rotated");
+
+	/* Cancel. */
+	for (int i = 0; i < ZONES; i++) {
+		soa_check_submit(engine, conf(), zones[i], 1, &silent, 1);
+	}
+	soa_check_cancel(engine);
+	ok(wait_done(zones, ZONES, 0) == KNOT_EOK &&
+	   zones[0]->soa_result.ret == KNOT_EAGAIN &&
+	   zones[ZONES - 1]->soa_result.ret == KNOT_EAGAIN, "checks canceled");
+	ok(zone_events_get_time(zones[ZONES - 1], ZONE_EVENT_REFRESH) > 0,
+	   "refresh of canceled zone scheduled");
+	reset(zones, ZONES);
+
+	soa_check_stop(engine);
+	ret = soa_check_submit(engine, conf(), zones[0], 1, &live, 1);
+	is_int(KNOT_ENOTRUNNING, ret, "submit to stopped engine");
+	soa_check_free(engine);
+
+	net_dgram_send(live_fd, (const uint8_t *)"", 1, (struct sockaddr *)&live.addr);
+	pthread_join(thread, NULL);
+
+	for (int i = 0; i < ZONES; i++) {
+		zone_free(&zones[i]);
+	}
+	close(live_fd);
+	close(silent_fd);
+	conf_free(conf());
+
+	return 0;
+}
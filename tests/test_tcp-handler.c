@@ -0,0 +1,257 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <tap/basic.h>
+
+#include "knot/server/tcp-handler.c"
+#include "test_conf.h"
+
+#define ZONE	"example."
+#define NAMES	20000
+
+/*! \brief Maximum server backlog, the limit and one more message. */
+#define TX_BOUND (TCP_TX_LIMIT + sizeof(uint16_t) + KNOT_WIRE_MAX_PKTSIZE)
+
+static int add_rr(zone_contents_t *contents, const char *owner, uint16_t type,
+                  const uint8_t *rdata, uint16_t rdlen)
+{
+	knot_dname_t *name = knot_dname_from_str_alloc(owner);
+	knot_rrset_t rr;
+	knot_rrset_init(&rr, name, type, KNOT_CLASS_IN, 3600);
+
+	zone_node_t *node = NULL;
+	int ret = knot_rrset_add_rdata(&rr, rdata, rdlen, NULL);
+	if (ret == KNOT_EOK) {
+		ret = zone_contents_add_rr(contents, &rr, &node);
+	}
+	knot_rrset_clear(&rr, NULL);
+
+	return ret;
+}
+
+/*! \brief Creates the zone with NAMES TXT records besides SOA. */
+static zone_t *create_zone(void)
+{
+	static const uint8_t soa[] = {
+		0x02, 'n', 's', 0x00,
+		0x04, 'm', 'a', 'i', 'l', 0x00,
+		0x00, 0x00, 0x00, 0x01,
+		0x00, 0x00, 0x0e, 0x10,
+		0x00, 0x00, 0x03, 0x84,
+		0x00, 0x01, 0x51, 0x80,
+		0x00, 0x00, 0x02, 0x58
+	};
+	uint8_t txt[101] = { 100 };
+	memset(txt + 1, 'x', 100);
+
+	knot_dname_t *apex = knot_dname_from_str_alloc(ZONE);
+	zone_t *zone = zone_new(apex);
+	knot_dname_free(&apex, NULL);
+	zone->contents = zone_contents_new(zone->name);
+
+	int ret = add_rr(zone->contents, ZONE, KNOT_RRTYPE_SOA, soa, sizeof(soa));
+	for (int i = 0; i < NAMES && ret == KNOT_EOK; i++) {
+		char owner[64];
+		(void)snprintf(owner, sizeof(owner), "host%d." ZONE, i);
+		ret = add_rr(zone->contents, owner, KNOT_RRTYPE_TXT, txt, sizeof(txt));
+	}
+	if (ret != KNOT_EOK || zone_contents_adjust_full(zone->contents) != KNOT_EOK) {
+		zone_free(&zone);
+		return NULL;
+	}
+
+	return zone;
+}
+
+/*! \brief Sends the AXFR query from the client socket. */
+static int send_axfr(int fd)
+{
+	knot_dname_t *qname = knot_dname_from_str_alloc(ZONE);
+	knot_pkt_t *query = knot_pkt_new(NULL, KNOT_WIRE_MIN_PKTSIZE, NULL);
+	knot_wire_set_id(query->wire, 0x1234);
+	int ret = knot_pkt_put_question(query, qname, KNOT_CLASS_IN, KNOT_RRTYPE_AXFR);
+	knot_dname_free(&qname, NULL);
+
+	uint8_t buf[sizeof(uint16_t) + KNOT_WIRE_MIN_PKTSIZE];
+	knot_wire_write_u16(buf, query->size);
+	memcpy(buf + sizeof(uint16_t), query->wire, query->size);
+	if (ret == KNOT_EOK &&
+	    send(fd, buf, sizeof(uint16_t) + query->size, 0) != sizeof(uint16_t) + query->size) {
+		ret = KNOT_ECONN;
+	}
+	knot_pkt_free(query);
+
+	return ret;
+}
+
+typedef struct {
+	uint8_t buf[TCP_RX_SIZE];
+	size_t len;
+	size_t bytes;
+	size_t messages;
+	size_t rrs;
+	size_t soas;
+	bool malformed;
+} client_t;
+
+/*! \brief Reads whatever is available and parses the complete messages. */
+static ssize_t client_read(client_t *client, int fd)
+{
+	ssize_t ret = recv(fd, client->buf + client->len,
+	                   sizeof(client->buf) - client->len, MSG_DONTWAIT);
+	if (ret <= 0) {
+		return ret;
+	}
+	client->len += ret;
+	client->bytes += ret;
+
+	size_t off = 0;
+	while (client->len - off >= sizeof(uint16_t)) {
+		uint16_t msg_len = knot_wire_read_u16(client->buf + off);
+		if (client->len - off < sizeof(uint16_t) + msg_len) {
+			break;
+		}
+
+		knot_pkt_t *pkt = knot_pkt_new(client->buf + off + sizeof(uint16_t),
+		                               msg_len, NULL);
+		if (knot_pkt_parse(pkt, 0) != KNOT_EOK ||
+		    knot_wire_get_rcode(pkt->wire) != KNOT_RCODE_NOERROR) {
+			client->malformed = true;
+		} else {
+			const knot_pktsection_t *answer = knot_pkt_section(pkt, KNOT_ANSWER);
+			for (unsigned i = 0; i < answer->count; i++) {
+				if (knot_pkt_rr(answer, i)->type == KNOT_RRTYPE_SOA) {
+					client->soas++;
+				}
+			}
+			client->rrs += answer->count;
+		}
+		knot_pkt_free(pkt);
+
+		client->messages++;
+		off += sizeof(uint16_t) + msg_len;
+	}
+
+	memmove(client->buf, client->buf + off, client->len - off);
+	client->len -= off;
+
+	return ret;
+}
+
+static void test_axfr(server_t *server)
+{
+	int fds[2];
+	int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	is_int(0, ret, "create socket pair");
+
+	/* Keep the kernel buffers small, so most of the zone waits in the server. */
+	int bufsize = 16 * 1024;
+	(void)setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+	(void)setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+
+	tcp_context_t tcp = {
+		.server = server,
+		.iov = {
+			{ .iov_base = malloc(TCP_RX_SIZE), .iov_len = TCP_RX_SIZE },
+			{ .iov_base = malloc(KNOT_WIRE_MAX_PKTSIZE), .iov_len = KNOT_WIRE_MAX_PKTSIZE }
+		}
+	};
+	fdset_init(&tcp.set, 1);
+
+	/* Pretend a remote client allowed to transfer the zone. */
+	tcp_conn_t *conn = tcp_conn_new(fds[0]);
+	sockaddr_set(&conn->addr, AF_INET, "127.0.0.1", 53);
+	int idx = fdset_add(&tcp.set, fds[0], POLLIN, conn);
+	is_int(0, idx, "add connection");
+
+	ret = send_axfr(fds[1]);
+	is_int(KNOT_EOK, ret, "send AXFR query");
+
+	/* The client doesn't read, the answering must pause. */
+	ret = tcp_event_serve(&tcp, idx, true);
+	is_int(KNOT_EOK, ret, "start AXFR");
+	ok(conn->query != NULL && tcp_conn_blocked(conn), "AXFR paused");
+	ok(conn->tx_len >= TCP_TX_LIMIT && conn->tx_len <= TX_BOUND,
+	   "backlog bounded, %zu bytes", conn->tx_len);
+
+	bool bounded = true;
+	for (int i = 0; i < 10; i++) {
+		ret = tcp_event_send(&tcp, idx);
+		bounded = bounded && ret == KNOT_EOK && conn->tx_len <= TX_BOUND;
+	}
+	ok(bounded && conn->query != NULL, "backlog bounded without reading");
+
+	/* The client reads, the answering resumes. */
+	client_t *client = calloc(1, sizeof(*client));
+	size_t max_backlog = 0;
+	while (ret == KNOT_EOK && (conn->query != NULL || conn->tx_len > 0)) {
+		client_read(client, fds[1]);
+		ret = tcp_event_send(&tcp, idx);
+		max_backlog = MAX(max_backlog, conn->tx_len);
+	}
+	while (client_read(client, fds[1]) > 0);
+	is_int(KNOT_EOK, ret, "finish AXFR");
+	ok(max_backlog <= TX_BOUND, "backlog bounded while reading, max %zu bytes",
+	   max_backlog);
+	ok(client->bytes > 4 * TX_BOUND, "transfer larger than the backlog, %zu bytes",
+	   client->bytes);
+	ok(!client->malformed && client->messages > 1 && client->len == 0 &&
+	   client->rrs == NAMES + 2 && client->soas == 2,
+	   "complete transfer, %zu messages", client->messages);
+	ok(!tcp_conn_blocked(conn), "reading resumed");
+
+	free(client);
+	tcp_conn_free(conn);
+	fdset_clear(&tcp.set);
+	free(tcp.iov[0].iov_base);
+	free(tcp.iov[1].iov_base);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	const char *conf_str = "acl:\n"
+	                       " - id: xfr\n"
+	                       "   address: 127.0.0.1\n"
+	                       "   action: transfer\n"
+	                       "zone:\n"
+	                       " - domain: " ZONE "\n"
+	                       "   acl: xfr\n"
+	                       "   zonefile-sync: -1\n";
+	int ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "load configuration");
+
+	server_t server;
+	ret = server_init(&server, 1);
+	is_int(KNOT_EOK, ret, "initialize server");
+
+	zone_t *zone = create_zone();
+	ok(zone != NULL, "create zone");
+	zone->journal_db = &server.journal_db;
+	knot_zonedb_free(&server.zone_db);
+	server.zone_db = knot_zonedb_new();
+	knot_zonedb_insert(server.zone_db, zone);
+
+	test_axfr(&server);
+
+	server_deinit(&server);
+	conf_free(conf());
+
+	return 0;
+}
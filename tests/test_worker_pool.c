@@ -61,10 +61,53 @@ static void task_counting(task_t *task)
 	pthread_mutex_unlock(&log->mx);
 }
 
+static int order[3];
+static int order_count;
+
+/*!
+ * Task recording the execution order.
+ */
+static void task_ordering(task_t *task)
+{
+	order[order_count++] = *(int *)task->ctx;
+}
+
 static void interrupt_handle(int s)
 {
 }
 
+/*!
+ * Check the priority classes with a single worker.
+ */
+static void test_priorities(void)
+{
+	worker_pool_t *pool = worker_pool_create(1);
+	ok(pool != NULL, "create single worker pool");
+	if (!pool) {
+		return;
+	}
+
+	int ids[] = { 0, 1, 2 };
+	task_t tasks[] = {
+		{ .run = task_ordering, .ctx = &ids[0], .prio = TASK_PRIO_LOW },
+		{ .run = task_ordering, .ctx = &ids[1], .prio = TASK_PRIO_NORMAL },
+		{ .run = task_ordering, .ctx = &ids[2], .prio = TASK_PRIO_HIGH },
+	};
+	for (int i = 0; i < 3; i++) {
+		worker_pool_assign(pool, &tasks[i]);
+	}
+	worker_pool_assign(pool, &tasks[2]);
+
+	worker_pool_start(pool);
+	worker_pool_wait(pool);
+	ok(order_count == 3 && order[0] == 2 && order[1] == 1 && order[2] == 0,
+	   "tasks executed by priority, queued task not duplicated");
+
+	worker_pool_stop(pool);
+	worker_pool_join(pool);
+	worker_pool_destroy(pool);
+}
+
 int main(void)
 {
 	plan_lazy();
@@ -89,9 +132,13 @@ int main(void)
 
 	// schedule jobs while pool is stopped
 
-	task_t task = { .run = task_counting, .ctx = &log };
+	task_t tasks[THREADS + TASKS_BATCH];
+	for (int i = 0; i < THREADS + TASKS_BATCH; i++) {
+		tasks[i] = (task_t) { .run = task_counting, .ctx = &log };
+	}
+
 	for (int i = 0; i < TASKS_BATCH; i++) {
-		worker_pool_assign(pool, &task);
+		worker_pool_assign(pool, &tasks[i]);
 	}
 
 	sched_yield();
@@ -106,7 +153,7 @@ int main(void)
 	// add additional jobs while pool is running
 
 	for (int i = 0; i < TASKS_BATCH; i++) {
-		worker_pool_assign(pool, &task);
+		worker_pool_assign(pool, &tasks[i]);
 	}
 
 	worker_pool_wait(pool);
@@ -117,7 +164,7 @@ int main(void)
 	worker_pool_suspend(pool);
 
 	for (int i = 0; i < TASKS_BATCH; i++) {
-		worker_pool_assign(pool, &task);
+		worker_pool_assign(pool, &tasks[i]);
 	}
 
 	sched_yield();
@@ -131,7 +178,7 @@ int main(void)
 
 	pthread_mutex_lock(&log.mx);
 	for (int i = 0; i < THREADS + TASKS_BATCH; i++) {
-		worker_pool_assign(pool, &task);
+		worker_pool_assign(pool, &tasks[i]);
 	}
 	sched_yield();
 	worker_pool_clear(pool);
@@ -148,5 +195,7 @@ int main(void)
 
 	pthread_mutex_destroy(&log.mx);
 
+	test_priorities();
+
 	return 0;
 }
@@ -22,9 +22,10 @@ int main(void)
 {
 	plan_lazy();
 
-	task_t task_one = { 0 };
-	task_t task_two = { 0 };
+	task_t task_one = { .prio = TASK_PRIO_NORMAL };
+	task_t task_two = { .prio = TASK_PRIO_NORMAL };
 	task_t task_three = { 0 };
+	task_t task_urgent = { .prio = TASK_PRIO_HIGH };
 
 	// init
 
@@ -45,6 +46,16 @@ int main(void)
 	ok(worker_queue_dequeue(&queue) == &task_two, "dequeue second");
 	ok(worker_queue_dequeue(&queue) == NULL, "dequeue from empty");
 
+	// priorities
+
+	worker_queue_enqueue(&queue, &task_one);
+	worker_queue_enqueue(&queue, &task_urgent);
+	ok(worker_queue_count(&queue, TASK_PRIO_HIGH) == 1 &&
+	   worker_queue_count(&queue, TASK_PRIO_NORMAL) == 1, "count by priority");
+	ok(worker_queue_dequeue(&queue) == &task_urgent, "dequeue high priority first");
+	ok(worker_queue_dequeue_prio(&queue, TASK_PRIO_HIGH) == NULL, "dequeue from empty class");
+	ok(worker_queue_dequeue(&queue) == &task_one, "dequeue normal priority");
+
 	// deinit
 
 	worker_queue_enqueue(&queue, &task_three);
@@ -0,0 +1,194 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Zone lookup with packed nodes.
+ *
+ * Checks that packed zone nodes keep their RR data in the node block and
+ * answer the same lookups as unpacked ones. The RR data left on the heap and
+ * the cost of the name lookup followed by an RRSet retrieval are reported;
+ * pass a larger
+ * number of names as the first argument to use it as a benchmark
+ * (e.g. 1000000).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <tap/basic.h>
+
+#include "knot/zone/contents.h"
+#include "libknot/libknot.h"
+
+#define DEFAULT_NAMES 1000
+
+static knot_dname_t *name_at(unsigned i)
+{
+	char name[64];
+	(void)snprintf(name, sizeof(name), "host%u.sub%u.example.", i, i % 100);
+	return knot_dname_from_str_alloc(name);
+}
+
+static int add_rr(zone_contents_t *zone, const knot_dname_t *owner,
+                  uint16_t type, const uint8_t *rdata, uint16_t rdlen)
+{
+	knot_rrset_t rr;
+	knot_rrset_init(&rr, (knot_dname_t *)owner, type, KNOT_CLASS_IN, 3600);
+	int ret = knot_rrset_add_rdata(&rr, rdata, rdlen, NULL);
+	if (ret == KNOT_EOK) {
+		zone_node_t *n = NULL;
+		ret = zone_contents_add_rr(zone, &rr, &n);
+	}
+	knot_rdataset_clear(&rr.rrs, NULL);
+
+	return ret;
+}
+
+static zone_contents_t *create_zone(knot_dname_t **names, unsigned count)
+{
+	knot_dname_t *apex = knot_dname_from_str_alloc("example.");
+	zone_contents_t *zone = zone_contents_new(apex);
+	knot_dname_free(&apex, NULL);
+	if (zone == NULL) {
+		return NULL;
+	}
+
+	const uint8_t soa[22] = { 0 };
+	int ret = add_rr(zone, zone->apex->owner, KNOT_RRTYPE_SOA, soa, sizeof(soa));
+
+	/* Every node has an A record, every fourth one has AAAA too. */
+	for (unsigned i = 0; i < count && ret == KNOT_EOK; i++) {
+		const uint8_t a[4] = { 192, 0, 2, i % 256 };
+		ret = add_rr(zone, names[i], KNOT_RRTYPE_A, a, sizeof(a));
+		if (ret == KNOT_EOK && i % 4 == 0) {
+			const uint8_t aaaa[16] = { 0x20, 0x01, 0x0d, 0xb8, [15] = i % 256 };
+			ret = add_rr(zone, names[i], KNOT_RRTYPE_AAAA, aaaa, sizeof(aaaa));
+		}
+	}
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&zone);
+	}
+
+	return zone;
+}
+
+typedef struct {
+	size_t heap_blocks; /*!< Count of RR data allocated separately. */
+	size_t heap_size;   /*!< Size of the RR data allocated separately. */
+	size_t records;     /*!< Count of records. */
+} zone_stats_t;
+
+static int node_stats(zone_node_t *node, void *data)
+{
+	zone_stats_t *stats = data;
+	for (uint16_t i = 0; i < node->rrset_count; i++) {
+		const knot_rdataset_t *rrs = &node->rrs[i].rrs;
+		if (!node_rdataset_embedded(node, rrs)) {
+			stats->heap_blocks++;
+			stats->heap_size += knot_rdataset_size(rrs);
+		}
+		stats->records += rrs->rr_count;
+	}
+
+	return KNOT_EOK;
+}
+
+static zone_stats_t zone_stats(zone_contents_t *zone, const char *desc)
+{
+	zone_stats_t stats = { 0 };
+	(void)zone_contents_apply(zone, node_stats, &stats);
+
+	diag("%s RR data on heap: %zu blocks, %.1f B per record", desc,
+	     stats.heap_blocks, (double)stats.heap_size / stats.records);
+
+	return stats;
+}
+
+/*! \brief Looks all the names up in a pseudo-random order. */
+static unsigned lookup(const zone_contents_t *zone, knot_dname_t **names,
+                       unsigned count, const char *desc)
+{
+	unsigned step = 7919;
+	while (count % step == 0 && step > 1) {
+		step--;
+	}
+
+	unsigned found = 0;
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (unsigned i = 0, pos = 0; i < count; i++, pos = (pos + step) % count) {
+		const zone_node_t *match = NULL, *closest = NULL, *prev = NULL;
+		int ret = zone_contents_find_dname(zone, names[pos], &match, &closest, &prev);
+		knot_rrset_t rr = node_rrset(match, KNOT_RRTYPE_A);
+		if (ret == ZONE_NAME_FOUND && !knot_rrset_empty(&rr) &&
+		    knot_rdataset_at(&rr.rrs, 0)->data[3] == pos % 256) {
+			found++;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double secs = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+	diag("%s find_dname + node_rrset: %.1f ns per lookup", desc, secs * 1e9 / count);
+
+	return found;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	unsigned count = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_NAMES;
+	knot_dname_t **names = calloc(count, sizeof(*names));
+	for (unsigned i = 0; names != NULL && i < count; i++) {
+		names[i] = name_at(i);
+	}
+
+	zone_contents_t *zone = (names != NULL) ? create_zone(names, count) : NULL;
+	ok(zone != NULL, "create zone with %u names", count);
+	if (zone == NULL) {
+		return 1;
+	}
+
+	int ret = zone_contents_adjust_full(zone);
+	ok(ret == KNOT_EOK, "adjust zone");
+	zone_stats_t plain = zone_stats(zone, "unpacked");
+	ok(lookup(zone, names, count, "unpacked") == count, "find names and RRSets");
+
+	ret = zone_contents_pack(zone);
+	ok(ret == KNOT_EOK, "pack zone");
+	ret = zone_contents_adjust_full(zone);
+	ok(ret == KNOT_EOK, "adjust packed zone");
+	zone_stats_t packed = zone_stats(zone, "packed");
+	ok(plain.heap_blocks > count && packed.heap_blocks == 0 &&
+	   packed.records == plain.records,
+	   "packed nodes embed all RR data");
+	ok(lookup(zone, names, count, "packed") == count, "find names and RRSets in packed zone");
+
+	/* Shallow copy (as made by an incremental update) keeps the data embedded. */
+	zone_contents_t *copy = NULL;
+	ret = zone_contents_shallow_copy(zone, &copy);
+	ok(ret == KNOT_EOK && zone_contents_adjust_full(copy) == KNOT_EOK &&
+	   zone_stats(copy, "copied").heap_blocks == 0, "shallow copy of packed zone");
+	zone_contents_free(&copy);
+
+	for (unsigned i = 0; i < count; i++) {
+		knot_dname_free(&names[i], NULL);
+	}
+	free(names);
+	zone_contents_deep_free(&zone);
+
+	return 0;
+}
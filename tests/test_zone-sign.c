@@ -0,0 +1,282 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+
+#include "test_conf.h"
+#include "knot/dnssec/context.h"
+#include "knot/dnssec/kasp/kasp_db.h"
+#include "knot/dnssec/zone-keys.h"
+#include "knot/dnssec/zone-nsec.h"
+#include "knot/dnssec/zone-sign.h"
+#include "knot/updates/zone-update.h"
+#include "knot/zone/zone.h"
+#include "libknot/libknot.h"
+#include "zscanner/scanner.h"
+
+#define ZONE		"example."
+#define DELEGATIONS	200
+#define NAMES		2000
+#define THREADS		4
+
+/*! \brief Generates the test zone text, including delegations and glue. */
+static char *zone_text(void)
+{
+	size_t size = 256 + (NAMES + 3 * DELEGATIONS) * 64;
+	char *text = malloc(size);
+	if (text == NULL) {
+		return NULL;
+	}
+
+	int len = snprintf(text, size,
+	                   "@ 3600 SOA ns.example. admin.example. 1 3600 900 86400 600\n"
+	                   "@ NS ns\n"
+	                   "ns A 192.0.2.1\n"
+	                   "* TXT wildcard\n");
+	for (int i = 0; i < NAMES; i++) {
+		len += snprintf(text + len, size - len,
+		                "host%d A 198.51.100.%d\n", i, i % 256);
+	}
+	for (int i = 0; i < DELEGATIONS; i++) {
+		len += snprintf(text + len, size - len,
+		                "sub%d NS ns.sub%d\n"
+		                "sub%d DS 1234 8 2 %064x\n"
+		                "ns.sub%d A 203.0.113.%d\n",
+		                i, i, i, i, i, i % 256);
+	}
+
+	return text;
+}
+
+static void add_rr(zs_scanner_t *sc)
+{
+	zone_contents_t *contents = sc->process.data;
+
+	knot_rrset_t rr;
+	knot_rrset_init(&rr, sc->r_owner, sc->r_type, sc->r_class, sc->r_ttl);
+	zone_node_t *node = NULL;
+	if (knot_rrset_add_rdata(&rr, sc->r_data, sc->r_data_length, NULL) != KNOT_EOK ||
+	    zone_contents_add_rr(contents, &rr, &node) != KNOT_EOK) {
+		sc->state = ZS_STATE_STOP;
+	}
+	knot_rdataset_clear(&rr.rrs, NULL);
+}
+
+static zone_contents_t *zone_load(const knot_dname_t *apex, const char *text)
+{
+	zone_contents_t *contents = zone_contents_new(apex);
+	if (contents == NULL) {
+		return NULL;
+	}
+
+	zs_scanner_t sc;
+	if (zs_init(&sc, ZONE, KNOT_CLASS_IN, 3600) != 0 ||
+	    zs_set_processing(&sc, add_rr, NULL, contents) != 0 ||
+	    zs_set_input_string(&sc, text, strlen(text)) != 0 ||
+	    zs_parse_all(&sc) != 0 || sc.state == ZS_STATE_STOP ||
+	    zone_contents_adjust_full(contents) != KNOT_EOK) {
+		zs_deinit(&sc);
+		zone_contents_deep_free(&contents);
+		return NULL;
+	}
+	zs_deinit(&sc);
+
+	return contents;
+}
+
+/*! \brief Signs a fresh copy of the zone with the given number of threads. */
+static int zone_sign(zone_update_t *up, zone_t *zone, const char *text,
+                     zone_keyset_t *keyset, kdnssec_ctx_t *ctx, unsigned threads)
+{
+	zone_contents_t *contents = zone_load(zone->name, text);
+	if (contents == NULL) {
+		return KNOT_ERROR;
+	}
+
+	int ret = zone_update_from_contents(up, zone, contents, UPDATE_INCREMENTAL);
+	if (ret != KNOT_EOK) {
+		zone_contents_deep_free(&contents);
+		return ret;
+	}
+
+	ctx->policy->signing_threads = threads;
+
+	knot_time_t expire = 0;
+	ret = knot_zone_create_nsec_chain(up, keyset, ctx, false);
+	if (ret == KNOT_EOK) {
+		ret = knot_zone_sign(up, keyset, ctx, &expire);
+	}
+
+	return ret;
+}
+
+typedef struct {
+	zone_tree_t *other;
+	size_t rrsigs;
+	bool equal;
+} compare_ctx_t;
+
+static int compare_node(zone_node_t **node, void *data)
+{
+	compare_ctx_t *cmp = data;
+
+	zone_node_t *other = zone_tree_get(cmp->other, (*node)->owner);
+	if (other == NULL || other->rrset_count != (*node)->rrset_count) {
+		cmp->equal = false;
+		return KNOT_EOK;
+	}
+
+	for (unsigned i = 0; i < (*node)->rrset_count; i++) {
+		knot_rrset_t rr = node_rrset_at(*node, i);
+		knot_rrset_t other_rr = node_rrset(other, rr.type);
+		if (!knot_rrset_equal(&rr, &other_rr, KNOT_RRSET_COMPARE_WHOLE)) {
+			cmp->equal = false;
+		}
+		if (rr.type == KNOT_RRTYPE_RRSIG) {
+			cmp->rrsigs += rr.rrs.rr_count;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*! \brief Compares the trees and returns the number of RRSIGs, 0 if different. */
+static size_t tree_compare(zone_tree_t *a, zone_tree_t *b)
+{
+	if (zone_tree_count(a) != zone_tree_count(b)) {
+		return 0;
+	}
+
+	compare_ctx_t cmp = { .other = b, .equal = true };
+	if (zone_tree_apply(a, compare_node, &cmp) != KNOT_EOK || !cmp.equal) {
+		return 0;
+	}
+
+	return cmp.rrsigs;
+}
+
+static void test_sign(zone_t *zone, const char *text, zone_keyset_t *keyset,
+                      kdnssec_ctx_t *ctx, const char *chain)
+{
+	zone_update_t serial, parallel;
+
+	int ret = zone_sign(&serial, zone, text, keyset, ctx, 1);
+	is_int(KNOT_EOK, ret, "%s: serial signing", chain);
+	ret = zone_sign(&parallel, zone, text, keyset, ctx, THREADS);
+	is_int(KNOT_EOK, ret, "%s: parallel signing", chain);
+	if (ret != KNOT_EOK) {
+		return;
+	}
+
+	zone_contents_t *s = serial.new_cont, *p = parallel.new_cont;
+	size_t nodes = zone_tree_count(s->nodes);
+	size_t nsec3_nodes = s->nsec3_nodes ? zone_tree_count(s->nsec3_nodes) : 0;
+	ok(nodes >= THREADS * 256 && (!ctx->policy->nsec3_enabled ||
+	   nsec3_nodes >= THREADS * 256), "%s: zone large enough to be split", chain);
+
+	ok(tree_compare(s->nodes, p->nodes) > NAMES,
+	   "%s: same signatures and chain", chain);
+	if (ctx->policy->nsec3_enabled) {
+		ok(p->nsec3_nodes != NULL &&
+		   tree_compare(s->nsec3_nodes, p->nsec3_nodes) >= nsec3_nodes,
+		   "%s: same NSEC3 chain and signatures", chain);
+	}
+
+	zone_update_clear(&serial);
+	zone_update_clear(&parallel);
+}
+
+static void interrupt_handle(int s)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	/* Signing threads are woken up by SIGALRM. */
+	struct sigaction sa;
+	sa.sa_handler = interrupt_handle;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGALRM, &sa, NULL);
+
+	char *temp_dir = test_mkdtemp();
+	ok(temp_dir != NULL, "make temporary directory");
+
+	char conf_str[512];
+	snprintf(conf_str, sizeof(conf_str),
+	         "policy:\n"
+	         " - id: rsa\n"
+	         "   algorithm: rsasha256\n"
+	         "   ksk-size: 1024\n"
+	         "   zsk-size: 1024\n"
+	         "zone:\n"
+	         " - domain: " ZONE "\n"
+	         "   dnssec-policy: rsa\n"
+	         "template:\n"
+	         " - id: default\n"
+	         "   storage: %s\n",
+	         temp_dir);
+	int ret = test_conf(conf_str, NULL);
+	is_int(KNOT_EOK, ret, "load configuration");
+
+	char *kasp_dir = conf_kaspdir(conf());
+	ret = kasp_db_init(kaspdb(), kasp_dir, 100 * 1024 * 1024);
+	free(kasp_dir);
+	is_int(KNOT_EOK, ret, "init KASP database");
+
+	knot_dname_t *apex = knot_dname_from_str_alloc(ZONE);
+	zone_t *zone = zone_new(apex);
+
+	/* RSA signatures are deterministic, the signing time is fixed. */
+	kdnssec_ctx_t ctx;
+	ret = kdnssec_ctx_init(conf(), &ctx, apex, NULL);
+	is_int(KNOT_EOK, ret, "init DNSSEC context");
+	ctx.now = 1500000000;
+
+	knot_kasp_key_t *key = NULL;
+	ret = kdnssec_generate_key(&ctx, true, true, &key);
+	is_int(KNOT_EOK, ret, "generate key");
+	key->timing.publish = ctx.now;
+	key->timing.active = ctx.now;
+
+	zone_keyset_t keyset = { 0 };
+	ret = load_zone_keys(&ctx, &keyset, false);
+	is_int(KNOT_EOK, ret, "load zone keys");
+
+	char *text = zone_text();
+	test_sign(zone, text, &keyset, &ctx, "NSEC");
+	ctx.policy->nsec3_enabled = true;
+	test_sign(zone, text, &keyset, &ctx, "NSEC3");
+	free(text);
+
+	free_zone_keys(&keyset);
+	kdnssec_ctx_deinit(&ctx);
+	zone_free(&zone);
+	knot_dname_free(&apex, NULL);
+	kasp_db_close(kaspdb());
+	conf_free(conf());
+	test_rm_rf(temp_dir);
+	free(temp_dir);
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+
+#include "test_zone.h"
+#include "knot/zone/zone-snapshot.h"
+#include "knot/zone/zonefile.h"
+#include "libknot/libknot.h"
+#include "contrib/string.h"
+
+static const char *zone_str =
+	"example. 600 SOA ns.example. m.example. 1 900 300 4800 900\n"
+	"example. 600 NS ns.example.\n"
+	"ns.example. 600 A 192.0.2.1\n"
+	"ns.example. 600 AAAA 2001:db8::1\n"
+	"www.example. 300 TXT \"a\" \"bc\"\n"
+	"www.example. 300 TXT \"odd\"\n"
+	"*.wild.example. 300 MX 10 ns.example.\n"
+	"sub.example. 600 NS ns.sub.example.\n"
+	"ns.sub.example. 600 A 192.0.2.2\n";
+
+static zone_contents_t *load_text(const char *path, const knot_dname_t *origin)
+{
+	zloader_t zl;
+	if (zonefile_open(&zl, path, origin, false, 0) != KNOT_EOK) {
+		return NULL;
+	}
+
+	sem_handler_t handler = { .cb = err_handler_logger };
+	zl.err_handler = &handler;
+
+	zone_contents_t *contents = zonefile_load(&zl);
+	zonefile_close(&zl);
+
+	return contents;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	char *dir = test_mkdtemp();
+	ok(dir != NULL, "create temporary directory");
+	char *zonefile = sprintf_alloc("%s/example.zone", dir);
+	char *snapshot = sprintf_alloc("%s/example.zone.snapshot", dir);
+	knot_dname_t *origin = knot_dname_from_str_alloc("example.");
+
+	write_file(zonefile, zone_str, "w");
+	zone_contents_t *text = load_text(zonefile, origin);
+	ok(text != NULL, "load text zone file");
+
+	zone_contents_t *loaded = NULL;
+	int ret = zone_snapshot_load(zonefile, origin, &loaded);
+	is_int(KNOT_ENOENT, ret, "load missing snapshot");
+
+	ret = zone_snapshot_write(zonefile, text);
+	is_int(KNOT_EOK, ret, "write snapshot");
+
+	ret = zone_snapshot_load(zonefile, origin, &loaded);
+	is_int(KNOT_EOK, ret, "load snapshot");
+	ok(loaded != NULL && contents_equal(text, loaded), "snapshot matches zone file");
+	const zone_node_t *deleg = (loaded == NULL) ? NULL :
+		zone_contents_find_node(loaded, (const knot_dname_t *)"\x03""sub""\x07""example");
+	ok(deleg != NULL && (deleg->flags & NODE_FLAGS_DELEG), "snapshot contents adjusted");
+	zone_contents_deep_free(&loaded);
+
+	/* Corrupt one byte of the data. */
+	FILE *file = fopen(snapshot, "r+");
+	ok(file != NULL && fseek(file, -1, SEEK_END) == 0 && fputc(0xff, file) != EOF,
+	   "corrupt snapshot");
+	if (file != NULL) {
+		fclose(file);
+	}
+	ret = zone_snapshot_load(zonefile, origin, &loaded);
+	is_int(KNOT_EMALF, ret, "load corrupted snapshot");
+
+	/* Zone file changed within the same second, same size. */
+	ret = zone_snapshot_write(zonefile, text);
+	is_int(KNOT_EOK, ret, "rewrite snapshot");
+	struct stat st;
+	stat(zonefile, &st);
+	char *same_size = strdup(zone_str);
+	same_size[strlen(same_size) - 2] = '3';
+	write_file(zonefile, same_size, "w");
+	free(same_size);
+	struct timespec times[2] = { st.st_atim, st.st_mtim };
+	times[1].tv_nsec = (times[1].tv_nsec + 1) % 1000000000;
+	ok(utimensat(AT_FDCWD, zonefile, times, 0) == 0, "set zone file mtime");
+	ret = zone_snapshot_load(zonefile, origin, &loaded);
+	is_int(KNOT_ENOENT, ret, "load snapshot of zone file changed in the same second");
+
+	/* Outdated snapshot. */
+	write_file(zonefile, zone_str, "w");
+	ret = zone_snapshot_write(zonefile, text);
+	is_int(KNOT_EOK, ret, "rewrite snapshot");
+	write_file(zonefile, "; changed\n", "a");
+	ret = zone_snapshot_load(zonefile, origin, &loaded);
+	is_int(KNOT_ENOENT, ret, "load snapshot of changed zone file");
+
+	zone_contents_deep_free(&text);
+	knot_dname_free(&origin, NULL);
+	free(snapshot);
+	free(zonefile);
+	test_rm_rf(dir);
+	free(dir);
+
+	return 0;
+}
@@ -15,12 +15,14 @@
  */
 
 #include <assert.h>
+#include <urcu.h>
 #include <tap/basic.h>
 #include <tap/files.h>
 
 #include "test_conf.h"
 #include "contrib/macros.h"
 #include "contrib/getline.h"
+#include "knot/updates/apply.h"
 #include "knot/updates/zone-update.h"
 #include "knot/zone/node.h"
 #include "zscanner/scanner.h"
@@ -184,6 +186,9 @@ void test_incremental(zone_t *zone, zs_scanner_t *sc)
 {
 	int ret = KNOT_EOK;
 
+	/* Snapshot of the current version (e.g. outgoing transfer) */
+	zone_contents_t *snapshot = zone_contents_retain(zone->contents);
+
 	/* Init update */
 	zone_update_t update;
 	zone_update_init(&update, zone, UPDATE_INCREMENTAL);
@@ -278,6 +283,329 @@ void test_incremental(zone_t *zone, zs_scanner_t *sc)
 	ok(ret == KNOT_EOK && rrset_present, "incremental zone update: commit");
 
 	knot_rdataset_clear(&rrset.rrs, NULL);
+
+	/* Snapshot must survive the commit */
+	rcu_barrier();
+	if (zs_set_input_string(sc, del_str, strlen(del_str)) != 0 ||
+	    zs_parse_all(sc) != 0) {
+		assert(0);
+	}
+	rrset_present = node_contains_rr(snapshot->apex, &rrset);
+	ok(snapshot != zone->contents && rrset_present,
+	   "incremental zone update: snapshot intact");
+	knot_rdataset_clear(&rrset.rrs, NULL);
+
+	zone_contents_release(snapshot);
+}
+
+static const char *lazy_base =
+	"test. SOA ns.test. m.test. 1 900 300 4800 900\n"
+	"test. NS ns.test.\n"
+	"ns.test. A 192.0.2.1\n"
+	"a.test. TXT \"a\"\n"
+	"b.test. MX 10 mail.b.test.\n"
+	"sub.test. NS ns.sub.test.\n"
+	"ns.sub.test. A 192.0.2.2\n"
+	"deep.x.y.test. TXT \"deep\"\n"
+	"*.w.test. TXT \"wild\"\n";
+
+/*! \brief Changes applied one by one and the resulting zones. */
+static const struct {
+	const char *del;
+	const char *add;
+	const char *result;
+} lazy_steps[] = {
+	{ /* New glue target, new and removed nodes. */
+	  "test. SOA ns.test. m.test. 1 900 300 4800 900\n"
+	  "a.test. TXT \"a\"\n",
+	  "test. SOA ns.test. m.test. 2 900 300 4800 900\n"
+	  "mail.b.test. A 192.0.2.3\n"
+	  "c.test. TXT \"c\"\n",
+	  "test. SOA ns.test. m.test. 2 900 300 4800 900\n"
+	  "test. NS ns.test.\n"
+	  "ns.test. A 192.0.2.1\n"
+	  "b.test. MX 10 mail.b.test.\n"
+	  "mail.b.test. A 192.0.2.3\n"
+	  "c.test. TXT \"c\"\n"
+	  "sub.test. NS ns.sub.test.\n"
+	  "ns.sub.test. A 192.0.2.2\n"
+	  "deep.x.y.test. TXT \"deep\"\n"
+	  "*.w.test. TXT \"wild\"\n" },
+	{ /* Delegations moved, empty non-terminals removed. */
+	  "test. SOA ns.test. m.test. 2 900 300 4800 900\n"
+	  "sub.test. NS ns.sub.test.\n"
+	  "deep.x.y.test. TXT \"deep\"\n",
+	  "test. SOA ns.test. m.test. 3 900 300 4800 900\n"
+	  "y.test. NS ns.sub.test.\n"
+	  "z.x.y.test. A 192.0.2.4\n",
+	  "test. SOA ns.test. m.test. 3 900 300 4800 900\n"
+	  "test. NS ns.test.\n"
+	  "ns.test. A 192.0.2.1\n"
+	  "b.test. MX 10 mail.b.test.\n"
+	  "mail.b.test. A 192.0.2.3\n"
+	  "c.test. TXT \"c\"\n"
+	  "ns.sub.test. A 192.0.2.2\n"
+	  "y.test. NS ns.sub.test.\n"
+	  "z.x.y.test. A 192.0.2.4\n"
+	  "*.w.test. TXT \"wild\"\n" },
+	{ /* Glue removed, wildcard at the apex. */
+	  "test. SOA ns.test. m.test. 3 900 300 4800 900\n"
+	  "ns.test. A 192.0.2.1\n"
+	  "*.w.test. TXT \"wild\"\n",
+	  "test. SOA ns.test. m.test. 4 900 300 4800 900\n"
+	  "*.test. TXT \"wild\"\n",
+	  "test. SOA ns.test. m.test. 4 900 300 4800 900\n"
+	  "test. NS ns.test.\n"
+	  "*.test. TXT \"wild\"\n"
+	  "b.test. MX 10 mail.b.test.\n"
+	  "mail.b.test. A 192.0.2.3\n"
+	  "c.test. TXT \"c\"\n"
+	  "ns.sub.test. A 192.0.2.2\n"
+	  "y.test. NS ns.sub.test.\n"
+	  "z.x.y.test. A 192.0.2.4\n" },
+};
+
+typedef struct {
+	zone_contents_t *contents;
+	apply_ctx_t *ctx;
+	bool remove;
+	int ret;
+} lazy_data_t;
+
+static void lazy_process(zs_scanner_t *scanner)
+{
+	lazy_data_t *data = scanner->process.data;
+
+	knot_rrset_t rr;
+	knot_rrset_init(&rr, scanner->r_owner, scanner->r_type, scanner->r_class,
+	                scanner->r_ttl);
+	int ret = knot_rrset_add_rdata(&rr, scanner->r_data, scanner->r_data_length, NULL);
+	if (ret == KNOT_EOK) {
+		if (data->ctx == NULL) {
+			zone_node_t *unused = NULL;
+			ret = zone_contents_add_rr(data->contents, &rr, &unused);
+		} else if (data->remove) {
+			ret = apply_remove_rr(data->ctx, &rr);
+		} else {
+			ret = apply_add_rr(data->ctx, &rr);
+		}
+	}
+	knot_rdataset_clear(&rr.rrs, NULL);
+
+	if (data->ret == KNOT_EOK) {
+		data->ret = ret;
+	}
+}
+
+static int lazy_parse(zs_scanner_t *sc, const char *str, lazy_data_t *data)
+{
+	if (zs_set_processing(sc, lazy_process, NULL, data) != 0 ||
+	    zs_set_input_string(sc, str, strlen(str)) != 0 ||
+	    zs_parse_all(sc) != 0) {
+		return KNOT_EPARSEFAIL;
+	}
+
+	return data->ret;
+}
+
+static zone_contents_t *lazy_load(zs_scanner_t *sc, const char *str)
+{
+	lazy_data_t data = { .contents = zone_contents_new((const knot_dname_t *)"\x04""test") };
+	// Packed like a loaded zone, updates must not modify the embedded data.
+	if (lazy_parse(sc, str, &data) != KNOT_EOK ||
+	    zone_contents_pack(data.contents) != KNOT_EOK ||
+	    zone_contents_adjust_full(data.contents) != KNOT_EOK) {
+		zone_contents_deep_free(&data.contents);
+	}
+
+	return data.contents;
+}
+
+static zone_contents_t *lazy_apply(zs_scanner_t *sc, zone_contents_t *old,
+                                   apply_ctx_t *ctx, const char *del, const char *add)
+{
+	zone_contents_t *contents = NULL;
+	if (apply_prepare_zone_copy(old, &contents) != KNOT_EOK) {
+		return NULL;
+	}
+	apply_init_ctx(ctx, contents, APPLY_STRICT);
+
+	lazy_data_t data = { .ctx = ctx, .remove = true };
+	int ret = lazy_parse(sc, del, &data);
+	if (ret == KNOT_EOK) {
+		data.remove = false;
+		ret = lazy_parse(sc, add, &data);
+	}
+	if (ret == KNOT_EOK) {
+		ret = apply_finalize(ctx);
+	}
+	if (ret != KNOT_EOK) {
+		update_rollback(ctx);
+		update_free_zone(&contents);
+	}
+
+	return contents;
+}
+
+static bool same_owner(const zone_node_t *a, const zone_node_t *b)
+{
+	return (a == NULL && b == NULL) ||
+	       (a != NULL && b != NULL && knot_dname_is_equal(a->owner, b->owner));
+}
+
+static bool same_glues(const zone_contents_t *a_zone, const additional_t *a,
+                       const zone_contents_t *b_zone, const additional_t *b)
+{
+	uint16_t a_count = (a == NULL) ? 0 : a->count;
+	uint16_t b_count = (b == NULL) ? 0 : b->count;
+	if (a_count != b_count) {
+		return false;
+	}
+
+	for (uint16_t i = 0; i < a_count; i++) {
+		if (!same_owner(zone_contents_glue_node(a_zone, &a->glues[i]),
+		                zone_contents_glue_node(b_zone, &b->glues[i])) ||
+		    a->glues[i].optional != b->glues[i].optional) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+typedef struct {
+	const zone_contents_t *zone;
+	const zone_contents_t *expected;
+	bool nsec3;
+} lazy_cmp_t;
+
+static int lazy_cmp_node(zone_node_t **exp_node, void *data)
+{
+	lazy_cmp_t *cmp = data;
+	const zone_node_t *exp = *exp_node;
+	const zone_node_t *node = cmp->nsec3 ?
+	                          zone_contents_find_nsec3_node(cmp->zone, exp->owner) :
+	                          zone_contents_find_node(cmp->zone, exp->owner);
+	if (node == NULL || node->rrset_count != exp->rrset_count ||
+	    node->children != exp->children ||
+	    (node->flags & ~NODE_FLAGS_VERSIONING) != (exp->flags & ~NODE_FLAGS_VERSIONING) ||
+	    (!cmp->nsec3 &&
+	     !same_owner(zone_contents_node_parent(cmp->zone, node),
+	                 zone_contents_node_parent(cmp->expected, exp))) ||
+	    !same_owner(zone_tree_current(cmp->nsec3 ? cmp->zone->nsec3_nodes : cmp->zone->nodes, node->prev),
+	                exp->prev)) {
+		return KNOT_EMALF;
+	}
+
+	for (uint16_t i = 0; i < exp->rrset_count; i++) {
+		const struct rr_data *exp_data = &exp->rrs[i];
+		const struct rr_data *node_data = NULL;
+		for (uint16_t j = 0; j < node->rrset_count; j++) {
+			if (node->rrs[j].type == exp_data->type) {
+				node_data = &node->rrs[j];
+			}
+		}
+		if (node_data == NULL || !knot_rdataset_eq(&node_data->rrs, &exp_data->rrs) ||
+		    !same_glues(cmp->zone, node_data->additional,
+		                cmp->expected, exp_data->additional)) {
+			return KNOT_EMALF;
+		}
+	}
+
+	return KNOT_EOK;
+}
+
+/*!< \brief Returns true if the contents are the same as freshly loaded ones. */
+static bool lazy_consistent(const zone_contents_t *zone, const zone_contents_t *expected)
+{
+	if (zone_tree_count(zone->nodes) != zone_tree_count(expected->nodes) ||
+	    zone_tree_count(zone->nsec3_nodes) != zone_tree_count(expected->nsec3_nodes) ||
+	    zone->size != expected->size) {
+		return false;
+	}
+
+	lazy_cmp_t cmp = { zone, expected, false };
+	if (zone_tree_apply(expected->nodes, lazy_cmp_node, &cmp) != KNOT_EOK) {
+		return false;
+	}
+	cmp.nsec3 = true;
+
+	return zone_tree_apply(expected->nsec3_nodes, lazy_cmp_node, &cmp) == KNOT_EOK;
+}
+
+static const zone_node_t *lazy_node(const zone_contents_t *zone, const char *name)
+{
+	knot_dname_t *owner = knot_dname_from_str_alloc(name);
+	const zone_node_t *node = zone_contents_find_node(zone, owner);
+	knot_dname_free(&owner, NULL);
+
+	return node;
+}
+
+/*! \brief Replaces the previous version as when the update is committed. */
+static void lazy_retire(zone_contents_t **old, zone_contents_t *new, apply_ctx_t *ctx)
+{
+	zone_contents_chain(*old, new);
+	new->refs--;
+	update_free_zone(old);
+	update_cleanup(ctx);
+}
+
+static void test_lazy_copy(void)
+{
+	zs_scanner_t sc;
+	if (zs_init(&sc, "test.", KNOT_CLASS_IN, 3600) != 0) {
+		assert(0);
+	}
+
+	zone_contents_t *zone = lazy_load(&sc, lazy_base);
+	zone_contents_t *base = lazy_load(&sc, lazy_base);
+	ok(zone != NULL && base != NULL, "lazy copy: load zone");
+
+	for (int i = 0; i < sizeof(lazy_steps) / sizeof(*lazy_steps); i++) {
+		apply_ctx_t ctx;
+		zone_contents_t *expected = lazy_load(&sc, lazy_steps[i].result);
+		zone_contents_t *updated = lazy_apply(&sc, zone, &ctx, lazy_steps[i].del,
+		                                      lazy_steps[i].add);
+		ok(updated != NULL && lazy_consistent(updated, expected),
+		   "lazy copy: step %i applied", i + 1);
+		ok(lazy_consistent(zone, base), "lazy copy: step %i previous version intact", i + 1);
+		if (i == 0) {
+			ok(updated != NULL &&
+			   lazy_node(updated, "ns.sub.test.") == lazy_node(zone, "ns.sub.test.") &&
+			   lazy_node(updated, "*.w.test.") == lazy_node(zone, "*.w.test."),
+			   "lazy copy: unchanged nodes shared");
+			ok(updated != NULL && lazy_node(updated, "b.test.") != lazy_node(zone, "b.test."),
+			   "lazy copy: referring node copied");
+		}
+		if (updated == NULL) {
+			zone_contents_deep_free(&expected);
+			break;
+		}
+
+		lazy_retire(&zone, updated, &ctx);
+		zone = updated;
+		zone_contents_deep_free(&base);
+		base = expected;
+	}
+
+	/* Repeated changes of the same node replace the generation eventually. */
+	bool consistent = true;
+	for (int i = 0; i < 64 && consistent; i++) {
+		apply_ctx_t ctx;
+		zone_contents_t *updated = lazy_apply(&sc, zone, &ctx, "c.test. TXT \"c\"\n",
+		                                      "c.test. TXT \"c\"\n");
+		consistent = (updated != NULL && lazy_consistent(updated, base));
+		if (updated != NULL) {
+			lazy_retire(&zone, updated, &ctx);
+			zone = updated;
+		}
+	}
+	ok(consistent, "lazy copy: repeated updates");
+
+	zone_contents_deep_free(&zone);
+	zone_contents_deep_free(&base);
+	zs_deinit(&sc);
 }
 
 int main(int argc, char *argv[])
@@ -321,6 +649,7 @@ int main(int argc, char *argv[])
 	/* Test FULL update, commit it and use the result to test the INCREMENTAL update */
 	test_full(zone, &sc);
 	test_incremental(zone, &sc);
+	test_lazy_copy();
 
 	zs_deinit(&sc);
 	zone_free(&zone);
@@ -0,0 +1,50 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "knot/updates/changesets.h"
+#include "knot/zone/contents.h"
+#include "knot/zone/zone-diff.h"
+#include "libknot/errcode.h"
+
+/* Write (mode "w") or append (mode "a") the data to the file. */
+static inline void write_file(const char *path, const char *data, const char *mode)
+{
+	FILE *file = fopen(path, mode);
+	if (file != NULL) {
+		fputs(data, file);
+		fclose(file);
+	}
+}
+
+/* Compare zone contents, no differences in records expected. */
+static inline bool contents_equal(const zone_contents_t *a, const zone_contents_t *b)
+{
+	changeset_t ch;
+	if (changeset_init(&ch, a->apex->owner) != KNOT_EOK) {
+		return false;
+	}
+
+	int ret = zone_contents_diff(a, b, &ch);
+	bool equal = (ret == KNOT_ENODIFF) || (ret == KNOT_EOK && changeset_empty(&ch));
+	changeset_clear(&ch);
+
+	return equal;
+}
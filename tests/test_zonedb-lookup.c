@@ -0,0 +1,126 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Zone database lookup microbenchmark.
+ *
+ * Compares the zone suffix lookup with a label-by-label search using exact
+ * lookups. The number of zones can be specified as the first argument
+ * (e.g. 1000000), the default is small for the test suite.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <tap/basic.h>
+
+#include "knot/zone/zone.h"
+#include "knot/zone/zonedb.h"
+#include "libknot/libknot.h"
+
+#define DEFAULT_ZONES 20000
+
+static knot_dname_t *name_at(const char *prefix, unsigned i)
+{
+	char name[128];
+	(void)snprintf(name, sizeof(name), "%szone%u.tld%u.", prefix, i, i % 500);
+	return knot_dname_from_str_alloc(name);
+}
+
+/*! \brief Reference lookup, stripping one label at a time. */
+static zone_t *find_suffix_labels(knot_zonedb_t *db, const knot_dname_t *name)
+{
+	while (true) {
+		zone_t *zone = knot_zonedb_find(db, name);
+		if (zone != NULL || *name == '\0') {
+			return zone;
+		}
+		name = knot_wire_next_label(name, NULL);
+	}
+}
+
+static double elapsed(const struct timespec *begin)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - begin->tv_sec) + (end.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	unsigned count = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_ZONES;
+	zone_t **zones = calloc(count, sizeof(*zones));
+	knot_dname_t **qnames = calloc(count, sizeof(*qnames));
+	knot_zonedb_t *db = knot_zonedb_new();
+	ok(zones != NULL && qnames != NULL && db != NULL, "create zone database");
+	if (zones == NULL || qnames == NULL || db == NULL) {
+		return 1;
+	}
+
+	int ret = KNOT_EOK;
+	for (unsigned i = 0; i < count && ret == KNOT_EOK; i++) {
+		knot_dname_t *name = name_at("", i);
+		zones[i] = zone_new(name);
+		knot_dname_free(&name, NULL);
+		ret = (zones[i] != NULL) ? knot_zonedb_insert(db, zones[i]) : KNOT_ENOMEM;
+		/* Names a few labels deep, every eighth one out of any zone. */
+		qnames[i] = name_at((i % 8 == 0) ? "www.nx" : "www.a.b.", i);
+	}
+	ok(ret == KNOT_EOK, "insert %u zones", count);
+
+	/* Lookups in a pseudo-random order. */
+	unsigned step = 7919;
+	while (count % step == 0 && step > 1) {
+		step--;
+	}
+
+	unsigned found = 0;
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (unsigned i = 0, pos = 0; i < count; i++, pos = (pos + step) % count) {
+		zone_t *zone = knot_zonedb_find_suffix(db, qnames[pos]);
+		if (zone == ((pos % 8 == 0) ? NULL : zones[pos])) {
+			found++;
+		}
+	}
+	double secs = elapsed(&begin);
+	ok(found == count, "find_suffix");
+	diag("find_suffix: %.1f ns per lookup", secs * 1e9 / count);
+
+	found = 0;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (unsigned i = 0, pos = 0; i < count; i++, pos = (pos + step) % count) {
+		zone_t *zone = find_suffix_labels(db, qnames[pos]);
+		if (zone == ((pos % 8 == 0) ? NULL : zones[pos])) {
+			found++;
+		}
+	}
+	secs = elapsed(&begin);
+	ok(found == count, "label-by-label find");
+	diag("label-by-label find: %.1f ns per lookup", secs * 1e9 / count);
+
+	for (unsigned i = 0; i < count; i++) {
+		knot_dname_free(&qnames[i], NULL);
+		zone_free(&zones[i]);
+	}
+	free(qnames);
+	free(zones);
+	knot_zonedb_free(&db);
+
+	return 0;
+}
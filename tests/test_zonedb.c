@@ -95,6 +95,11 @@ int main(int argc, char *argv[])
 	}
 	ok(nr_passed == ZONE_COUNT, "zonedb: find zones for subnames");
 
+	/* Zero byte within a label mustn't match a zone on a misaligned prefix. */
+	dname = (knot_dname_t *)"\x05""a\0com""\x03""net";
+	ok(knot_zonedb_find_suffix(db, dname) == zones[2],
+	   "zonedb: find zone for a name with a zero byte");
+
 	/* Remove all zones. */
 	nr_passed = 0;
 	for (unsigned i = 0; i < ZONE_COUNT; ++i) {
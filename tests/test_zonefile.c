@@ -0,0 +1,173 @@
+/*  Copyright (C) 2018 CZ.NIC, z.s.p.o. <knot-dns@labs.nic.cz>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tap/basic.h>
+#include <tap/files.h>
+
+#include "test_zone.h"
+#include "knot/zone/zonefile.h"
+#include "libknot/libknot.h"
+#include "contrib/string.h"
+
+static const char *zone_str =
+	"$TTL 600\n"
+	"@ SOA ns m.example. (\n"
+	"      1    ; serial (\n"
+	"      900 300 4800 900 )\n"
+	"  NS ns\n"
+	"ns A 192.0.2.1\n"
+	"   AAAA 2001:db8::1\n"
+	"txt 300 TXT \"a ; (\" \"b\\\"c\"\n"
+	"    300 TXT ( \"multi\"\n"
+	"\"line\" )\n"
+	"$ORIGIN sub.example.\n"
+	"@ NS ns\n"
+	"ns A 192.0.2.2\n"
+	"$ORIGIN deep.sub.example.\n"
+	"$TTL 60\n"
+	"a A 192.0.2.3\n"
+	"$ORIGIN example.\n"
+	"b A 192.0.2.4\n";
+
+static const char *include_str =
+	"$TTL 120\n"
+	"i1 A 192.0.2.10\n"
+	"i2 AAAA 2001:db8::10\n"
+	"$ORIGIN inner.example.\n"
+	"i3 A 192.0.2.11\n";
+
+static zone_contents_t *load(const char *path, const knot_dname_t *origin,
+                             unsigned threads, size_t chunk_size)
+{
+	zloader_t zl;
+	if (zonefile_open(&zl, path, origin, false, 0) != KNOT_EOK) {
+		return NULL;
+	}
+
+	sem_handler_t handler = { .cb = err_handler_logger };
+	zl.err_handler = &handler;
+	zl.threads = threads;
+	zl.chunk_size = chunk_size;
+
+	zone_contents_t *contents = zonefile_load(&zl);
+	zonefile_close(&zl);
+
+	return contents;
+}
+
+static size_t node_count(const zone_contents_t *contents)
+{
+	return zone_tree_count(contents->nodes);
+}
+
+static void test_parallel(const char *path, const knot_dname_t *origin,
+                          const char *msg)
+{
+	zone_contents_t *seq = load(path, origin, 1, 0);
+	ok(seq != NULL, "%s: sequential load", msg);
+
+	const size_t chunk_sizes[] = { 1, 64, 1000 };
+	for (int i = 0; i < sizeof(chunk_sizes) / sizeof(*chunk_sizes); i++) {
+		zone_contents_t *par = load(path, origin, 4, chunk_sizes[i]);
+		ok(par != NULL && seq != NULL && contents_equal(seq, par) &&
+		   node_count(seq) == node_count(par),
+		   "%s: parallel load, chunk size %zu", msg, chunk_sizes[i]);
+		zone_contents_deep_free(&par);
+	}
+
+	zone_contents_deep_free(&seq);
+}
+
+static void interrupt_handle(int s)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	plan_lazy();
+
+	/* Parsing threads are woken up by SIGALRM. */
+	struct sigaction sa;
+	sa.sa_handler = interrupt_handle;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGALRM, &sa, NULL);
+
+	char *dir = test_mkdtemp();
+	ok(dir != NULL, "create temporary directory");
+	char *zonefile = sprintf_alloc("%s/example.zone", dir);
+	knot_dname_t *origin = knot_dname_from_str_alloc("example.");
+
+	/* Directives, parentheses, comments, and inherited owners. */
+	write_file(zonefile, zone_str, "w");
+	test_parallel(zonefile, origin, "directives");
+
+	/* Many records. */
+	for (int i = 0; i < 2000; i++) {
+		char line[128];
+		(void)snprintf(line, sizeof(line),
+		               "n%d 300 A 192.0.2.%d\n   TXT \"%d\"\n", i, i % 256, i);
+		write_file(zonefile, line, "a");
+	}
+	test_parallel(zonefile, origin, "records");
+
+	/* Directives between records, each record in its own chunk. */
+	char *include = sprintf_alloc("%s/include.zone", dir);
+	write_file(include, include_str, "w");
+	write_file(zonefile, zone_str, "w");
+	for (int i = 0; i < 20; i++) {
+		char line[512];
+		(void)snprintf(line, sizeof(line),
+		               "$ORIGIN s%d.example.\n"
+		               "a%d A 192.0.2.%d\n"
+		               "$TTL %d\n"
+		               "b%d TXT \"%d\"\n"
+		               "$INCLUDE include.zone\n"
+		               "c%d A 192.0.2.%d\n"
+		               "$INCLUDE %s i%d.example.\n"
+		               "d%d A 192.0.2.%d\n",
+		               i, i, i, 100 + i, i, i, i, i, include, i, i, i);
+		write_file(zonefile, line, "a");
+	}
+	test_parallel(zonefile, origin, "includes");
+	free(include);
+
+	/* Error in a later chunk. */
+	write_file(zonefile, "bad 300 A 192.0.2.256\nlast A 192.0.2.1\n", "a");
+	zone_contents_t *contents = load(zonefile, origin, 4, 64);
+	ok(contents == NULL, "parallel load with an error");
+
+	/* Out-of-zone record in a later chunk. */
+	write_file(zonefile, zone_str, "w");
+	write_file(zonefile, "$ORIGIN other.\nx A 192.0.2.1\n", "a");
+	contents = load(zonefile, origin, 4, 64);
+	zone_contents_t *seq = load(zonefile, origin, 1, 0);
+	ok(contents != NULL && seq != NULL && contents_equal(seq, contents),
+	   "parallel load with an out-of-zone record");
+	zone_contents_deep_free(&seq);
+	zone_contents_deep_free(&contents);
+
+	knot_dname_free(&origin, NULL);
+	free(zonefile);
+	test_rm_rf(dir);
+	free(dir);
+
+	return 0;
+}